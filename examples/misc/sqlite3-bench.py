@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+#
+# Compares SQLite3 plugin write throughput across journaling and statement
+# modes. For each mode a fresh database is created, nfacctd is started and
+# fed synthetic NetFlow v5 flows twice: the first purge INSERTs all rows,
+# the second one UPDATEs them. Throughput is read from the "purge throughput"
+# debug line logged by the plugin.
+#
+
+import sys, os, getopt, re, signal, socket, sqlite3, struct, subprocess, tempfile, time
+
+MODES = [
+	("plain", {}),
+	("wal", { "sql_wal": "true" }),
+	("wal+prepared", { "sql_wal": "true", "sql_use_prepared": "true" }),
+]
+
+SCHEMA = "CREATE TABLE acct (ip_src CHAR(45) NOT NULL DEFAULT '0.0.0.0', ip_dst CHAR(45) NOT NULL DEFAULT '0.0.0.0', \
+src_port INT NOT NULL DEFAULT 0, dst_port INT NOT NULL DEFAULT 0, packets INT NOT NULL, bytes BIGINT NOT NULL, \
+stamp_inserted DATETIME NOT NULL, stamp_updated DATETIME, PRIMARY KEY (ip_src, ip_dst, src_port, dst_port, stamp_inserted))"
+
+THROUGHPUT_RE = re.compile(r"purge throughput: (\d+) rows in (\d+) ms \((\d+) rows/s\)")
+
+def usage(tool):
+	print("")
+	print("Usage: %s [options]" % tool)
+	print("")
+	print("  -n, --nfacctd".ljust(25) + "Path to the nfacctd binary [default: nfacctd]")
+	print("  -f, --flows".ljust(25) + "Number of distinct flows to send [default: 50000]")
+	print("  -p, --port".ljust(25) + "UDP port nfacctd listens on [default: 20555]")
+	print("  -r, --refresh".ljust(25) + "sql_refresh_time, in secs [default: 5]")
+	print("")
+	print("  -h, --help".ljust(25) + "Print this help")
+
+def send_flows(port, flows):
+	sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+	seq = 0
+
+	for base in range(0, flows, 30):
+		count = min(30, flows - base)
+		recs = b""
+
+		for idx in range(base, base + count):
+			recs += struct.pack("!IIIHHIIIIHHBBBBHHBBH", 0x0a000000 + (idx >> 16), 0x0b000000 + (idx & 0xffff),
+					0, 1, 2, 1, 100, 1000, 1000, 1024 + (idx % 7), 80, 0, 0, 6, 0, 0, 0, 24, 24, 0)
+
+		hdr = struct.pack("!HHIIIIBBH", 5, count, 1000, int(time.time()), 0, seq, 0, 0, 0)
+		sock.sendto(hdr + recs, ("127.0.0.1", port))
+		seq += count
+
+		# leave the collector some room, flows are sent over UDP
+		time.sleep(0.0002)
+
+def run_mode(nfacctd, workdir, name, keys, flows, port, refresh):
+	db = os.path.join(workdir, "%s.db" % name.replace("+", "_"))
+	conf = os.path.join(workdir, "%s.conf" % name.replace("+", "_"))
+	log = os.path.join(workdir, "%s.log" % name.replace("+", "_"))
+
+	conn = sqlite3.connect(db)
+	conn.execute(SCHEMA)
+	conn.close()
+
+	with open(conf, "w") as f:
+		f.write("daemonize: false\ndebug: true\n")
+		f.write("nfacctd_ip: 127.0.0.1\nnfacctd_port: %d\n" % port)
+		f.write("plugins: sqlite3\naggregate: src_host, dst_host, src_port, dst_port\n")
+		f.write("sql_db: %s\nsql_table: acct\nsql_optimize_clauses: true\n" % db)
+		f.write("sql_history: 1h\nsql_history_roundoff: h\nsql_refresh_time: %d\n" % refresh)
+		f.write("plugin_pipe_size: 102400000\nplugin_buffer_size: 10240\n")
+		f.write("sql_cache_entries: %d\n" % (flows * 2 + 1))
+		for key, value in keys.items():
+			f.write("%s: %s\n" % (key, value))
+
+	with open(log, "w") as f:
+		proc = subprocess.Popen([nfacctd, "-f", conf], stdout=f, stderr=subprocess.STDOUT, start_new_session=True)
+
+	try:
+		time.sleep(1)
+		for _ in range(2):
+			send_flows(port, flows)
+			time.sleep(refresh * 2)
+	finally:
+		# both purges are in the log by now, no need for a graceful shutdown
+		os.killpg(proc.pid, signal.SIGKILL)
+		proc.wait()
+
+	results = []
+	with open(log) as f:
+		for line in f:
+			match = THROUGHPUT_RE.search(line)
+			if match and int(match.group(1)): results.append(match.groups())
+
+	return results
+
+def main():
+	try:
+		opts, args = getopt.getopt(sys.argv[1:], "n:f:p:r:h", ["nfacctd=", "flows=", "port=", "refresh=", "help"])
+	except getopt.GetoptError as err:
+		print(str(err))
+		usage(sys.argv[0])
+		sys.exit(2)
+
+	nfacctd = "nfacctd"
+	flows = 50000
+	port = 20555
+	refresh = 5
+
+	for o, a in opts:
+		if o in ("-h", "--help"):
+			usage(sys.argv[0])
+			sys.exit(0)
+		elif o in ("-n", "--nfacctd"):
+			nfacctd = a
+		elif o in ("-f", "--flows"):
+			flows = int(a)
+		elif o in ("-p", "--port"):
+			port = int(a)
+		elif o in ("-r", "--refresh"):
+			refresh = int(a)
+
+	workdir = tempfile.mkdtemp(prefix="sqlite3-bench.")
+	print("Working directory: %s" % workdir)
+	print("%-15s %-8s %10s %10s %12s" % ("mode", "round", "rows", "ms", "rows/s"))
+
+	for name, keys in MODES:
+		results = run_mode(nfacctd, workdir, name, keys, flows, port, refresh)
+		if not results:
+			print("%-15s no purge logged, see %s" % (name, workdir))
+			continue
+
+		for idx, (rows, ms, rate) in enumerate(results):
+			print("%-15s %-8s %10s %10s %12s" % (name, "insert" if not idx else "update", rows, ms, rate))
+		sys.stdout.flush()
+
+if __name__ == "__main__":
+	main()
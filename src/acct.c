@@ -25,8 +25,13 @@
 #include "crc32.h"
 #include "bgp/bgp.h"
 
+/* global variables */
+struct imt_rcu imt_rcu;
+struct imt_index imt_index;
+struct imt_epoch *imt_epoch;
+
 /* functions */
-struct acc *search_accounting_structure(struct primitives_ptrs *prim_ptrs)
+struct acc *search_accounting_structure(struct acc *table, struct primitives_ptrs *prim_ptrs)
 {
   struct pkt_data *data = prim_ptrs->data;
   struct pkt_primitives *addr = &data->primitives;
@@ -59,14 +64,14 @@ struct acc *search_accounting_structure(struct primitives_ptrs *prim_ptrs)
 
   Log(LOG_DEBUG, "DEBUG ( %s/%s ): Selecting bucket %u.\n", config.name, config.type, pos);
 
-  elem_acc = (struct acc *) a;
+  elem_acc = table;
   elem_acc += pos;  
   
   while (elem_acc) {
     if (elem_acc->signature == hash) {
       if (compare_accounting_structure(elem_acc, prim_ptrs) == 0) return elem_acc;
     }
-    elem_acc = elem_acc->next;
+    elem_acc = IMT_ACC_NEXT(elem_acc);
   } 
 
   return NULL;
@@ -119,6 +124,67 @@ int compare_accounting_structure(struct acc *elem, struct primitives_ptrs *prim_
   return res_data | res_bgp | res_lbgp | res_nat | res_mpls | res_tun | res_cust | res_vlen;
 }
 
+/* to be called once the element is fully updated: readers loading the
+   epoch of the table are then guaranteed to see the element as of it */
+static void touch_accounting_structure(struct acc *elem_acc)
+{
+  u_int64_t epoch = (imt_epoch->current + 1);
+
+  __atomic_store_n(&elem_acc->epoch, epoch, __ATOMIC_RELAXED);
+  __atomic_store_n(&imt_epoch->current, epoch, __ATOMIC_RELEASE);
+}
+
+static void update_accounting_structure(struct acc *elem_acc, struct pkt_data *data)
+{
+  if (elem_acc->reset_flag) reset_counters(elem_acc);
+  elem_acc->packet_counter += data->pkt_num;
+  elem_acc->flow_counter += data->flo_num;
+  elem_acc->bytes_counter += data->pkt_len;
+  elem_acc->tcp_flags |= data->tcp_flags;
+  elem_acc->flow_type = data->flow_type;
+  if (config.what_to_count & COUNT_CLASS) {
+    elem_acc->packet_counter += data->cst.pa;
+    elem_acc->bytes_counter += data->cst.ba;
+    elem_acc->flow_counter += data->cst.fa;
+  }
+  touch_accounting_structure(elem_acc);
+}
+
+/* with query threads, an element readers may have seen can be reused,
+   and its extras freed, only once they are all done with it, that is a
+   grace period after it was hidden; until then it is skipped as if in
+   use. Never used elements have a zero epoch and are reusable at once */
+static int reusable_accounting_structure(struct acc *elem_acc)
+{
+  if (!config.imt_query_threads) return TRUE;
+
+  /* zeroed by subtracting accumulators, but still visible */
+  if (elem_acc->flow_type) {
+    __atomic_store_n(&elem_acc->flow_type, 0, __ATOMIC_RELEASE);
+    touch_accounting_structure(elem_acc);
+  }
+
+  if (elem_acc->epoch > imt_rcu.safe) imt_rcu_poll();
+
+  return (elem_acc->epoch <= imt_rcu.safe);
+}
+
+/* makes sure the current memory pool can fit 'size' bytes */
+static int reserve_accounting_structure(int size)
+{
+  if (no_more_space) return FALSE;
+  if (current_pool->space_left >= size) return TRUE;
+
+  current_pool = request_memory_pool(config.memory_pool_size);
+  if (current_pool == NULL) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to allocate more memory pools, clear stats manually!\n", config.name, config.type);
+    no_more_space = TRUE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 {
   struct pkt_data *data = prim_ptrs->data;
@@ -130,7 +196,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
   struct pkt_tunnel_primitives *ptun = prim_ptrs->ptun;
   u_char *pcust = prim_ptrs->pcust;
   struct pkt_vlen_hdr_primitives *pvlen = prim_ptrs->pvlen;
-  struct acc *elem_acc;
+  struct acc *elem_acc, *prev_acc;
   unsigned char *elem, *new_elem;
   int solved = FALSE;
   unsigned int hash, pos;
@@ -150,7 +216,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
     pm_class_t lclass = data->primitives.class;
 
     data->primitives.class = 0;
-    elem_acc = search_accounting_structure(prim_ptrs);
+    elem_acc = search_accounting_structure((struct acc *) a, prim_ptrs);
     data->primitives.class = lclass;
 
     /* We can assign the flow to a new class only if we are able to subtract
@@ -164,6 +230,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
         elem_acc->bytes_counter -= MIN(elem_acc->bytes_counter, data->cst.ba);
         elem_acc->packet_counter -= MIN(elem_acc->packet_counter, data->cst.pa);
         elem_acc->flow_counter -= MIN(elem_acc->flow_counter, data->cst.fa);
+        touch_accounting_structure(elem_acc);
       } 
       else memset(&data->cst, 0, CSSz);
     }
@@ -187,21 +254,19 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
      1st stage: compare data with last used element;
      2nd stage: compare data with elements in the table, following chains
   */
-  if (lru_elem_ptr[pos]) {
+  if (imt_index.entries) {
+    /* the index knows about all elements: a miss means a new one */
+    elem_acc = imt_index_lookup(hash, prim_ptrs);
+    if (elem_acc) {
+      update_accounting_structure(elem_acc, data);
+      return;
+    }
+  }
+  else if (lru_elem_ptr[pos]) {
     elem_acc = lru_elem_ptr[pos];
     if (elem_acc->signature == hash) {
       if (compare_accounting_structure(elem_acc, prim_ptrs) == 0) { 
-        if (elem_acc->reset_flag) reset_counters(elem_acc);
-        elem_acc->packet_counter += data->pkt_num;
-        elem_acc->flow_counter += data->flo_num;
-        elem_acc->bytes_counter += data->pkt_len;
-	elem_acc->tcp_flags |= data->tcp_flags;
-        elem_acc->flow_type = data->flow_type; 
-        if (config.what_to_count & COUNT_CLASS) {
-          elem_acc->packet_counter += data->cst.pa;
-          elem_acc->bytes_counter += data->cst.ba;
-          elem_acc->flow_counter += data->cst.fa;
-        }
+        update_accounting_structure(elem_acc, data);
         return;
       }
     }
@@ -213,28 +278,26 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
   while (solved == FALSE) {
     if (elem_acc->signature == hash) {
       if (compare_accounting_structure(elem_acc, prim_ptrs) == 0) {
-        if (elem_acc->reset_flag) reset_counters(elem_acc);
-        elem_acc->packet_counter += data->pkt_num;
-        elem_acc->flow_counter += data->flo_num;
-        elem_acc->bytes_counter += data->pkt_len;
-	elem_acc->tcp_flags |= data->tcp_flags;
-        elem_acc->flow_type = data->flow_type;
-	if (config.what_to_count & COUNT_CLASS) {
-	  elem_acc->packet_counter += data->cst.pa;
-	  elem_acc->bytes_counter += data->cst.ba;
-          elem_acc->flow_counter += data->cst.fa;
-	}
+        update_accounting_structure(elem_acc, data);
         lru_elem_ptr[pos] = elem_acc;
         return;
       }
     }
-    if (!elem_acc->bytes_counter && !elem_acc->packet_counter) { /* hmmm */
+    if (!elem_acc->bytes_counter && !elem_acc->packet_counter && reusable_accounting_structure(elem_acc)) { /* hmmm */
+      if (imt_index.entries) {
+	/* extras of an element are allocated on its first use and then kept */
+	if (imt_index.extras_len && !elem_acc->pbgp && !elem_acc->pnat && !elem_acc->pmpls &&
+	    !elem_acc->ptun && !elem_acc->pcust && !reserve_accounting_structure(imt_index.extras_len)) return;
+
+	imt_index_del(elem_acc->signature, elem_acc);
+      }
+
       if (elem_acc->reset_flag) elem_acc->reset_flag = FALSE; 
       memcpy(&elem_acc->primitives, addr, sizeof(struct pkt_primitives));
 
       if (pbgp) {
         if (!elem_acc->pbgp) {
-          elem_acc->pbgp = (struct pkt_bgp_primitives *) malloc(pb_size);
+          elem_acc->pbgp = (struct pkt_bgp_primitives *) imt_extras_alloc(pb_size);
           if (!elem_acc->pbgp) {
             Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
             exit_gracefully(1);
@@ -242,10 +305,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
         }
         memcpy(elem_acc->pbgp, pbgp, pb_size);
       }
-      else {
-        if (elem_acc->pbgp) free(elem_acc->pbgp);
-        elem_acc->pbgp = NULL;
-      }
+      else elem_acc->pbgp = imt_extras_release(elem_acc->pbgp, pb_size);
 
       if (plbgp) {
         if (!elem_acc->clbgp) {
@@ -263,7 +323,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 
       if (pnat) {
 	if (!elem_acc->pnat) {
-	  elem_acc->pnat = (struct pkt_nat_primitives *) malloc(pn_size);
+	  elem_acc->pnat = (struct pkt_nat_primitives *) imt_extras_alloc(pn_size);
 	  if (!elem_acc->pnat) {
             Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
             exit_gracefully(1);
@@ -271,14 +331,11 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 	}
 	memcpy(elem_acc->pnat, pnat, pn_size);
       }
-      else {
-	if (elem_acc->pnat) free(elem_acc->pnat);
-	elem_acc->pnat = NULL;
-      }
+      else elem_acc->pnat = imt_extras_release(elem_acc->pnat, pn_size);
 
       if (pmpls) {
 	if (!elem_acc->pmpls) {
-	  elem_acc->pmpls = (struct pkt_mpls_primitives *) malloc(pm_size);
+	  elem_acc->pmpls = (struct pkt_mpls_primitives *) imt_extras_alloc(pm_size);
 	  if (!elem_acc->pmpls) {
             Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
             exit_gracefully(1);
@@ -286,14 +343,11 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 	}
         memcpy(elem_acc->pmpls, pmpls, pm_size);
       }
-      else {
-	if (elem_acc->pmpls) free(elem_acc->pmpls);
-	elem_acc->pmpls = NULL;
-      }
+      else elem_acc->pmpls = imt_extras_release(elem_acc->pmpls, pm_size);
 
       if (ptun) {
 	if (!elem_acc->ptun) {
-	  elem_acc->ptun = (struct pkt_tunnel_primitives *) malloc(pt_size);
+	  elem_acc->ptun = (struct pkt_tunnel_primitives *) imt_extras_alloc(pt_size);
 	  if (!elem_acc->ptun) {
             Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
             exit_gracefully(1);
@@ -301,14 +355,11 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 	}
 	memcpy(elem_acc->ptun, ptun, pt_size);
       }
-      else {
-	if (elem_acc->ptun) free(elem_acc->ptun);
-	elem_acc->ptun = NULL;
-      }
+      else elem_acc->ptun = imt_extras_release(elem_acc->ptun, pt_size);
 
       if (pcust) {
 	if (!elem_acc->pcust) {
-	  elem_acc->pcust = malloc(pc_size);
+	  elem_acc->pcust = imt_extras_alloc(pc_size);
 	  if (!elem_acc->pcust) {
             Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
             exit_gracefully(1);
@@ -316,10 +367,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
 	}
         memcpy(elem_acc->pcust, pcust, pc_size);
       }
-      else {
-	if (elem_acc->pcust) free(elem_acc->pcust);
-	elem_acc->pcust = NULL;
-      }
+      else elem_acc->pcust = imt_extras_release(elem_acc->pcust, pc_size);
 
       /* if we have a pvlen from before let's free it up due to the vlen nature of the memory area */
       if (elem_acc->pvlen) {
@@ -341,13 +389,18 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
       elem_acc->flow_counter += data->flo_num;
       elem_acc->bytes_counter += data->pkt_len;
       elem_acc->tcp_flags |= data->tcp_flags;
-      elem_acc->flow_type = data->flow_type;
       elem_acc->signature = hash;
       if (config.what_to_count & COUNT_CLASS) {
         elem_acc->packet_counter += data->cst.pa;
         elem_acc->bytes_counter += data->cst.ba;
         elem_acc->flow_counter += data->cst.fa;
       }
+      if (imt_index.entries) imt_index_add(hash, elem_acc);
+
+      /* a recycled element is hidden to readers (see test_zero_elem())
+	 until flow_type is set: do it last */
+      __atomic_store_n(&elem_acc->flow_type, data->flow_type, __ATOMIC_RELEASE);
+      touch_accounting_structure(elem_acc);
       lru_elem_ptr[pos] = elem_acc;
       return;
     }
@@ -366,31 +419,19 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
       /* We have to allocate new space for this address */
       Log(LOG_DEBUG, "DEBUG ( %s/%s ): Creating new element.\n", config.name, config.type);
 
-      if (current_pool->space_left >= sizeof(struct acc)) {
-        new_elem = current_pool->ptr;
-	current_pool->space_left -= sizeof(struct acc);
-	current_pool->ptr += sizeof(struct acc);
-      }
-      else {
-        current_pool = request_memory_pool(config.memory_pool_size); 
-	if (current_pool == NULL) {
-          Log(LOG_WARNING, "WARN ( %s/%s ): Unable to allocate more memory pools, clear stats manually!\n", config.name, config.type);
-	  no_more_space = TRUE;
-	  return;
-        }
-        else {
-          new_elem = current_pool->ptr;
-          current_pool->space_left -= sizeof(struct acc);
-          current_pool->ptr += sizeof(struct acc);
-	}
-      }
+      /* with the open layout, extras are carved right after the element */
+      if (!reserve_accounting_structure(sizeof(struct acc) + imt_index.extras_len)) return;
+
+      new_elem = current_pool->ptr;
+      current_pool->space_left -= sizeof(struct acc);
+      current_pool->ptr += sizeof(struct acc);
 
-      elem_acc->next = (struct acc *) new_elem;
+      prev_acc = elem_acc;
       elem_acc = (struct acc *) new_elem;
       memcpy(&elem_acc->primitives, addr, sizeof(struct pkt_primitives));
 
       if (pbgp) {
-        elem_acc->pbgp = (struct pkt_bgp_primitives *) malloc(pb_size);
+        elem_acc->pbgp = (struct pkt_bgp_primitives *) imt_extras_alloc(pb_size);
         if (!elem_acc->pbgp) {
           Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
           exit_gracefully(1);
@@ -411,7 +452,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
       else elem_acc->clbgp = NULL;
 
       if (pnat) {
-        elem_acc->pnat = (struct pkt_nat_primitives *) malloc(pn_size);
+        elem_acc->pnat = (struct pkt_nat_primitives *) imt_extras_alloc(pn_size);
 	if (!elem_acc->pnat) {
           Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
           exit_gracefully(1);
@@ -421,7 +462,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
       else elem_acc->pnat = NULL;
 
       if (pmpls) {
-        elem_acc->pmpls = (struct pkt_mpls_primitives *) malloc(pm_size);
+        elem_acc->pmpls = (struct pkt_mpls_primitives *) imt_extras_alloc(pm_size);
 	if (!elem_acc->pmpls) {
           Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
           exit_gracefully(1);
@@ -431,7 +472,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
       else elem_acc->pmpls = NULL;
 
       if (ptun) {
-        elem_acc->ptun = (struct pkt_tunnel_primitives *) malloc(pt_size);
+        elem_acc->ptun = (struct pkt_tunnel_primitives *) imt_extras_alloc(pt_size);
 	if (!elem_acc->ptun) {
           Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
           exit_gracefully(1);
@@ -441,7 +482,7 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
       else elem_acc->ptun = NULL;
 
       if (pcust) {
-        elem_acc->pcust = malloc(pc_size);
+        elem_acc->pcust = imt_extras_alloc(pc_size);
 	if (!elem_acc->pcust) {
           Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (insert_accounting_structure). Exiting ..\n", config.name, config.type);
           exit_gracefully(1);
@@ -478,15 +519,206 @@ void insert_accounting_structure(struct primitives_ptrs *prim_ptrs)
         elem_acc->flow_counter += data->cst.fa;
       }
       elem_acc->next = NULL;
+      touch_accounting_structure(elem_acc);
       lru_elem_ptr[pos] = elem_acc;
+      if (imt_index.entries) imt_index_add(hash, elem_acc);
+
+      /* chaining the new element only once complete, readers may be
+	 walking the collision chain concurrently */
+      __atomic_store_n(&prev_acc->next, elem_acc, __ATOMIC_RELEASE);
+      return;
+    }
+  }
+}
+
+/* fixed-size extras (BGP, NAT, MPLS, tunnel and custom primitives) are
+   carved from memory pools with the open layout: they then sit next to
+   their element and are released all at once when the table is erased */
+void *imt_extras_alloc(int size)
+{
+  void *ptr;
+
+  if (!imt_index.entries) return malloc(size);
+
+  size = IMT_EXTRAS_ALIGN(size);
+  if (!current_pool || current_pool->space_left < size) return NULL;
+
+  ptr = current_pool->ptr;
+  current_pool->space_left -= size;
+  current_pool->ptr += size;
+
+  return ptr;
+}
+
+void imt_extras_free(void *ptr)
+{
+  if (!imt_index.entries) free(ptr);
+}
+
+/* releases the extras of an element being recycled; with the open layout
+   they can't be handed back to the pools, so they are kept, zeroed, and
+   reused in place by the next use of the element */
+void *imt_extras_release(void *ptr, int size)
+{
+  if (!ptr) return NULL;
+
+  if (imt_index.entries) {
+    memset(ptr, 0, size);
+    return ptr;
+  }
+
+  free(ptr);
+  return NULL;
+}
+
+void imt_index_init(u_int32_t buckets, u_int32_t extras_len)
+{
+  memset(&imt_index, 0, sizeof(imt_index));
+
+  for (imt_index.size = 1024; imt_index.size < (buckets * 2); imt_index.size <<= 1);
+
+  imt_index.entries = calloc(imt_index.size, sizeof(struct imt_index_entry));
+  if (!imt_index.entries) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (imt_index_init). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  imt_index.extras_len = extras_len;
+}
+
+void imt_index_clear()
+{
+  memset(imt_index.entries, 0, imt_index.size * sizeof(struct imt_index_entry));
+  imt_index.used = 0;
+  imt_index.deleted = 0;
+}
+
+static void imt_index_resize(u_int32_t size)
+{
+  struct imt_index_entry *old = imt_index.entries;
+  u_int32_t idx, old_size = imt_index.size;
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): Resizing index to %u entries.\n", config.name, config.type, size);
+
+  imt_index.entries = calloc(size, sizeof(struct imt_index_entry));
+  if (!imt_index.entries) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (imt_index_resize). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  imt_index.size = size;
+  imt_index.used = 0;
+  imt_index.deleted = 0;
+
+  for (idx = 0; idx < old_size; idx++) {
+    if (old[idx].elem && old[idx].elem != IMT_INDEX_DELETED) imt_index_add(old[idx].signature, old[idx].elem);
+  }
+
+  free(old);
+}
+
+/* linear probing; the index is kept at most 3/4 full so that probes
+   always end on an empty slot */
+struct acc *imt_index_lookup(u_int32_t hash, struct primitives_ptrs *prim_ptrs)
+{
+  struct imt_index_entry *entry;
+  u_int32_t mask = imt_index.size - 1, pos;
+
+  for (pos = (hash & mask); ; pos = ((pos + 1) & mask)) {
+    entry = &imt_index.entries[pos];
+
+    if (!entry->elem) return NULL;
+    if (entry->signature == hash && entry->elem != IMT_INDEX_DELETED &&
+	!compare_accounting_structure(entry->elem, prim_ptrs)) return entry->elem;
+  }
+}
+
+void imt_index_add(u_int32_t hash, struct acc *elem)
+{
+  struct imt_index_entry *entry;
+  u_int32_t mask, pos;
+
+  if (((imt_index.used + imt_index.deleted + 1) * 4) > (imt_index.size * 3)) {
+    /* grow unless it is mostly about reclaiming deleted entries */
+    if ((imt_index.used * 2) >= imt_index.size) imt_index_resize(imt_index.size * 2);
+    else imt_index_resize(imt_index.size);
+  }
+
+  mask = imt_index.size - 1;
+
+  for (pos = (hash & mask); ; pos = ((pos + 1) & mask)) {
+    entry = &imt_index.entries[pos];
+
+    if (!entry->elem || entry->elem == IMT_INDEX_DELETED) {
+      if (entry->elem == IMT_INDEX_DELETED) imt_index.deleted--;
+      entry->signature = hash;
+      entry->elem = elem;
+      imt_index.used++;
       return;
     }
   }
 }
 
+void imt_index_del(u_int32_t hash, struct acc *elem)
+{
+  struct imt_index_entry *entry;
+  u_int32_t mask = imt_index.size - 1, pos;
+
+  for (pos = (hash & mask); ; pos = ((pos + 1) & mask)) {
+    entry = &imt_index.entries[pos];
+
+    if (!entry->elem) return;
+    if (entry->elem == elem) {
+      entry->elem = IMT_INDEX_DELETED;
+      imt_index.used--;
+      imt_index.deleted++;
+      return;
+    }
+  }
+}
+
+/* re-indexes the elements of a table restored from imt_table_file */
+void imt_index_rebuild(struct acc *table)
+{
+  struct acc *elem_acc;
+  unsigned int idx;
+
+  for (idx = 0; idx < config.buckets; idx++) {
+    for (elem_acc = (table + idx); elem_acc; elem_acc = elem_acc->next) {
+      if (elem_acc->bytes_counter || elem_acc->packet_counter) imt_index_add(elem_acc->signature, elem_acc);
+    }
+  }
+}
+
+void imt_epoch_init()
+{
+  /* a table restored from imt_table_file carries on with its epoch */
+  if (imt_file) {
+    imt_epoch = &imt_file->epoch;
+    return;
+  }
+
+  imt_epoch = map_shared(0, sizeof(struct imt_epoch), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  if (imt_epoch == MAP_FAILED) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate the table epoch. Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  memset(imt_epoch, 0, sizeof(struct imt_epoch));
+}
+
+/* changes since an epoch up to this one can't be told anymore */
+void imt_epoch_erase()
+{
+  imt_epoch->erased = imt_epoch->current;
+  __atomic_store_n(&imt_epoch->current, (imt_epoch->erased + 1), __ATOMIC_RELEASE);
+}
+
 void set_reset_flag(struct acc *elem)
 {
-  elem->reset_flag = TRUE;
+  /* may be called by reader threads: the reset is then carried out by
+     the plugin on the next insert */
+  __atomic_store_n(&elem->reset_flag, TRUE, __ATOMIC_RELAXED);
 }
 
 void reset_counters(struct acc *elem)
@@ -495,6 +727,76 @@ void reset_counters(struct acc *elem)
   elem->packet_counter = 0;
   elem->bytes_counter = 0;
   elem->tcp_flags = 0;
-  elem->flow_type = 0;
+  __atomic_store_n(&elem->flow_type, 0, __ATOMIC_RELEASE);
   memcpy(&elem->rstamp, &cycle_stamp, sizeof(struct timeval));
+
+  /* stamps the time it was hidden, see reusable_accounting_structure() */
+  touch_accounting_structure(elem);
+}
+
+/*
+   Readers (query threads) walk the table without locks while the plugin
+   keeps aggregating into it: new elements and recycled ones are made
+   visible only once complete. Erasing the table is the only operation
+   that needs readers out of the way: imt_rcu_unpublish() hides the table
+   to new readers, then waits for a grace period, ie. for readers which
+   may still hold a reference to it to be done. Readers are counted per
+   epoch; flipping the epoch makes sure only pre-existing readers are
+   waited for. Elements hidden by the plugin are reused once a grace
+   period is over too, which imt_rcu_poll() tells without waiting.
+   Readers copy replies out (see enQueue_spool_send()) so that no socket
+   I/O holds a grace period up.
+*/
+void imt_rcu_publish(struct acc *table)
+{
+  __atomic_store_n(&imt_rcu.table, table, __ATOMIC_SEQ_CST);
+}
+
+void imt_rcu_unpublish()
+{
+  u_int32_t old;
+
+  __atomic_store_n(&imt_rcu.table, NULL, __ATOMIC_SEQ_CST);
+
+  old = (__atomic_fetch_add(&imt_rcu.epoch, 1, __ATOMIC_SEQ_CST) & 1);
+  while (__atomic_load_n(&imt_rcu.readers[old], __ATOMIC_SEQ_CST)) usleep(100);
+}
+
+struct acc *imt_rcu_read_lock(u_int32_t *epoch)
+{
+  struct acc *table;
+
+  for (;;) {
+    (*epoch) = (__atomic_load_n(&imt_rcu.epoch, __ATOMIC_SEQ_CST) & 1);
+    __atomic_add_fetch(&imt_rcu.readers[(*epoch)], 1, __ATOMIC_SEQ_CST);
+
+    if ((__atomic_load_n(&imt_rcu.epoch, __ATOMIC_SEQ_CST) & 1) == (*epoch)) {
+      table = __atomic_load_n(&imt_rcu.table, __ATOMIC_SEQ_CST);
+      if (table) return table;
+
+      /* table is being erased */
+      __atomic_sub_fetch(&imt_rcu.readers[(*epoch)], 1, __ATOMIC_SEQ_CST);
+      usleep(1000);
+    }
+    else __atomic_sub_fetch(&imt_rcu.readers[(*epoch)], 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void imt_rcu_read_unlock(u_int32_t epoch)
+{
+  __atomic_sub_fetch(&imt_rcu.readers[epoch], 1, __ATOMIC_SEQ_CST);
+}
+
+/* non-blocking grace period detection: once readers from before the
+   last flip are gone, changes made up to that flip are no longer seen
+   by anybody; a new flip is then started */
+void imt_rcu_poll()
+{
+  u_int32_t epoch = __atomic_load_n(&imt_rcu.epoch, __ATOMIC_SEQ_CST);
+
+  if (!__atomic_load_n(&imt_rcu.readers[(epoch - 1) & 1], __ATOMIC_SEQ_CST)) {
+    imt_rcu.safe = imt_rcu.mark;
+    imt_rcu.mark = __atomic_load_n(&imt_epoch->current, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&imt_rcu.epoch, 1, __ATOMIC_SEQ_CST);
+  }
 }
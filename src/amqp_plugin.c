@@ -554,6 +554,8 @@ void amqp_cache_purge(struct chained_cache *queue[], int index, int safe_action)
 			   pvlen, queue[j]->bytes_counter, queue[j]->packet_counter,
 			   queue[j]->flow_counter, queue[j]->tcp_flags, &queue[j]->basetime,
 			   queue[j]->stitch, avro_iface);
+
+      if (config.distinct_what_to_count) add_distinct_count_avro(avro_value, queue[j]->flow_type, P_cache_distinct_count(queue[j]));
       add_writer_name_and_pid_avro(avro_value, config.name, writer_pid);
 
       if (config.message_broker_output & PRINT_OUTPUT_AVRO_BIN) {
@@ -27,6 +27,7 @@
 #include "rpki/rpki.h"
 #include "bgp_blackhole.h"
 #include "thread_pool.h"
+#include "evloop.h"
 #if defined WITH_RABBITMQ
 #include "amqp_common.h"
 #endif
@@ -41,7 +42,8 @@
 #endif
 
 /* Global variables */
-thread_pool_t *bgp_pool;
+thread_pool_t *bgp_pool, *bgp_workers_pool;
+struct bgp_worker *bgp_workers;
 struct bgp_peer *peers;
 struct bgp_peer_cache_bucket *peers_cache, *peers_port_cache;
 char *std_comm_patterns[MAX_BGP_COMM_PATTERNS];
@@ -55,6 +57,9 @@ u_int32_t (*bgp_route_info_modulo)(struct bgp_peer *, path_id_t *, int);
 struct bgp_rt_structs inter_domain_routing_dbs[FUNC_TYPE_MAX], *bgp_routing_db;
 struct bgp_misc_structs inter_domain_misc_dbs[FUNC_TYPE_MAX], *bgp_misc_db;
 struct bgp_xconnects bgp_xcs_map;
+u_int64_t bgp_rib_gen;
+volatile sig_atomic_t bgp_shutdown;
+static int bgp_shutdown_pipe[2];
 
 /* Functions */
 void nfacctd_bgp_wrapper()
@@ -83,7 +88,6 @@ void skinny_bgp_daemon_online()
 #if (defined IPV6_BINDV6ONLY)
   int no=0;
 #endif
-  int peers_idx_rr = 0, peers_xconnect_idx_rr = 0, max_peers_idx = 0;
   struct plugin_requests req;
   struct host_addr addr;
   struct bgp_peer *peer;
@@ -101,14 +105,22 @@ void skinny_bgp_daemon_online()
 
   sigset_t signal_set;
 
-  /* select() stuff */
-  fd_set read_descs, bkp_read_descs; 
-  int fd, select_fd, bkp_select_fd, recalc_fds, select_num;
+  /* event loop stuff */
+  struct pm_evloop bgp_evloop;
+  int fd, select_num, reads;
   int recv_fd, send_fd;
+  int snapshot_timeout;
+
+  /* signals are for the core process to handle, see bgp_daemon_shutdown_request() */
+  if (bgp_misc_db->is_thread) {
+    sigfillset(&signal_set);
+    pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
+  }
 
   /* initial cleanups */
   reload_map_bgp_thread = FALSE;
   reload_log_bgp_thread = FALSE;
+  print_stats_bgp_thread = FALSE;
   memset(&server, 0, sizeof(server));
   memset(&client, 0, sizeof(client));
   memset(&allow, 0, sizeof(struct hosts_table));
@@ -272,6 +284,12 @@ void skinny_bgp_daemon_online()
       Log(LOG_ERR, "ERROR ( %s/%s ): bgp_table_dump_file, bgp_table_dump_amqp_routing_key and bgp_table_dump_kafka_topic are mutually exclusive. Terminating thread.\n", config.name, bgp_misc_db->log_str);
       exit_gracefully(1);
     }
+
+    /* writers would overwrite each other's files */
+    if (config.bgp_table_dump_workers > 1 && config.bgp_table_dump_file && !strstr(config.bgp_table_dump_file, "$peer_src_ip")) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): bgp_table_dump_workers requires $peer_src_ip in bgp_table_dump_file. Forced to 1.\n", config.name, bgp_misc_db->log_str);
+      config.bgp_table_dump_workers = 1;
+    }
   }
 
   if ((bgp_misc_db->msglog_backend_methods || bgp_misc_db->dump_backend_methods) && config.bgp_xconnect_map) {
@@ -279,6 +297,14 @@ void skinny_bgp_daemon_online()
     exit_gracefully(1);
   }
 
+  /* shared RIB: routes of all peers are in the same bucket */
+  if (config.bgp_table_shared_paths) {
+    if (config.bgp_table_peer_buckets > 1)
+      Log(LOG_WARNING, "WARN ( %s/%s ): bgp_table_shared_paths set: bgp_table_peer_buckets forced to 1.\n", config.name, bgp_misc_db->log_str);
+
+    config.bgp_table_peer_buckets = 1;
+  }
+
   if (!config.bgp_table_peer_buckets) config.bgp_table_peer_buckets = DEFAULT_BGP_INFO_HASH;
   if (!config.bgp_table_per_peer_buckets) config.bgp_table_per_peer_buckets = DEFAULT_BGP_INFO_PER_PEER_HASH;
 
@@ -358,9 +384,11 @@ void skinny_bgp_daemon_online()
   }
 
   /* Preparing for syncronous I/O multiplexing */
-  select_fd = 0;
-  FD_ZERO(&bkp_read_descs);
-  FD_SET(config.bgp_sock, &bkp_read_descs);
+  if (pm_evloop_init(&bgp_evloop) == ERR || pm_evloop_add(&bgp_evloop, config.bgp_sock, NULL, PM_EVLOOP_LEVEL) == ERR ||
+      pipe(bgp_shutdown_pipe) || pm_evloop_add(&bgp_evloop, bgp_shutdown_pipe[0], NULL, PM_EVLOOP_LEVEL) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): unable to set up the event loop. Terminating thread.\n", config.name, bgp_misc_db->log_str);
+    exit_gracefully(1);
+  }
 
   {
     char srv_string[INET6_ADDRSTRLEN];
@@ -386,6 +414,7 @@ void skinny_bgp_daemon_online()
   for (afi = AFI_IP; afi < AFI_MAX; afi++) {
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
       bgp_routing_db->rib[afi][safi] = bgp_table_init(afi, safi);
+      if (config.bgp_table_lpm_index) bgp_lpm_init(bgp_routing_db->rib[afi][safi]);
     }
   }
 
@@ -532,11 +561,19 @@ void skinny_bgp_daemon_online()
 #endif
     }
 
-  select_fd = bkp_select_fd = (config.bgp_sock + 1);
-  recalc_fds = FALSE;
-
   bgp_link_misc_structs(bgp_misc_db);
 
+  if (config.bgp_daemon_threads) {
+    if (config.bgp_xconnect_map) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): 'bgp_daemon_threads' not supported with 'bgp_daemon_xconnect_map'. Ignored.\n", config.name, bgp_misc_db->log_str);
+      config.bgp_daemon_threads = 0;
+    }
+    else bgp_workers_init(config.bgp_daemon_threads);
+  }
+
+  /* no sessions yet, restored routes are all stale */
+  bgp_snapshot_init();
+
   sigemptyset(&signal_set);
   sigaddset(&signal_set, SIGCHLD);
   sigaddset(&signal_set, SIGHUP);
@@ -553,30 +590,6 @@ void skinny_bgp_daemon_online()
       sigprocmask(SIG_BLOCK, &signal_set, NULL);
     }
 
-    if (recalc_fds) { 
-      select_fd = config.bgp_sock;
-      max_peers_idx = -1; /* .. since valid indexes include 0 */
-
-      for (peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
-        if (select_fd < peers[peers_idx].fd) select_fd = peers[peers_idx].fd; 
-
-        if (config.bgp_xconnect_map) {
-	  if (select_fd < peers[peers_idx].xconnect_fd)
-	    select_fd = peers[peers_idx].xconnect_fd; 
-	}
-
-	if (peers[peers_idx].fd) max_peers_idx = peers_idx;
-      }
-      select_fd++;
-      max_peers_idx++;
-
-      bkp_select_fd = select_fd;
-      recalc_fds = FALSE;
-    }
-    else select_fd = bkp_select_fd;
-
-    memcpy(&read_descs, &bkp_read_descs, sizeof(bkp_read_descs));
-
     if (bgp_misc_db->dump_backend_methods) {
       int delta;
 
@@ -587,7 +600,22 @@ void skinny_bgp_daemon_online()
     }
     else drt_ptr = NULL;
 
-    select_num = select(select_fd, &read_descs, NULL, NULL, drt_ptr);
+    /* RIB memory retired while collectors were looking: come back for it */
+    if (bgp_rcu_reclaim() && !drt_ptr) {
+      dump_refresh_timeout.tv_sec = BGP_RCU_RECLAIM_INTERVAL;
+      dump_refresh_timeout.tv_usec = 0;
+      drt_ptr = &dump_refresh_timeout;
+    }
+
+    /* RIB snapshots and stale routes have deadlines of their own */
+    if ((snapshot_timeout = bgp_snapshot_timeout()) != ERR && (!drt_ptr || snapshot_timeout < drt_ptr->tv_sec)) {
+      dump_refresh_timeout.tv_sec = snapshot_timeout;
+      dump_refresh_timeout.tv_usec = 0;
+      drt_ptr = &dump_refresh_timeout;
+    }
+
+    select_num = pm_evloop_wait(&bgp_evloop, drt_ptr);
+    if (bgp_shutdown == BGP_SHUTDOWN_REQUESTED) bgp_daemon_shutdown();
     if (select_num < 0) goto select_again;
     now = time(NULL);
 
@@ -618,6 +646,8 @@ void skinny_bgp_daemon_online()
     }
 
     if (reload_log_bgp_thread) {
+      bgp_rib_lock(bgp_misc_db);
+
       for (peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
 	if (bgp_misc_db->peers_log[peers_idx].fd) {
 	  fclose(bgp_misc_db->peers_log[peers_idx].fd);
@@ -627,10 +657,19 @@ void skinny_bgp_daemon_online()
 	else break;
       }
 
+      bgp_rib_unlock(bgp_misc_db);
       reload_log_bgp_thread = FALSE;
     }
 
+    if (print_stats_bgp_thread) {
+      bgp_slab_stats_log(bgp_misc_db->log_str);
+      print_stats_bgp_thread = FALSE;
+    }
+
     if (bgp_misc_db->msglog_backend_methods || bgp_misc_db->dump_backend_methods) {
+      /* workers log, and dumps fork, off the same structures */
+      bgp_rib_lock(bgp_misc_db);
+
       gettimeofday(&bgp_misc_db->log_tstamp, NULL);
       compose_timestamp(bgp_misc_db->log_tstamp_str, SRVBUFLEN, &bgp_misc_db->log_tstamp, TRUE,
 			config.timestamps_since_epoch, config.timestamps_rfc3339, config.timestamps_utc);
@@ -677,21 +716,29 @@ void skinny_bgp_daemon_online()
           bgp_daemon_msglog_init_kafka_host();
       }
 #endif
+
+      bgp_rib_unlock(bgp_misc_db);
     }
 
+    bgp_snapshot_handle_timers(now);
+
     /* 
-       If select_num == 0 then we got out of select() due to a timeout rather
+       If select_num == 0 then we got out of the wait due to a timeout rather
        than because we had a message from a peer to handle. By now we did all
-       routine checks and can happily return to select() again.
+       routine checks and can happily return to waiting again.
     */ 
     if (!select_num) goto select_again;
 
+    next_event:
+    fd = pm_evloop_next(&bgp_evloop, (void **) &peer);
+    if (fd == ERR) goto select_again;
+
     /* New connection is coming in */ 
-    if (FD_ISSET(config.bgp_sock, &read_descs)) {
+    if (fd == config.bgp_sock) {
       int peers_check_idx, peers_num;
 
       fd = accept(config.bgp_sock, (struct sockaddr *) &client, &clen);
-      if (fd == ERR) goto read_data;
+      if (fd == ERR) goto next_event;
 
       ipv4_mapped_to_ipv4(&client);
 
@@ -701,11 +748,14 @@ void skinny_bgp_daemon_online()
 
       if (!allowed) {
         close(fd);
-        goto read_data;
+        goto next_event;
       }
 
+      /* workers may be closing sessions meanwhile */
+      bgp_rib_lock(bgp_misc_db);
+
       for (peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
-        if (!peers[peers_idx].fd) {
+        if (!peers[peers_idx].fd && !peers[peers_idx].stale) {
 	  /*
 	     Admitted if:
 	     *  batching feature is disabled or
@@ -715,7 +765,6 @@ void skinny_bgp_daemon_online()
           if (bgp_batch_is_admitted(&bp_batch, now)) {
             peer = &peers[peers_idx];
             if (bgp_peer_init(peer, FUNC_TYPE_BGP)) peer = NULL;
-	    else recalc_fds = TRUE;
 
             log_notification_unset(&log_notifications.bgp_peers_throttling);
 
@@ -734,24 +783,42 @@ void skinny_bgp_daemon_online()
 	    }
 
             close(fd);
-            goto read_data;
+            goto accept_done;
           }
         }
 	/* XXX: replenish sessions with expired keepalives */
       }
 
+      /* no free slot: stale routes restored from a snapshot may give way */
+      if (!peer && peers_idx == config.nfacctd_bgp_max_peers) {
+	struct host_addr client_addr;
+	u_int16_t client_port;
+
+	memset(&client_addr, 0, sizeof(client_addr));
+	sa_to_addr((struct sockaddr *)&client, &client_addr, &client_port);
+
+	peer = bgp_snapshot_takeover(&client_addr);
+	if (peer) {
+	  peers_idx = peer->idx;
+	  if (bgp_peer_init(peer, FUNC_TYPE_BGP)) peer = NULL;
+	}
+      }
+
       if (!peer) {
 	/* We briefly accept the new connection to be able to drop it */
         Log(LOG_ERR, "ERROR ( %s/%s ): Insufficient number of BGP peers has been configured by 'bgp_daemon_max_peers' (%d).\n",
 			config.name, bgp_misc_db->log_str, config.nfacctd_bgp_max_peers);
 
 	close(fd);
-	goto read_data;
+	goto accept_done;
       }
 
       peer->fd = fd;
       peer->idx = peers_idx; 
-      FD_SET(peer->fd, &bkp_read_descs);
+      if (!config.bgp_daemon_threads && pm_evloop_add(&bgp_evloop, peer->fd, peer, PM_EVLOOP_EDGE) == ERR) {
+	bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+	goto accept_done;
+      }
       peer->addr.family = ((struct sockaddr *)&client)->sa_family;
       if (peer->addr.family == AF_INET) {
 	peer->addr.address.ipv4.s_addr = ((struct sockaddr_in *)&client)->sin_addr.s_addr;
@@ -777,6 +844,9 @@ void skinny_bgp_daemon_online()
 
       /* Check: more than one TCP connection from a peer (IP address) */
       for (peers_check_idx = 0, peers_num = 0; peers_check_idx < config.nfacctd_bgp_max_peers; peers_check_idx++) { 
+	/* routes restored from a snapshot, see bgp_snapshot_eor() */
+	if (peers[peers_check_idx].stale) continue;
+
 	if (peers_idx != peers_check_idx && !memcmp(&peers[peers_check_idx].addr, &peer->addr, sizeof(peers[peers_check_idx].addr))) {
 	  int same_peer = FALSE;
 
@@ -800,16 +870,20 @@ void skinny_bgp_daemon_online()
 		bgp_peer_print(&peers[peers_check_idx], bgp_peer_str, INET6_ADDRSTRLEN);
               	Log(LOG_INFO, "INFO ( %s/%s ): [%s] Replenishing stale connection by peer.\n",
 			config.name, bgp_misc_db->log_str, bgp_peer_str);
-		FD_CLR(peers[peers_check_idx].fd, &bkp_read_descs);
-		bgp_peer_close(&peers[peers_check_idx], FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+		/* if served by a worker, let it find out and close the session */
+		if (config.bgp_daemon_threads) shutdown(peers[peers_check_idx].fd, SHUT_RDWR);
+		else {
+		  pm_evloop_del(&bgp_evloop, peers[peers_check_idx].fd);
+		  bgp_peer_close(&peers[peers_check_idx], FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+		}
 	      }
 	      else {
 		Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Refusing new connection from existing peer (residual holdtime: %ld).\n",
 			config.name, bgp_misc_db->log_str, bgp_peer_str,
 			(peers[peers_check_idx].ht - ((long)now - peers[peers_check_idx].last_keepalive)));
-		FD_CLR(peer->fd, &bkp_read_descs);
+		pm_evloop_del(&bgp_evloop, peer->fd);
 		bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
-		goto read_data;
+		goto accept_done;
 	      }
 	    }
 	  }
@@ -818,9 +892,9 @@ void skinny_bgp_daemon_online()
 	  else {
 	    Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Refusing new incoming connection for existing BGP xconnect.\n",
 			config.name, bgp_misc_db->log_str, bgp_peer_str);
-	    FD_CLR(peer->fd, &bkp_read_descs);
+	    pm_evloop_del(&bgp_evloop, peer->fd);
 	    bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
-	    goto read_data;
+	    goto accept_done;
 	  }
         }
 	else if (peers[peers_check_idx].fd) peers_num++;
@@ -829,11 +903,10 @@ void skinny_bgp_daemon_online()
       if (config.bgp_xconnect_map) {
         bgp_peer_xconnect_init(peer, FUNC_TYPE_BGP);
 
-        if (peer->xconnect_fd) FD_SET(peer->xconnect_fd, &bkp_read_descs);
-        else {
-          FD_CLR(peer->fd, &bkp_read_descs);
+        if (!peer->xconnect_fd || pm_evloop_add(&bgp_evloop, peer->xconnect_fd, peer, PM_EVLOOP_EDGE) == ERR) {
+          pm_evloop_del(&bgp_evloop, peer->fd);
           bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
-          goto read_data;
+          goto accept_done;
         }
       }
 
@@ -849,115 +922,336 @@ void skinny_bgp_daemon_online()
       }
 
       if (config.nfacctd_bgp_neighbors_file) write_neighbors_file(config.nfacctd_bgp_neighbors_file, FUNC_TYPE_BGP);
-    }
+      if (config.bgp_daemon_threads) bgp_worker_handoff(peer);
 
-    read_data:
+      accept_done:
+      bgp_rib_unlock(bgp_misc_db);
+
+      goto next_event;
+    }
 
     /*
-       We have something coming in: let's lookup which peer is that.
-       FvD: To avoid starvation of the "later established" peers, we
-       offset the start of the search in a round-robin style.
+       We have something coming in from a peer: sockets are edge-triggered
+       hence we read until there is nothing left or, to avoid starvation of
+       other peers, PM_EVLOOP_READS_MAX times; in this case the peer is
+       served again in the next round.
     */
-    for (peer = NULL, peers_idx = 0; peers_idx < max_peers_idx; peers_idx++) {
-      int loc_idx = (peers_idx + peers_idx_rr) % max_peers_idx;
-      recv_fd = 0; send_fd = 0;
-
-      if (peers[loc_idx].fd && FD_ISSET(peers[loc_idx].fd, &read_descs)) {
-        peer = &peers[loc_idx];
-	recv_fd = peer->fd;
-	if (config.bgp_xconnect_map) send_fd = peer->xconnect_fd;
-        peers_idx_rr = (peers_idx_rr + 1) % max_peers_idx;
-	break;
-      }
-      
-      // XXX: verify round-robin fairness holding up
-      if (config.bgp_xconnect_map) {
-        loc_idx = (peers_idx + peers_xconnect_idx_rr) % max_peers_idx;
+    recv_fd = fd;
+    if (config.bgp_xconnect_map) send_fd = (recv_fd == peer->fd ? peer->xconnect_fd : peer->fd);
+    else send_fd = 0;
 
-	if (peers[loc_idx].xconnect_fd && FD_ISSET(peers[loc_idx].xconnect_fd, &read_descs)) {
-	  peer = &peers[loc_idx];
-	  recv_fd = peer->xconnect_fd;
-	  send_fd = peer->fd;
-	  peers_xconnect_idx_rr = (peers_xconnect_idx_rr + 1) % max_peers_idx;
-	  break;
-	}
-      }
-    }
+    for (reads = 0; reads < PM_EVLOOP_READS_MAX; reads++) {
+      ret = recv(recv_fd, &peer->buf.base[peer->buf.truncated_len], (peer->buf.len - peer->buf.truncated_len), MSG_DONTWAIT);
+      if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) goto next_event;
 
-    if (!peer) goto select_again;
+      peer->msglen = (ret + peer->buf.truncated_len);
 
-    ret = recv(recv_fd, &peer->buf.base[peer->buf.truncated_len], (peer->buf.len - peer->buf.truncated_len), 0);
-    peer->msglen = (ret + peer->buf.truncated_len);
+      if (ret <= 0) {
+        if (!config.bgp_xconnect_map) {
+	  bgp_peer_print(peer, bgp_peer_str, INET6_ADDRSTRLEN);
+	  Log(LOG_INFO, "INFO ( %s/%s ): [%s] BGP connection reset by peer (%d).\n", config.name, bgp_misc_db->log_str, bgp_peer_str, errno);
+	  pm_evloop_del(&bgp_evloop, peer->fd);
+        }
+        else {
+	  bgp_peer_xconnect_print(peer, bgp_xconnect_peer_str, BGP_XCONNECT_STRLEN);
 
-    if (ret <= 0) {
-      if (!config.bgp_xconnect_map) {
-	bgp_peer_print(peer, bgp_peer_str, INET6_ADDRSTRLEN);
-	Log(LOG_INFO, "INFO ( %s/%s ): [%s] BGP connection reset by peer (%d).\n", config.name, bgp_misc_db->log_str, bgp_peer_str, errno);
-	FD_CLR(peer->fd, &bkp_read_descs);
+	  if (recv_fd == peer->fd)
+	    Log(LOG_INFO, "INFO ( %s/%s ): [%s] recv(): BGP xconnect reset by src peer (%d).\n",
+		config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
+	  else if (recv_fd == peer->xconnect_fd)
+	    Log(LOG_INFO, "INFO ( %s/%s ): [%s] recv(): BGP xconnect reset by dst peer (%d).\n",
+		config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
+
+	  pm_evloop_del(&bgp_evloop, peer->fd);
+	  pm_evloop_del(&bgp_evloop, peer->xconnect_fd);
+        }
+
+        bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+        goto next_event;
       }
       else {
-	bgp_peer_xconnect_print(peer, bgp_xconnect_peer_str, BGP_XCONNECT_STRLEN);
+        if (!config.bgp_xconnect_map) {
+	  /* Appears a valid peer with a valid BGP message: before
+	     continuing let's see if it's time to send a KEEPALIVE
+	     back */
+	  if (peer->status == Established && ((now - peer->last_keepalive) > (peer->ht / 2))) {
+	    bgp_reply_pkt_ptr = bgp_reply_pkt;
+	    bgp_reply_pkt_ptr += bgp_write_keepalive_msg(bgp_reply_pkt_ptr);
+	    ret = send(recv_fd, bgp_reply_pkt, bgp_reply_pkt_ptr - bgp_reply_pkt, 0);
+	    peer->last_keepalive = now;
+	  } 
+
+	  ret = bgp_parse_msg(peer, now, TRUE);
+	  if (ret) {
+	    pm_evloop_del(&bgp_evloop, recv_fd);
+
+	    if (ret < 0) bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+	    else bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, TRUE, ret, BGP_NOTIFY_SUBCODE_UNSPECIFIC, NULL);
+
+	    goto next_event;
+	  }
+        }
+        else {
+	  ret = send(send_fd, &peer->buf.base[peer->buf.truncated_len], peer->msglen, 0);
+	  if (ret <= 0) {
+	    bgp_peer_xconnect_print(peer, bgp_xconnect_peer_str, BGP_XCONNECT_STRLEN);
 
-	if (recv_fd == peer->fd)
-	  Log(LOG_INFO, "INFO ( %s/%s ): [%s] recv(): BGP xconnect reset by src peer (%d).\n",
-		config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
-	else if (recv_fd == peer->xconnect_fd)
-	  Log(LOG_INFO, "INFO ( %s/%s ): [%s] recv(): BGP xconnect reset by dst peer (%d).\n",
-		config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
+	    if (send_fd == peer->fd)
+	      Log(LOG_INFO, "INFO ( %s/%s ): [%s] send(): BGP xconnect reset by src peer (%d).\n",
+		  config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
+	    else if (send_fd == peer->xconnect_fd)
+	      Log(LOG_INFO, "INFO ( %s/%s ): [%s] send(): BGP xconnect reset by dst peer (%d).\n",
+		  config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
+
+	    pm_evloop_del(&bgp_evloop, peer->fd);
+	    pm_evloop_del(&bgp_evloop, peer->xconnect_fd);
 
-	FD_CLR(peer->fd, &bkp_read_descs);
-	FD_CLR(peer->xconnect_fd, &bkp_read_descs);
+	    bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+	    goto next_event;
+	  }
+        }
       }
+    }
 
-      bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+    pm_evloop_again(&bgp_evloop, recv_fd);
+    goto next_event;
+  }
+}
 
-      recalc_fds = TRUE;
-      goto select_again;
+/*
+   Called by PM_sigint_handler(), hence async-signal-safe: the BGP thread
+   is woken up to save the RIB and close the sessions, see
+   bgp_daemon_shutdown(). If the BGP daemon runs in a thread of the core
+   process, the handler waits for it; if it runs standalone, the handler
+   was invoked from within the BGP loop itself: FALSE is returned, the
+   handler returns and is called again, once done, by the BGP loop.
+*/
+int bgp_daemon_shutdown_request()
+{
+  struct timespec nap = { 0, 10000000 };
+  char wakeup = 0;
+
+  if (bgp_shutdown == BGP_SHUTDOWN_DONE || !bgp_shutdown_pipe[1]) return TRUE;
+
+  bgp_shutdown = BGP_SHUTDOWN_REQUESTED;
+  if (write(bgp_shutdown_pipe[1], &wakeup, sizeof(wakeup)) != sizeof(wakeup)) return TRUE;
+  if (!bgp_misc_db->is_thread) return FALSE;
+
+  while (bgp_shutdown != BGP_SHUTDOWN_DONE) nanosleep(&nap, NULL);
+
+  return TRUE;
+}
+
+/* workers stop in between messages and stay parked until exit */
+static void bgp_workers_stop(int num)
+{
+  struct timespec nap = { 0, 10000000 };
+  int idx, stop = ERR, stopped;
+
+  for (idx = 0; idx < num; idx++) {
+    if (write(bgp_workers[idx].pipe[1], &stop, sizeof(stop)) != sizeof(stop)) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): write() to BGP worker #%d failed (errno: %d).\n", config.name, bgp_misc_db->log_str, idx, errno);
+      bgp_workers[idx].stopped = TRUE;
     }
-    else {
-      if (!config.bgp_xconnect_map) {
-	/* Appears a valid peer with a valid BGP message: before
-	   continuing let's see if it's time to send a KEEPALIVE
-	   back */
-	if (peer->status == Established && ((now - peer->last_keepalive) > (peer->ht / 2))) {
-	  bgp_reply_pkt_ptr = bgp_reply_pkt;
-	  bgp_reply_pkt_ptr += bgp_write_keepalive_msg(bgp_reply_pkt_ptr);
-	  ret = send(recv_fd, bgp_reply_pkt, bgp_reply_pkt_ptr - bgp_reply_pkt, 0);
-	  peer->last_keepalive = now;
-	} 
+  }
 
-	ret = bgp_parse_msg(peer, now, TRUE);
-	if (ret) {
-	  FD_CLR(recv_fd, &bkp_read_descs);
+  for (stopped = 0; stopped < num; ) {
+    nanosleep(&nap, NULL);
+
+    bgp_rib_lock(bgp_misc_db);
+    for (idx = 0, stopped = 0; idx < num; idx++) {
+      if (bgp_workers[idx].stopped) stopped++;
+    }
+    bgp_rib_unlock(bgp_misc_db);
+  }
+}
+
+/*
+   Shutdown, in the BGP thread: with no worker left in the middle of a
+   message, the RIB is saved while still whole and the sessions are
+   closed; the rest of the exit sequence is up to PM_sigint_handler().
+*/
+void bgp_daemon_shutdown()
+{
+  char shutdown_msg[] = "pmacct received SIGINT - shutting down";
+  int idx;
+
+  if (config.bgp_daemon_threads) bgp_workers_stop(config.bgp_daemon_threads);
+
+  bgp_snapshot_save();
+
+  for (idx = 0; idx < config.nfacctd_bgp_max_peers; idx++) {
+    if (peers[idx].fd)
+      bgp_peer_close(&peers[idx], FUNC_TYPE_BGP, TRUE, TRUE, BGP_NOTIFY_CEASE, BGP_NOTIFY_CEASE_ADMIN_SHUTDOWN, shutdown_msg);
+  }
+
+  bgp_shutdown = BGP_SHUTDOWN_DONE;
+
+  if (!bgp_misc_db->is_thread) PM_sigint_handler(SIGINT);
+
+  /* the core process is exiting */
+  for (;;) pause();
+}
+
+void bgp_workers_init(int num)
+{
+  int idx;
+
+  bgp_misc_db->rib_mutex = malloc(sizeof(pthread_mutex_t));
+  bgp_workers = malloc(num * sizeof(struct bgp_worker));
+  if (!bgp_misc_db->rib_mutex || !bgp_workers) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_workers_init). Exiting ..\n", config.name, bgp_misc_db->log_str);
+    exit_gracefully(1);
+  }
+
+  pthread_mutex_init(bgp_misc_db->rib_mutex, NULL);
+  memset(bgp_workers, 0, num * sizeof(struct bgp_worker));
+
+  /* UPDATEs lock just the table they change, unless they go out to message
+     logs or blackhole feeds, shared among all peers, see bgp_nlri_parse() */
+  if (!bgp_misc_db->msglog_backend_methods && !config.bgp_blackhole_stdcomm_list) {
+    bgp_misc_db->rib_table_mutex = malloc(AFI_MAX * SAFI_MAX * sizeof(pthread_mutex_t));
+    if (!bgp_misc_db->rib_table_mutex) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_workers_init). Exiting ..\n", config.name, bgp_misc_db->log_str);
+      exit_gracefully(1);
+    }
+
+    for (idx = 0; idx < (AFI_MAX * SAFI_MAX); idx++) pthread_mutex_init(&bgp_misc_db->rib_table_mutex[idx], NULL);
+  }
+
+  /* attributes are interned from all workers */
+  hash_locks_init(bgp_routing_db->attrhash, HASHLOCKSNUM);
+  hash_locks_init(bgp_routing_db->ashash, HASHLOCKSNUM);
+  hash_locks_init(bgp_routing_db->comhash, HASHLOCKSNUM);
+  hash_locks_init(bgp_routing_db->ecomhash, HASHLOCKSNUM);
+  hash_locks_init(bgp_routing_db->lcomhash, HASHLOCKSNUM);
+
+  for (idx = 0; idx < num; idx++) {
+    bgp_workers[idx].id = idx;
 
-	  if (ret < 0) bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
-	  else bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, TRUE, ret, BGP_NOTIFY_SUBCODE_UNSPECIFIC, NULL);
+    if (pipe(bgp_workers[idx].pipe)) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): pipe() failed (bgp_workers_init, errno: %d). Exiting ..\n", config.name, bgp_misc_db->log_str, errno);
+      exit_gracefully(1);
+    }
+  }
+
+  bgp_workers_pool = allocate_thread_pool(num);
+  assert(bgp_workers_pool);
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d worker thread(s) initialized\n", config.name, bgp_misc_db->log_str, num);
+
+  for (idx = 0; idx < num; idx++) send_to_pool(bgp_workers_pool, bgp_worker_daemon, &bgp_workers[idx]);
+}
+
+/* to be called with rib_mutex held, once the peer is fully set up */
+void bgp_worker_handoff(struct bgp_peer *peer)
+{
+  struct bgp_worker *bw = &bgp_workers[peer->idx % config.bgp_daemon_threads];
+
+  if (write(bw->pipe[1], &peer->idx, sizeof(peer->idx)) != sizeof(peer->idx)) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): write() to BGP worker #%d failed (errno: %d).\n", config.name, bgp_misc_db->log_str, bw->id, errno);
+    bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+  }
+}
 
-	  recalc_fds = TRUE;
-	  goto select_again;
+static void bgp_worker_close(struct pm_evloop *loop, struct bgp_peer *peer, int ret)
+{
+  pm_evloop_del(loop, peer->fd);
+
+  bgp_rib_lock(bgp_misc_db);
+
+  if (ret <= 0) bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+  else bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, TRUE, ret, BGP_NOTIFY_SUBCODE_UNSPECIFIC, NULL);
+
+  bgp_rib_unlock(bgp_misc_db);
+}
+
+/*
+   Same as the peers part of the skinny_bgp_daemon_online() loop, for the
+   sessions pinned to this worker; these are registered to the event loop
+   of the worker as they are handed over through the pipe.
+*/
+void bgp_worker_daemon(struct bgp_worker *bw)
+{
+  char bgp_reply_pkt[BGP_BUFFER_SIZE], *bgp_reply_pkt_ptr;
+  char bgp_peer_str[INET6_ADDRSTRLEN];
+  struct pm_evloop bw_evloop;
+  struct bgp_peer *peer;
+  struct timeval reclaim_timeout, *rt_ptr;
+  sigset_t signal_set;
+  int ret, fd, reads, peers_idx;
+  time_t now;
+
+  /* signals are for the main thread to handle */
+  sigfillset(&signal_set);
+  pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
+
+  if (pm_evloop_init(&bw_evloop) == ERR || pm_evloop_add(&bw_evloop, bw->pipe[0], NULL, PM_EVLOOP_LEVEL) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): unable to set up the event loop of BGP worker #%d. Exiting ..\n", config.name, bgp_misc_db->log_str, bw->id);
+    exit_gracefully(1);
+  }
+
+  for (;;) {
+    /* RIB memory retired by the last batch: the main loop may be asleep,
+       so it is reclaimed here and, if collectors are still looking, come
+       back for it */
+    if (bgp_rcu_reclaim()) {
+      reclaim_timeout.tv_sec = BGP_RCU_RECLAIM_INTERVAL;
+      reclaim_timeout.tv_usec = 0;
+      rt_ptr = &reclaim_timeout;
+    }
+    else rt_ptr = NULL;
+
+    if (pm_evloop_wait(&bw_evloop, rt_ptr) < 0) continue;
+    now = time(NULL);
+
+    while ((fd = pm_evloop_next(&bw_evloop, (void **) &peer)) != ERR) {
+      if (fd == bw->pipe[0]) {
+	if (read(bw->pipe[0], &peers_idx, sizeof(peers_idx)) == sizeof(peers_idx)) {
+	  if (peers_idx == ERR) {
+	    bgp_rib_lock(bgp_misc_db);
+	    bw->stopped = TRUE;
+	    bgp_rib_unlock(bgp_misc_db);
+
+	    /* see bgp_workers_stop() */
+	    for (;;) pause();
+	  }
+
+	  peer = &peers[peers_idx];
+	  if (pm_evloop_add(&bw_evloop, peer->fd, peer, PM_EVLOOP_EDGE) == ERR) bgp_worker_close(&bw_evloop, peer, ERR);
 	}
+
+	continue;
       }
-      else {
-	ret = send(send_fd, &peer->buf.base[peer->buf.truncated_len], peer->msglen, 0);
-	if (ret <= 0) {
-	  bgp_peer_xconnect_print(peer, bgp_xconnect_peer_str, BGP_XCONNECT_STRLEN);
 
-	  if (send_fd == peer->fd)
-	    Log(LOG_INFO, "INFO ( %s/%s ): [%s] send(): BGP xconnect reset by src peer (%d).\n",
-		config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
-	  else if (send_fd == peer->xconnect_fd)
-	    Log(LOG_INFO, "INFO ( %s/%s ): [%s] send(): BGP xconnect reset by dst peer (%d).\n",
-		config.name, bgp_misc_db->log_str, bgp_xconnect_peer_str, errno);
+      for (reads = 0; reads < PM_EVLOOP_READS_MAX; reads++) {
+	ret = recv(peer->fd, &peer->buf.base[peer->buf.truncated_len], (peer->buf.len - peer->buf.truncated_len), MSG_DONTWAIT);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+
+	peer->msglen = (ret + peer->buf.truncated_len);
+
+	if (ret <= 0) {
+	  bgp_peer_print(peer, bgp_peer_str, INET6_ADDRSTRLEN);
+	  Log(LOG_INFO, "INFO ( %s/%s ): [%s] BGP connection reset by peer (%d).\n", config.name, bgp_misc_db->log_str, bgp_peer_str, errno);
 
-	  FD_CLR(peer->fd, &bkp_read_descs);
-	  FD_CLR(peer->xconnect_fd, &bkp_read_descs);
+	  bgp_worker_close(&bw_evloop, peer, ERR);
+	  break;
+	}
 
-	  bgp_peer_close(peer, FUNC_TYPE_BGP, FALSE, FALSE, FALSE, FALSE, NULL);
+	if (peer->status == Established && ((now - peer->last_keepalive) > (peer->ht / 2))) {
+	  bgp_reply_pkt_ptr = bgp_reply_pkt;
+	  bgp_reply_pkt_ptr += bgp_write_keepalive_msg(bgp_reply_pkt_ptr);
+	  ret = send(peer->fd, bgp_reply_pkt, bgp_reply_pkt_ptr - bgp_reply_pkt, 0);
+	  peer->last_keepalive = now;
+	}
 
-	  recalc_fds = TRUE;
-	  goto select_again;
+	ret = bgp_parse_msg(peer, now, TRUE);
+	if (ret) {
+	  bgp_worker_close(&bw_evloop, peer, ret);
+	  break;
 	}
       }
+
+      if (reads == PM_EVLOOP_READS_MAX) pm_evloop_again(&bw_evloop, fd);
     }
   }
 }
@@ -24,6 +24,10 @@
 #include "bgp_prefix.h"
 #include "bgp_packet.h"
 #include "bgp_table.h"
+#include "bgp_lpm.h"
+#include "bgp_rcu.h"
+#include "bgp_slab.h"
+#include "bgp_snapshot.h"
 #include "bgp_logdump.h"
 
 #ifndef _BGP_H_
@@ -73,6 +77,7 @@
 
 /* BGP misc */
 #define MAX_BGP_PEERS_DEFAULT	4
+#define BGP_WORKERS_MAX		64
 #define MAX_HOPS_FOLLOW_NH	20
 #define MAX_NH_SELF_REFERENCES	1
 #define BGP_XCONNECT_STRLEN	(2 * (INET6_ADDRSTRLEN + PORT_STRLEN + 1) + 4) 
@@ -86,6 +91,11 @@
 #define BGP_DAEMON_TRUE		1
 #define BGP_DAEMON_ONLINE	1
 
+/* bgp_shutdown, see bgp_daemon_shutdown_request() */
+#define BGP_SHUTDOWN_NONE	0
+#define BGP_SHUTDOWN_REQUESTED	1
+#define BGP_SHUTDOWN_DONE	2
+
 #define BGP_MSG_EXTRA_DATA_NONE	0
 #define BGP_MSG_EXTRA_DATA_BMP	1
 
@@ -105,6 +115,8 @@ struct bgp_dump_event {
   struct timeval tstamp;
   char tstamp_str[SRVBUFLEN];
   int period;
+  u_int32_t gen; /* dumps forked so far, see bgp_table_dump_checkpoint */
+  int delta;
 };
 
 struct bgp_rt_structs {
@@ -188,6 +200,16 @@ struct bgp_peer {
 
   struct bgp_xconnect xc;
   int xconnect_fd;
+
+  u_int64_t rib_gen; /* changes whenever routes of the peer are added or removed */
+  struct bgp_slab *info_slab; /* arenas, see bgp_slab.h */
+  struct bgp_slab *info_extra_slab;
+
+  u_int8_t dump_seen; /* part of a dump already, next ones can be deltas */
+  struct bgp_dump_journal dump_journal;
+
+  u_int8_t stale; /* restored from a snapshot, see bgp_snapshot.c */
+  u_int32_t stale_eor; /* tables still waiting for End-of-RIB */
 };
 
 struct bgp_msg_data {
@@ -257,9 +279,12 @@ struct bgp_misc_structs {
   int table_per_peer_buckets;
   int table_attr_hash_buckets;
   int table_per_peer_hash;
+  int table_shared_paths;
+  int dump_checkpoint;
   u_int32_t (*route_info_modulo)(struct bgp_peer *, path_id_t *, int);
   struct bgp_peer *(*bgp_lookup_find_peer)(struct sockaddr *, struct xflow_status_entry *, u_int16_t, int);
   int (*bgp_lookup_node_match_cmp)(struct bgp_info *, struct node_match_cmp_term2 *);
+  struct bgp_lookup_cache *lookup_cache;
 
   int msglog_backend_methods;
   int dump_backend_methods;
@@ -268,6 +293,27 @@ struct bgp_misc_structs {
   int (*bgp_msg_open_router_id_check)(struct bgp_msg_data *);
 
   void *bgp_blackhole_zmq_host;
+
+  /* set if peers are served by worker threads, see bgp_daemon_threads,
+     or if the RIB is to be saved on shutdown, see bgp_table_snapshot_file */
+  pthread_mutex_t *rib_mutex;
+
+  /* one per rib[afi][safi], if worker threads update tables in parallel */
+  pthread_mutex_t *rib_table_mutex;
+
+  struct bgp_snapshot_state snapshot;
+};
+
+/*
+   A worker thread serving the sessions pinned to it: the main loop keeps
+   accepting connections and hands new peers over via 'pipe'. 'rib_mutex'
+   serializes, among threads, writes to the RIB and to the peers table;
+   UPDATE messages take just 'rib_table_mutex' of the table they change.
+*/
+struct bgp_worker {
+  int id;
+  int pipe[2];
+  int stopped;
 };
 
 /* these includes require definition of bgp_rt_structs and bgp_peer */
@@ -340,6 +386,7 @@ struct bgp_lg_rep_ipl_data {
   safi_t safi;
   struct prefix *pref;
   struct bgp_info *info;
+  struct bgp_info info_view; /* see bgp_info_peer_view() */
 };
 
 struct bgp_lg_rep_gp_data {
@@ -356,6 +403,11 @@ extern void skinny_bgp_daemon();
 extern void skinny_bgp_daemon_online();
 extern void bgp_prepare_thread();
 extern void bgp_prepare_daemon();
+extern void bgp_workers_init(int);
+extern void bgp_worker_daemon(struct bgp_worker *);
+extern void bgp_worker_handoff(struct bgp_peer *);
+extern int bgp_daemon_shutdown_request();
+extern void bgp_daemon_shutdown();
 
 /* global variables */
 extern struct bgp_peer *peers;
@@ -373,4 +425,6 @@ extern struct bgp_rt_structs inter_domain_routing_dbs[FUNC_TYPE_MAX], *bgp_routi
 extern struct bgp_misc_structs inter_domain_misc_dbs[FUNC_TYPE_MAX], *bgp_misc_db;
 
 extern struct bgp_xconnects bgp_xcs_map;
+extern u_int64_t bgp_rib_gen;
+extern volatile sig_atomic_t bgp_shutdown;
 #endif 
@@ -240,12 +240,7 @@ aspath_new ()
 {
   struct aspath *aspath;
 
-  aspath = malloc(sizeof (struct aspath));
-
-  if (!aspath) {
-    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (aspath_new). Exiting ..\n", config.name); // XXX
-    exit_gracefully(1);
-  }
+  aspath = bgp_slab_alloc(&aspath_slab);
   memset (aspath, 0, sizeof (struct aspath));
 
   return aspath;
@@ -260,7 +255,7 @@ aspath_free (struct aspath *aspath)
   if (aspath->segments)
     assegment_free_all (aspath->segments);
   if (aspath->str) free(aspath->str);
-  free(aspath);
+  bgp_slab_free(aspath);
 }
 
 /* Unintern aspath from AS path bucket. */
@@ -269,6 +264,7 @@ aspath_unintern(struct bgp_peer *peer, struct aspath *aspath)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct aspath *ret = NULL;
+  pthread_mutex_t *lock;
   (void) ret;
 
   if (!peer) return;
@@ -277,15 +273,19 @@ aspath_unintern(struct bgp_peer *peer, struct aspath *aspath)
 
   if (!inter_domain_routing_db) return;
 
-  if (aspath->refcnt)
-    aspath->refcnt--;
+  lock = hash_lock(inter_domain_routing_db->ashash, aspath);
 
-  if (aspath->refcnt == 0) {
+  if (__atomic_load_n(&aspath->refcnt, __ATOMIC_RELAXED))
+    __atomic_sub_fetch(&aspath->refcnt, 1, __ATOMIC_ACQ_REL);
+
+  if (__atomic_load_n(&aspath->refcnt, __ATOMIC_ACQUIRE) == 0) {
     /* This aspath must exist in aspath hash table. */
     ret = hash_release(inter_domain_routing_db->ashash, aspath);
     assert (ret != NULL);
-    aspath_free (aspath);
+    bgp_rcu_free(aspath, (void (*)(void *)) aspath_free);
   }
+
+  hash_unlock(lock);
 }
 
 /* Add new as segment to the as path. */
@@ -609,6 +609,7 @@ aspath_intern (struct bgp_peer *peer, struct aspath *aspath)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct aspath *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
@@ -619,17 +620,21 @@ aspath_intern (struct bgp_peer *peer, struct aspath *aspath)
   /* Assert this AS path structure is not interned. */
   assert (aspath->refcnt == 0);
 
+  lock = hash_lock(inter_domain_routing_db->ashash, aspath);
+
   /* Check AS path hash. */
   find = hash_get(peer, inter_domain_routing_db->ashash, aspath, hash_alloc_intern);
 
   if (find != aspath)
     aspath_free (aspath);
 
-  find->refcnt++;
+  __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
 
   if (! find->str)
     find->str = aspath_make_str_count (find);
 
+  hash_unlock(lock);
+
   return find;
 }
 
@@ -640,11 +645,7 @@ aspath_dup (struct aspath *aspath)
 {
   struct aspath *new;
 
-  new = malloc(sizeof (struct aspath));
-  if (!new) {
-    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (aspath_dup). Exiting ..\n", config.name); // XXX
-    exit_gracefully(1);
-  }
+  new = bgp_slab_alloc(&aspath_slab);
   memset(new, 0, sizeof(struct aspath));
 
   if (aspath->segments)
@@ -749,6 +750,7 @@ struct aspath *aspath_parse(struct bgp_peer *peer, char *s, size_t length, int u
   struct bgp_rt_structs *inter_domain_routing_db;
   struct aspath as;
   struct aspath *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
@@ -767,8 +769,13 @@ struct aspath *aspath_parse(struct bgp_peer *peer, char *s, size_t length, int u
   memset (&as, 0, sizeof (struct aspath));
   as.segments = assegments_parse(s, length, use32bit);
   
+  lock = hash_lock(inter_domain_routing_db->ashash, &as);
+
   /* If already same aspath exist then return it. */
   find = hash_get (peer, inter_domain_routing_db->ashash, &as, aspath_hash_alloc);
+  if (find) __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
+
+  hash_unlock(lock);
   
   /* aspath_hash_alloc dupes segments too. that probably could be
    * optimised out.
@@ -777,10 +784,6 @@ struct aspath *aspath_parse(struct bgp_peer *peer, char *s, size_t length, int u
   if (as.str)
     free(as.str);
   
-  if (! find)
-    return NULL;
-  find->refcnt++;
-
   return find;
 }
 
@@ -1216,6 +1219,7 @@ aspath_parse_ast(struct bgp_peer *peer, as_t asn)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct aspath *aspath, *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
@@ -1224,16 +1228,16 @@ aspath_parse_ast(struct bgp_peer *peer, as_t asn)
   if (!inter_domain_routing_db) return NULL;
 
   aspath = aspath_ast2aspath(asn);
-  find = hash_get (peer, inter_domain_routing_db->ashash, aspath, aspath_hash_alloc);
 
-  /* aspath_hash_alloc dupes stuff */
-  assegment_free_all (aspath->segments);
-  if (aspath->str) free(aspath->str);
-  free(aspath);
+  lock = hash_lock(inter_domain_routing_db->ashash, aspath);
 
-  if (!find) return NULL;
+  find = hash_get (peer, inter_domain_routing_db->ashash, aspath, aspath_hash_alloc);
+  if (find) __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
 
-  find->refcnt++;
+  hash_unlock(lock);
+
+  /* aspath_hash_alloc dupes stuff */
+  aspath_free (aspath);
 
   return find;
 }
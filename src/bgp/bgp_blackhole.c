@@ -217,6 +217,7 @@ int bgp_blackhole_instrument(struct bgp_peer *peer, struct prefix *p, void *a, a
 
   acopy = malloc(sizeof(struct bgp_attr));
   memcpy(acopy, attr, sizeof(struct bgp_attr));
+  acopy->refcnt = 0; /* a private copy, see bgp_attr_intern() */
 
   peer_copy = malloc(sizeof(struct bgp_peer));
   memcpy(peer_copy, peer, sizeof(struct bgp_peer));
@@ -39,11 +39,7 @@ struct community *community_new (struct bgp_peer *peer)
 
   if (!bms) return NULL;
 
-  tmp = malloc(sizeof (struct community));
-  if (!tmp) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (community_new). Exiting ..\n", config.name, bms->log_str);
-    exit_gracefully(1);
-  }
+  tmp = bgp_slab_alloc(&community_slab);
   memset(tmp, 0, sizeof (struct community));
 
   return (struct community *) tmp;
@@ -55,7 +51,7 @@ community_free (struct community *com)
 {
   if (com->val) free(com->val);
   if (com->str) free(com->str);
-  free(com);
+  bgp_slab_free(com);
 }
 
 /* Add one community value to the community. */
@@ -330,6 +326,7 @@ community_intern (struct bgp_peer *peer, struct community *com)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct community *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
@@ -340,6 +337,8 @@ community_intern (struct bgp_peer *peer, struct community *com)
   /* Assert this community structure is not interned. */
   assert (com->refcnt == 0);
 
+  lock = hash_lock(inter_domain_routing_db->comhash, com);
+
   /* Lookup community hash. */
   find = (struct community *) hash_get(peer, inter_domain_routing_db->comhash, com, hash_alloc_intern);
 
@@ -349,12 +348,14 @@ community_intern (struct bgp_peer *peer, struct community *com)
     community_free (com);
 
   /* Increment refrence counter.  */
-  find->refcnt++;
+  __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
 
   /* Make string.  */
   if (! find->str)
     find->str = community_com2str (peer, find);
 
+  hash_unlock(lock);
+
   return find;
 }
 
@@ -364,6 +365,7 @@ community_unintern (struct bgp_peer *peer, struct community *com)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct community *ret = NULL;
+  pthread_mutex_t *lock;
   (void) ret;
 
   if (!peer) return;
@@ -372,17 +374,21 @@ community_unintern (struct bgp_peer *peer, struct community *com)
 
   if (!inter_domain_routing_db) return;
 
-  if (com->refcnt)
-    com->refcnt--;
+  lock = hash_lock(inter_domain_routing_db->comhash, com);
+
+  if (__atomic_load_n(&com->refcnt, __ATOMIC_RELAXED))
+    __atomic_sub_fetch(&com->refcnt, 1, __ATOMIC_ACQ_REL);
 
   /* Pull off from hash.  */
-  if (com->refcnt == 0) {
+  if (__atomic_load_n(&com->refcnt, __ATOMIC_ACQUIRE) == 0) {
     /* Community value com must exist in hash. */
     ret = (struct community *) hash_release(inter_domain_routing_db->comhash, com);
     assert (ret != NULL);
 
-    community_free (com);
+    bgp_rcu_free(com, (void (*)(void *)) community_free);
   }
+
+  hash_unlock(lock);
 }
 
 /* Create new community attribute. */
@@ -498,7 +504,8 @@ struct community *community_dup(struct community *com)
 {
   struct community *new;
 
-  new = malloc(sizeof(struct community));
+  new = bgp_slab_alloc(&community_slab);
+  memset(new, 0, sizeof(struct community));
 
   new->size = com->size;
 
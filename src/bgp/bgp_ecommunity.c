@@ -41,11 +41,7 @@ ecommunity_new (struct bgp_peer *peer)
 
   if (!bms) return NULL;
 
-  tmp = malloc(sizeof (struct ecommunity));
-  if (!tmp) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (ecommunity_new). Exiting ..\n", config.name, bms->log_str);
-    exit_gracefully(1);
-  }
+  tmp = bgp_slab_alloc(&ecommunity_slab);
   memset(tmp, 0, sizeof (struct ecommunity));
 
   return (struct ecommunity *) tmp;
@@ -57,7 +53,7 @@ ecommunity_free (struct ecommunity *ecom)
 {
   if (ecom->val) free(ecom->val);
   if (ecom->str) free(ecom->str);
-  free(ecom);
+  bgp_slab_free(ecom);
 }
 
 /* Add a new Extended Communities value to Extended Communities
@@ -166,6 +162,7 @@ ecommunity_intern (struct bgp_peer *peer, struct ecommunity *ecom)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct ecommunity *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
@@ -175,16 +172,20 @@ ecommunity_intern (struct bgp_peer *peer, struct ecommunity *ecom)
 
   assert (ecom->refcnt == 0);
 
+  lock = hash_lock(inter_domain_routing_db->ecomhash, ecom);
+
   find = (struct ecommunity *) hash_get(peer, inter_domain_routing_db->ecomhash, ecom, hash_alloc_intern);
 
   if (find != ecom)
     ecommunity_free (ecom);
 
-  find->refcnt++;
+  __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
 
   if (! find->str)
     find->str = ecommunity_ecom2str (peer, find, ECOMMUNITY_FORMAT_DISPLAY);
 
+  hash_unlock(lock);
+
   return find;
 }
 
@@ -194,6 +195,7 @@ ecommunity_unintern (struct bgp_peer *peer, struct ecommunity *ecom)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct ecommunity *ret = NULL;
+  pthread_mutex_t *lock;
   (void) ret;
 
   if (!peer) return;
@@ -202,17 +204,21 @@ ecommunity_unintern (struct bgp_peer *peer, struct ecommunity *ecom)
 
   if (!inter_domain_routing_db) return;
 
-  if (ecom->refcnt)
-    ecom->refcnt--;
+  lock = hash_lock(inter_domain_routing_db->ecomhash, ecom);
+
+  if (__atomic_load_n(&ecom->refcnt, __ATOMIC_RELAXED))
+    __atomic_sub_fetch(&ecom->refcnt, 1, __ATOMIC_ACQ_REL);
 
   /* Pull off from hash.  */
-  if (ecom->refcnt == 0) {
+  if (__atomic_load_n(&ecom->refcnt, __ATOMIC_ACQUIRE) == 0) {
     /* Extended community must be in the hash.  */
     ret = (struct ecommunity *) hash_release(inter_domain_routing_db->ecomhash, ecom);
     assert (ret != NULL);
 
-    ecommunity_free(ecom);
+    bgp_rcu_free(ecom, (void (*)(void *)) ecommunity_free);
   }
+
+  hash_unlock(lock);
 }
 
 /* Utinity function to make hash key.  */
@@ -430,7 +436,8 @@ struct ecommunity *ecommunity_dup(struct ecommunity *ecom)
 {
   struct ecommunity *new;
 
-  new = malloc(sizeof(struct ecommunity));
+  new = bgp_slab_alloc(&ecommunity_slab);
+  memset(new, 0, sizeof(struct ecommunity));
 
   new->size = ecom->size;
 
@@ -26,6 +26,7 @@
 
 #include "pmacct.h"
 #include "bgp.h"
+#include "thread_pool.h"
 
 /* Allocate a new hash.  */
 struct hash *
@@ -62,6 +63,51 @@ hash_create (int buckets, unsigned int (*hash_key) (void *),
   return hash_create_size (buckets, hash_key, hash_cmp);
 }
 
+/* Make the hash safe to share among threads: buckets are split in
+   'num' stripes, each guarded by its own lock. Entries equal to some
+   data always fall in the same stripe; whoever looks them up and takes
+   a reference, or drops one and releases them, is to hold it, see
+   hash_lock(). Reference counts are updated atomically: holders of a
+   reference may take one more without the lock, as the count can't
+   drop to zero meanwhile. */
+void
+hash_locks_init (struct hash *hash, unsigned int num)
+{
+  unsigned int i;
+
+  if (!num || hash->locks) return;
+
+  hash->locks = malloc(sizeof (pthread_mutex_t) * num);
+  if (!hash->locks) {
+    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (hash_locks_init). Exiting ..\n", config.name); // XXX
+    exit_gracefully(1);
+  }
+
+  for (i = 0; i < num; i++) pthread_mutex_init(&hash->locks[i], NULL);
+  hash->locks_num = num;
+}
+
+/* Lock the stripe of 'data'; returns NULL, and is a no-op, if the hash
+   is not shared among threads. */
+pthread_mutex_t *
+hash_lock (struct hash *hash, void *data)
+{
+  pthread_mutex_t *lock;
+
+  if (!hash->locks) return NULL;
+
+  lock = &hash->locks[(((*hash->hash_key) (data)) % hash->size) % hash->locks_num];
+  pthread_mutex_lock(lock);
+
+  return lock;
+}
+
+void
+hash_unlock (pthread_mutex_t *lock)
+{
+  if (lock) pthread_mutex_unlock(lock);
+}
+
 /* Utility function for hash_get().  When this function is specified
    as alloc_func, return arugment as it is.  This function is used for
    intern already allocated value.  */
@@ -114,7 +160,7 @@ hash_get (struct bgp_peer *peer, struct hash *hash, void *data, void * (*alloc_f
       backet->key = key;
       backet->next = hash->index[index];
       hash->index[index] = backet;
-      hash->count++;
+      __atomic_add_fetch(&hash->count, 1, __ATOMIC_RELAXED);
       return backet->data;
     }
 
@@ -147,7 +193,7 @@ hash_release (struct hash *hash, void *data)
 
 	  ret = backet->data;
 	  free(backet);
-	  hash->count--;
+	  __atomic_sub_fetch(&hash->count, 1, __ATOMIC_RELAXED);
 	  return ret;
 	}
       pp = backet;
@@ -204,6 +250,10 @@ hash_clean (struct hash *hash, void (*free_func) (void *))
 void
 hash_free (struct hash *hash)
 {
+  unsigned int i;
+
+  for (i = 0; i < hash->locks_num; i++) pthread_mutex_destroy(&hash->locks[i]);
+  free(hash->locks);
   free(hash->index);
   free(hash);
 }
@@ -30,6 +30,9 @@ Boston, MA 02111-1307, USA.
 /* Default hash table size.  */ 
 #define HASHTABSIZE     65535
 
+/* Default number of lock stripes, see hash_locks_init() */
+#define HASHLOCKSNUM    64
+
 struct hash_backet
 {
   /* Linked list.  */
@@ -58,10 +61,17 @@ struct hash
 
   /* Backet alloc. */
   unsigned long count;
+
+  /* Lock stripes, if shared among threads. */
+  pthread_mutex_t *locks;
+  unsigned int locks_num;
 };
 
 extern struct hash *hash_create (int, unsigned int (*) (void *), int (*) (const void *, const void *));
 extern struct hash *hash_create_size (unsigned int, unsigned int (*) (void *), int (*) (const void *, const void *));
+extern void hash_locks_init (struct hash *, unsigned int);
+extern pthread_mutex_t *hash_lock (struct hash *, void *);
+extern void hash_unlock (pthread_mutex_t *);
 extern void *hash_get (struct bgp_peer *, struct hash *, void *, void * (*) (void *));
 extern void *hash_alloc_intern (void *);
 extern void *hash_release (struct hash *, void *);
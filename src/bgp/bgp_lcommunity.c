@@ -38,11 +38,7 @@ lcommunity_new (struct bgp_peer *peer)
 
   if (!bms) return NULL;
 
-  tmp = malloc(sizeof (struct lcommunity));
-  if (!tmp) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (lcommunity_new). Exiting ..\n", config.name, bms->log_str);
-    exit_gracefully(1);
-  }
+  tmp = bgp_slab_alloc(&lcommunity_slab);
   memset(tmp, 0, sizeof (struct lcommunity));
 
   return (struct lcommunity *) tmp;
@@ -54,7 +50,7 @@ lcommunity_free (struct lcommunity *lcom)
 {
   if (lcom->val) free(lcom->val);
   if (lcom->str) free(lcom->str);
-  free(lcom);
+  bgp_slab_free(lcom);
 }
 
 /* Add a new Large Communities value to Large Communities
@@ -163,6 +159,7 @@ lcommunity_intern (struct bgp_peer *peer, struct lcommunity *lcom)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct lcommunity *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
@@ -172,16 +169,20 @@ lcommunity_intern (struct bgp_peer *peer, struct lcommunity *lcom)
 
   assert (lcom->refcnt == 0);
 
+  lock = hash_lock(inter_domain_routing_db->lcomhash, lcom);
+
   find = (struct lcommunity *) hash_get(peer, inter_domain_routing_db->lcomhash, lcom, hash_alloc_intern);
 
   if (find != lcom)
     lcommunity_free (lcom);
 
-  find->refcnt++;
+  __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
 
   if (! find->str)
     find->str = lcommunity_lcom2str (peer, find);
 
+  hash_unlock(lock);
+
   return find;
 }
 
@@ -191,6 +192,7 @@ lcommunity_unintern (struct bgp_peer *peer, struct lcommunity *lcom)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct lcommunity *ret = NULL;
+  pthread_mutex_t *lock;
   (void) ret;
 
   if (!peer) return;
@@ -199,17 +201,21 @@ lcommunity_unintern (struct bgp_peer *peer, struct lcommunity *lcom)
 
   if (!inter_domain_routing_db) return;
 
-  if (lcom->refcnt)
-    lcom->refcnt--;
+  lock = hash_lock(inter_domain_routing_db->lcomhash, lcom);
+
+  if (__atomic_load_n(&lcom->refcnt, __ATOMIC_RELAXED))
+    __atomic_sub_fetch(&lcom->refcnt, 1, __ATOMIC_ACQ_REL);
 
   /* Pull off from hash.  */
-  if (lcom->refcnt == 0) {
+  if (__atomic_load_n(&lcom->refcnt, __ATOMIC_ACQUIRE) == 0) {
     /* Large community must be in the hash.  */
     ret = (struct lcommunity *) hash_release(inter_domain_routing_db->lcomhash, lcom);
     assert (ret != NULL);
 
-    lcommunity_free(lcom);
+    bgp_rcu_free(lcom, (void (*)(void *)) lcommunity_free);
   }
+
+  hash_unlock(lock);
 }
 
 /* Utinity function to make hash key.  */
@@ -308,7 +314,8 @@ struct lcommunity *lcommunity_dup(struct lcommunity *lcom)
 {
   struct lcommunity *new;
 
-  new = malloc(sizeof(struct lcommunity));
+  new = bgp_slab_alloc(&lcommunity_slab);
+  memset(new, 0, sizeof(struct lcommunity));
 
   new->size = lcom->size;
 
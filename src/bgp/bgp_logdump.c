@@ -105,6 +105,12 @@ int bgp_peer_log_msg(struct bgp_node *route, struct bgp_info *ri, afi_t afi, saf
     }
     else if (etype == BGP_LOGDUMP_ET_DUMP) {
       json_object_set_new_nocheck(obj, "seq", json_integer((json_int_t) bgp_peer_log_seq_get(&bms->log_seq)));
+
+      /* differential dumps */
+      if (log_type == BGP_LOG_TYPE_UPDATE)
+	json_object_set_new_nocheck(obj, "log_type", json_string("update"));
+      else if (log_type == BGP_LOG_TYPE_WITHDRAW)
+	json_object_set_new_nocheck(obj, "log_type", json_string("withdraw"));
     }
 
     if (etype == BGP_LOGDUMP_ET_LOG)
@@ -270,6 +276,20 @@ int bgp_peer_log_msg(struct bgp_node *route, struct bgp_info *ri, afi_t afi, saf
     else if (etype == BGP_LOGDUMP_ET_DUMP) {
       pm_avro_check(avro_value_get_by_name(&avro_obj, "seq", &avro_field, NULL));
       pm_avro_check(avro_value_set_long(&avro_field, bgp_peer_log_seq_get(&bms->log_seq)));
+
+      if (bms->dump_checkpoint) {
+	pm_avro_check(avro_value_get_by_name(&avro_obj, "log_type", &avro_field, NULL));
+
+	if (log_type == BGP_LOG_TYPE_UPDATE) {
+	  pm_avro_check(avro_value_set_branch(&avro_field, TRUE, &avro_branch));
+	  pm_avro_check(avro_value_set_string(&avro_branch, "update"));
+	}
+	else if (log_type == BGP_LOG_TYPE_WITHDRAW) {
+	  pm_avro_check(avro_value_set_branch(&avro_field, TRUE, &avro_branch));
+	  pm_avro_check(avro_value_set_string(&avro_branch, "withdraw"));
+	}
+	else pm_avro_check(avro_value_set_branch(&avro_field, FALSE, &avro_branch));
+      }
     }
 
     if (etype == BGP_LOGDUMP_ET_LOG) {
@@ -1113,6 +1133,9 @@ int bgp_peer_dump_init(struct bgp_peer *peer, int output, int type)
 
     json_object_set_new_nocheck(obj, "dump_period", json_integer((json_int_t)bms->dump.period));
 
+    if (bms->dump_checkpoint)
+      json_object_set_new_nocheck(obj, "dump_type", json_string(bms->dump.delta ? "delta" : "full"));
+
     json_object_set_new_nocheck(obj, "seq", json_integer((json_int_t) bgp_peer_log_seq_get(&bms->log_seq)));
 
     if (bms->bgp_peer_logdump_initclose_extras) {
@@ -1182,6 +1205,11 @@ int bgp_peer_dump_init(struct bgp_peer *peer, int output, int type)
     pm_avro_check(avro_value_get_by_name(&avro_obj, "dump_period", &avro_field, NULL));
     pm_avro_check(avro_value_set_int(&avro_field, bms->dump.period)); 
 
+    if (bms->dump_checkpoint) {
+      pm_avro_check(avro_value_get_by_name(&avro_obj, "dump_type", &avro_field, NULL));
+      pm_avro_check(avro_value_set_string(&avro_field, (bms->dump.delta ? "delta" : "full")));
+    }
+
     pm_avro_check(avro_value_get_by_name(&avro_obj, "writer_id", &avro_field, NULL));
     snprintf(wid, SHORTSHORTBUFLEN, "%s/%u", config.proc_name, writer_pid);
     pm_avro_check(avro_value_set_string(&avro_field, wid));
@@ -1421,12 +1449,13 @@ int bgp_peer_dump_close(struct bgp_peer *peer, struct bgp_dump_stats *bds, int o
   return (ret | amqp_ret | kafka_ret);
 }
 
-void bgp_handle_dump_event()
+/* 'writer' out of 'writers' forked by bgp_handle_dump_event(), never returns */
+static void bgp_dump_writer(int writer, int writers, u_int64_t dump_seqno)
 {
   struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
   char current_filename[SRVBUFLEN], last_filename[SRVBUFLEN], tmpbuf[SRVBUFLEN];
   char latest_filename[SRVBUFLEN], event_type[] = "dump", *fd_buf = NULL;
-  int ret, peers_idx, duration, tables_num; 
+  int peers_idx, peers_num, duration, tables_num; 
   struct bgp_rt_structs *inter_domain_routing_db;
   struct bgp_peer *peer, *saved_peer;
   struct bgp_table *table;
@@ -1437,206 +1466,341 @@ void bgp_handle_dump_event()
   safi_t safi;
   pid_t dumper_pid;
   time_t start;
-  u_int64_t dump_elems = 0, dump_seqno;
+  u_int64_t dump_elems = 0;
+  u_int32_t deltas_num = 0;
 
-  /* pre-flight check */
-  if (!bms->dump_backend_methods || !config.bgp_table_dump_refresh_time)
-    return;
+  /* we have to ignore signals to avoid loops: because we are already forked */
+  signal(SIGINT, SIG_IGN);
+  signal(SIGHUP, SIG_IGN);
+  pm_setproctitle("%s %s [%s]", config.type, "Core Process -- BGP Dump Writer", config.name, bms->log_str);
+  config.is_forked = TRUE;
 
-  /* Sequencing the dump event */
-  dump_seqno = bgp_peer_log_seq_get(&bms->log_seq);
-  bgp_peer_log_seq_increment(&bms->log_seq);
-
-  switch (ret = fork()) {
-  case 0: /* Child */
-    /* we have to ignore signals to avoid loops: because we are already forked */
-    signal(SIGINT, SIG_IGN);
-    signal(SIGHUP, SIG_IGN);
-    pm_setproctitle("%s %s [%s]", config.type, "Core Process -- BGP Dump Writer", config.name, bms->log_str);
-    config.is_forked = TRUE;
+  memset(last_filename, 0, sizeof(last_filename));
+  memset(current_filename, 0, sizeof(current_filename));
+  memset(&peer_log, 0, sizeof(struct bgp_peer_log));
+  memset(&bds, 0, sizeof(struct bgp_dump_stats));
 
-    memset(last_filename, 0, sizeof(last_filename));
-    memset(current_filename, 0, sizeof(current_filename));
-    memset(&peer_log, 0, sizeof(struct bgp_peer_log));
-    memset(&bds, 0, sizeof(struct bgp_dump_stats));
-
-    fd_buf = malloc(OUTPUT_FILE_BUFSZ);
-    bgp_peer_log_seq_set(&bms->log_seq, dump_seqno);
+  fd_buf = malloc(OUTPUT_FILE_BUFSZ);
+  bgp_peer_log_seq_set(&bms->log_seq, dump_seqno);
 
 #ifdef WITH_RABBITMQ
-    if (config.bgp_table_dump_amqp_routing_key) {
-      bgp_table_dump_init_amqp_host();
-      ret = p_amqp_connect_to_publish(&bgp_table_dump_amqp_host);
-      if (ret) exit_gracefully(ret);
-    }
+  if (config.bgp_table_dump_amqp_routing_key) {
+    int ret;
+
+    bgp_table_dump_init_amqp_host();
+    ret = p_amqp_connect_to_publish(&bgp_table_dump_amqp_host);
+    if (ret) exit_gracefully(ret);
+  }
 #endif
 
 #ifdef WITH_KAFKA
-    if (config.bgp_table_dump_kafka_topic) {
-      ret = bgp_table_dump_init_kafka_host();
-      if (ret) exit_gracefully(ret);
-    }
+  if (config.bgp_table_dump_kafka_topic) {
+    int ret;
+
+    ret = bgp_table_dump_init_kafka_host();
+    if (ret) exit_gracefully(ret);
+  }
 #endif
 
-    dumper_pid = getpid();
-    Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BGP tables - START (PID: %u) ***\n", config.name, bms->log_str, dumper_pid);
-    start = time(NULL);
-    tables_num = 0;
+  dumper_pid = getpid();
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BGP tables - START (PID: %u) ***\n", config.name, bms->log_str, dumper_pid);
+  start = time(NULL);
+  tables_num = 0;
 
 #ifdef WITH_SERDES
-    if (config.bgp_table_dump_kafka_avro_schema_registry) { 
-      if (strchr(config.bgp_table_dump_kafka_topic, '$')) {
-        Log(LOG_ERR, "ERROR ( %s/%s ): dynamic 'bgp_table_dump_kafka_topic' is not compatible with 'bgp_table_dump_kafka_avro_schema_registry'. Exiting.\n",
-	    config.name, bms->log_str);
-	exit_gracefully(1);
-      }
-
-      bgp_table_dump_kafka_host.sd_schema[0] = compose_avro_schema_registry_name_2(config.bgp_table_dump_kafka_topic, FALSE,
-										   bms->dump_avro_schema[0],
-										   "bgp", "dump",
-										   config.bgp_table_dump_kafka_avro_schema_registry);
-
-      bgp_table_dump_kafka_host.sd_schema[BGP_LOG_TYPE_DUMPINIT] = compose_avro_schema_registry_name_2(config.bgp_table_dump_kafka_topic, FALSE,
-										   bms->dump_avro_schema[BGP_LOG_TYPE_DUMPINIT],
-										   "bgp", "dumpinit",
-										   config.bgp_table_dump_kafka_avro_schema_registry);
-
-      bgp_table_dump_kafka_host.sd_schema[BGP_LOG_TYPE_DUMPCLOSE] = compose_avro_schema_registry_name_2(config.bgp_table_dump_kafka_topic, FALSE,
-										   bms->dump_avro_schema[BGP_LOG_TYPE_DUMPCLOSE],
-										   "bgp", "dumpclose",
-										   config.bgp_table_dump_kafka_avro_schema_registry);
-    }
+  if (config.bgp_table_dump_kafka_avro_schema_registry) { 
+    if (strchr(config.bgp_table_dump_kafka_topic, '$')) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): dynamic 'bgp_table_dump_kafka_topic' is not compatible with 'bgp_table_dump_kafka_avro_schema_registry'. Exiting.\n",
+	  config.name, bms->log_str);
+      exit_gracefully(1);
+    }
+
+    bgp_table_dump_kafka_host.sd_schema[0] = compose_avro_schema_registry_name_2(config.bgp_table_dump_kafka_topic, FALSE,
+										 bms->dump_avro_schema[0],
+										 "bgp", "dump",
+										 config.bgp_table_dump_kafka_avro_schema_registry);
+
+    bgp_table_dump_kafka_host.sd_schema[BGP_LOG_TYPE_DUMPINIT] = compose_avro_schema_registry_name_2(config.bgp_table_dump_kafka_topic, FALSE,
+										 bms->dump_avro_schema[BGP_LOG_TYPE_DUMPINIT],
+										 "bgp", "dumpinit",
+										 config.bgp_table_dump_kafka_avro_schema_registry);
+
+    bgp_table_dump_kafka_host.sd_schema[BGP_LOG_TYPE_DUMPCLOSE] = compose_avro_schema_registry_name_2(config.bgp_table_dump_kafka_topic, FALSE,
+										 bms->dump_avro_schema[BGP_LOG_TYPE_DUMPCLOSE],
+										 "bgp", "dumpclose",
+										 config.bgp_table_dump_kafka_avro_schema_registry);
+  }
 #endif
 
-    for (peer = NULL, saved_peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
-      if (peers[peers_idx].fd) {
-        peer = &peers[peers_idx];
-	peer->log = &peer_log; /* abusing struct bgp_peer a bit, but we are in a child */
+  for (peer = NULL, saved_peer = NULL, peers_idx = 0, peers_num = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+    if (peers[peers_idx].fd) {
+      if ((peers_num++ % writers) != writer) continue;
 
-	if (config.bgp_table_dump_file) {
-	  bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bgp_table_dump_file, peer);
-	}
+      peer = &peers[peers_idx];
+      peer->log = &peer_log; /* abusing struct bgp_peer a bit, but we are in a child */
 
-	if (config.bgp_table_dump_amqp_routing_key) {
-	  bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bgp_table_dump_amqp_routing_key, peer);
-	}
+      if (config.bgp_table_dump_file) {
+	bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bgp_table_dump_file, peer);
+      }
 
-	if (config.bgp_table_dump_kafka_topic) {
-	  bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bgp_table_dump_kafka_topic, peer);
-	}
+      if (config.bgp_table_dump_amqp_routing_key) {
+	bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bgp_table_dump_amqp_routing_key, peer);
+      }
 
-	pm_strftime_same(current_filename, SRVBUFLEN, tmpbuf, &bms->dump.tstamp.tv_sec, config.timestamps_utc);
-
-	/*
-	   we close last_filename and open current_filename in case they differ;
-	   we are safe with this approach until time and BGP peer (IP, port) are
-	   the only variables supported as part of bgp_table_dump_file.
-        */
-	if (config.bgp_table_dump_file) {
-	  if (strcmp(last_filename, current_filename)) {
-	    if (saved_peer && saved_peer->log && strlen(last_filename)) {
-	      close_output_file(saved_peer->log->fd);
-
-	      if (config.bgp_table_dump_latest_file) {
-		bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bgp_table_dump_latest_file, saved_peer);
-		link_latest_output_file(latest_filename, last_filename);
-	      }
-	    }
-	    peer->log->fd = open_output_file(current_filename, "w", TRUE);
-	    if (fd_buf) {
-	      if (setvbuf(peer->log->fd, fd_buf, _IOFBF, OUTPUT_FILE_BUFSZ))
-		Log(LOG_WARNING, "WARN ( %s/%s ): [%s] setvbuf() failed: %s\n",
-		    config.name, bms->log_str, current_filename, strerror(errno));
-	      else memset(fd_buf, 0, OUTPUT_FILE_BUFSZ); 
+      if (config.bgp_table_dump_kafka_topic) {
+	bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bgp_table_dump_kafka_topic, peer);
+      }
+
+      pm_strftime_same(current_filename, SRVBUFLEN, tmpbuf, &bms->dump.tstamp.tv_sec, config.timestamps_utc);
+
+      /*
+	 we close last_filename and open current_filename in case they differ;
+	 we are safe with this approach until time and BGP peer (IP, port) are
+	 the only variables supported as part of bgp_table_dump_file.
+      */
+      if (config.bgp_table_dump_file) {
+	if (strcmp(last_filename, current_filename)) {
+	  if (saved_peer && saved_peer->log && strlen(last_filename)) {
+	    close_output_file(saved_peer->log->fd);
+
+	    if (config.bgp_table_dump_latest_file) {
+	      bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bgp_table_dump_latest_file, saved_peer);
+	      link_latest_output_file(latest_filename, last_filename);
 	    }
 	  }
+	  peer->log->fd = open_output_file(current_filename, "w", TRUE);
+	  if (fd_buf) {
+	    if (setvbuf(peer->log->fd, fd_buf, _IOFBF, OUTPUT_FILE_BUFSZ))
+	      Log(LOG_WARNING, "WARN ( %s/%s ): [%s] setvbuf() failed: %s\n",
+		  config.name, bms->log_str, current_filename, strerror(errno));
+	    else memset(fd_buf, 0, OUTPUT_FILE_BUFSZ); 
+	  }
 	}
+      }
 
-	/*
-	   a bit pedantic maybe but should come at little cost and emulating
-	   bgp_table_dump_file behaviour will work
-	*/ 
+      /*
+	 a bit pedantic maybe but should come at little cost and emulating
+	 bgp_table_dump_file behaviour will work
+      */ 
 #ifdef WITH_RABBITMQ
-	if (config.bgp_table_dump_amqp_routing_key) {
-	  peer->log->amqp_host = &bgp_table_dump_amqp_host;
-	  strcpy(peer->log->filename, current_filename);
-	}
+      if (config.bgp_table_dump_amqp_routing_key) {
+	peer->log->amqp_host = &bgp_table_dump_amqp_host;
+	strcpy(peer->log->filename, current_filename);
+      }
 #endif
 
 #ifdef WITH_KAFKA
-	if (config.bgp_table_dump_kafka_topic) {
-	  peer->log->kafka_host = &bgp_table_dump_kafka_host;
-	  strcpy(peer->log->filename, current_filename);
-	}
+      if (config.bgp_table_dump_kafka_topic) {
+	peer->log->kafka_host = &bgp_table_dump_kafka_host;
+	strcpy(peer->log->filename, current_filename);
+      }
 #endif
 
-	bgp_peer_dump_init(peer, config.bgp_table_dump_output, FUNC_TYPE_BGP);
-        inter_domain_routing_db = bgp_select_routing_db(FUNC_TYPE_BGP);
-	dump_elems = 0;
+      /* peers new since the last dump get a full one, see bgp_table_dump_checkpoint */
+      bms->dump.delta = (bms->dump_checkpoint && (bms->dump.gen % bms->dump_checkpoint) && peer->dump_seen);
+      if (bms->dump.delta) deltas_num++;
+
+      bgp_peer_dump_init(peer, config.bgp_table_dump_output, FUNC_TYPE_BGP);
+      inter_domain_routing_db = bgp_select_routing_db(FUNC_TYPE_BGP);
+      dump_elems = 0;
+
+      if (!inter_domain_routing_db) exit_gracefully(1);
+
+      /* withdrawals first: a route may have been re-announced since */
+      if (bms->dump.delta) {
+	struct bgp_dump_journal_entry *bdje;
+	struct bgp_info_extra extra_local;
+	struct bgp_info ri_local;
+	struct bgp_node node_local;
+	u_int32_t idx;
+
+	for (idx = 0; idx < peer->dump_journal.num; idx++) {
+	  bdje = &peer->dump_journal.list[idx];
+
+	  memset(&node_local, 0, sizeof(struct bgp_node));
+	  memset(&ri_local, 0, sizeof(struct bgp_info));
+	  memset(&extra_local, 0, sizeof(struct bgp_info_extra));
+
+	  memcpy(&node_local.p, &bdje->p, sizeof(struct prefix));
+	  memcpy(&extra_local.rd, &bdje->rd, sizeof(rd_t));
+	  memcpy(extra_local.label, bdje->label, 3);
+	  extra_local.path_id = bdje->path_id;
+	  ri_local.peer = peer;
+	  ri_local.extra = &extra_local;
+
+	  bgp_peer_log_msg(&node_local, &ri_local, bdje->afi, bdje->safi, event_type, config.bgp_table_dump_output, NULL, BGP_LOG_TYPE_WITHDRAW);
+	  dump_elems++;
+	}
+      }
+
+      for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+	for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+	  table = inter_domain_routing_db->rib[afi][safi];
+	  node = bgp_table_top(peer, table);
 
-	if (!inter_domain_routing_db) return;
+	  while (node) {
+	    u_int32_t modulo = bgp_route_info_modulo(peer, NULL, bms->table_per_peer_buckets);
+	    u_int32_t peer_buckets;
+	    struct bgp_info *ri;
 
-	for (afi = AFI_IP; afi < AFI_MAX; afi++) {
-	  for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-	    table = inter_domain_routing_db->rib[afi][safi];
-	    node = bgp_table_top(peer, table);
+	    for (peer_buckets = 0; peer_buckets < config.bgp_table_per_peer_buckets; peer_buckets++) {
+	      for (ri = node->info[modulo+peer_buckets]; ri; ri = ri->next) {
+		if (bgp_info_peer_match(ri, peer)) {
+		  struct bgp_info ri_view;
 
-	    while (node) {
-	      u_int32_t modulo = bgp_route_info_modulo(peer, NULL, bms->table_per_peer_buckets);
-	      u_int32_t peer_buckets;
-	      struct bgp_info *ri;
+		  if (bms->dump.delta) {
+		    /* unchanged since the last dump */
+		    if (ri->dump_gen != bms->dump.gen) continue;
 
-	      for (peer_buckets = 0; peer_buckets < config.bgp_table_per_peer_buckets; peer_buckets++) {
-	        for (ri = node->info[modulo+peer_buckets]; ri; ri = ri->next) {
-		  if (ri->peer == peer) {
-	            bgp_peer_log_msg(node, ri, afi, safi, event_type, config.bgp_table_dump_output, NULL, BGP_LOG_TYPE_MISC);
-	            dump_elems++;
+		    bgp_peer_log_msg(node, bgp_info_peer_view(ri, peer, &ri_view), afi, safi, event_type, config.bgp_table_dump_output, NULL, BGP_LOG_TYPE_UPDATE);
 		  }
+		  else bgp_peer_log_msg(node, bgp_info_peer_view(ri, peer, &ri_view), afi, safi, event_type, config.bgp_table_dump_output, NULL, BGP_LOG_TYPE_MISC);
+
+		  dump_elems++;
 		}
 	      }
-
-	      node = bgp_route_next(peer, node);
 	    }
+
+	    node = bgp_route_next(peer, node);
 	  }
 	}
+      }
 
-        saved_peer = peer;
-	tables_num++;
+      saved_peer = peer;
+      tables_num++;
 
-        strlcpy(last_filename, current_filename, SRVBUFLEN);
-	bds.entries = dump_elems;
-	bds.tables = tables_num;
-        bgp_peer_dump_close(peer, &bds, config.bgp_table_dump_output, FUNC_TYPE_BGP);
-      }
+      strlcpy(last_filename, current_filename, SRVBUFLEN);
+      bds.entries = dump_elems;
+      bds.tables = tables_num;
+      bgp_peer_dump_close(peer, &bds, config.bgp_table_dump_output, FUNC_TYPE_BGP);
     }
+  }
 
 #ifdef WITH_RABBITMQ
-    if (config.bgp_table_dump_amqp_routing_key)
-      p_amqp_close(&bgp_table_dump_amqp_host, FALSE);
+  if (config.bgp_table_dump_amqp_routing_key)
+    p_amqp_close(&bgp_table_dump_amqp_host, FALSE);
 #endif
 
 #ifdef WITH_KAFKA
-    if (config.bgp_table_dump_kafka_topic)
-      p_kafka_close(&bgp_table_dump_kafka_host, FALSE);
+  if (config.bgp_table_dump_kafka_topic)
+    p_kafka_close(&bgp_table_dump_kafka_host, FALSE);
 #endif
 
-    if (config.bgp_table_dump_latest_file && peer) {
-      bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bgp_table_dump_latest_file, peer);
-      link_latest_output_file(latest_filename, last_filename);
-    }
+  if (config.bgp_table_dump_latest_file && peer) {
+    bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bgp_table_dump_latest_file, peer);
+    link_latest_output_file(latest_filename, last_filename);
+  }
+
+  duration = time(NULL)-start;
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BGP tables - END (PID: %u TABLES: %u ENTRIES: %" PRIu64 " ET: %u) ***\n",
+	      config.name, bms->log_str, dumper_pid, tables_num, dump_elems, duration);
+
+  if (bms->dump_checkpoint)
+    Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BGP tables - %u full, %u delta (PID: %u) ***\n",
+	config.name, bms->log_str, (tables_num - deltas_num), deltas_num, dumper_pid);
 
-    duration = time(NULL)-start;
-    Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BGP tables - END (PID: %u TABLES: %u ENTRIES: %" PRIu64 " ET: %u) ***\n",
-		config.name, bms->log_str, dumper_pid, tables_num, dump_elems, duration);
+  /* figures are process-wide, once is enough */
+  if (!writer) bgp_slab_stats_log(bms->log_str);
 
-    exit_gracefully(0);
-  default: /* Parent */
-    if (ret == -1) { /* Something went wrong */
+  exit_gracefully(0);
+}
+
+void bgp_handle_dump_event()
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  int writers = (config.bgp_table_dump_workers ? config.bgp_table_dump_workers : 1);
+  int ret, peers_idx, peers_num, writer;
+  u_int8_t forked[writers];
+  u_int64_t dump_seqno;
+
+  /* pre-flight check */
+  if (!bms->dump_backend_methods || !config.bgp_table_dump_refresh_time)
+    return;
+
+  /* Sequencing the dump event */
+  dump_seqno = bgp_peer_log_seq_get(&bms->log_seq);
+  bgp_peer_log_seq_increment(&bms->log_seq);
+
+  /* peers are shared round-robin among writers, see bgp_dump_writer() */
+  for (writer = 0; writer < writers; writer++) {
+    ret = fork();
+
+    if (!ret) bgp_dump_writer(writer, writers, dump_seqno); /* Child */
+    else if (ret == -1) /* Something went wrong */
       Log(LOG_WARNING, "WARN ( %s/%s ): Unable to fork BGP table dump writer: %s\n", config.name, bms->log_str, strerror(errno));
+
+    forked[writer] = (ret != -1);
+  }
+
+  if (bms->dump_checkpoint) {
+    /* writers got their copy of the journals: start over */
+    for (peers_idx = 0, peers_num = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+      if (peers[peers_idx].fd) {
+	/* peers left out of this dump go in full next time */
+	peers[peers_idx].dump_seen = forked[(peers_num++) % writers];
+	peers[peers_idx].dump_journal.num = 0;
+      }
+    }
+
+    bms->dump.gen++;
+  }
+}
+
+void bgp_info_dump_stamp(struct bgp_peer *peer, struct bgp_info *ri)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+
+  if (bms && bms->dump_checkpoint) ri->dump_gen = bms->dump.gen;
+}
+
+/* to be called before 'ri' is deleted, 'peer' being the one withdrawing it */
+void bgp_dump_journal_add(struct bgp_peer *peer, struct bgp_node *route, struct bgp_info *ri, afi_t afi, safi_t safi)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+  struct bgp_dump_journal *bdj = &peer->dump_journal;
+  struct bgp_dump_journal_entry *list, *bdje;
+  u_int32_t max;
+
+  if (!bms || !bms->dump_checkpoint) return;
+
+  /* next dump of the peer is going to be a full one anyway */
+  if (!peer->dump_seen || !(bms->dump.gen % bms->dump_checkpoint)) return;
+
+  if (bdj->num == bdj->max) {
+    max = (bdj->max ? (bdj->max * 2) : 64);
+
+    list = realloc(bdj->list, (max * sizeof(struct bgp_dump_journal_entry)));
+    if (!list) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): realloc() failed (bgp_dump_journal_add). Exiting ..\n", config.name, bms->log_str);
+      exit_gracefully(1);
     }
 
-    break;
+    bdj->list = list;
+    bdj->max = max;
+  }
+
+  bdje = &bdj->list[bdj->num];
+  memset(bdje, 0, sizeof(struct bgp_dump_journal_entry));
+
+  memcpy(&bdje->p, &route->p, sizeof(struct prefix));
+  bdje->afi = afi;
+  bdje->safi = safi;
+
+  if (ri->extra) {
+    memcpy(&bdje->rd, &ri->extra->rd, sizeof(rd_t));
+    memcpy(bdje->label, ri->extra->label, 3);
+    bdje->path_id = ri->extra->path_id;
   }
+
+  bdj->num++;
+}
+
+void bgp_dump_journal_free(struct bgp_peer *peer)
+{
+  struct bgp_dump_journal *bdj = &peer->dump_journal;
+
+  if (bdj->list) free(bdj->list);
+  memset(bdj, 0, sizeof(struct bgp_dump_journal));
 }
 
 #if defined WITH_RABBITMQ
@@ -1769,6 +1933,10 @@ avro_schema_t avro_schema_build_bgp(int log_type, char *schema_name)
   avro_schema_record_field_append(schema, "peer_ip_src", avro_schema_string());
   avro_schema_record_field_append(schema, "peer_tcp_port", optint_s);
 
+  /* set in differential dumps only */
+  if (log_type == BGP_LOGDUMP_ET_DUMP && config.bgp_table_dump_checkpoint)
+    avro_schema_record_field_append(schema, "log_type", optstr_s);
+
   avro_schema_build_bgp_route(&schema, &optlong_s, &optstr_s, &optint_s);
 
   avro_schema_decref(optlong_s);
@@ -1820,6 +1988,9 @@ avro_schema_t avro_schema_build_bgp_dump_init(int log_type, char *schema_name)
   avro_schema_record_field_append(schema, "peer_tcp_port", optint_s);
   avro_schema_record_field_append(schema, "dump_period", avro_schema_int());
 
+  if (config.bgp_table_dump_checkpoint)
+    avro_schema_record_field_append(schema, "dump_type", avro_schema_string());
+
   avro_schema_decref(optlong_s);
   avro_schema_decref(optstr_s);
   avro_schema_decref(optint_s);
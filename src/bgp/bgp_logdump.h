@@ -55,6 +55,22 @@ struct bgp_dump_stats {
   u_int32_t tables;
 };
 
+/* routes withdrawn by a peer since the last dump, see bgp_table_dump_checkpoint */
+struct bgp_dump_journal_entry {
+  struct prefix p;
+  afi_t afi;
+  safi_t safi;
+  rd_t rd;
+  u_char label[3];
+  path_id_t path_id;
+};
+
+struct bgp_dump_journal {
+  struct bgp_dump_journal_entry *list;
+  u_int32_t num;
+  u_int32_t max;
+};
+
 /* prototypes */
 extern int bgp_peer_log_init(struct bgp_peer *, int, int);
 extern int bgp_peer_log_close(struct bgp_peer *, int, int);
@@ -70,6 +86,9 @@ extern int bgp_peer_log_seq_has_ro_bit(u_int64_t *);
 extern int bgp_peer_dump_init(struct bgp_peer *, int, int);
 extern int bgp_peer_dump_close(struct bgp_peer *, struct bgp_dump_stats *, int, int);
 extern void bgp_handle_dump_event();
+extern void bgp_dump_journal_add(struct bgp_peer *, struct bgp_node *, struct bgp_info *, afi_t, safi_t);
+extern void bgp_dump_journal_free(struct bgp_peer *);
+extern void bgp_info_dump_stamp(struct bgp_peer *, struct bgp_info *);
 extern void bgp_daemon_msglog_init_amqp_host();
 extern void bgp_table_dump_init_amqp_host();
 extern int bgp_daemon_msglog_init_kafka_host();
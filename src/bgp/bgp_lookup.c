@@ -28,6 +28,7 @@
 #include "bgp.h"
 #include "pmbgpd.h"
 #include "rpki/rpki.h"
+#include "jhash.h"
 
 void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
 {
@@ -121,11 +122,8 @@ void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
 	nmct2.peer_dst_ip = NULL;
 
         memcpy(&pref4, &((struct pm_iphdr *)pptrs->iph_ptr)->ip_src, sizeof(struct in_addr));
-	bgp_node_match_ipv4(inter_domain_routing_db->rib[AFI_IP][safi],
-			    &pref4, (struct bgp_peer *) pptrs->bgp_peer,
-		     	    bms->route_info_modulo,
-			    bms->bgp_lookup_node_match_cmp, &nmct2,
-			    bms->bnv, &result, &info);
+	bgp_lookup_node_match(bms, inter_domain_routing_db->rib[AFI_IP][safi], AFI_IP,
+			      &pref4, &nmct2, &result, &info);
       }
 
       if (!pptrs->bgp_src_info && result) {
@@ -149,11 +147,8 @@ void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
         nmct2.peer_dst_ip = &peer_dst_ip;
 
 	memcpy(&pref4, &((struct pm_iphdr *)pptrs->iph_ptr)->ip_dst, sizeof(struct in_addr));
-	bgp_node_match_ipv4(inter_domain_routing_db->rib[AFI_IP][safi],
-			    &pref4, (struct bgp_peer *) pptrs->bgp_peer,
-			    bms->route_info_modulo,
-			    bms->bgp_lookup_node_match_cmp, &nmct2,
-			    bms->bnv, &result, &info);
+	bgp_lookup_node_match(bms, inter_domain_routing_db->rib[AFI_IP][safi], AFI_IP,
+			      &pref4, &nmct2, &result, &info);
       }
 
       if (!pptrs->bgp_dst_info && result) {
@@ -178,11 +173,8 @@ void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
         nmct2.peer_dst_ip = NULL;
 
         memcpy(&pref6, &((struct ip6_hdr *)pptrs->iph_ptr)->ip6_src, sizeof(struct in6_addr));
-	bgp_node_match_ipv6(inter_domain_routing_db->rib[AFI_IP6][safi],
-		            &pref6, (struct bgp_peer *) pptrs->bgp_peer,
-		            bms->route_info_modulo,
-		            bms->bgp_lookup_node_match_cmp, &nmct2,
-		            bms->bnv, &result, &info);
+	bgp_lookup_node_match(bms, inter_domain_routing_db->rib[AFI_IP6][safi], AFI_IP6,
+			      &pref6, &nmct2, &result, &info);
       }
 
       if (!pptrs->bgp_src_info && result) {
@@ -205,11 +197,8 @@ void bgp_srcdst_lookup(struct packet_ptrs *pptrs, int type)
         nmct2.peer_dst_ip = &peer_dst_ip;
 
         memcpy(&pref6, &((struct ip6_hdr *)pptrs->iph_ptr)->ip6_dst, sizeof(struct in6_addr));
-	bgp_node_match_ipv6(inter_domain_routing_db->rib[AFI_IP6][safi],
-	     		    &pref6, (struct bgp_peer *) pptrs->bgp_peer,
-			    bms->route_info_modulo,
-			    bms->bgp_lookup_node_match_cmp, &nmct2,
-			    bms->bnv, &result, &info);
+	bgp_lookup_node_match(bms, inter_domain_routing_db->rib[AFI_IP6][safi], AFI_IP6,
+			      &pref6, &nmct2, &result, &info);
       }
 
       if (!pptrs->bgp_dst_info && result) {
@@ -405,7 +394,7 @@ void bgp_follow_nexthop_lookup(struct packet_ptrs *pptrs, int type)
     if (result_node) {
       for (local_modulo = modulo, modulo_idx = 0; modulo_idx < modulo_max; local_modulo++, modulo_idx++) {
         for (info = result_node->info[modulo]; info; info = info->next) {
-          if (info->peer == nh_peer) break;
+          if (bgp_info_peer_match(info, nh_peer)) break;
 	}
       }
     }
@@ -548,7 +537,7 @@ int bgp_lookup_node_match_cmp_bgp(struct bgp_info *info, struct node_match_cmp_t
 {
   int no_match = FALSE;
 
-  if (info->peer == nmct2->peer) {
+  if (bgp_info_peer_match(info, nmct2->peer)) {
     if (nmct2->safi == SAFI_MPLS_VPN) no_match++;
 
     if (nmct2->peer->cap_add_paths && info->extra && info->extra->path_id &&
@@ -577,6 +566,83 @@ int bgp_lookup_node_match_cmp_bgp(struct bgp_info *info, struct node_match_cmp_t
   return TRUE;
 }
 
+/*
+   Longest-match lookup of an address on behalf of bgp_srcdst_lookup(),
+   served out of the lookup cache when possible: flows tend to hit the
+   same few prefixes over and over. Entries are valid as long as the
+   peer RIB generation they were taken at is current. RPKI lookups need
+   the node vector of an actual walk and ADD-PATH ones depend on the
+   peer_dst_ip; they are not cached.
+*/
+void bgp_lookup_node_match(struct bgp_misc_structs *bms, struct bgp_table *table, afi_t afi, void *addr,
+			   struct node_match_cmp_term2 *nmct2, struct bgp_node **result, struct bgp_info **info)
+{
+  struct bgp_lookup_cache *cache = bms->lookup_cache;
+  struct bgp_lookup_cache_entry *entry = NULL;
+  struct bgp_lookup_cache_key key;
+  struct bgp_peer *peer = nmct2->peer;
+  u_int64_t rib_gen = 0;
+
+  if (config.bgp_lookup_cache_entries && table && peer && !peer->cap_add_paths &&
+      !config.rpki_roas_file && !config.rpki_rtr_cache) {
+    if (!cache) cache = bgp_lookup_cache_init(bms);
+
+    memset(&key, 0, sizeof(key));
+    key.peer = peer;
+    key.table = table;
+    key.safi = nmct2->safi;
+    key.afi = afi;
+    if (nmct2->rd) memcpy(&key.rd, nmct2->rd, sizeof(rd_t));
+    memcpy(key.addr, addr, (afi == AFI_IP ? 4 : 16));
+
+    rib_gen = __atomic_load_n(&peer->rib_gen, __ATOMIC_SEQ_CST);
+    entry = &cache->entries[jhash(&key, sizeof(key), 0) % cache->num];
+
+    if (entry->rib_gen == rib_gen && !memcmp(&entry->key, &key, sizeof(key))) {
+      (*result) = entry->node;
+      (*info) = entry->info;
+
+      return;
+    }
+  }
+
+  if (afi == AFI_IP)
+    bgp_node_match_ipv4(table, (struct in_addr *) addr, peer, bms->route_info_modulo,
+			bms->bgp_lookup_node_match_cmp, nmct2, bms->bnv, result, info);
+  else
+    bgp_node_match_ipv6(table, (struct in6_addr *) addr, peer, bms->route_info_modulo,
+			bms->bgp_lookup_node_match_cmp, nmct2, bms->bnv, result, info);
+
+  if (entry) {
+    memcpy(&entry->key, &key, sizeof(key));
+    entry->rib_gen = rib_gen;
+    entry->node = (*result);
+    entry->info = (*info);
+  }
+}
+
+struct bgp_lookup_cache *bgp_lookup_cache_init(struct bgp_misc_structs *bms)
+{
+  struct bgp_lookup_cache *cache;
+
+  cache = malloc(sizeof(struct bgp_lookup_cache));
+  if (!cache) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_lookup_cache_init). Exiting ..\n", config.name, bms->log_str);
+    exit_gracefully(1);
+  }
+
+  cache->num = config.bgp_lookup_cache_entries;
+  cache->entries = calloc(cache->num, sizeof(struct bgp_lookup_cache_entry));
+  if (!cache->entries) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): calloc() failed (bgp_lookup_cache_init). Exiting ..\n", config.name, bms->log_str);
+    exit_gracefully(1);
+  }
+
+  bms->lookup_cache = cache;
+
+  return cache;
+}
+
 int bgp_lookup_node_vector_unicast(struct prefix *p, struct bgp_peer *peer, struct bgp_node_vector *bnv)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
@@ -839,7 +905,7 @@ int bgp_lg_daemon_ip_lookup(struct bgp_lg_req_ipl_data *req, struct bgp_lg_rep *
 			    NULL, &result, &info);
 
       if (result) {
-	bgp_lg_rep_ipl_data_add(rep, AFI_IP, safi, &result->p, info);
+	bgp_lg_rep_ipl_data_add(rep, AFI_IP, safi, &result->p, info, peer);
 	ret = BGP_LOOKUP_OK;
       }
       else ret = BGP_LOOKUP_NOPREFIX; 
@@ -851,7 +917,7 @@ int bgp_lg_daemon_ip_lookup(struct bgp_lg_req_ipl_data *req, struct bgp_lg_rep *
 			    NULL, &result, &info);
 
       if (result) {
-	bgp_lg_rep_ipl_data_add(rep, AFI_IP6, safi, &result->p, info);
+	bgp_lg_rep_ipl_data_add(rep, AFI_IP6, safi, &result->p, info, peer);
 	ret = BGP_LOOKUP_OK;
       }
       else ret = BGP_LOOKUP_NOPREFIX; 
@@ -940,7 +1006,8 @@ struct bgp_lg_rep_data *bgp_lg_rep_data_add(struct bgp_lg_rep *rep)
   return data;
 }
 
-void bgp_lg_rep_ipl_data_add(struct bgp_lg_rep *rep, afi_t afi, safi_t safi, struct prefix *pref, struct bgp_info *info)
+void bgp_lg_rep_ipl_data_add(struct bgp_lg_rep *rep, afi_t afi, safi_t safi, struct prefix *pref, struct bgp_info *info,
+			     struct bgp_peer *peer)
 {
   struct bgp_lg_rep_data *data;
   struct bgp_lg_rep_ipl_data *ipl_data;
@@ -955,7 +1022,7 @@ void bgp_lg_rep_ipl_data_add(struct bgp_lg_rep *rep, afi_t afi, safi_t safi, str
   ipl_data->afi = afi;
   ipl_data->safi = safi;
   ipl_data->pref = pref;
-  ipl_data->info = info;
+  ipl_data->info = bgp_info_peer_view(info, peer, &ipl_data->info_view);
 }
 
 void bgp_lg_rep_gp_data_add(struct bgp_lg_rep *rep, struct bgp_peer *peer)
@@ -22,6 +22,28 @@
 #ifndef _BGP_LOOKUP_H_
 #define _BGP_LOOKUP_H_
 
+/* structures */
+struct bgp_lookup_cache_key {
+  struct bgp_peer *peer;
+  struct bgp_table *table;
+  rd_t rd;
+  safi_t safi;
+  afi_t afi;
+  u_int8_t addr[16];
+};
+
+struct bgp_lookup_cache_entry {
+  struct bgp_lookup_cache_key key;
+  u_int64_t rib_gen;
+  struct bgp_node *node;
+  struct bgp_info *info;
+};
+
+struct bgp_lookup_cache {
+  struct bgp_lookup_cache_entry *entries;
+  u_int32_t num;
+};
+
 /* prototypes */
 extern void bgp_srcdst_lookup(struct packet_ptrs *, int);
 extern void bgp_follow_nexthop_lookup(struct packet_ptrs *, int);
@@ -29,6 +51,9 @@ extern struct bgp_peer *bgp_lookup_find_bgp_peer(struct sockaddr *, struct xflow
 extern u_int32_t bgp_route_info_modulo_pathid(struct bgp_peer *, path_id_t *, int);
 extern int bgp_lookup_node_match_cmp_bgp(struct bgp_info *, struct node_match_cmp_term2 *);
 extern int bgp_lookup_node_vector_unicast(struct prefix *, struct bgp_peer *, struct bgp_node_vector *);
+extern void bgp_lookup_node_match(struct bgp_misc_structs *, struct bgp_table *, afi_t, void *, struct node_match_cmp_term2 *,
+				  struct bgp_node **, struct bgp_info **);
+extern struct bgp_lookup_cache *bgp_lookup_cache_init(struct bgp_misc_structs *);
 
 extern void pkt_to_cache_legacy_bgp_primitives(struct cache_legacy_bgp_primitives *, struct pkt_legacy_bgp_primitives *, pm_cfgreg_t, pm_cfgreg_t);
 extern void cache_to_pkt_legacy_bgp_primitives(struct pkt_legacy_bgp_primitives *, struct cache_legacy_bgp_primitives *);
@@ -38,6 +63,6 @@ extern int bgp_lg_daemon_ip_lookup(struct bgp_lg_req_ipl_data *, struct bgp_lg_r
 extern int bgp_lg_daemon_get_peers(struct bgp_lg_rep *, int);
 extern void bgp_lg_rep_init(struct bgp_lg_rep *);
 extern struct bgp_lg_rep_data *bgp_lg_rep_data_add(struct bgp_lg_rep *);
-extern void bgp_lg_rep_ipl_data_add(struct bgp_lg_rep *, afi_t, safi_t, struct prefix *, struct bgp_info *);
+extern void bgp_lg_rep_ipl_data_add(struct bgp_lg_rep *, afi_t, safi_t, struct prefix *, struct bgp_info *, struct bgp_peer *);
 extern void bgp_lg_rep_gp_data_add(struct bgp_lg_rep *, struct bgp_peer *);
 #endif 
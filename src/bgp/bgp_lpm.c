@@ -0,0 +1,314 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "bgp.h"
+
+/* functions */
+void bgp_lpm_init(struct bgp_table *table)
+{
+  if (!table || table->lpm) return;
+  if (table->afi != AFI_IP && table->afi != AFI_IP6) return;
+
+  table->lpm = malloc(sizeof(struct bgp_lpm));
+  if (!table->lpm) {
+    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (bgp_lpm_init). Exiting ..\n", config.name);
+    exit_gracefully(1);
+  }
+
+  memset(table->lpm, 0, sizeof(struct bgp_lpm));
+  table->lpm->addr_len = (table->afi == AFI_IP ? 4 : 16);
+}
+
+static void *bgp_lpm_chunk_get(struct bgp_lpm_chunk *chunk, u_int8_t slot)
+{
+  u_int16_t rank;
+
+  rank = chunk->base[slot >> 6] + __builtin_popcountll(chunk->runs[slot >> 6] & (~0ULL >> (63 - (slot & 63))));
+
+  return chunk->vals[rank - 1];
+}
+
+static void bgp_lpm_chunk_unpack(struct bgp_lpm_chunk *chunk, void **slots)
+{
+  int idx, val;
+
+  for (idx = 0, val = -1; idx < BGP_LPM_CHUNK_SLOTS; idx++) {
+    if (chunk->runs[idx >> 6] & (1ULL << (idx & 63))) val++;
+    slots[idx] = chunk->vals[val];
+  }
+}
+
+/* returns a leaf if all slots are the same, a tagged chunk otherwise */
+static void *bgp_lpm_chunk_pack(struct bgp_lpm *lpm, void **slots)
+{
+  struct bgp_lpm_chunk *chunk;
+  int idx, num;
+
+  for (idx = 1, num = 1; idx < BGP_LPM_CHUNK_SLOTS; idx++) {
+    if (slots[idx] != slots[idx - 1]) num++;
+  }
+
+  if (num == 1) return slots[0];
+
+  chunk = malloc(sizeof(struct bgp_lpm_chunk) + (num * sizeof(void *)));
+  if (!chunk) {
+    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (bgp_lpm_chunk_pack). Exiting ..\n", config.name);
+    exit_gracefully(1);
+  }
+
+  memset(chunk, 0, sizeof(struct bgp_lpm_chunk));
+
+  for (idx = 0, num = 0; idx < BGP_LPM_CHUNK_SLOTS; idx++) {
+    if (!(idx & 63)) chunk->base[idx >> 6] = num;
+
+    if (!idx || slots[idx] != slots[idx - 1]) {
+      chunk->runs[idx >> 6] |= (1ULL << (idx & 63));
+      chunk->vals[num] = slots[idx];
+      num++;
+    }
+  }
+
+  chunk->vals_num = num;
+  lpm->chunks++;
+
+  return BGP_LPM_TAG(chunk);
+}
+
+/* queues the chunk only, children may still be referenced by its successor */
+static void bgp_lpm_chunk_release(struct bgp_lpm *lpm, void *val)
+{
+  struct bgp_lpm_chunk **retired;
+
+  if (!BGP_LPM_IS_CHUNK(val)) return;
+
+  if (lpm->retired_num == lpm->retired_max) {
+    retired = realloc(lpm->retired, ((lpm->retired_max + 16) * sizeof(struct bgp_lpm_chunk *)));
+    if (!retired) {
+      Log(LOG_ERR, "ERROR ( %s/core/BGP ): realloc() failed (bgp_lpm_chunk_release). Exiting ..\n", config.name);
+      exit_gracefully(1);
+    }
+
+    lpm->retired = retired;
+    lpm->retired_max += 16;
+  }
+
+  lpm->retired[lpm->retired_num] = BGP_LPM_CHUNK(val);
+  lpm->retired_num++;
+  lpm->chunks--;
+}
+
+/* to be called once the chunks queued are no longer reachable */
+static void bgp_lpm_chunk_flush(struct bgp_lpm *lpm)
+{
+  u_int32_t idx;
+
+  for (idx = 0; idx < lpm->retired_num; idx++) bgp_rcu_free(lpm->retired[idx], NULL);
+  lpm->retired_num = 0;
+}
+
+static void bgp_lpm_slot_free(struct bgp_lpm *lpm, void *val)
+{
+  struct bgp_lpm_chunk *chunk;
+  int idx;
+
+  if (BGP_LPM_IS_CHUNK(val)) {
+    chunk = BGP_LPM_CHUNK(val);
+    for (idx = 0; idx < chunk->vals_num; idx++) bgp_lpm_slot_free(lpm, chunk->vals[idx]);
+    free(chunk);
+    lpm->chunks--;
+  }
+}
+
+/*
+   Applies an update to a slot entirely covered by the prefix of 'node':
+   on insert the node replaces any shorter (covering) one, on delete the
+   node is replaced by 'repl', its closest ancestor in the tree. Chunks
+   below the slot are rebuilt only if something changed in them.
+*/
+static void *bgp_lpm_slot_update(struct bgp_lpm *lpm, void *val, struct bgp_node *node,
+				 struct bgp_node *repl, int del)
+{
+  void *slots[BGP_LPM_CHUNK_SLOTS], *new, *ret;
+  int idx, changed = FALSE;
+
+  if (!BGP_LPM_IS_CHUNK(val)) {
+    if (del) return (val == node ? repl : val);
+    if (!val || ((struct bgp_node *) val)->p.prefixlen < node->p.prefixlen) return node;
+
+    return val;
+  }
+
+  bgp_lpm_chunk_unpack(BGP_LPM_CHUNK(val), slots);
+
+  for (idx = 0; idx < BGP_LPM_CHUNK_SLOTS; idx++) {
+    new = bgp_lpm_slot_update(lpm, slots[idx], node, repl, del);
+    if (new != slots[idx]) {
+      slots[idx] = new;
+      changed = TRUE;
+    }
+  }
+
+  if (!changed) return val;
+
+  ret = bgp_lpm_chunk_pack(lpm, slots);
+  bgp_lpm_chunk_release(lpm, val);
+
+  return ret;
+}
+
+/* 'val' is the slot covering the first 'depth' bytes of the prefix */
+static void *bgp_lpm_level_update(struct bgp_lpm *lpm, void *val, int depth, struct bgp_node *node,
+				  struct bgp_node *repl, int del)
+{
+  void *slots[BGP_LPM_CHUNK_SLOTS], *new, *ret;
+  u_char *addr = &node->p.u.prefix;
+  int idx, first, num, start = (depth * 8), changed = FALSE;
+
+  /* on delete there is nothing to be found below a leaf */
+  if (!BGP_LPM_IS_CHUNK(val)) {
+    if (del) return bgp_lpm_slot_update(lpm, val, node, repl, del);
+    for (idx = 0; idx < BGP_LPM_CHUNK_SLOTS; idx++) slots[idx] = val;
+  }
+  else bgp_lpm_chunk_unpack(BGP_LPM_CHUNK(val), slots);
+
+  if (node->p.prefixlen <= (start + BGP_LPM_STRIDE)) {
+    num = (1 << (start + BGP_LPM_STRIDE - node->p.prefixlen));
+    first = (addr[depth] & ~(num - 1));
+
+    for (idx = first; idx < (first + num); idx++) {
+      new = bgp_lpm_slot_update(lpm, slots[idx], node, repl, del);
+      if (new != slots[idx]) {
+	slots[idx] = new;
+	changed = TRUE;
+      }
+    }
+  }
+  else {
+    idx = addr[depth];
+    new = bgp_lpm_level_update(lpm, slots[idx], (depth + 1), node, repl, del);
+    if (new != slots[idx]) {
+      slots[idx] = new;
+      changed = TRUE;
+    }
+  }
+
+  if (!changed) return val;
+
+  ret = bgp_lpm_chunk_pack(lpm, slots);
+  bgp_lpm_chunk_release(lpm, val);
+
+  return ret;
+}
+
+static void bgp_lpm_update(struct bgp_table *table, struct bgp_node *node, struct bgp_node *repl, int del)
+{
+  struct bgp_lpm *lpm = table->lpm;
+  u_char *addr = &node->p.u.prefix;
+  void **root, *new;
+  int idx, first, num;
+
+  if (node->p.prefixlen > (lpm->addr_len * 8)) return;
+
+  if (!lpm->root) {
+    if (del) return;
+
+    root = calloc(BGP_LPM_ROOT_SLOTS, sizeof(void *));
+    if (!root) {
+      Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (bgp_lpm_update). Exiting ..\n", config.name);
+      exit_gracefully(1);
+    }
+
+    __atomic_store_n(&lpm->root, root, __ATOMIC_RELEASE);
+  }
+
+  root = lpm->root;
+
+  /* new values are published into the root slots only once complete */
+  if (node->p.prefixlen <= BGP_LPM_ROOT_BITS) {
+    num = (1 << (BGP_LPM_ROOT_BITS - node->p.prefixlen));
+    first = (((addr[0] << 8) | addr[1]) & ~(num - 1));
+
+    for (idx = first; idx < (first + num); idx++) {
+      new = bgp_lpm_slot_update(lpm, root[idx], node, repl, del);
+      if (new != root[idx]) __atomic_store_n(&root[idx], new, __ATOMIC_RELEASE);
+    }
+  }
+  else {
+    idx = ((addr[0] << 8) | addr[1]);
+    new = bgp_lpm_level_update(lpm, root[idx], (BGP_LPM_ROOT_BITS / 8), node, repl, del);
+    if (new != root[idx]) __atomic_store_n(&root[idx], new, __ATOMIC_RELEASE);
+  }
+
+  bgp_lpm_chunk_flush(lpm);
+}
+
+void bgp_lpm_insert(struct bgp_table *table, struct bgp_node *node)
+{
+  if (!table || !table->lpm || !node) return;
+
+  bgp_lpm_update(table, node, NULL, FALSE);
+}
+
+/* 'parent' is the closest node covering 'node', if any, now taking its place */
+void bgp_lpm_delete(struct bgp_table *table, struct bgp_node *node, struct bgp_node *parent)
+{
+  if (!table || !table->lpm || !node) return;
+
+  bgp_lpm_update(table, node, parent, TRUE);
+}
+
+/* returns the deepest node of the table covering 'addr', if any */
+struct bgp_node *bgp_lpm_lookup(const struct bgp_table *table, u_char *addr)
+{
+  void **root, *val;
+  int depth;
+
+  root = __atomic_load_n(&table->lpm->root, __ATOMIC_ACQUIRE);
+  if (!root) return NULL;
+
+  val = __atomic_load_n(&root[(addr[0] << 8) | addr[1]], __ATOMIC_ACQUIRE);
+
+  for (depth = (BGP_LPM_ROOT_BITS / 8); BGP_LPM_IS_CHUNK(val); depth++)
+    val = bgp_lpm_chunk_get(BGP_LPM_CHUNK(val), addr[depth]);
+
+  return val;
+}
+
+void bgp_lpm_free(struct bgp_table *table)
+{
+  struct bgp_lpm *lpm;
+  int idx;
+
+  if (!table || !table->lpm) return;
+
+  lpm = table->lpm;
+
+  if (lpm->root) {
+    for (idx = 0; idx < BGP_LPM_ROOT_SLOTS; idx++) bgp_lpm_slot_free(lpm, lpm->root[idx]);
+    free(lpm->root);
+  }
+
+  if (lpm->retired) free(lpm->retired);
+  free(lpm);
+  table->lpm = NULL;
+}
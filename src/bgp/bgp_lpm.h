@@ -0,0 +1,73 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _BGP_LPM_H_
+#define _BGP_LPM_H_
+
+/* defines */
+#define BGP_LPM_ROOT_BITS		16
+#define BGP_LPM_ROOT_SLOTS		(1 << BGP_LPM_ROOT_BITS)
+#define BGP_LPM_STRIDE			8
+#define BGP_LPM_CHUNK_SLOTS		(1 << BGP_LPM_STRIDE)
+#define BGP_LPM_CHUNK_WORDS		(BGP_LPM_CHUNK_SLOTS / 64)
+
+/* a slot holds either a struct bgp_node pointer or, tagged, a child chunk */
+#define BGP_LPM_IS_CHUNK(x)		((uintptr_t)(x) & 0x1)
+#define BGP_LPM_CHUNK(x)		((struct bgp_lpm_chunk *)((uintptr_t)(x) & ~((uintptr_t)0x1)))
+#define BGP_LPM_TAG(x)			((void *)((uintptr_t)(x) | 0x1))
+
+/* structs */
+/*
+   Compressed multibit trie indexing the nodes of a bgp_table. The first
+   BGP_LPM_ROOT_BITS of the address select a root slot, then each further
+   level consumes one byte. Slots are leaf-pushed: a slot always carries
+   the deepest bgp_node covering it, so a lookup ends at the first slot
+   which is not a chunk. Chunks are stored run-length compressed: bit N
+   of 'runs' is set if slot N starts a new run of identical values and
+   'base' caches the number of runs preceding each word, so the value of
+   a slot is found with a single popcount. Chunks are never modified once
+   published: updates rebuild the path from the root slot down and retire
+   the chunks replaced only after the new path is in place.
+*/
+struct bgp_lpm_chunk {
+  u_int64_t runs[BGP_LPM_CHUNK_WORDS];
+  u_int16_t base[BGP_LPM_CHUNK_WORDS];
+  u_int16_t vals_num;
+  void *vals[];
+};
+
+struct bgp_lpm {
+  void **root;
+  u_int8_t addr_len;
+  u_int64_t chunks;
+
+  struct bgp_lpm_chunk **retired;
+  u_int32_t retired_num;
+  u_int32_t retired_max;
+};
+
+/* prototypes */
+extern void bgp_lpm_init(struct bgp_table *);
+extern void bgp_lpm_free(struct bgp_table *);
+extern void bgp_lpm_insert(struct bgp_table *, struct bgp_node *);
+extern void bgp_lpm_delete(struct bgp_table *, struct bgp_node *, struct bgp_node *);
+extern struct bgp_node *bgp_lpm_lookup(const struct bgp_table *, u_char *);
+#endif
@@ -181,7 +181,10 @@ int bgp_parse_open_msg(struct bgp_msg_data *bmd, char *bgp_packet_ptr, time_t no
       if (!config.bgp_disable_router_id_check && bms->bgp_msg_open_router_id_check) {
 	int check_ret;
 
+	/* looks through the peers table, shared among worker threads */
+	bgp_rib_lock(bms);
 	check_ret = bms->bgp_msg_open_router_id_check(bmd);
+	bgp_rib_unlock(bms);
 	if (check_ret) return check_ret;
       }
 
@@ -588,11 +591,19 @@ int bgp_parse_notification_msg(struct bgp_msg_data *bmd, char *pkt, u_int8_t *re
   return ret;
 }
 
+/*
+   Message decoding runs unlocked; with worker threads, attributes are
+   interned under locks of the hashes they go in, see hash_lock(), once
+   per message rather than per prefix, RIB inserts and deletes take the
+   lock of their table, see bgp_nlri_parse(), and only End-of-RIB, which
+   may retire routes of all tables, locks the whole RIB.
+*/
 int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
 {
   struct bgp_peer *peer = bmd->peer;
+  struct bgp_misc_structs *bms;
   struct bgp_header bhdr;
-  struct bgp_attr attr;
+  struct bgp_attr attr, *attr_new = NULL;
   u_int16_t attribute_len;
   u_int16_t update_len;
   u_int16_t withdraw_len;
@@ -605,6 +616,8 @@ int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
 
   if (!peer || !pkt) return ERR;
 
+  bms = bgp_select_misc_db(peer->type);
+
   /* Set initial values. */
   memset(&attr, 0, sizeof (struct bgp_attr));
   memset(&update, 0, sizeof (struct bgp_nlri));
@@ -658,15 +671,18 @@ int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
     update.length = update_len;
   }
 
+  /* interned here, outside of RIB locks: prefixes just take a reference */
+  if (update.length || mp_update.length) attr_new = bgp_attr_intern(peer, &attr);
+
   /* NLRI parsing */
   if (withdraw.length) bgp_nlri_parse(bmd, NULL, &withdraw);
-  if (update.length)  bgp_nlri_parse(bmd, &attr, &update);
+  if (update.length)  bgp_nlri_parse(bmd, attr_new, &update);
 	
   if (mp_update.length
 	  && mp_update.afi == AFI_IP
 	  && (mp_update.safi == SAFI_UNICAST || mp_update.safi == SAFI_MPLS_LABEL ||
 	      mp_update.safi == SAFI_MPLS_VPN))
-    bgp_nlri_parse(bmd, &attr, &mp_update);
+    bgp_nlri_parse(bmd, attr_new, &mp_update);
 
   if (mp_withdraw.length
 	  && mp_withdraw.afi == AFI_IP
@@ -678,7 +694,7 @@ int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
 	  && mp_update.afi == AFI_IP6
 	  && (mp_update.safi == SAFI_UNICAST || mp_update.safi == SAFI_MPLS_LABEL ||
 	      mp_update.safi == SAFI_MPLS_VPN))
-    bgp_nlri_parse(bmd, &attr, &mp_update);
+    bgp_nlri_parse(bmd, attr_new, &mp_update);
 
   if (mp_withdraw.length
 	  && mp_withdraw.afi == AFI_IP6
@@ -686,11 +702,19 @@ int bgp_parse_update_msg(struct bgp_msg_data *bmd, char *pkt)
 	      mp_withdraw.safi == SAFI_MPLS_VPN))
     bgp_nlri_parse(bmd, NULL, &mp_withdraw);
 
-  /* Receipt of End-of-RIB can be processed here; being a silent
-	 BGP receiver only, honestly it doesn't matter to us */
+  /* Receipt of End-of-RIB: being a silent BGP receiver only, it
+	 matters to us just to let go of routes restored at startup */
+  if (!withdraw_len && !update_len && !mp_update.length) {
+    bgp_rib_lock(bms);
+    if (!attribute_len) bgp_snapshot_eor(peer, AFI_IP, SAFI_UNICAST);
+    else if (mp_withdraw.afi && !mp_withdraw.length) bgp_snapshot_eor(peer, mp_withdraw.afi, mp_withdraw.safi);
+    bgp_rib_unlock(bms);
+  }
 
   /* Everything is done.  We unintern temporary structures which
 	 interned in bgp_attr_parse(). */
+  if (attr_new)
+    bgp_attr_unintern(peer, attr_new);
   if (attr.aspath)
     aspath_unintern(peer, attr.aspath);
   if (attr.community)
@@ -983,6 +1007,7 @@ int bgp_attr_parse_mp_unreach(struct bgp_peer *peer, u_int16_t len, struct bgp_a
 int bgp_nlri_parse(struct bgp_msg_data *bmd, void *attr, struct bgp_nlri *info)
 {
   struct bgp_peer *peer = bmd->peer;
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
   u_char *pnt;
   u_char *lim;
   u_char safi, label[3];
@@ -1117,6 +1142,9 @@ int bgp_nlri_parse(struct bgp_msg_data *bmd, void *attr, struct bgp_nlri *info)
 
     // XXX: check prefix correctnesss now that we have it?
 
+    /* Let's do our job now! */
+    bgp_rib_table_lock(bms, info->afi, safi);
+
 #if defined WITH_ZMQ
     if (config.bgp_blackhole_stdcomm_list) {
       bmd->is_blackhole = bgp_blackhole_evaluate_comms(attr);
@@ -1128,7 +1156,6 @@ int bgp_nlri_parse(struct bgp_msg_data *bmd, void *attr, struct bgp_nlri *info)
     }
 #endif
 
-    /* Let's do our job now! */
     if (attr) {
       ret = bgp_process_update(bmd, &p, attr, info->afi, safi, &rd, &path_id, label);
     }
@@ -1146,6 +1173,8 @@ int bgp_nlri_parse(struct bgp_msg_data *bmd, void *attr, struct bgp_nlri *info)
       }
     }
 #endif
+
+    bgp_rib_table_unlock(bms, info->afi, safi);
   }
 
   return SUCCESS;
@@ -1175,7 +1204,7 @@ int bgp_process_update(struct bgp_msg_data *bmd, struct prefix *p, void *attr, a
 
     /* Check previously received route. */
     for (ri = route->info[modulo]; ri; ri = ri->next) {
-      if (ri->peer == peer) { 
+      if (bgp_info_peer_match(ri, peer)) {
         if (safi == SAFI_MPLS_VPN) {
 	  if (ri->extra && !memcmp(&ri->extra->rd, rd, sizeof(rd_t)));
 	  else continue;
@@ -1214,12 +1243,13 @@ int bgp_process_update(struct bgp_msg_data *bmd, struct prefix *p, void *attr, a
 
         return SUCCESS;
       }
-      else {
+      else if (!bms->table_shared_paths) {
         /* Update to new attribute.  */
         bgp_attr_unintern(peer, ri->attr);
         ri->attr = attr_new;
         bgp_info_extra_process(peer, ri, safi, path_id, rd, label);
         if (bms->bgp_extra_data_process) (*bms->bgp_extra_data_process)(&bmd->extra, ri);
+        bgp_info_dump_stamp(peer, ri);
 
         bgp_unlock_node (peer, route);
 
@@ -1230,6 +1260,19 @@ int bgp_process_update(struct bgp_msg_data *bmd, struct prefix *p, void *attr, a
       }
     }
 
+    if (bms->table_shared_paths) {
+      new = bgp_process_update_shared(bmd, route, ri, attr_new, safi, rd, path_id, label, modulo);
+
+      bgp_unlock_node(peer, route);
+
+      if (bms->msglog_backend_methods) {
+        ri = new;
+        goto log_update;
+      }
+
+      return SUCCESS;
+    }
+
     /* Make new BGP info. */
     new = bgp_info_new(peer);
     if (new) {
@@ -1274,8 +1317,9 @@ int bgp_process_update(struct bgp_msg_data *bmd, struct prefix *p, void *attr, a
 log_update:
   {
     char event_type[] = "log";
+    struct bgp_info ri_view;
 
-    bgp_peer_log_msg(route, ri, afi, safi, event_type, bms->msglog_output, NULL, BGP_LOG_TYPE_UPDATE);
+    bgp_peer_log_msg(route, bgp_info_peer_view(ri, peer, &ri_view), afi, safi, event_type, bms->msglog_output, NULL, BGP_LOG_TYPE_UPDATE);
   }
 
   if (bms->skip_rib) {
@@ -1286,6 +1330,64 @@ log_update:
   return SUCCESS;
 }
 
+/*
+   Shared RIB counterpart of the above, see bgp_table_shared_paths: 'peer'
+   joins the entry of the node with same attributes and extra info, if
+   any, or else creates it; only then it leaves 'ri', the entry it was on,
+   so that a lookup never finds the peer without the route. Returns the
+   entry the peer is now on.
+*/
+struct bgp_info *bgp_process_update_shared(struct bgp_msg_data *bmd, struct bgp_node *route, struct bgp_info *ri,
+					   struct bgp_attr *attr_new, safi_t safi, rd_t *rd, path_id_t *path_id,
+					   u_char *label, u_int32_t modulo)
+{
+  struct bgp_peer *peer = bmd->peer;
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+  struct bgp_info *shared, ri_local;
+
+  memset(&ri_local, 0, sizeof(struct bgp_info));
+  ri_local.peer = peer;
+  ri_local.attr = attr_new;
+  bgp_info_extra_process(peer, &ri_local, safi, path_id, rd, label);
+  if (bms->bgp_extra_data_process) (*bms->bgp_extra_data_process)(&bmd->extra, &ri_local);
+
+  for (shared = route->info[modulo]; shared; shared = shared->next) {
+    if (shared->attr != attr_new) continue;
+
+    if (shared->extra && ri_local.extra) {
+      if (memcmp(&shared->extra->rd, &ri_local.extra->rd, sizeof(rd_t))) continue;
+      if (memcmp(shared->extra->label, ri_local.extra->label, 3)) continue;
+      if (shared->extra->path_id != ri_local.extra->path_id) continue;
+
+      if (shared->extra->bmed.id || ri_local.extra->bmed.id) {
+	if (bms->bgp_extra_data_cmp && !(*bms->bgp_extra_data_cmp)(&ri_local.extra->bmed, &shared->extra->bmed));
+	else continue;
+      }
+    }
+    else if (shared->extra || ri_local.extra) continue;
+
+    break;
+  }
+
+  if (shared) {
+    if (shared != ri) bgp_info_share(peer, shared);
+
+    bgp_attr_unintern(peer, attr_new);
+    bgp_info_extra_free(peer, &ri_local.extra);
+  }
+  else {
+    shared = bgp_info_shared_new(peer);
+    shared->attr = ri_local.attr;
+    shared->extra = ri_local.extra;
+
+    bgp_info_add(peer, route, shared, modulo);
+  }
+
+  if (ri && ri != shared) bgp_info_delete(peer, route, ri, modulo);
+
+  return shared;
+}
+
 int bgp_process_withdraw(struct bgp_msg_data *bmd, struct prefix *p, void *attr, afi_t afi, safi_t safi,
 			 rd_t *rd, path_id_t *path_id, u_char *label)
 {
@@ -1311,7 +1413,7 @@ int bgp_process_withdraw(struct bgp_msg_data *bmd, struct prefix *p, void *attr,
 
     /* Check previously received route. */
     for (ri = route->info[modulo]; ri; ri = ri->next) {
-      if (ri->peer == peer) {
+      if (bgp_info_peer_match(ri, peer)) {
         if (safi == SAFI_MPLS_VPN) {
           if (ri->extra && !memcmp(&ri->extra->rd, rd, sizeof(rd_t)));
           else continue;
@@ -1354,13 +1456,17 @@ int bgp_process_withdraw(struct bgp_msg_data *bmd, struct prefix *p, void *attr,
 
   if (ri && bms->msglog_backend_methods) {
     char event_type[] = "log";
+    struct bgp_info ri_view;
 
-    bgp_peer_log_msg(route, ri, afi, safi, event_type, bms->msglog_output, NULL, BGP_LOG_TYPE_WITHDRAW);
+    bgp_peer_log_msg(route, bgp_info_peer_view(ri, peer, &ri_view), afi, safi, event_type, bms->msglog_output, NULL, BGP_LOG_TYPE_WITHDRAW);
   }
 
   if (!bms->skip_rib) {
     /* Withdraw specified route from routing table. */
-    if (ri) bgp_info_delete(peer, route, ri, modulo); 
+    if (ri) {
+      bgp_dump_journal_add(peer, route, ri, afi, safi);
+      bgp_info_delete(peer, route, ri, modulo);
+    }
 
     /* Unlock bgp_node_get() lock. */
     bgp_unlock_node(peer, route);
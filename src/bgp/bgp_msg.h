@@ -46,5 +46,6 @@ extern int bgp_attr_parse_mp_reach(struct bgp_peer *, u_int16_t, struct bgp_attr
 extern int bgp_attr_parse_mp_unreach(struct bgp_peer *, u_int16_t, struct bgp_attr *, char *, struct bgp_nlri *);
 extern int bgp_nlri_parse(struct bgp_msg_data *, void *, struct bgp_nlri *);
 extern int bgp_process_update(struct bgp_msg_data *, struct prefix *, void *, afi_t, safi_t, rd_t *, path_id_t *, u_char *);
+extern struct bgp_info *bgp_process_update_shared(struct bgp_msg_data *, struct bgp_node *, struct bgp_info *, struct bgp_attr *, safi_t, rd_t *, path_id_t *, u_char *, u_int32_t);
 extern int bgp_process_withdraw(struct bgp_msg_data *, struct prefix *, void *, afi_t, safi_t, rd_t *, path_id_t *, u_char *);
 #endif 
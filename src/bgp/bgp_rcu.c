@@ -0,0 +1,158 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "bgp.h"
+#include "thread_pool.h"
+
+/* global variables */
+static u_int64_t bgp_rcu_epoch = 1;
+static u_int32_t bgp_rcu_readers_num;
+static struct bgp_rcu_reader bgp_rcu_readers[BGP_RCU_READERS_MAX];
+static __thread struct bgp_rcu_reader *bgp_rcu_self;
+static struct bgp_rcu_retired bgp_rcu_retired = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0 };
+
+/* functions */
+static struct bgp_rcu_reader *bgp_rcu_reader_register()
+{
+  u_int32_t idx;
+
+  idx = __atomic_fetch_add(&bgp_rcu_readers_num, 1, __ATOMIC_SEQ_CST);
+  if (idx >= BGP_RCU_READERS_MAX) {
+    Log(LOG_ERR, "ERROR ( %s/core/BGP ): too many RIB readers (max: %u). Exiting ..\n", config.name, BGP_RCU_READERS_MAX);
+    exit_gracefully(1);
+  }
+
+  return &bgp_rcu_readers[idx];
+}
+
+void bgp_rcu_read_lock()
+{
+  struct bgp_rcu_reader *self = bgp_rcu_self;
+
+  if (!self) self = bgp_rcu_self = bgp_rcu_reader_register();
+  if (self->nesting++) return;
+
+  /* a seq_cst store: pointers can't be loaded before the epoch is visible */
+  __atomic_store_n(&self->epoch, __atomic_load_n(&bgp_rcu_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+void bgp_rcu_read_unlock()
+{
+  struct bgp_rcu_reader *self = bgp_rcu_self;
+
+  if (!self || !self->nesting) return;
+  if (--self->nesting) return;
+
+  __atomic_store_n(&self->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* returns the oldest epoch a reader is in, 0 if none */
+static u_int64_t bgp_rcu_min_epoch()
+{
+  u_int64_t epoch, min = 0;
+  u_int32_t idx, num;
+
+  num = __atomic_load_n(&bgp_rcu_readers_num, __ATOMIC_SEQ_CST);
+  if (num > BGP_RCU_READERS_MAX) num = BGP_RCU_READERS_MAX;
+
+  for (idx = 0; idx < num; idx++) {
+    epoch = __atomic_load_n(&bgp_rcu_readers[idx].epoch, __ATOMIC_SEQ_CST);
+    if (epoch && (!min || epoch < min)) min = epoch;
+  }
+
+  return min;
+}
+
+/* 'ptr' must be already unreachable from the RIBs */
+void bgp_rcu_free(void *ptr, void (*free_func)(void *))
+{
+  struct bgp_rcu_retired *r = &bgp_rcu_retired;
+  struct bgp_rcu_garbage *list;
+
+  if (!ptr) return;
+  if (!free_func) free_func = free;
+
+  /* order the unlinking before looking at readers */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  /* readers not in a read-side section hold no references */
+  if (!bgp_rcu_min_epoch()) {
+    (*free_func)(ptr);
+    return;
+  }
+
+  pthread_mutex_lock(&r->mutex);
+
+  if (r->num == r->max && r->head) {
+    memmove(r->list, &r->list[r->head], ((r->num - r->head) * sizeof(struct bgp_rcu_garbage)));
+    r->num -= r->head;
+    r->head = 0;
+  }
+
+  if (r->num == r->max) {
+    list = realloc(r->list, ((r->max ? (r->max * 2) : 1024) * sizeof(struct bgp_rcu_garbage)));
+    if (!list) {
+      Log(LOG_ERR, "ERROR ( %s/core/BGP ): realloc() failed (bgp_rcu_free). Exiting ..\n", config.name);
+      exit_gracefully(1);
+    }
+
+    r->list = list;
+    r->max = (r->max ? (r->max * 2) : 1024);
+  }
+
+  r->list[r->num].ptr = ptr;
+  r->list[r->num].free_func = free_func;
+  r->list[r->num].epoch = __atomic_load_n(&bgp_rcu_epoch, __ATOMIC_SEQ_CST);
+  r->num++;
+
+  pthread_mutex_unlock(&r->mutex);
+}
+
+/* returns the number of objects still waiting for readers to move on */
+u_int32_t bgp_rcu_reclaim()
+{
+  struct bgp_rcu_retired *r = &bgp_rcu_retired;
+  u_int64_t min;
+  u_int32_t pending;
+
+  /* called after each batch of BGP workers too: nothing to do is cheap */
+  if (!__atomic_load_n(&r->num, __ATOMIC_SEQ_CST)) return 0;
+
+  __atomic_add_fetch(&bgp_rcu_epoch, 1, __ATOMIC_SEQ_CST);
+  min = bgp_rcu_min_epoch();
+
+  pthread_mutex_lock(&r->mutex);
+
+  /* objects are queued in epoch order */
+  for (; r->head < r->num; r->head++) {
+    if (min && r->list[r->head].epoch >= min) break;
+    (*r->list[r->head].free_func)(r->list[r->head].ptr);
+  }
+
+  if (r->head == r->num) r->head = r->num = 0;
+  pending = (r->num - r->head);
+
+  pthread_mutex_unlock(&r->mutex);
+
+  return pending;
+}
@@ -0,0 +1,65 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _BGP_RCU_H_
+#define _BGP_RCU_H_
+
+/* defines */
+#define BGP_RCU_READERS_MAX		64
+#define BGP_RCU_RECLAIM_INTERVAL	1 /* secs */
+
+/* structs */
+/*
+   Epoch-based reclamation of RIB memory. Collector threads wrap any
+   access to the RIBs, from the lookup to the last use of the results,
+   in bgp_rcu_read_lock() / bgp_rcu_read_unlock(); doing so they record
+   the epoch they entered at. The BGP and BMP threads unlink objects from
+   the RIBs first and then hand them to bgp_rcu_free(), which tags them
+   with the current epoch; bgp_rcu_reclaim() advances the epoch and frees
+   whatever was retired before the oldest epoch a reader is still in. It
+   is called by whichever thread retires objects, BGP workers included,
+   every BGP_RCU_RECLAIM_INTERVAL for as long as some are pending.
+*/
+struct bgp_rcu_reader {
+  u_int64_t epoch; /* 0 = not in a read-side section */
+  u_int32_t nesting;
+} __attribute__ ((aligned (64)));
+
+struct bgp_rcu_garbage {
+  void *ptr;
+  void (*free_func)(void *);
+  u_int64_t epoch;
+};
+
+struct bgp_rcu_retired {
+  pthread_mutex_t mutex;
+  struct bgp_rcu_garbage *list;
+  u_int32_t head;
+  u_int32_t num;
+  u_int32_t max;
+};
+
+/* prototypes */
+extern void bgp_rcu_read_lock();
+extern void bgp_rcu_read_unlock();
+extern void bgp_rcu_free(void *, void (*)(void *));
+extern u_int32_t bgp_rcu_reclaim();
+#endif
@@ -0,0 +1,310 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "bgp.h"
+#include "thread_pool.h"
+#include <sys/mman.h>
+
+/* global vars */
+struct bgp_slab bgp_node_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_NODE, sizeof(struct bgp_node));
+struct bgp_slab bgp_info_extra_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_INFO_EXTRA, sizeof(struct bgp_info_extra));
+struct bgp_slab bgp_attr_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_ATTR, sizeof(struct bgp_attr));
+struct bgp_slab aspath_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_ASPATH, sizeof(struct aspath));
+struct bgp_slab community_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_COMMUNITY, sizeof(struct community));
+struct bgp_slab ecommunity_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_ECOMMUNITY, sizeof(struct ecommunity));
+struct bgp_slab lcommunity_slab = BGP_SLAB_INITIALIZER(BGP_SLAB_LCOMMUNITY, sizeof(struct lcommunity));
+
+/* per type, global slabs and peer arenas alike */
+static struct bgp_slab_stats bgp_slab_stats[BGP_SLAB_TYPES] = {
+  { "bgp_node" }, { "bgp_info" }, { "bgp_info_extra" }, { "bgp_attr" },
+  { "aspath" }, { "community" }, { "ecommunity" }, { "lcommunity" }
+};
+
+/* functions */
+static size_t bgp_slab_hdr_size()
+{
+  return ((sizeof(struct bgp_slab_block) + 63) & ~((size_t) 63));
+}
+
+static size_t bgp_slab_obj_size(struct bgp_slab *slab)
+{
+  return ((slab->obj_size + 7) & ~((size_t) 7));
+}
+
+static void bgp_slab_list_add(struct bgp_slab_block **list, struct bgp_slab_block *block)
+{
+  block->prev = NULL;
+  block->next = (*list);
+  if (*list) (*list)->prev = block;
+  (*list) = block;
+}
+
+static void bgp_slab_list_del(struct bgp_slab_block **list, struct bgp_slab_block *block)
+{
+  if (block->prev) block->prev->next = block->next;
+  else (*list) = block->next;
+  if (block->next) block->next->prev = block->prev;
+
+  block->prev = block->next = NULL;
+}
+
+static struct bgp_slab_block *bgp_slab_block_new(struct bgp_slab *slab)
+{
+  struct bgp_slab_block *block;
+  char *base, *aligned, *obj;
+  size_t obj_size = bgp_slab_obj_size(slab);
+  u_int32_t idx;
+
+  /* map twice the size, then trim to get a block aligned to its size */
+  base = mmap(NULL, (2 * BGP_SLAB_BLOCK_SIZE), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    Log(LOG_ERR, "ERROR ( %s/core/BGP ): mmap() failed (bgp_slab_block_new): %s. Exiting ..\n", config.name, strerror(errno));
+    exit_gracefully(1);
+  }
+
+  aligned = (char *) BGP_SLAB_BLOCK(base + BGP_SLAB_BLOCK_SIZE - 1);
+  if (aligned > base) munmap(base, (aligned - base));
+  if ((aligned + BGP_SLAB_BLOCK_SIZE) < (base + (2 * BGP_SLAB_BLOCK_SIZE)))
+    munmap((aligned + BGP_SLAB_BLOCK_SIZE), ((base + (2 * BGP_SLAB_BLOCK_SIZE)) - (aligned + BGP_SLAB_BLOCK_SIZE)));
+
+  block = (struct bgp_slab_block *) aligned;
+  memset(block, 0, sizeof(struct bgp_slab_block));
+  block->slab = slab;
+
+  if (!slab->block_objs) slab->block_objs = ((BGP_SLAB_BLOCK_SIZE - bgp_slab_hdr_size()) / obj_size);
+
+  /* objects are handed out in address order */
+  for (idx = slab->block_objs, obj = (aligned + bgp_slab_hdr_size() + ((idx - 1) * obj_size)); idx; idx--, obj -= obj_size) {
+    (*(void **) obj) = block->free_list;
+    block->free_list = obj;
+  }
+
+  __atomic_add_fetch(&bgp_slab_stats[slab->type].objs_total, slab->block_objs, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&bgp_slab_stats[slab->type].blocks, 1, __ATOMIC_RELAXED);
+
+  return block;
+}
+
+static void bgp_slab_block_free(struct bgp_slab_block *block)
+{
+  struct bgp_slab *slab = block->slab;
+
+  __atomic_sub_fetch(&bgp_slab_stats[slab->type].objs_total, slab->block_objs, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&bgp_slab_stats[slab->type].blocks, 1, __ATOMIC_RELAXED);
+
+  munmap(block, BGP_SLAB_BLOCK_SIZE);
+}
+
+static void bgp_slab_destroy(struct bgp_slab *slab)
+{
+  struct bgp_slab_block *block;
+
+  while ((block = slab->partial)) {
+    bgp_slab_list_del(&slab->partial, block);
+    bgp_slab_block_free(block);
+  }
+
+  while ((block = slab->full)) {
+    bgp_slab_list_del(&slab->full, block);
+    bgp_slab_block_free(block);
+  }
+
+  if (slab->spare) bgp_slab_block_free(slab->spare);
+
+  pthread_mutex_destroy(&slab->mutex);
+  free(slab);
+
+#if defined HAVE_MALLOC_TRIM
+  /* the heap is left with holes where the routes were, give those back too */
+  malloc_trim(0);
+#endif
+}
+
+/* creates a peer arena, see bgp_slab_drain() */
+struct bgp_slab *bgp_slab_new(u_int8_t type, size_t obj_size)
+{
+  struct bgp_slab *slab;
+
+  slab = malloc(sizeof(struct bgp_slab));
+  if (!slab) {
+    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (bgp_slab_new). Exiting ..\n", config.name);
+    exit_gracefully(1);
+  }
+
+  memset(slab, 0, sizeof(struct bgp_slab));
+  pthread_mutex_init(&slab->mutex, NULL);
+  slab->type = type;
+  slab->obj_size = obj_size;
+
+  return slab;
+}
+
+void *bgp_slab_alloc(struct bgp_slab *slab)
+{
+  struct bgp_slab_block *block;
+  void *obj;
+
+  pthread_mutex_lock(&slab->mutex);
+
+  if (!(block = slab->partial)) {
+    if (slab->spare) {
+      block = slab->spare;
+      slab->spare = NULL;
+    }
+    else block = bgp_slab_block_new(slab);
+
+    bgp_slab_list_add(&slab->partial, block);
+  }
+
+  obj = block->free_list;
+  block->free_list = (*(void **) obj);
+  block->objs_used++;
+  slab->objs_used++;
+
+  if (!block->free_list) {
+    bgp_slab_list_del(&slab->partial, block);
+    bgp_slab_list_add(&slab->full, block);
+  }
+
+  pthread_mutex_unlock(&slab->mutex);
+
+  __atomic_add_fetch(&bgp_slab_stats[slab->type].objs_used, 1, __ATOMIC_RELAXED);
+
+  return obj;
+}
+
+void bgp_slab_free(void *obj)
+{
+  struct bgp_slab_block *block;
+  struct bgp_slab *slab;
+  u_int8_t type;
+  int destroy;
+
+  if (!obj) return;
+
+  block = BGP_SLAB_BLOCK(obj);
+  slab = block->slab;
+  type = slab->type;
+
+  pthread_mutex_lock(&slab->mutex);
+
+  if (!block->free_list) {
+    bgp_slab_list_del(&slab->full, block);
+    bgp_slab_list_add(&slab->partial, block);
+  }
+
+  (*(void **) obj) = block->free_list;
+  block->free_list = obj;
+  block->objs_used--;
+  slab->objs_used--;
+
+  if (!block->objs_used) {
+    bgp_slab_list_del(&slab->partial, block);
+
+    if (!slab->spare && !slab->released) slab->spare = block;
+    else bgp_slab_block_free(block);
+  }
+
+  destroy = (slab->released && !slab->objs_used);
+
+  pthread_mutex_unlock(&slab->mutex);
+
+  __atomic_sub_fetch(&bgp_slab_stats[type].objs_used, 1, __ATOMIC_RELAXED);
+
+  if (destroy) bgp_slab_destroy(slab);
+}
+
+/*
+   To be used in place of bgp_rcu_free() for objects which may belong to
+   a draining arena: those are not returned one by one, the arena will go
+   away as a whole once bgp_slab_release() is called.
+*/
+void bgp_slab_retire(void *obj)
+{
+  struct bgp_slab *slab;
+
+  if (!obj) return;
+
+  slab = BGP_SLAB_BLOCK(obj)->slab;
+
+  if (slab->draining) {
+    pthread_mutex_lock(&slab->mutex);
+    slab->objs_abandoned++;
+    pthread_mutex_unlock(&slab->mutex);
+  }
+  else bgp_rcu_free(obj, bgp_slab_free);
+}
+
+/* from now on objects of the arena are unlinked but not freed */
+void bgp_slab_drain(struct bgp_slab *slab)
+{
+  if (slab) slab->draining = TRUE;
+}
+
+static void bgp_slab_release_func(void *ptr)
+{
+  struct bgp_slab *slab = ptr;
+  u_int64_t abandoned;
+  u_int8_t type = slab->type;
+  int destroy;
+
+  pthread_mutex_lock(&slab->mutex);
+
+  abandoned = slab->objs_abandoned;
+  slab->objs_used -= abandoned;
+  slab->objs_abandoned = 0;
+  slab->released = TRUE;
+
+  /* objects retired before the arena was drained may be still on their way */
+  destroy = !slab->objs_used;
+
+  pthread_mutex_unlock(&slab->mutex);
+
+  __atomic_sub_fetch(&bgp_slab_stats[type].objs_used, abandoned, __ATOMIC_RELAXED);
+
+  if (destroy) bgp_slab_destroy(slab);
+}
+
+/* the arena must be drained and all its objects unreachable */
+void bgp_slab_release(struct bgp_slab *slab)
+{
+  if (slab) bgp_rcu_free(slab, bgp_slab_release_func);
+}
+
+void bgp_slab_stats_log(char *log_str)
+{
+  u_int64_t used, total, blocks;
+  int idx;
+
+  for (idx = 0; idx < BGP_SLAB_TYPES; idx++) {
+    used = __atomic_load_n(&bgp_slab_stats[idx].objs_used, __ATOMIC_RELAXED);
+    total = __atomic_load_n(&bgp_slab_stats[idx].objs_total, __ATOMIC_RELAXED);
+    blocks = __atomic_load_n(&bgp_slab_stats[idx].blocks, __ATOMIC_RELAXED);
+
+    if (!blocks) continue;
+
+    Log(LOG_INFO, "INFO ( %s/%s ): *** Slab %s: %" PRIu64 "/%" PRIu64 " objects used (%" PRIu64 "%%) in %" PRIu64 " blocks (%" PRIu64 " KB) ***\n",
+	config.name, log_str, bgp_slab_stats[idx].name, used, total, (total ? ((used * 100) / total) : 0),
+	blocks, ((blocks * BGP_SLAB_BLOCK_SIZE) / 1024));
+  }
+}
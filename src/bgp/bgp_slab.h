@@ -0,0 +1,98 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _BGP_SLAB_H_
+#define _BGP_SLAB_H_
+
+/* defines */
+#define BGP_SLAB_BLOCK_SIZE		65536 /* power of 2 */
+#define BGP_SLAB_BLOCK(x)		((struct bgp_slab_block *)((uintptr_t)(x) & ~((uintptr_t)BGP_SLAB_BLOCK_SIZE - 1)))
+
+#define BGP_SLAB_NODE			0
+#define BGP_SLAB_INFO			1
+#define BGP_SLAB_INFO_EXTRA		2
+#define BGP_SLAB_ATTR			3
+#define BGP_SLAB_ASPATH			4
+#define BGP_SLAB_COMMUNITY		5
+#define BGP_SLAB_ECOMMUNITY		6
+#define BGP_SLAB_LCOMMUNITY		7
+#define BGP_SLAB_TYPES			8
+
+#define BGP_SLAB_INITIALIZER(t, s)	{ PTHREAD_MUTEX_INITIALIZER, (t), (s) }
+
+/* structs */
+/*
+   Fixed-size object allocator for RIB structures. Objects are carved out
+   of blocks of BGP_SLAB_BLOCK_SIZE bytes, mapped aligned to their size so
+   that the block, and the slab, of an object is found by masking its
+   address. Blocks are unmapped as soon as they are empty (one is kept as
+   a spare), which gives memory back to the system after a session flap
+   rather than leaving it fragmented in the heap.
+
+   Slabs are either global, ie. bgp_node_slab, or per-peer arenas holding
+   the bgp_info of a peer: when the peer goes away its routes are still
+   unlinked one by one but the arena is retired as a whole, see
+   bgp_slab_drain() and bgp_slab_release().
+*/
+struct bgp_slab_block {
+  struct bgp_slab *slab;
+  struct bgp_slab_block *prev;
+  struct bgp_slab_block *next;
+  void *free_list;
+  u_int32_t objs_used;
+};
+
+struct bgp_slab {
+  pthread_mutex_t mutex;
+  u_int8_t type;
+  size_t obj_size;
+
+  u_int32_t block_objs;
+  struct bgp_slab_block *partial;
+  struct bgp_slab_block *full;
+  struct bgp_slab_block *spare;
+
+  u_int64_t objs_used;
+  u_int64_t objs_abandoned;
+  u_int8_t draining;
+  u_int8_t released;
+};
+
+struct bgp_slab_stats {
+  char *name;
+  u_int64_t objs_used;
+  u_int64_t objs_total;
+  u_int64_t blocks;
+};
+
+/* global vars */
+extern struct bgp_slab bgp_node_slab, bgp_info_extra_slab, bgp_attr_slab;
+extern struct bgp_slab aspath_slab, community_slab, ecommunity_slab, lcommunity_slab;
+
+/* prototypes */
+extern struct bgp_slab *bgp_slab_new(u_int8_t, size_t);
+extern void *bgp_slab_alloc(struct bgp_slab *);
+extern void bgp_slab_free(void *);
+extern void bgp_slab_retire(void *);
+extern void bgp_slab_drain(struct bgp_slab *);
+extern void bgp_slab_release(struct bgp_slab *);
+extern void bgp_slab_stats_log(char *);
+#endif
@@ -0,0 +1,719 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "addr.h"
+#include "bgp.h"
+#include "thread_pool.h"
+#include <sys/mman.h>
+
+/* structs */
+struct bgp_snapshot_buf {
+  char *base;
+  u_int64_t len;
+  u_int64_t max;
+};
+
+struct bgp_snapshot_attr_ref {
+  struct bgp_attr *attr;
+  u_int64_t offset;
+};
+
+/* functions */
+static int bgp_snapshot_attr_ref_cmp(const void *a, const void *b)
+{
+  const struct bgp_snapshot_attr_ref *ref_a = a, *ref_b = b;
+
+  if (ref_a->attr < ref_b->attr) return -1;
+  if (ref_a->attr > ref_b->attr) return 1;
+
+  return 0;
+}
+
+static u_int32_t bgp_snapshot_aspath_len(struct aspath *aspath)
+{
+  struct assegment *seg;
+  u_int32_t len = 0;
+
+  /* segments longer than AS_SEGMENT_MAX are split, see below */
+  for (seg = aspath->segments; seg; seg = seg->next) {
+    if (!seg->length) continue;
+    len += ((((seg->length - 1) / AS_SEGMENT_MAX) + 1) * 2) + (seg->length * AS_VALUE_SIZE);
+  }
+
+  return len;
+}
+
+static void bgp_snapshot_aspath_put(struct aspath *aspath, u_char *ptr)
+{
+  struct assegment *seg;
+  u_int32_t as;
+  int idx, num;
+
+  for (seg = aspath->segments; seg; seg = seg->next) {
+    for (idx = 0; idx < seg->length; idx++) {
+      if (!(idx % AS_SEGMENT_MAX)) {
+	num = MIN((seg->length - idx), AS_SEGMENT_MAX);
+	(*ptr) = seg->type; ptr++;
+	(*ptr) = num; ptr++;
+      }
+
+      as = htonl(seg->as[idx]);
+      memcpy(ptr, &as, AS_VALUE_SIZE);
+      ptr += AS_VALUE_SIZE;
+    }
+  }
+}
+
+/* appends 'attr' to the attributes section, unless there already */
+static int bgp_snapshot_attr_add(struct bgp_snapshot_buf *sb, void **refs, struct bgp_attr *attr, u_int64_t *offset)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  struct bgp_snapshot_attr_ref ref, *found;
+  struct bgp_snapshot_attr *sa;
+  u_int64_t len, max;
+  char *base, *ptr;
+
+  ref.attr = attr;
+  ref.offset = sb->len;
+  found = *(struct bgp_snapshot_attr_ref **) pm_tsearch(&ref, refs, bgp_snapshot_attr_ref_cmp, sizeof(ref));
+
+  (*offset) = found->offset;
+  if (found->offset != sb->len) return SUCCESS;
+
+  len = sizeof(struct bgp_snapshot_attr);
+  if (attr->community) len += (attr->community->size * 4);
+  if (attr->ecommunity) len += ecom_length(attr->ecommunity);
+  if (attr->lcommunity) len += lcom_length(attr->lcommunity);
+  if (attr->aspath) len += bgp_snapshot_aspath_len(attr->aspath);
+  len = BGP_SNAPSHOT_ALIGN(len);
+
+  if ((sb->len + len) > sb->max) {
+    for (max = (sb->max ? sb->max : LARGEBUFLEN); max < (sb->len + len); max *= 2);
+
+    base = realloc(sb->base, max);
+    if (!base) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): realloc() failed (bgp_snapshot_attr_add).\n", config.name, bms->log_str);
+      return ERR;
+    }
+
+    sb->base = base;
+    sb->max = max;
+  }
+
+  ptr = (sb->base + sb->len);
+  memset(ptr, 0, len);
+  sa = (struct bgp_snapshot_attr *) ptr;
+
+  sa->flag = attr->flag;
+  sa->med = attr->med;
+  sa->local_pref = attr->local_pref;
+  sa->nexthop = attr->nexthop;
+  sa->origin = attr->origin;
+  sa->mp_nexthop_family = attr->mp_nexthop.family;
+  memcpy(sa->mp_nexthop, &attr->mp_nexthop.address, sizeof(sa->mp_nexthop));
+  ptr += sizeof(struct bgp_snapshot_attr);
+
+  /* 4-byte aligned ones first, AS path last */
+  if (attr->community) {
+    sa->present |= BGP_SNAPSHOT_COMMUNITY;
+    sa->community_len = (attr->community->size * 4);
+    memcpy(ptr, attr->community->val, sa->community_len);
+    ptr += sa->community_len;
+  }
+
+  if (attr->ecommunity) {
+    sa->present |= BGP_SNAPSHOT_ECOMMUNITY;
+    sa->ecommunity_len = ecom_length(attr->ecommunity);
+    memcpy(ptr, attr->ecommunity->val, sa->ecommunity_len);
+    ptr += sa->ecommunity_len;
+  }
+
+  if (attr->lcommunity) {
+    sa->present |= BGP_SNAPSHOT_LCOMMUNITY;
+    sa->lcommunity_len = lcom_length(attr->lcommunity);
+    memcpy(ptr, attr->lcommunity->val, sa->lcommunity_len);
+    ptr += sa->lcommunity_len;
+  }
+
+  if (attr->aspath) {
+    sa->present |= BGP_SNAPSHOT_ASPATH;
+    sa->aspath_len = bgp_snapshot_aspath_len(attr->aspath);
+    bgp_snapshot_aspath_put(attr->aspath, (u_char *) ptr);
+  }
+
+  sb->len += len;
+
+  return SUCCESS;
+}
+
+/* to be called with the RIB locked, or from a forked process */
+int bgp_snapshot_write(char *filename)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  struct bgp_rt_structs *inter_domain_routing_db = bgp_select_routing_db(FUNC_TYPE_BGP);
+  char tmp_filename[SRVBUFLEN];
+  struct bgp_snapshot_hdr hdr;
+  struct bgp_snapshot_peer sp;
+  struct bgp_snapshot_route sr;
+  struct bgp_snapshot_buf sb;
+  struct bgp_peer *peer;
+  struct bgp_table *table;
+  struct bgp_node *node;
+  struct bgp_info *ri;
+  void *refs = NULL;
+  FILE *file;
+  int peers_idx, ret = ERR;
+  u_int32_t peers_num, modulo, peer_buckets;
+  u_int64_t routes_num;
+  afi_t afi;
+  safi_t safi;
+  time_t start;
+
+  if (!bms || !inter_domain_routing_db || !filename) return ERR;
+
+  snprintf(tmp_filename, SRVBUFLEN, "%s.%u", filename, getpid());
+  memset(&hdr, 0, sizeof(hdr));
+  memset(&sb, 0, sizeof(sb));
+
+  start = time(NULL);
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Saving BGP RIB snapshot - START (PID: %u) ***\n", config.name, bms->log_str, getpid());
+
+  file = open_output_file(tmp_filename, "w", FALSE);
+  if (!file) return ERR;
+
+  /* the header goes in last, once complete */
+  if (fwrite(&hdr, sizeof(hdr), 1, file) != 1) goto exit_lane;
+
+  for (peers_idx = 0, peers_num = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+    peer = &peers[peers_idx];
+    if ((!peer->fd && !peer->stale) || !peer->addr.family) continue;
+
+    memset(&sp, 0, sizeof(sp));
+    sp.addr_family = peer->addr.family;
+    memcpy(sp.addr, &peer->addr.address, sizeof(sp.addr));
+    sp.id_family = peer->id.family;
+    memcpy(sp.id, &peer->id.address, sizeof(sp.id));
+    sp.tcp_port = peer->tcp_port;
+    sp.cap_add_paths = peer->cap_add_paths;
+    sp.as = peer->as;
+    sp.myas = peer->myas;
+
+    if (fwrite(&sp, sizeof(sp), 1, file) != 1) goto exit_lane;
+    peers_num++;
+  }
+
+  /* same walk as above: routes refer to peers by their position */
+  for (peers_idx = 0, peers_num = 0, routes_num = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+    peer = &peers[peers_idx];
+    if ((!peer->fd && !peer->stale) || !peer->addr.family) continue;
+
+    for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+      for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+	table = inter_domain_routing_db->rib[afi][safi];
+	node = bgp_table_top(peer, table);
+
+	while (node) {
+	  modulo = bms->route_info_modulo(peer, NULL, bms->table_per_peer_buckets);
+
+	  for (peer_buckets = 0; peer_buckets < bms->table_per_peer_buckets; peer_buckets++) {
+	    for (ri = node->info[modulo + peer_buckets]; ri; ri = ri->next) {
+	      if (!ri->attr || !bgp_info_peer_match(ri, peer)) continue;
+
+	      memset(&sr, 0, sizeof(sr));
+	      if (bgp_snapshot_attr_add(&sb, &refs, ri->attr, &sr.attr) == ERR) goto exit_lane;
+
+	      sr.peer = peers_num;
+	      sr.afi = afi;
+	      sr.safi = safi;
+	      sr.family = node->p.family;
+	      sr.prefixlen = node->p.prefixlen;
+	      memcpy(sr.prefix, &node->p.u.prefix6, sizeof(sr.prefix));
+
+	      if (ri->extra) {
+		memcpy(&sr.rd, &ri->extra->rd, sizeof(rd_t));
+		memcpy(sr.label, ri->extra->label, 3);
+		sr.path_id = ri->extra->path_id;
+	      }
+
+	      if (fwrite(&sr, sizeof(sr), 1, file) != 1) goto exit_lane;
+	      routes_num++;
+	    }
+	  }
+
+	  node = bgp_route_next(peer, node);
+	}
+      }
+    }
+
+    peers_num++;
+  }
+
+  if (sb.len && fwrite(sb.base, sb.len, 1, file) != 1) goto exit_lane;
+
+  memcpy(hdr.magic, BGP_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+  hdr.version = BGP_SNAPSHOT_VERSION;
+  hdr.bom = BGP_SNAPSHOT_BOM;
+  hdr.tstamp = start;
+  hdr.peers_num = peers_num;
+  hdr.routes_num = routes_num;
+  hdr.attrs_len = sb.len;
+
+  if (fseek(file, 0, SEEK_SET) || fwrite(&hdr, sizeof(hdr), 1, file) != 1) goto exit_lane;
+  if (fflush(file) || fsync(fileno(file))) goto exit_lane;
+
+  ret = SUCCESS;
+
+  exit_lane:
+  if (ret == ERR) Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Unable to write BGP RIB snapshot: %s\n", config.name, bms->log_str, tmp_filename, strerror(errno));
+
+  close_output_file(file);
+  pm_tdestroy(&refs, free);
+  free(sb.base);
+
+  /* the previous snapshot is replaced only by a complete one */
+  if (ret == SUCCESS && rename(tmp_filename, filename)) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): [%s] rename() failed: %s\n", config.name, bms->log_str, filename, strerror(errno));
+    ret = ERR;
+  }
+
+  if (ret == ERR) unlink(tmp_filename);
+  else Log(LOG_INFO, "INFO ( %s/%s ): *** Saving BGP RIB snapshot - END (PID: %u PEERS: %u ROUTES: %" PRIu64 " ATTRS: %" PRIu64 " KB ET: %u) ***\n",
+	   config.name, bms->log_str, getpid(), hdr.peers_num, hdr.routes_num, (hdr.attrs_len / 1024), (u_int32_t) (time(NULL) - start));
+
+  return ret;
+}
+
+/* peers sharing an address, ie. a session saved with its stale twin, are merged */
+static struct bgp_peer *bgp_snapshot_peer_restore(struct bgp_snapshot_peer *sp)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  struct bgp_peer *peer;
+  struct host_addr addr;
+  int peers_idx;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.family = sp->addr_family;
+  memcpy(&addr.address, sp->addr, sizeof(sp->addr));
+
+  for (peers_idx = 0, peer = NULL; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+    if (peers[peers_idx].stale && !memcmp(&peers[peers_idx].addr, &addr, sizeof(addr))) return &peers[peers_idx];
+    if (!peer && !peers[peers_idx].fd && !peers[peers_idx].stale) peer = &peers[peers_idx];
+  }
+
+  if (!peer) return NULL;
+
+  memset(peer, 0, sizeof(struct bgp_peer));
+  peer->idx = (peer - peers);
+  peer->type = FUNC_TYPE_BGP;
+  peer->status = Idle;
+  memcpy(&peer->addr, &addr, sizeof(addr));
+  peer->id.family = sp->id_family;
+  memcpy(&peer->id.address, sp->id, sizeof(sp->id));
+  addr_to_str(peer->addr_str, &peer->addr);
+  peer->tcp_port = sp->tcp_port;
+  peer->cap_add_paths = sp->cap_add_paths;
+  peer->as = sp->as;
+  peer->myas = sp->myas;
+  peer->stale = TRUE;
+
+  if (bms->peers_cache && bms->peers_port_cache) {
+    u_int32_t bucket;
+
+    bucket = addr_hash(&peer->addr, bms->max_peers);
+    bgp_peer_cache_insert(bms->peers_cache, bucket, peer);
+
+    bucket = addr_port_hash(&peer->addr, peer->tcp_port, bms->max_peers);
+    bgp_peer_cache_insert(bms->peers_port_cache, bucket, peer);
+  }
+
+  bms->snapshot.stale_peers++;
+
+  return peer;
+}
+
+static int bgp_snapshot_attr_restore(struct bgp_peer *peer, char *attrs, u_int64_t attrs_len, u_int64_t offset, struct bgp_attr *attr)
+{
+  struct bgp_snapshot_attr *sa;
+  char *ptr;
+
+  if (offset > attrs_len || (attrs_len - offset) < sizeof(struct bgp_snapshot_attr)) return ERR;
+
+  sa = (struct bgp_snapshot_attr *) (attrs + offset);
+  if ((attrs_len - offset - sizeof(struct bgp_snapshot_attr)) <
+      ((u_int64_t) sa->community_len + sa->ecommunity_len + sa->lcommunity_len + sa->aspath_len)) return ERR;
+
+  memset(attr, 0, sizeof(struct bgp_attr));
+  attr->flag = sa->flag;
+  attr->med = sa->med;
+  attr->local_pref = sa->local_pref;
+  attr->nexthop = sa->nexthop;
+  attr->origin = sa->origin;
+  attr->mp_nexthop.family = sa->mp_nexthop_family;
+  memcpy(&attr->mp_nexthop.address, sa->mp_nexthop, sizeof(sa->mp_nexthop));
+  ptr = (char *) (sa + 1);
+
+  /* same as bgp_attr_parse(): interned, to be uninterned by the caller */
+  if (sa->present & BGP_SNAPSHOT_COMMUNITY) attr->community = community_parse(peer, (u_int32_t *) ptr, sa->community_len);
+  ptr += sa->community_len;
+
+  if (sa->present & BGP_SNAPSHOT_ECOMMUNITY) attr->ecommunity = ecommunity_parse(peer, (u_int8_t *) ptr, sa->ecommunity_len);
+  ptr += sa->ecommunity_len;
+
+  if (sa->present & BGP_SNAPSHOT_LCOMMUNITY) attr->lcommunity = lcommunity_parse(peer, (u_int8_t *) ptr, sa->lcommunity_len);
+  ptr += sa->lcommunity_len;
+
+  if (sa->present & BGP_SNAPSHOT_ASPATH) attr->aspath = aspath_parse(peer, ptr, sa->aspath_len, TRUE);
+
+  return SUCCESS;
+}
+
+static void bgp_snapshot_attr_release(struct bgp_peer *peer, struct bgp_attr *attr)
+{
+  if (attr->aspath) aspath_unintern(peer, attr->aspath);
+  if (attr->community) community_unintern(peer, attr->community);
+  if (attr->ecommunity) ecommunity_unintern(peer, attr->ecommunity);
+  if (attr->lcommunity) lcommunity_unintern(peer, attr->lcommunity);
+
+  memset(attr, 0, sizeof(struct bgp_attr));
+}
+
+static void bgp_snapshot_load(char *filename)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  struct bgp_snapshot_hdr *hdr;
+  struct bgp_snapshot_peer *sp;
+  struct bgp_snapshot_route *sr;
+  struct bgp_peer **restored, *peer, *attr_peer = NULL;
+  struct bgp_msg_data bmd;
+  struct bgp_attr attr;
+  struct prefix p;
+  struct stat st;
+  char *base, *attrs;
+  int fd, msglog_backend_methods, full = FALSE;
+  u_int64_t idx, routes_num = 0, attr_offset = 0;
+  time_t start;
+
+  fd = open(filename, O_RDONLY);
+  if (fd == ERR) {
+    if (errno != ENOENT) Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Unable to open BGP RIB snapshot: %s\n", config.name, bms->log_str, filename, strerror(errno));
+    else Log(LOG_INFO, "INFO ( %s/%s ): [%s] No BGP RIB snapshot found, starting clean.\n", config.name, bms->log_str, filename);
+
+    return;
+  }
+
+  if (fstat(fd, &st) || st.st_size < sizeof(struct bgp_snapshot_hdr)) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Invalid BGP RIB snapshot. Ignored.\n", config.name, bms->log_str, filename);
+    close(fd);
+    return;
+  }
+
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (base == MAP_FAILED) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): [%s] mmap() failed: %s\n", config.name, bms->log_str, filename, strerror(errno));
+    return;
+  }
+
+  hdr = (struct bgp_snapshot_hdr *) base;
+  sp = (struct bgp_snapshot_peer *) (hdr + 1);
+  sr = (struct bgp_snapshot_route *) (sp + hdr->peers_num);
+  attrs = (char *) (sr + hdr->routes_num);
+
+  if (memcmp(hdr->magic, BGP_SNAPSHOT_MAGIC, sizeof(hdr->magic)) || hdr->version != BGP_SNAPSHOT_VERSION ||
+      hdr->bom != BGP_SNAPSHOT_BOM || hdr->routes_num > (st.st_size / sizeof(struct bgp_snapshot_route)) ||
+      (sizeof(struct bgp_snapshot_hdr) + (hdr->peers_num * sizeof(struct bgp_snapshot_peer)) +
+       (hdr->routes_num * sizeof(struct bgp_snapshot_route)) + hdr->attrs_len) != st.st_size) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Invalid or incompatible BGP RIB snapshot. Ignored.\n", config.name, bms->log_str, filename);
+    munmap(base, st.st_size);
+    return;
+  }
+
+  restored = calloc((hdr->peers_num ? hdr->peers_num : 1), sizeof(struct bgp_peer *));
+  if (!restored) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_snapshot_load). Exiting ..\n", config.name, bms->log_str);
+    exit_gracefully(1);
+  }
+
+  start = time(NULL);
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+
+  /* restored routes are not news to anybody */
+  msglog_backend_methods = bms->msglog_backend_methods;
+  bms->msglog_backend_methods = FALSE;
+
+  memset(&attr, 0, sizeof(attr));
+  memset(&bmd, 0, sizeof(bmd));
+
+  for (idx = 0; idx < hdr->routes_num; idx++, sr++) {
+    if (sr->peer >= hdr->peers_num || sr->afi < AFI_IP || sr->afi >= AFI_MAX || sr->safi >= SAFI_MAX) continue;
+    if ((sr->family != AF_INET || sr->prefixlen > 32) && (sr->family != AF_INET6 || sr->prefixlen > 128)) continue;
+
+    if (!(peer = restored[sr->peer])) {
+      if (!(peer = bgp_snapshot_peer_restore(&sp[sr->peer]))) {
+	if (!full) Log(LOG_WARNING, "WARN ( %s/%s ): [%s] Insufficient number of BGP peers has been configured by 'bgp_daemon_max_peers' (%d).\n",
+			config.name, bms->log_str, filename, config.nfacctd_bgp_max_peers);
+	full = TRUE;
+	continue;
+      }
+
+      restored[sr->peer] = peer;
+    }
+
+    /* routes of a peer tend to come in runs sharing attributes */
+    if (!attr_peer || attr_offset != sr->attr) {
+      if (attr_peer) bgp_snapshot_attr_release(attr_peer, &attr);
+      attr_peer = NULL;
+
+      if (bgp_snapshot_attr_restore(peer, attrs, hdr->attrs_len, sr->attr, &attr) == ERR) continue;
+
+      attr_peer = peer;
+      attr_offset = sr->attr;
+    }
+
+    memset(&p, 0, sizeof(p));
+    p.family = sr->family;
+    p.prefixlen = sr->prefixlen;
+    memcpy(&p.u.prefix6, sr->prefix, sizeof(sr->prefix));
+
+    bmd.peer = peer;
+    if (bgp_process_update(&bmd, &p, &attr, sr->afi, sr->safi, &sr->rd, &sr->path_id, sr->label) == SUCCESS) {
+      peer->stale_eor |= BGP_SNAPSHOT_EOR_BIT(sr->afi, sr->safi);
+      routes_num++;
+    }
+  }
+
+  if (attr_peer) bgp_snapshot_attr_release(attr_peer, &attr);
+  bms->msglog_backend_methods = msglog_backend_methods;
+
+  Log(LOG_INFO, "INFO ( %s/%s ): [%s] Loaded BGP RIB snapshot: %d peers, %" PRIu64 " routes as stale (age: %us, ET: %u).\n",
+      config.name, bms->log_str, filename, bms->snapshot.stale_peers, routes_num, (u_int32_t) (start - hdr->tstamp), (u_int32_t) (time(NULL) - start));
+
+  free(restored);
+  munmap(base, st.st_size);
+}
+
+void bgp_snapshot_init()
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  time_t now;
+
+  if (!bms || !config.bgp_table_snapshot_file) return;
+
+  if (config.bgp_xconnect_map || bms->skip_rib) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): 'bgp_table_snapshot_file' requires a BGP RIB to be kept (not the case with 'bgp_daemon_xconnect_map' or no dumps/lookups). Ignored.\n",
+	config.name, bms->log_str);
+    config.bgp_table_snapshot_file = NULL;
+    return;
+  }
+
+  if (!config.bgp_table_snapshot_stale_time) config.bgp_table_snapshot_stale_time = BGP_SNAPSHOT_STALE_TIME_DEFAULT;
+
+  /* the RIB is saved on shutdown by whichever thread gets the signal */
+  if (!bms->rib_mutex) {
+    bms->rib_mutex = malloc(sizeof(pthread_mutex_t));
+    if (!bms->rib_mutex) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_snapshot_init). Exiting ..\n", config.name, bms->log_str);
+      exit_gracefully(1);
+    }
+
+    pthread_mutex_init(bms->rib_mutex, NULL);
+  }
+
+  bgp_rib_lock(bms);
+
+  bgp_snapshot_load(config.bgp_table_snapshot_file);
+
+  now = time(NULL);
+  bms->snapshot.stale_deadline = (now + config.bgp_table_snapshot_stale_time);
+  if (config.bgp_table_snapshot_refresh_time) bms->snapshot.refresh_deadline = (now + config.bgp_table_snapshot_refresh_time);
+  bms->snapshot.ready = TRUE;
+
+  bgp_rib_unlock(bms);
+}
+
+/* to be called on shutdown, before peers are closed */
+void bgp_snapshot_save()
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+
+  if (!bms || !config.bgp_table_snapshot_file) return;
+
+  bgp_rib_lock(bms);
+  if (bms->snapshot.ready) bgp_snapshot_write(config.bgp_table_snapshot_file);
+  bgp_rib_unlock(bms);
+}
+
+void bgp_handle_snapshot_event()
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  int ret;
+
+  ret = fork();
+
+  if (!ret) { /* Child */
+    /* we have to ignore signals to avoid loops: because we are already forked */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    pm_setproctitle("%s %s [%s]", config.type, "Core Process -- BGP Snapshot Writer", config.name);
+    config.is_forked = TRUE;
+
+    if (bgp_snapshot_write(config.bgp_table_snapshot_file) == ERR) exit_gracefully(1);
+
+    exit_gracefully(0);
+  }
+  else if (ret == -1) /* Something went wrong */
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to fork BGP RIB snapshot writer: %s\n", config.name, bms->log_str, strerror(errno));
+}
+
+/* seconds to the next snapshot or stale routes deadline, ERR if none */
+int bgp_snapshot_timeout()
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  time_t now, deadline = 0;
+
+  if (!bms || !config.bgp_table_snapshot_file) return ERR;
+
+  if (bms->snapshot.stale_peers) deadline = bms->snapshot.stale_deadline;
+  if (bms->snapshot.refresh_deadline && (!deadline || bms->snapshot.refresh_deadline < deadline))
+    deadline = bms->snapshot.refresh_deadline;
+
+  if (!deadline) return ERR;
+
+  now = time(NULL);
+
+  return (deadline > now ? (deadline - now) : 0);
+}
+
+/* to be called with the RIB locked */
+static void bgp_snapshot_retire(struct bgp_peer *peer, char *reason)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+  char peer_str[INET6_ADDRSTRLEN];
+
+  bgp_peer_print(peer, peer_str, INET6_ADDRSTRLEN);
+  Log(LOG_INFO, "INFO ( %s/%s ): [%s] Dropping stale routes (%s).\n", config.name, bms->log_str, peer_str, reason);
+
+  bgp_peer_info_delete(peer);
+
+  if (bms->peers_cache && bms->peers_port_cache) {
+    u_int32_t bucket;
+
+    bucket = addr_hash(&peer->addr, bms->max_peers);
+    bgp_peer_cache_delete(bms->peers_cache, bucket, peer);
+
+    bucket = addr_port_hash(&peer->addr, peer->tcp_port, bms->max_peers);
+    bgp_peer_cache_delete(bms->peers_port_cache, bucket, peer);
+  }
+
+  memset(&peer->id, 0, sizeof(peer->id));
+  memset(&peer->addr, 0, sizeof(peer->addr));
+  memset(&peer->addr_str, 0, sizeof(peer->addr_str));
+  peer->stale = FALSE;
+  peer->stale_eor = 0;
+
+  bms->snapshot.stale_peers--;
+}
+
+/*
+   The peers table is full and a new session comes in from 'addr': rather
+   than refusing it until bgp_table_snapshot_stale_time, stale routes give
+   way, those of the peer itself if any. The freed slot is returned, NULL
+   if there are no stale routes. To be called with the RIB locked.
+*/
+struct bgp_peer *bgp_snapshot_takeover(struct host_addr *addr)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  struct bgp_peer *stale = NULL;
+  int peers_idx;
+
+  if (!bms || !bms->snapshot.stale_peers) return NULL;
+
+  for (peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+    if (!peers[peers_idx].stale) continue;
+
+    if (!memcmp(&peers[peers_idx].addr, addr, sizeof(peers[peers_idx].addr))) {
+      bgp_snapshot_retire(&peers[peers_idx], "taken over by the new session");
+      return &peers[peers_idx];
+    }
+
+    if (!stale) stale = &peers[peers_idx];
+  }
+
+  if (stale) bgp_snapshot_retire(stale, "slot taken over by a new peer");
+
+  return stale;
+}
+
+void bgp_snapshot_handle_timers(time_t now)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BGP);
+  int peers_idx;
+
+  if (!bms || !config.bgp_table_snapshot_file) return;
+
+  if (!(bms->snapshot.stale_peers && now >= bms->snapshot.stale_deadline) &&
+      !(bms->snapshot.refresh_deadline && now >= bms->snapshot.refresh_deadline)) return;
+
+  bgp_rib_lock(bms);
+
+  if (bms->snapshot.stale_peers && now >= bms->snapshot.stale_deadline) {
+    for (peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+      if (peers[peers_idx].stale) bgp_snapshot_retire(&peers[peers_idx], "stale time expired");
+    }
+  }
+
+  if (bms->snapshot.refresh_deadline && now >= bms->snapshot.refresh_deadline) {
+    bgp_handle_snapshot_event();
+
+    while (bms->snapshot.refresh_deadline <= now)
+      bms->snapshot.refresh_deadline += config.bgp_table_snapshot_refresh_time;
+  }
+
+  bgp_rib_unlock(bms);
+}
+
+/*
+   End-of-RIB received by 'peer' for afi/safi: once a re-established peer
+   has sent it for all the tables it had routes in, its stale routes can go.
+   To be called with the RIB locked.
+*/
+void bgp_snapshot_eor(struct bgp_peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+  struct bgp_peer *stale;
+  int peers_idx;
+
+  if (!bms || !bms->snapshot.stale_peers || peer->stale || peer->type != FUNC_TYPE_BGP) return;
+
+  for (peers_idx = 0; peers_idx < config.nfacctd_bgp_max_peers; peers_idx++) {
+    stale = &peers[peers_idx];
+
+    if (stale->stale && !memcmp(&stale->addr, &peer->addr, sizeof(stale->addr))) {
+      stale->stale_eor &= ~BGP_SNAPSHOT_EOR_BIT(afi, safi);
+      if (!stale->stale_eor) bgp_snapshot_retire(stale, "End-of-RIB received");
+
+      break;
+    }
+  }
+}
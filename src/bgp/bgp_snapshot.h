@@ -0,0 +1,120 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef _BGP_SNAPSHOT_H_
+#define _BGP_SNAPSHOT_H_
+
+/* defines */
+#define BGP_SNAPSHOT_MAGIC		"PMBGPSNP"
+#define BGP_SNAPSHOT_VERSION		1
+#define BGP_SNAPSHOT_BOM		0x01020304 /* written in native byte order */
+#define BGP_SNAPSHOT_STALE_TIME_DEFAULT	300
+
+#define BGP_SNAPSHOT_ALIGN(x)		(((x) + 7) & ~((u_int64_t) 7))
+
+/* one bit per table, SAFI_MPLS_VPN (128) folding onto 0 */
+#define BGP_SNAPSHOT_EOR_BIT(afi, safi)	(1U << (((afi) * 8) + ((safi) & 7)))
+
+#define BGP_SNAPSHOT_ASPATH		0x01
+#define BGP_SNAPSHOT_COMMUNITY		0x02
+#define BGP_SNAPSHOT_ECOMMUNITY		0x04
+#define BGP_SNAPSHOT_LCOMMUNITY		0x08
+
+/* structs */
+/*
+   On-disk layout: the header, the peers section, the routes section and
+   the attributes section, in this order. Peers and routes are arrays of
+   fixed size records, so that the file can be mmap()'ed and walked in
+   place; attributes are variable size records, each shared by all the
+   routes pointing to its offset: communities, as found in struct community
+   and friends, then the AS path in wire format, with 4-byte ASNs.
+*/
+struct bgp_snapshot_hdr {
+  char magic[8];
+  u_int32_t version;
+  u_int32_t bom;
+  u_int64_t tstamp;
+  u_int32_t peers_num;
+  u_int32_t reserved;
+  u_int64_t routes_num;
+  u_int64_t attrs_len;
+};
+
+struct bgp_snapshot_peer {
+  u_int8_t addr_family;
+  u_int8_t id_family;
+  u_int16_t tcp_port;
+  u_int8_t cap_add_paths;
+  u_int8_t reserved[3];
+  as_t as;
+  as_t myas;
+  u_int8_t addr[16];
+  u_int8_t id[16];
+};
+
+struct bgp_snapshot_route {
+  u_int64_t attr; /* offset into the attributes section */
+  u_int32_t peer; /* index into the peers section */
+  path_id_t path_id;
+  rd_t rd;
+  u_int8_t afi;
+  u_int8_t safi;
+  u_int8_t family;
+  u_int8_t prefixlen;
+  u_int8_t label[3];
+  u_int8_t reserved;
+  u_int8_t prefix[16];
+};
+
+struct bgp_snapshot_attr {
+  u_int32_t flag;
+  u_int32_t med;
+  u_int32_t local_pref;
+  struct in_addr nexthop;
+  u_int8_t origin;
+  u_int8_t present; /* BGP_SNAPSHOT_ASPATH, etc. */
+  u_int8_t mp_nexthop_family;
+  u_int8_t reserved;
+  u_int8_t mp_nexthop[16];
+  u_int32_t aspath_len;
+  u_int32_t community_len;
+  u_int32_t ecommunity_len;
+  u_int32_t lcommunity_len;
+  /* followed by communities, ext and large communities and AS path */
+};
+
+struct bgp_snapshot_state {
+  int ready; /* the RIB is worth saving, ie. the snapshot was loaded */
+  int stale_peers;
+  time_t stale_deadline;
+  time_t refresh_deadline;
+};
+
+/* prototypes */
+extern void bgp_snapshot_init();
+extern int bgp_snapshot_write(char *);
+extern void bgp_snapshot_save();
+extern void bgp_handle_snapshot_event();
+extern int bgp_snapshot_timeout();
+extern void bgp_snapshot_handle_timers(time_t);
+extern struct bgp_peer *bgp_snapshot_takeover(struct host_addr *);
+extern void bgp_snapshot_eor(struct bgp_peer *, afi_t, safi_t);
+#endif
@@ -67,7 +67,7 @@ bgp_node_create (struct bgp_peer *peer)
 
   if (!bms) return NULL;
 
-  rn = (struct bgp_node *) malloc (sizeof (struct bgp_node));
+  rn = (struct bgp_node *) bgp_slab_alloc (&bgp_node_slab);
   if (rn) {
     memset (rn, 0, sizeof (struct bgp_node));
 
@@ -111,7 +111,7 @@ bgp_node_free (struct bgp_node *node)
     node->info = NULL;
   }
 
-  free (node);
+  bgp_slab_free (node);
 }
 
 /* Utility mask array. */
@@ -258,26 +258,45 @@ bgp_node_match (const struct bgp_table *table, struct prefix *p, struct bgp_peer
   node = table->top;
   if (bnv) bnv->entries = 0;
 
-  /* Walk down tree.  If there is matched route then store it to matched. */
-  while (node && node->p.prefixlen <= p->prefixlen && prefix_match(&node->p, p)) {
-    for (local_modulo = modulo, modulo_idx = 0; modulo_idx < modulo_max; local_modulo++, modulo_idx++) {
-      for (info = node->info[local_modulo]; info; info = info->next) {
-	if (!cmp_func(info, nmct2)) {
-	  matched_node = node;
-	  matched_info = info;
-
-	  if (bnv) {
-	    bnv->v[bnv->entries].p = &node->p;
-	    bnv->v[bnv->entries].info = info;
-	    bnv->entries++;
+  /* Host lookups against an indexed table start from the deepest node
+     covering the address and walk up: the first node matching is the
+     result. The node vector needs all levels, hence the full walk. */
+  if (table->lpm && !bnv && p->prefixlen == (table->lpm->addr_len * 8)) {
+    for (node = bgp_lpm_lookup(table, &p->u.prefix); node && !matched_node; node = node->parent) {
+      for (local_modulo = modulo, modulo_idx = 0; modulo_idx < modulo_max; local_modulo++, modulo_idx++) {
+	for (info = node->info[local_modulo]; info; info = info->next) {
+	  if (!cmp_func(info, nmct2)) {
+	    matched_node = node;
+	    matched_info = info;
+
+	    if (node->p.prefixlen == p->prefixlen) break;
 	  }
-
-	  if (node->p.prefixlen == p->prefixlen) break;
 	}
       }
     }
+  }
+  else {
+    /* Walk down tree.  If there is matched route then store it to matched. */
+    while (node && node->p.prefixlen <= p->prefixlen && prefix_match(&node->p, p)) {
+      for (local_modulo = modulo, modulo_idx = 0; modulo_idx < modulo_max; local_modulo++, modulo_idx++) {
+	for (info = node->info[local_modulo]; info; info = info->next) {
+	  if (!cmp_func(info, nmct2)) {
+	    matched_node = node;
+	    matched_info = info;
+
+	    if (bnv) {
+	      bnv->v[bnv->entries].p = &node->p;
+	      bnv->v[bnv->entries].info = info;
+	      bnv->entries++;
+	    }
+
+	    if (node->p.prefixlen == p->prefixlen) break;
+	  }
+	}
+      }
 
-    node = node->link[check_bit(&p->u.prefix, node->p.prefixlen)];
+      node = node->link[check_bit(&p->u.prefix, node->p.prefixlen)];
+    }
   }
 
   if (config.debug && bnv) bgp_node_vector_debug(bnv, p); 
@@ -358,6 +377,8 @@ bgp_node_get (struct bgp_peer *peer, struct bgp_table *const table, struct prefi
 	set_link (match, new);
       else
 	table->top = new;
+
+      bgp_lpm_insert (table, new);
     }
   else
     {
@@ -372,12 +393,16 @@ bgp_node_get (struct bgp_peer *peer, struct bgp_table *const table, struct prefi
       else
 	table->top = new;
 
+      bgp_lpm_insert (table, new);
+
       if (new->p.prefixlen != p->prefixlen)
 	{
 	  match = new;
 	  new = bgp_node_set (peer, table, p);
 	  set_link (match, new);
 	  table->count++;
+
+	  bgp_lpm_insert (table, new);
 	}
     }
   table->count++;
@@ -424,8 +449,10 @@ bgp_node_delete (struct bgp_peer *peer, struct bgp_node *node)
     node->table->top = child;
   
   node->table->count--;
+
+  bgp_lpm_delete (node->table, node, parent);
   
-  bgp_node_free (node);
+  bgp_rcu_free (node, (void (*)(void *)) bgp_node_free);
 
   /* If parent node is stub then delete it also. */
   if (parent && parent->lock == 0)
@@ -500,6 +527,8 @@ void bgp_table_free (struct bgp_table *rt)
   if (rt == NULL)
     return;
 
+  bgp_lpm_free (rt);
+
   node = rt->top;
 
   /* Bulk deletion of nodes remaining in this table.  This function is not
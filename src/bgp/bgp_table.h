@@ -42,6 +42,9 @@ struct bgp_table
   struct bgp_node *top;
   
   unsigned long count;
+
+  /* optional multibit trie index for longest prefix match */
+  struct bgp_lpm *lpm;
 };
 
 struct bgp_node
@@ -80,6 +83,20 @@ struct bgp_info
   struct bgp_peer *peer;
   struct bgp_attr *attr;
   struct bgp_info_extra *extra;
+  u_int32_t dump_gen; /* dump the route was last changed before */
+};
+
+/*
+   Route entry of a shared RIB, see bgp_table_shared_paths: it stands for
+   all the peers flagged in 'peers_map', by index, and 'info.peer' is any
+   of them. Entries are never modified once published, but for the map:
+   a peer changing path moves to another entry.
+*/
+struct bgp_info_shared
+{
+  struct bgp_info info;
+  u_int32_t peers_num;
+  u_int64_t peers_map[];
 };
 
 struct node_match_cmp_term2 {
@@ -183,12 +183,14 @@ struct bgp_info_extra *bgp_info_extra_new(struct bgp_info *ri)
 
   if (!bms) return NULL;
 
-  new = malloc(sizeof(struct bgp_info_extra));
-  if (!new) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_info_extra_new). Exiting ..\n", config.name, bms->log_str);
-    exit_gracefully(1);
+  /* shared entries outlive the peer creating them */
+  if (bms->table_shared_paths) new = bgp_slab_alloc(&bgp_info_extra_slab);
+  else {
+    if (!ri->peer->info_extra_slab) ri->peer->info_extra_slab = bgp_slab_new(BGP_SLAB_INFO_EXTRA, sizeof(struct bgp_info_extra));
+    new = bgp_slab_alloc(ri->peer->info_extra_slab);
   }
-  else memset(new, 0, sizeof (struct bgp_info_extra));
+
+  memset(new, 0, sizeof (struct bgp_info_extra));
 
   return new;
 }
@@ -202,9 +204,10 @@ void bgp_info_extra_free(struct bgp_peer *peer, struct bgp_info_extra **extra)
   if (!bms) return;
 
   if (extra && *extra) {
+    /* extra data is not looked at by collectors, only the struct is deferred */
     if ((*extra)->bmed.id && bms->bgp_extra_data_free) (*bms->bgp_extra_data_free)(&(*extra)->bmed);
 
-    free(*extra);
+    bgp_slab_retire(*extra);
     *extra = NULL;
   }
 }
@@ -254,14 +257,123 @@ struct bgp_info *bgp_info_new(struct bgp_peer *peer)
 
   if (!bms) return NULL;
 
-  new = malloc(sizeof(struct bgp_info));
+  if (!peer->info_slab) peer->info_slab = bgp_slab_new(BGP_SLAB_INFO, sizeof(struct bgp_info));
+
+  new = bgp_slab_alloc(peer->info_slab);
+  memset(new, 0, sizeof (struct bgp_info));
+  
+  return new;
+}
+
+/* Allocate new shared bgp info structure, 'peer' being its first user */
+struct bgp_info *bgp_info_shared_new(struct bgp_peer *peer)
+{
+  struct bgp_misc_structs *bms;
+  struct bgp_info_shared *new;
+  size_t len;
+
+  if (!peer) return NULL;
+
+  bms = bgp_select_misc_db(peer->type);
+
+  if (!bms) return NULL;
+
+  len = (sizeof(struct bgp_info_shared) + (((bms->max_peers + 63) / 64) * sizeof(u_int64_t)));
+
+  new = malloc(len);
   if (!new) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_info_new). Exiting ..\n", config.name, bms->log_str);
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (bgp_info_shared_new). Exiting ..\n", config.name, bms->log_str);
     exit_gracefully(1);
   }
-  else memset(new, 0, sizeof (struct bgp_info));
-  
-  return new;
+  else memset(new, 0, len);
+
+  new->info.peer = peer;
+  new->peers_map[peer->idx / 64] = (1ULL << (peer->idx % 64));
+  new->peers_num = 1;
+
+  return &new->info;
+}
+
+/* 'peer' starts using a shared entry already in the RIB */
+void bgp_info_share(struct bgp_peer *peer, struct bgp_info *ri)
+{
+  struct bgp_info_shared *shared = (struct bgp_info_shared *) ri;
+
+  __atomic_or_fetch(&shared->peers_map[peer->idx / 64], (1ULL << (peer->idx % 64)), __ATOMIC_RELEASE);
+  shared->peers_num++;
+  peer->lock++;
+
+  /* other users of the entry will dump it again too, harmless */
+  bgp_info_dump_stamp(peer, ri);
+  bgp_peer_rib_gen_bump(peer);
+}
+
+/*
+   'peer' stops using a shared entry. Returns FALSE, leaving the entry
+   untouched, if the peer is the last user: the entry is then to be
+   deleted as any other.
+*/
+int bgp_info_unshare(struct bgp_peer *peer, struct bgp_info *ri)
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+  struct bgp_info_shared *shared = (struct bgp_info_shared *) ri;
+  struct bgp_peer *peers = bms->peers;
+  u_int64_t word;
+  int idx;
+
+  if (shared->peers_num <= 1) return FALSE;
+
+  /* 'peer' of the entry must keep pointing to one of its users */
+  if (ri->peer == peer) {
+    for (idx = 0; idx < ((bms->max_peers + 63) / 64); idx++) {
+      word = shared->peers_map[idx];
+      if (idx == (peer->idx / 64)) word &= ~(1ULL << (peer->idx % 64));
+
+      if (word) {
+	__atomic_store_n(&ri->peer, &peers[(idx * 64) + __builtin_ctzll(word)], __ATOMIC_RELEASE);
+	break;
+      }
+    }
+  }
+
+  __atomic_and_fetch(&shared->peers_map[peer->idx / 64], ~(1ULL << (peer->idx % 64)), __ATOMIC_RELEASE);
+  shared->peers_num--;
+  peer->lock--;
+
+  bgp_peer_rib_gen_bump(peer);
+
+  return TRUE;
+}
+
+/* whether the route is one of 'peer', also if part of a shared RIB */
+int bgp_info_peer_match(struct bgp_info *ri, struct bgp_peer *peer)
+{
+  struct bgp_misc_structs *bms;
+  struct bgp_info_shared *shared;
+
+  if (ri->peer == peer) return TRUE;
+
+  bms = bgp_select_misc_db(peer->type);
+  if (!bms || !bms->table_shared_paths) return FALSE;
+
+  shared = (struct bgp_info_shared *) ri;
+
+  return ((__atomic_load_n(&shared->peers_map[peer->idx / 64], __ATOMIC_ACQUIRE) & (1ULL << (peer->idx % 64))) ? TRUE : FALSE);
+}
+
+/*
+   Returns the route as seen by 'peer': for shared entries, standing for
+   several peers, a copy is made into 'view' on its behalf. Meant for any
+   output (logs, dumps, looking glass) reporting the peer of the route.
+*/
+struct bgp_info *bgp_info_peer_view(struct bgp_info *ri, struct bgp_peer *peer, struct bgp_info *view)
+{
+  if (!ri || ri->peer == peer) return ri;
+
+  memcpy(view, ri, sizeof(struct bgp_info));
+  view->peer = peer;
+
+  return view;
 }
 
 void bgp_info_add(struct bgp_peer *peer, struct bgp_node *rn, struct bgp_info *ri, u_int32_t modulo)
@@ -278,10 +390,18 @@ void bgp_info_add(struct bgp_peer *peer, struct bgp_node *rn, struct bgp_info *r
 
   bgp_lock_node(peer, rn);
   ri->peer->lock++;
+
+  bgp_info_dump_stamp(peer, ri);
+  bgp_peer_rib_gen_bump(peer);
 }
 
 void bgp_info_delete(struct bgp_peer *peer, struct bgp_node *rn, struct bgp_info *ri, u_int32_t modulo)
 {
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+
+  /* other peers still on the entry: just leave it */
+  if (bms && bms->table_shared_paths && bgp_info_unshare(peer, ri)) return;
+
   if (ri->next)
     ri->next->prev = ri->prev;
   if (ri->prev)
@@ -289,21 +409,95 @@ void bgp_info_delete(struct bgp_peer *peer, struct bgp_node *rn, struct bgp_info
   else
     rn->info[modulo] = ri->next;
 
+  /* before bgp_info_free(): a cached lookup must not outlive 'ri' */
+  bgp_peer_rib_gen_bump(peer);
+
   bgp_info_free(peer, ri);
 
   bgp_unlock_node(peer, rn);
 }
 
+/*
+   Invalidates lookup cache entries of the peer. Called once routes are
+   added or unlinked, not before, so that a concurrent lookup can't cache
+   a half-updated RIB under the new value; on removal it must come before
+   the route is handed to bgp_rcu_free(). Values are drawn from a shared
+   counter, rather than per peer, so that entries left over by a closed
+   session can't match a new one re-using the same peer structure; it is
+   64 bits wide so that it never wraps around to a value still cached,
+   nor to 0, the value of an unused entry.
+*/
+void bgp_peer_rib_gen_bump(struct bgp_peer *peer)
+{
+  u_int64_t rib_gen;
+
+  rib_gen = __atomic_add_fetch(&bgp_rib_gen, 1, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&peer->rib_gen, rib_gen, __ATOMIC_SEQ_CST);
+}
+
+/* no-ops unless peers are served by worker threads */
+void bgp_rib_lock(struct bgp_misc_structs *bms)
+{
+  int idx;
+
+  if (bms && bms->rib_mutex) {
+    pthread_mutex_lock(bms->rib_mutex);
+
+    /* tables are always taken in the same order, see bgp_rib_table_lock() */
+    if (bms->rib_table_mutex) {
+      for (idx = 0; idx < (AFI_MAX * SAFI_MAX); idx++) pthread_mutex_lock(&bms->rib_table_mutex[idx]);
+    }
+  }
+}
+
+void bgp_rib_unlock(struct bgp_misc_structs *bms)
+{
+  int idx;
+
+  if (bms && bms->rib_mutex) {
+    if (bms->rib_table_mutex) {
+      for (idx = ((AFI_MAX * SAFI_MAX) - 1); idx >= 0; idx--) pthread_mutex_unlock(&bms->rib_table_mutex[idx]);
+    }
+
+    pthread_mutex_unlock(bms->rib_mutex);
+  }
+}
+
+/*
+   Locks just the RIB table of afi/safi, so that workers updating different
+   tables don't wait on each other. Whoever holds it must not take any other
+   RIB lock; attributes are interned under locks of their own, see
+   hash_lock(). Falls back to bgp_rib_lock() if tables are not locked one by
+   one, see bgp_workers_init().
+*/
+void bgp_rib_table_lock(struct bgp_misc_structs *bms, afi_t afi, safi_t safi)
+{
+  if (bms && bms->rib_table_mutex) pthread_mutex_lock(&bms->rib_table_mutex[(afi * SAFI_MAX) + safi]);
+  else bgp_rib_lock(bms);
+}
+
+void bgp_rib_table_unlock(struct bgp_misc_structs *bms, afi_t afi, safi_t safi)
+{
+  if (bms && bms->rib_table_mutex) pthread_mutex_unlock(&bms->rib_table_mutex[(afi * SAFI_MAX) + safi]);
+  else bgp_rib_unlock(bms);
+}
+
 /* Free bgp route information. */
 void bgp_info_free(struct bgp_peer *peer, struct bgp_info *ri)
 {
+  struct bgp_misc_structs *bms = bgp_select_misc_db(peer->type);
+
   if (ri->attr)
     bgp_attr_unintern(peer, ri->attr);
 
   bgp_info_extra_free(peer, &ri->extra);
 
   ri->peer->lock--;
-  free(ri);
+
+  /* shared entries are variable-sized, see bgp_info_shared_new() */
+  if (bms && bms->table_shared_paths) bgp_rcu_free(ri, NULL);
+  else bgp_slab_retire(ri);
 }
 
 /* Initialization of attributes */
@@ -370,41 +564,55 @@ struct bgp_attr *bgp_attr_intern(struct bgp_peer *peer, struct bgp_attr *attr)
 {
   struct bgp_rt_structs *inter_domain_routing_db;
   struct bgp_attr *find;
+  pthread_mutex_t *lock;
 
   if (!peer) return NULL;
 
   inter_domain_routing_db = bgp_select_routing_db(peer->type);
 
   if (!inter_domain_routing_db) return NULL;
+
+  /* Already interned, the caller holding a reference: just one more */
+  if (__atomic_load_n(&attr->refcnt, __ATOMIC_RELAXED)) {
+    if (attr->aspath) __atomic_add_fetch(&attr->aspath->refcnt, 1, __ATOMIC_RELAXED);
+    if (attr->community) __atomic_add_fetch(&attr->community->refcnt, 1, __ATOMIC_RELAXED);
+    if (attr->ecommunity) __atomic_add_fetch(&attr->ecommunity->refcnt, 1, __ATOMIC_RELAXED);
+    if (attr->lcommunity) __atomic_add_fetch(&attr->lcommunity->refcnt, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&attr->refcnt, 1, __ATOMIC_RELAXED);
+
+    return attr;
+  }
  
   /* Intern referenced strucutre. */
   if (attr->aspath) {
-    if (! attr->aspath->refcnt)
+    if (! __atomic_load_n(&attr->aspath->refcnt, __ATOMIC_RELAXED))
       attr->aspath = aspath_intern(peer, attr->aspath);
   else
-    attr->aspath->refcnt++;
+    __atomic_add_fetch(&attr->aspath->refcnt, 1, __ATOMIC_RELAXED);
   }
   if (attr->community) {
-    if (! attr->community->refcnt)
+    if (! __atomic_load_n(&attr->community->refcnt, __ATOMIC_RELAXED))
       attr->community = community_intern(peer, attr->community);
     else
-      attr->community->refcnt++;
+      __atomic_add_fetch(&attr->community->refcnt, 1, __ATOMIC_RELAXED);
   }
   if (attr->ecommunity) {
-    if (!attr->ecommunity->refcnt)
+    if (! __atomic_load_n(&attr->ecommunity->refcnt, __ATOMIC_RELAXED))
       attr->ecommunity = ecommunity_intern(peer, attr->ecommunity);
   else
-    attr->ecommunity->refcnt++;
+    __atomic_add_fetch(&attr->ecommunity->refcnt, 1, __ATOMIC_RELAXED);
   }
   if (attr->lcommunity) {
-    if (!attr->lcommunity->refcnt)
+    if (! __atomic_load_n(&attr->lcommunity->refcnt, __ATOMIC_RELAXED))
       attr->lcommunity = lcommunity_intern(peer, attr->lcommunity);
   else
-    attr->lcommunity->refcnt++;
+    __atomic_add_fetch(&attr->lcommunity->refcnt, 1, __ATOMIC_RELAXED);
   }
  
+  lock = hash_lock(inter_domain_routing_db->attrhash, attr);
   find = (struct bgp_attr *) hash_get(peer, inter_domain_routing_db->attrhash, attr, bgp_attr_hash_alloc);
-  find->refcnt++;
+  __atomic_add_fetch(&find->refcnt, 1, __ATOMIC_RELAXED);
+  hash_unlock(lock);
 
   return find;
 }
@@ -419,6 +627,7 @@ void bgp_attr_unintern(struct bgp_peer *peer, struct bgp_attr *attr)
   struct community *community;
   struct ecommunity *ecommunity = NULL;
   struct lcommunity *lcommunity = NULL;
+  pthread_mutex_t *lock;
 
   if (!peer) return;
 
@@ -427,21 +636,24 @@ void bgp_attr_unintern(struct bgp_peer *peer, struct bgp_attr *attr)
 
   if (!inter_domain_routing_db || !bms) return;
  
-  /* Decrement attribute reference. */
-  attr->refcnt--;
   aspath = attr->aspath;
   community = attr->community;
   ecommunity = attr->ecommunity;
   lcommunity = attr->lcommunity;
 
-  /* If reference becomes zero then free attribute object. */
-  if (attr->refcnt == 0) {
+  lock = hash_lock(inter_domain_routing_db->attrhash, attr);
+
+  /* Decrement attribute reference. If reference becomes zero then
+     free attribute object. */
+  if (__atomic_sub_fetch(&attr->refcnt, 1, __ATOMIC_ACQ_REL) == 0) {
     ret = (struct bgp_attr *) hash_release(inter_domain_routing_db->attrhash, attr);
     // assert (ret != NULL);
     if (!ret) Log(LOG_INFO, "INFO ( %s/%s ): bgp_attr_unintern() hash lookup failed.\n", config.name, bms->log_str);
-    free(attr);
+    bgp_rcu_free(attr, bgp_slab_free);
   }
 
+  hash_unlock(lock);
+
   /* aspath refcount shoud be decrement. */
   if (aspath)
     aspath_unintern(peer, aspath);
@@ -458,16 +670,10 @@ void *bgp_attr_hash_alloc(void *p)
   struct bgp_attr *val = (struct bgp_attr *) p;
   struct bgp_attr *attr;
 
-  attr = malloc(sizeof (struct bgp_attr));
-  if (!attr) {
-    Log(LOG_ERR, "ERROR ( %s/core/BGP ): malloc() failed (bgp_attr_hash_alloc). Exiting ..\n", config.name); // XXX
-    exit_gracefully(1);
-  }
-  else {
-    memset(attr, 0, sizeof (struct bgp_attr));
-    memcpy(attr, val, sizeof (struct bgp_attr));
-    attr->refcnt = 0;
-  }
+  attr = bgp_slab_alloc(&bgp_attr_slab);
+  memset(attr, 0, sizeof (struct bgp_attr));
+  memcpy(attr, val, sizeof (struct bgp_attr));
+  attr->refcnt = 0;
 
   return attr;
 }
@@ -631,6 +837,9 @@ void bgp_peer_close(struct bgp_peer *peer, int type, int no_quiet, int send_noti
 
   free(peer->buf.base);
 
+  bgp_dump_journal_free(peer);
+  peer->dump_seen = FALSE;
+
   if (bms->neighbors_file)
     write_neighbors_file(bms->neighbors_file, peer->type);
 }
@@ -735,12 +944,21 @@ void bgp_peer_info_delete(struct bgp_peer *peer)
 
   if (!inter_domain_routing_db) return;
 
+  /* routes are unlinked one by one, arenas are then retired in bulk */
+  bgp_slab_drain(peer->info_slab);
+  bgp_slab_drain(peer->info_extra_slab);
+
   for (afi = AFI_IP; afi < AFI_MAX; afi++) {
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
       table = inter_domain_routing_db->rib[afi][safi];
       bgp_table_info_delete(peer, table, afi, safi);
     }
   }
+
+  bgp_slab_release(peer->info_slab);
+  bgp_slab_release(peer->info_extra_slab);
+  peer->info_slab = NULL;
+  peer->info_extra_slab = NULL;
 }
 
 void bgp_table_info_delete(struct bgp_peer *peer, struct bgp_table *table, afi_t afi, safi_t safi)
@@ -761,11 +979,12 @@ void bgp_table_info_delete(struct bgp_peer *peer, struct bgp_table *table, afi_t
 
     for (peer_buckets = 0; peer_buckets < bms->table_per_peer_buckets; peer_buckets++) {
       for (ri = node->info[modulo + peer_buckets]; ri; ri = ri_next) {
-	if (ri->peer == peer) {
+	if (bgp_info_peer_match(ri, peer)) {
 	  if (bms->msglog_backend_methods) {
 	    char event_type[] = "log";
+	    struct bgp_info ri_view;
 
-	    bgp_peer_log_msg(node, ri, afi, safi, event_type, bms->msglog_output, NULL, BGP_LOG_TYPE_DELETE);
+	    bgp_peer_log_msg(node, bgp_info_peer_view(ri, peer, &ri_view), afi, safi, event_type, bms->msglog_output, NULL, BGP_LOG_TYPE_DELETE);
 	  }
 
 	  ri_next = ri->next; /* let's save pointer to next before free up */
@@ -1373,6 +1592,8 @@ void bgp_link_misc_structs(struct bgp_misc_structs *bms)
   bms->table_per_peer_buckets = config.bgp_table_per_peer_buckets;
   bms->table_attr_hash_buckets = config.bgp_table_attr_hash_buckets;
   bms->table_per_peer_hash = config.bgp_table_per_peer_hash;
+  bms->table_shared_paths = config.bgp_table_shared_paths;
+  bms->dump_checkpoint = config.bgp_table_dump_checkpoint;
   bms->route_info_modulo = bgp_route_info_modulo;
   bms->bgp_lookup_find_peer = bgp_lookup_find_bgp_peer;
   bms->bgp_lookup_node_match_cmp = bgp_lookup_node_match_cmp_bgp;
@@ -1471,6 +1692,9 @@ int bgp_router_id_check(struct bgp_msg_data *bmd)
   peers_check = bms->peers;
 
   for (; peers_check_idx < bms->max_peers; peers_check_idx++) {
+    /* a stale twin is let go on End-of-RIB, see bgp_snapshot_eor() */
+    if (peers_check[peers_check_idx].stale) continue;
+
     if (peers_check_idx != peer->idx && !memcmp(&peers_check[peers_check_idx].id, &peer->id, sizeof(peers_check[peers_check_idx].id))) {
       char bgp_peer_str[INET6_ADDRSTRLEN];
 
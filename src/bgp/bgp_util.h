@@ -55,8 +55,18 @@ extern struct bgp_info_extra *bgp_info_extra_get(struct bgp_info *);
 extern struct bgp_info_extra *bgp_info_extra_process(struct bgp_peer *, struct bgp_info *, safi_t, path_id_t *, rd_t *, u_char *);
 
 extern struct bgp_info *bgp_info_new(struct bgp_peer *);
+extern struct bgp_info *bgp_info_shared_new(struct bgp_peer *);
+extern void bgp_info_share(struct bgp_peer *, struct bgp_info *);
+extern int bgp_info_unshare(struct bgp_peer *, struct bgp_info *);
+extern int bgp_info_peer_match(struct bgp_info *, struct bgp_peer *);
+extern struct bgp_info *bgp_info_peer_view(struct bgp_info *, struct bgp_peer *, struct bgp_info *);
 extern void bgp_info_add(struct bgp_peer *, struct bgp_node *, struct bgp_info *, u_int32_t);
 extern void bgp_info_delete(struct bgp_peer *, struct bgp_node *, struct bgp_info *, u_int32_t);
+extern void bgp_peer_rib_gen_bump(struct bgp_peer *);
+extern void bgp_rib_lock(struct bgp_misc_structs *);
+extern void bgp_rib_unlock(struct bgp_misc_structs *);
+extern void bgp_rib_table_lock(struct bgp_misc_structs *, afi_t, safi_t);
+extern void bgp_rib_table_unlock(struct bgp_misc_structs *, afi_t, safi_t);
 extern void bgp_info_free(struct bgp_peer *, struct bgp_info *);
 extern void bgp_attr_init(int, struct bgp_rt_structs *);
 extern struct bgp_attr *bgp_attr_intern(struct bgp_peer *, struct bgp_attr *);
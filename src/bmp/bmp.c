@@ -26,6 +26,7 @@
 #include "bmp.h"
 #include "rpki/rpki.h"
 #include "thread_pool.h"
+#include "evloop.h"
 #if defined WITH_RABBITMQ
 #include "amqp_common.h"
 #endif
@@ -58,7 +59,6 @@ void nfacctd_bmp_wrapper()
 void skinny_bmp_daemon()
 {
   int ret, rc, peers_idx, allowed, yes=1;
-  int peers_idx_rr = 0, max_peers_idx = 0;
   u_int32_t pkt_remaining_len=0;
   time_t now;
   afi_t afi;
@@ -75,9 +75,9 @@ void skinny_bmp_daemon()
 
   sigset_t signal_set;
 
-  /* select() stuff */
-  fd_set read_descs, bkp_read_descs;
-  int fd, select_fd, bkp_select_fd, recalc_fds, select_num;
+  /* event loop stuff */
+  struct pm_evloop bmp_evloop;
+  int fd, select_num, reads;
 
   /* logdump time management */
   time_t dump_refresh_deadline = {0};
@@ -87,6 +87,7 @@ void skinny_bmp_daemon()
   /* initial cleanups */
   reload_map_bmp_thread = FALSE;
   reload_log_bmp_thread = FALSE;
+  print_stats_bmp_thread = FALSE;
   memset(&server, 0, sizeof(server));
   memset(&client, 0, sizeof(client));
   memset(&allow, 0, sizeof(struct hosts_table));
@@ -150,6 +151,12 @@ void skinny_bmp_daemon()
       Log(LOG_ERR, "ERROR ( %s/%s ): bmp_dump_file, bmp_dump_amqp_routing_key and bmp_dump_kafka_topic are mutually exclusive. Terminating thread.\n", config.name, bmp_misc_db->log_str);
       exit_gracefully(1);
     }
+
+    /* writers would overwrite each other's files */
+    if (config.bmp_dump_workers > 1 && config.bmp_dump_file && !strstr(config.bmp_dump_file, "$bmp_router")) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): bmp_dump_workers requires $bmp_router in bmp_dump_file. Forced to 1.\n", config.name, bmp_misc_db->log_str);
+      config.bmp_dump_workers = 1;
+    }
   }
 
   if (bmp_misc_db->msglog_backend_methods || bmp_misc_db->dump_backend_methods)
@@ -270,9 +277,10 @@ void skinny_bmp_daemon()
   }
 
   /* Preparing for syncronous I/O multiplexing */
-  select_fd = 0;
-  FD_ZERO(&bkp_read_descs);
-  FD_SET(config.bmp_sock, &bkp_read_descs);
+  if (pm_evloop_init(&bmp_evloop) == ERR || pm_evloop_add(&bmp_evloop, config.bmp_sock, NULL, PM_EVLOOP_LEVEL) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): unable to set up the event loop. Terminating thread.\n", config.name, bmp_misc_db->log_str);
+    exit_gracefully(1);
+  }
 
   {
     char srv_string[INET6_ADDRSTRLEN];
@@ -291,6 +299,7 @@ void skinny_bmp_daemon()
   for (afi = AFI_IP; afi < AFI_MAX; afi++) {
     for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
       bmp_routing_db->rib[afi][safi] = bgp_table_init(afi, safi);
+      if (config.bgp_table_lpm_index) bgp_lpm_init(bmp_routing_db->rib[afi][safi]);
     }
   }
 
@@ -510,9 +519,6 @@ void skinny_bmp_daemon()
 #endif
     }
 
-  select_fd = bkp_select_fd = (config.bmp_sock + 1);
-  recalc_fds = FALSE;
-
   bmp_link_misc_structs(bmp_misc_db);
 
   sigemptyset(&signal_set);
@@ -531,24 +537,6 @@ void skinny_bmp_daemon()
       sigprocmask(SIG_BLOCK, &signal_set, NULL);
     }
 
-    if (recalc_fds) {
-      select_fd = config.bmp_sock;
-      max_peers_idx = -1; /* .. since valid indexes include 0 */
-
-      for (peers_idx = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
-        if (select_fd < bmp_peers[peers_idx].self.fd) select_fd = bmp_peers[peers_idx].self.fd;
-        if (bmp_peers[peers_idx].self.fd) max_peers_idx = peers_idx;
-      }
-      select_fd++;
-      max_peers_idx++;
-
-      bkp_select_fd = select_fd;
-      recalc_fds = FALSE;
-    }
-    else select_fd = bkp_select_fd;
-
-    memcpy(&read_descs, &bkp_read_descs, sizeof(bkp_read_descs));
-
     if (bmp_misc_db->dump_backend_methods) {
       int delta;
 
@@ -559,7 +547,14 @@ void skinny_bmp_daemon()
     }
     else drt_ptr = NULL;
 
-    select_num = select(select_fd, &read_descs, NULL, NULL, drt_ptr);
+    /* RIB memory retired while collectors were looking: come back for it */
+    if (bgp_rcu_reclaim() && !drt_ptr) {
+      dump_refresh_timeout.tv_sec = BGP_RCU_RECLAIM_INTERVAL;
+      dump_refresh_timeout.tv_usec = 0;
+      drt_ptr = &dump_refresh_timeout;
+    }
+
+    select_num = pm_evloop_wait(&bmp_evloop, drt_ptr);
     if (select_num < 0) goto select_again;
 
     if (reload_map_bmp_thread) {
@@ -581,6 +576,11 @@ void skinny_bmp_daemon()
       reload_log_bmp_thread = FALSE;
     }
 
+    if (print_stats_bmp_thread) {
+      bgp_slab_stats_log(bmp_misc_db->log_str);
+      print_stats_bmp_thread = FALSE;
+    }
+
     if (bmp_misc_db->msglog_backend_methods || bmp_misc_db->dump_backend_methods) {
       gettimeofday(&bmp_misc_db->log_tstamp, NULL);
       compose_timestamp(bmp_misc_db->log_tstamp_str, SRVBUFLEN, &bmp_misc_db->log_tstamp, TRUE,
@@ -631,18 +631,22 @@ void skinny_bmp_daemon()
     }
 
     /* 
-       If select_num == 0 then we got out of select() due to a timeout rather
+       If select_num == 0 then we got out of the wait due to a timeout rather
        than because we had a message from a peer to handle. By now we did all
-       routine checks and can happily return to select() again.
+       routine checks and can happily return to waiting again.
     */
     if (!select_num) goto select_again;
 
+    next_event:
+    fd = pm_evloop_next(&bmp_evloop, (void **) &bmpp);
+    if (fd == ERR) goto select_again;
+
     /* New connection is coming in */
-    if (FD_ISSET(config.bmp_sock, &read_descs)) {
+    if (fd == config.bmp_sock) {
       int peers_check_idx, peers_num;
 
       fd = accept(config.bmp_sock, (struct sockaddr *) &client, &clen);
-      if (fd == ERR) goto read_data;
+      if (fd == ERR) goto next_event;
 
       ipv4_mapped_to_ipv4(&client);
 
@@ -652,7 +656,7 @@ void skinny_bmp_daemon()
 
       if (!allowed) {
 	close(fd);
-	goto read_data;
+	goto next_event;
       }
 
       for (peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
@@ -673,7 +677,6 @@ void skinny_bmp_daemon()
 	      peer = NULL;
 	      bmpp = NULL;
 	    }
-            else recalc_fds = TRUE;
 
             log_notification_unset(&log_notifications.bgp_peers_throttling);
 
@@ -692,7 +695,7 @@ void skinny_bmp_daemon()
             }
 
             close(fd);
-            goto read_data;
+            goto next_event;
           }
         }
       }
@@ -702,11 +705,10 @@ void skinny_bmp_daemon()
         Log(LOG_ERR, "ERROR ( %s/%s ): Insufficient number of BMP peers has been configured by 'bmp_daemon_max_peers' (%d).\n",
                         config.name, bmp_misc_db->log_str, config.nfacctd_bmp_max_peers);
         close(fd);
-        goto read_data;
+        goto next_event;
       }
 
       peer->fd = fd;
-      FD_SET(peer->fd, &bkp_read_descs);
       peer->addr.family = ((struct sockaddr *)&client)->sa_family;
       if (peer->addr.family == AF_INET) {
         peer->addr.address.ipv4.s_addr = ((struct sockaddr_in *)&client)->sin_addr.s_addr;
@@ -725,6 +727,11 @@ void skinny_bmp_daemon()
       if (bmp_misc_db->dump_backend_methods)
 	bmp_dump_init_peer(peer);
 
+      if (pm_evloop_add(&bmp_evloop, peer->fd, bmpp, PM_EVLOOP_EDGE) == ERR) {
+	bmp_peer_close(bmpp, FUNC_TYPE_BMP);
+	goto next_event;
+      }
+
       /* Check: multiple TCP connections per peer */
       for (peers_check_idx = 0, peers_num = 0; peers_check_idx < config.nfacctd_bmp_max_peers; peers_check_idx++) {
         if (peers_idx != peers_check_idx && !memcmp(&bmp_peers[peers_check_idx].self.addr, &peer->addr, sizeof(bmp_peers[peers_check_idx].self.addr))) {
@@ -739,46 +746,42 @@ void skinny_bmp_daemon()
       }
 
       Log(LOG_INFO, "INFO ( %s/%s ): [%s] BMP peers usage: %u/%u\n", config.name, bmp_misc_db->log_str, peer->addr_str, peers_num, config.nfacctd_bmp_max_peers);
-    }
 
-    read_data:
+      goto next_event;
+    }
 
     /*
-       We have something coming in: let's lookup which peer is that.
-       FvD: To avoid starvation of the "later established" peers, we
-       offset the start of the search in a round-robin style.
+       We have something coming in from a peer: sockets are edge-triggered
+       hence we read until there is nothing left or, to avoid starvation of
+       other peers, PM_EVLOOP_READS_MAX times; in this case the peer is
+       served again in the next round.
     */
-    for (peer = NULL, peers_idx = 0; peers_idx < max_peers_idx; peers_idx++) {
-      int loc_idx = (peers_idx + peers_idx_rr) % max_peers_idx;
-
-      if (bmp_peers[loc_idx].self.fd && FD_ISSET(bmp_peers[loc_idx].self.fd, &read_descs)) {
-        peer = &bmp_peers[loc_idx].self;
-	bmpp = &bmp_peers[loc_idx];
-        peers_idx_rr = (peers_idx_rr + 1) % max_peers_idx;
-        break;
-      }
-    }
+    peer = &bmpp->self;
 
-    if (!peer) goto select_again;
+    for (reads = 0; reads < PM_EVLOOP_READS_MAX; reads++) {
+      ret = recv(peer->fd, &peer->buf.base[peer->buf.truncated_len], (peer->buf.len - peer->buf.truncated_len), MSG_DONTWAIT);
+      if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) goto next_event;
 
-    ret = recv(peer->fd, &peer->buf.base[peer->buf.truncated_len], (peer->buf.len - peer->buf.truncated_len), 0);
-    peer->msglen = (ret + peer->buf.truncated_len);
+      peer->msglen = (ret + peer->buf.truncated_len);
 
-    if (ret <= 0) {
-      Log(LOG_INFO, "INFO ( %s/%s ): [%s] BMP connection reset by peer (%d).\n", config.name, bmp_misc_db->log_str, peer->addr_str, errno);
-      FD_CLR(peer->fd, &bkp_read_descs);
-      bmp_peer_close(bmpp, FUNC_TYPE_BMP);
-      recalc_fds = TRUE;
-      goto select_again;
-    }
-    else {
-      pkt_remaining_len = bmp_process_packet(peer->buf.base, peer->msglen, bmpp);
+      if (ret <= 0) {
+        Log(LOG_INFO, "INFO ( %s/%s ): [%s] BMP connection reset by peer (%d).\n", config.name, bmp_misc_db->log_str, peer->addr_str, errno);
+        pm_evloop_del(&bmp_evloop, peer->fd);
+        bmp_peer_close(bmpp, FUNC_TYPE_BMP);
+        goto next_event;
+      }
+      else {
+        pkt_remaining_len = bmp_process_packet(peer->buf.base, peer->msglen, bmpp);
 
-      /* handling offset for TCP segment reassembly */
-      if (pkt_remaining_len) peer->buf.truncated_len = bmp_packet_adj_offset(peer->buf.base, peer->buf.len, peer->msglen,
-									     pkt_remaining_len, peer->addr_str);
-      else peer->buf.truncated_len = 0;
+        /* handling offset for TCP segment reassembly */
+        if (pkt_remaining_len) peer->buf.truncated_len = bmp_packet_adj_offset(peer->buf.base, peer->buf.len, peer->msglen,
+									       pkt_remaining_len, peer->addr_str);
+        else peer->buf.truncated_len = 0;
+      }
     }
+
+    pm_evloop_again(&bmp_evloop, fd);
+    goto next_event;
   }
 }
 
@@ -981,12 +981,13 @@ void bmp_dump_se_ll_destroy(struct bmp_dump_se_ll *bdsell)
   bdsell->last = NULL;
 }
 
-void bmp_handle_dump_event()
+/* 'writer' out of 'writers' forked by bmp_handle_dump_event(), never returns */
+static void bmp_dump_writer(int writer, int writers, u_int64_t dump_seqno)
 {
   struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BMP);
   char current_filename[SRVBUFLEN], last_filename[SRVBUFLEN], tmpbuf[SRVBUFLEN];
   char latest_filename[SRVBUFLEN], event_type[] = "dump", *fd_buf = NULL;
-  int ret, peers_idx, duration, tables_num;
+  int peers_idx, peers_num, duration, tables_num;
   struct bgp_rt_structs *inter_domain_routing_db;
   struct bgp_table *table;
   struct bgp_node *node;
@@ -994,277 +995,298 @@ void bmp_handle_dump_event()
   safi_t safi;
   pid_t dumper_pid;
   time_t start;
-  u_int64_t dump_elems = 0, dump_seqno;
+  u_int64_t dump_elems = 0;
 
   struct bgp_peer *peer, *saved_peer;
   struct bmp_dump_se_ll *bdsell;
   struct bgp_peer_log peer_log;      
 
-  /* pre-flight check */
-  if (!bms->dump_backend_methods || !config.bmp_dump_refresh_time)
-    return;
-
-  /* Sequencing the dump event */
-  dump_seqno = bgp_peer_log_seq_get(&bms->log_seq);
-  bgp_peer_log_seq_increment(&bms->log_seq);
-
-  switch (ret = fork()) {
-  case 0: /* Child */
-    /* we have to ignore signals to avoid loops: because we are already forked */
-    signal(SIGINT, SIG_IGN);
-    signal(SIGHUP, SIG_IGN);
-    pm_setproctitle("%s %s [%s]", config.type, "Core Process -- BMP Dump Writer", config.name);
-    config.is_forked = TRUE;
+  /* we have to ignore signals to avoid loops: because we are already forked */
+  signal(SIGINT, SIG_IGN);
+  signal(SIGHUP, SIG_IGN);
+  pm_setproctitle("%s %s [%s]", config.type, "Core Process -- BMP Dump Writer", config.name);
+  config.is_forked = TRUE;
 
-    memset(last_filename, 0, sizeof(last_filename));
-    memset(current_filename, 0, sizeof(current_filename));
+  memset(last_filename, 0, sizeof(last_filename));
+  memset(current_filename, 0, sizeof(current_filename));
 
-    fd_buf = malloc(OUTPUT_FILE_BUFSZ);
-    bgp_peer_log_seq_set(&bms->log_seq, dump_seqno);
+  fd_buf = malloc(OUTPUT_FILE_BUFSZ);
+  bgp_peer_log_seq_set(&bms->log_seq, dump_seqno);
 
 #ifdef WITH_RABBITMQ
-    if (config.bmp_dump_amqp_routing_key) {
-      bmp_dump_init_amqp_host();
-      ret = p_amqp_connect_to_publish(&bmp_dump_amqp_host);
-      if (ret) exit_gracefully(ret);
-    }
+  if (config.bmp_dump_amqp_routing_key) {
+    int ret;
+
+    bmp_dump_init_amqp_host();
+    ret = p_amqp_connect_to_publish(&bmp_dump_amqp_host);
+    if (ret) exit_gracefully(ret);
+  }
 #endif
 
 #ifdef WITH_KAFKA
-    if (config.bmp_dump_kafka_topic) {
-      ret = bmp_dump_init_kafka_host();
-      if (ret) exit_gracefully(ret);
-    }
+  if (config.bmp_dump_kafka_topic) {
+    int ret;
+
+    ret = bmp_dump_init_kafka_host();
+    if (ret) exit_gracefully(ret);
+  }
 #endif
 
-    dumper_pid = getpid();
-    Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BMP tables - START (PID: %u) ***\n", config.name, bms->log_str, dumper_pid);
-    start = time(NULL);
-    tables_num = 0;
+  dumper_pid = getpid();
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BMP tables - START (PID: %u) ***\n", config.name, bms->log_str, dumper_pid);
+  start = time(NULL);
+  tables_num = 0;
 
 #ifdef WITH_SERDES
-    if (config.bmp_dump_kafka_avro_schema_registry) {
-      if (strchr(config.bmp_dump_kafka_topic, '$')) {
-	Log(LOG_ERR, "ERROR ( %s/%s ): dynamic 'bmp_dump_kafka_topic' is not compatible with 'bmp_dump_kafka_avro_schema_registry'. Exiting.\n",
-	    config.name, bms->log_str);
-	exit_gracefully(1);
-      }
-
-      bmp_dump_kafka_host.sd_schema[BMP_MSG_ROUTE_MONITOR] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_MSG_ROUTE_MONITOR],
-											     "bmp", "dump_rm",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_MSG_STATS] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_MSG_STATS],
-											     "bmp", "stats",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_MSG_PEER_UP] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_MSG_PEER_UP],
-											     "bmp", "peer_up",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_MSG_PEER_DOWN] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_MSG_PEER_DOWN],
-											     "bmp", "peer_down",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_MSG_INIT] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_MSG_INIT],
-											     "bmp", "init",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_MSG_TERM] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_MSG_TERM],
-											     "bmp", "term",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_LOG_TYPE_DUMPINIT] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_LOG_TYPE_DUMPINIT],
-											     "bmp", "dumpinit",
-											     config.bmp_dump_kafka_avro_schema_registry);
-
-      bmp_dump_kafka_host.sd_schema[BMP_LOG_TYPE_DUMPCLOSE] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
-											     bmp_misc_db->dump_avro_schema[BMP_LOG_TYPE_DUMPCLOSE],
-											     "bmp", "dumpclose",
-											     config.bmp_dump_kafka_avro_schema_registry);
+  if (config.bmp_dump_kafka_avro_schema_registry) {
+    if (strchr(config.bmp_dump_kafka_topic, '$')) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): dynamic 'bmp_dump_kafka_topic' is not compatible with 'bmp_dump_kafka_avro_schema_registry'. Exiting.\n",
+	  config.name, bms->log_str);
+      exit_gracefully(1);
     }
+
+    bmp_dump_kafka_host.sd_schema[BMP_MSG_ROUTE_MONITOR] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_MSG_ROUTE_MONITOR],
+											   "bmp", "dump_rm",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_MSG_STATS] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_MSG_STATS],
+											   "bmp", "stats",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_MSG_PEER_UP] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_MSG_PEER_UP],
+											   "bmp", "peer_up",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_MSG_PEER_DOWN] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_MSG_PEER_DOWN],
+											   "bmp", "peer_down",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_MSG_INIT] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_MSG_INIT],
+											   "bmp", "init",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_MSG_TERM] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_MSG_TERM],
+											   "bmp", "term",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_LOG_TYPE_DUMPINIT] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_LOG_TYPE_DUMPINIT],
+											   "bmp", "dumpinit",
+											   config.bmp_dump_kafka_avro_schema_registry);
+
+    bmp_dump_kafka_host.sd_schema[BMP_LOG_TYPE_DUMPCLOSE] = compose_avro_schema_registry_name_2(config.bmp_dump_kafka_topic, FALSE,
+											   bmp_misc_db->dump_avro_schema[BMP_LOG_TYPE_DUMPCLOSE],
+											   "bmp", "dumpclose",
+											   config.bmp_dump_kafka_avro_schema_registry);
+  }
 #endif
 
-    for (peer = NULL, saved_peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
-      if (bmp_peers[peers_idx].self.fd) {
-        peer = &bmp_peers[peers_idx].self;
-        peer->log = &peer_log; /* abusing struct bgp_peer a bit, but we are in a child */
-	bdsell = peer->bmp_se;
+  for (peer = NULL, saved_peer = NULL, peers_idx = 0, peers_num = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
+    if (bmp_peers[peers_idx].self.fd) {
+      if ((peers_num++ % writers) != writer) continue;
 
-        if (config.bmp_dump_file) {
-	  bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bmp_dump_file, peer);
-	}
+      peer = &bmp_peers[peers_idx].self;
+      peer->log = &peer_log; /* abusing struct bgp_peer a bit, but we are in a child */
+      bdsell = peer->bmp_se;
 
-        if (config.bmp_dump_amqp_routing_key) {
-	  bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bmp_dump_amqp_routing_key, peer);
-	}
+      if (config.bmp_dump_file) {
+	bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bmp_dump_file, peer);
+      }
 
-        if (config.bmp_dump_kafka_topic) {
-	  bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bmp_dump_kafka_topic, peer);
-	}
+      if (config.bmp_dump_amqp_routing_key) {
+	bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bmp_dump_amqp_routing_key, peer);
+      }
 
-        pm_strftime_same(current_filename, SRVBUFLEN, tmpbuf, &bms->dump.tstamp.tv_sec, config.timestamps_utc);
-
-        /*
-	   we close last_filename and open current_filename in case they differ;
-	   we are safe with this approach until time and BMP peer (IP, port) are
-	   the only variables supported as part of bmp_dump_file.
-        */
-        if (config.bmp_dump_file) {
-          if (strcmp(last_filename, current_filename)) {
-	    if (saved_peer && saved_peer->log && strlen(last_filename)) {
-	      close_output_file(saved_peer->log->fd);
-
-	      if (config.bmp_dump_latest_file) {
-	        bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bmp_dump_latest_file, saved_peer);
-	        link_latest_output_file(latest_filename, last_filename);
-	      }
+      if (config.bmp_dump_kafka_topic) {
+	bgp_peer_log_dynname(current_filename, SRVBUFLEN, config.bmp_dump_kafka_topic, peer);
+      }
+
+      pm_strftime_same(current_filename, SRVBUFLEN, tmpbuf, &bms->dump.tstamp.tv_sec, config.timestamps_utc);
+
+      /*
+	 we close last_filename and open current_filename in case they differ;
+	 we are safe with this approach until time and BMP peer (IP, port) are
+	 the only variables supported as part of bmp_dump_file.
+      */
+      if (config.bmp_dump_file) {
+	if (strcmp(last_filename, current_filename)) {
+	  if (saved_peer && saved_peer->log && strlen(last_filename)) {
+	    close_output_file(saved_peer->log->fd);
+
+	    if (config.bmp_dump_latest_file) {
+	      bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bmp_dump_latest_file, saved_peer);
+	      link_latest_output_file(latest_filename, last_filename);
 	    }
-            peer->log->fd = open_output_file(current_filename, "w", TRUE);
-            if (fd_buf) {
-              if (setvbuf(peer->log->fd, fd_buf, _IOFBF, OUTPUT_FILE_BUFSZ))
-		Log(LOG_WARNING, "WARN ( %s/%s ): [%s] setvbuf() failed: %s\n", config.name, bms->log_str, current_filename, strerror(errno));
-              else memset(fd_buf, 0, OUTPUT_FILE_BUFSZ);
-            }
-          }
-        }
-
-        /*
-          a bit pedantic maybe but should come at little cost and emulating
-          bmp_dump_file behaviour will work
-        */
+	  }
+	  peer->log->fd = open_output_file(current_filename, "w", TRUE);
+	  if (fd_buf) {
+	    if (setvbuf(peer->log->fd, fd_buf, _IOFBF, OUTPUT_FILE_BUFSZ))
+	      Log(LOG_WARNING, "WARN ( %s/%s ): [%s] setvbuf() failed: %s\n", config.name, bms->log_str, current_filename, strerror(errno));
+	    else memset(fd_buf, 0, OUTPUT_FILE_BUFSZ);
+	  }
+	}
+      }
+
+      /*
+	a bit pedantic maybe but should come at little cost and emulating
+	bmp_dump_file behaviour will work
+      */
 #ifdef WITH_RABBITMQ
-        if (config.bmp_dump_amqp_routing_key) {
-          peer->log->amqp_host = &bmp_dump_amqp_host;
-          strcpy(peer->log->filename, current_filename);
-        }
+      if (config.bmp_dump_amqp_routing_key) {
+	peer->log->amqp_host = &bmp_dump_amqp_host;
+	strcpy(peer->log->filename, current_filename);
+      }
 #endif
 
 #ifdef WITH_KAFKA
-        if (config.bmp_dump_kafka_topic) {
-          peer->log->kafka_host = &bmp_dump_kafka_host;
-          strcpy(peer->log->filename, current_filename);
-        }
+      if (config.bmp_dump_kafka_topic) {
+	peer->log->kafka_host = &bmp_dump_kafka_host;
+	strcpy(peer->log->filename, current_filename);
+      }
 #endif
 
-	bgp_peer_dump_init(peer, config.bmp_dump_output, FUNC_TYPE_BMP);
-	inter_domain_routing_db = bgp_select_routing_db(FUNC_TYPE_BMP);
-        dump_elems = 0;
-
-        if (!inter_domain_routing_db) return;
-
-        for (afi = AFI_IP; afi < AFI_MAX; afi++) {
-          for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
-            table = inter_domain_routing_db->rib[afi][safi];
-            node = bgp_table_top(peer, table);
-
-            while (node) {
-              u_int32_t modulo = bms->route_info_modulo(peer, NULL, bms->table_per_peer_buckets);
-              u_int32_t peer_buckets;
-              struct bgp_info *ri;
-
-              for (peer_buckets = 0; peer_buckets < config.bmp_table_per_peer_buckets; peer_buckets++) {
-                for (ri = node->info[modulo+peer_buckets]; ri; ri = ri->next) {
-		  struct bmp_peer *local_bmpp = ri->peer->bmp_se;
-
-                  if (local_bmpp && (&local_bmpp->self == peer)) {
-		    char peer_str[] = "peer_ip", *saved_peer_str = bms->peer_str;
-		    char peer_port_str[] = "peer_tcp_port", *saved_peer_port_str = bms->peer_port_str;
-
-		    ri->peer->log = peer->log;
-		    bms->peer_str = peer_str;
-		    bms->peer_port_str = peer_port_str;
-                    bgp_peer_log_msg(node, ri, afi, safi, event_type, config.bmp_dump_output, NULL, BGP_LOG_TYPE_MISC);
-		    bms->peer_str = saved_peer_str;
-		    bms->peer_port_str = saved_peer_port_str;
-                    dump_elems++;
-                  }
-                }
-              }
-
-              node = bgp_route_next(peer, node);
+      bgp_peer_dump_init(peer, config.bmp_dump_output, FUNC_TYPE_BMP);
+      inter_domain_routing_db = bgp_select_routing_db(FUNC_TYPE_BMP);
+      dump_elems = 0;
+
+      if (!inter_domain_routing_db) exit_gracefully(1);
+
+      for (afi = AFI_IP; afi < AFI_MAX; afi++) {
+	for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++) {
+	  table = inter_domain_routing_db->rib[afi][safi];
+	  node = bgp_table_top(peer, table);
+
+	  while (node) {
+	    u_int32_t modulo = bms->route_info_modulo(peer, NULL, bms->table_per_peer_buckets);
+	    u_int32_t peer_buckets;
+	    struct bgp_info *ri;
+
+	    for (peer_buckets = 0; peer_buckets < config.bmp_table_per_peer_buckets; peer_buckets++) {
+	      for (ri = node->info[modulo+peer_buckets]; ri; ri = ri->next) {
+		struct bmp_peer *local_bmpp = ri->peer->bmp_se;
+
+		if (local_bmpp && (&local_bmpp->self == peer)) {
+		  char peer_str[] = "peer_ip", *saved_peer_str = bms->peer_str;
+		  char peer_port_str[] = "peer_tcp_port", *saved_peer_port_str = bms->peer_port_str;
+
+		  ri->peer->log = peer->log;
+		  bms->peer_str = peer_str;
+		  bms->peer_port_str = peer_port_str;
+		  bgp_peer_log_msg(node, ri, afi, safi, event_type, config.bmp_dump_output, NULL, BGP_LOG_TYPE_MISC);
+		  bms->peer_str = saved_peer_str;
+		  bms->peer_port_str = saved_peer_port_str;
+		  dump_elems++;
+		}
+	      }
 	    }
+
+	    node = bgp_route_next(peer, node);
 	  }
 	}
+      }
 
-	if (bdsell && bdsell->start) {
-	  struct bmp_dump_se_ll_elem *se_ll_elem;
-	  char event_type[] = "dump";
-
-	  for (se_ll_elem = bdsell->start; se_ll_elem; se_ll_elem = se_ll_elem->next) {
-	    switch (se_ll_elem->rec.se_type) {
-	    case BMP_LOG_TYPE_STATS:
-	      bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.stats, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_STATS);
-	      break;
-	    case BMP_LOG_TYPE_INIT:
-	      bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.init, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_INIT);
-	      break;
-	    case BMP_LOG_TYPE_TERM:
-	      bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.term, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_TERM);
-	      break;
-	    case BMP_LOG_TYPE_PEER_UP:
-	      bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.peer_up, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_PEER_UP);
-	      break;
-	    case BMP_LOG_TYPE_PEER_DOWN:
-	      bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.peer_down, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_PEER_DOWN);
-	      break;
-	    default:
-	      break;
-	    }
+      if (bdsell && bdsell->start) {
+	struct bmp_dump_se_ll_elem *se_ll_elem;
+	char event_type[] = "dump";
+
+	for (se_ll_elem = bdsell->start; se_ll_elem; se_ll_elem = se_ll_elem->next) {
+	  switch (se_ll_elem->rec.se_type) {
+	  case BMP_LOG_TYPE_STATS:
+	    bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.stats, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_STATS);
+	    break;
+	  case BMP_LOG_TYPE_INIT:
+	    bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.init, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_INIT);
+	    break;
+	  case BMP_LOG_TYPE_TERM:
+	    bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.term, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_TERM);
+	    break;
+	  case BMP_LOG_TYPE_PEER_UP:
+	    bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.peer_up, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_PEER_UP);
+	    break;
+	  case BMP_LOG_TYPE_PEER_DOWN:
+	    bmp_log_msg(peer, &se_ll_elem->rec.bdata, &se_ll_elem->rec.se.peer_down, se_ll_elem->rec.seq, event_type, config.bmp_dump_output, BMP_LOG_TYPE_PEER_DOWN);
+	    break;
+	  default:
+	    break;
 	  }
 	}
- 
-	saved_peer = peer;
-        strlcpy(last_filename, current_filename, SRVBUFLEN);
-        bgp_peer_dump_close(peer, NULL, config.bmp_dump_output, FUNC_TYPE_BMP);
-        tables_num++;
       }
+
+      saved_peer = peer;
+      strlcpy(last_filename, current_filename, SRVBUFLEN);
+      bgp_peer_dump_close(peer, NULL, config.bmp_dump_output, FUNC_TYPE_BMP);
+      tables_num++;
     }
+  }
 
 #ifdef WITH_RABBITMQ
-    if (config.bmp_dump_amqp_routing_key)
-      p_amqp_close(&bmp_dump_amqp_host, FALSE);
+  if (config.bmp_dump_amqp_routing_key)
+    p_amqp_close(&bmp_dump_amqp_host, FALSE);
 #endif
 
 #ifdef WITH_KAFKA
-    if (config.bmp_dump_kafka_topic)
-      p_kafka_close(&bmp_dump_kafka_host, FALSE);
+  if (config.bmp_dump_kafka_topic)
+    p_kafka_close(&bmp_dump_kafka_host, FALSE);
 #endif
 
-    if (config.bmp_dump_latest_file && peer) {
-      bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bmp_dump_latest_file, peer);
-      link_latest_output_file(latest_filename, last_filename);
-    }
+  if (config.bmp_dump_latest_file && peer) {
+    bgp_peer_log_dynname(latest_filename, SRVBUFLEN, config.bmp_dump_latest_file, peer);
+    link_latest_output_file(latest_filename, last_filename);
+  }
+
+  duration = time(NULL)-start;
+  Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BMP tables - END (PID: %u TABLES: %u ENTRIES: %" PRIu64 " ET: %u) ***\n",
+	      config.name, bms->log_str, dumper_pid, tables_num, dump_elems, duration);
+
+  /* figures are process-wide, once is enough */
+  if (!writer) bgp_slab_stats_log(bms->log_str);
+
+  exit_gracefully(0);
+}
+
+void bmp_handle_dump_event()
+{
+  struct bgp_misc_structs *bms = bgp_select_misc_db(FUNC_TYPE_BMP);
+  int writers = (config.bmp_dump_workers ? config.bmp_dump_workers : 1);
+  int ret, peers_idx, writer;
+  u_int64_t dump_seqno;
+
+  struct bgp_peer *peer;
+  struct bmp_dump_se_ll *bdsell;
+
+  /* pre-flight check */
+  if (!bms->dump_backend_methods || !config.bmp_dump_refresh_time)
+    return;
+
+  /* Sequencing the dump event */
+  dump_seqno = bgp_peer_log_seq_get(&bms->log_seq);
+  bgp_peer_log_seq_increment(&bms->log_seq);
 
-    duration = time(NULL)-start;
-    Log(LOG_INFO, "INFO ( %s/%s ): *** Dumping BMP tables - END (PID: %u TABLES: %u ENTRIES: %" PRIu64 " ET: %u) ***\n",
-                config.name, bms->log_str, dumper_pid, tables_num, dump_elems, duration);
+  /* peers are shared round-robin among writers, see bmp_dump_writer() */
+  for (writer = 0; writer < writers; writer++) {
+    ret = fork();
 
-    exit_gracefully(0);
-  default: /* Parent */
-    if (ret == -1) { /* Something went wrong */
+    if (!ret) bmp_dump_writer(writer, writers, dump_seqno); /* Child */
+    else if (ret == -1) { /* Something went wrong */
       Log(LOG_WARNING, "WARN ( %s/%s ): Unable to fork BMP table dump writer: %s\n",
 		config.name, bms->log_str, strerror(errno));
     }
+  }
 
-    /* destroy bmp_se linked-list content after dump event */
-    for (peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
-      if (bmp_peers[peers_idx].self.fd) {
-        peer = &bmp_peers[peers_idx].self;
-        bdsell = peer->bmp_se;
+  /* destroy bmp_se linked-list content after dump event */
+  for (peer = NULL, peers_idx = 0; peers_idx < config.nfacctd_bmp_max_peers; peers_idx++) {
+    if (bmp_peers[peers_idx].self.fd) {
+      peer = &bmp_peers[peers_idx].self;
+      bdsell = peer->bmp_se;
 
-	if (bdsell && bdsell->start) bmp_dump_se_ll_destroy(bdsell);
-      }
+      if (bdsell && bdsell->start) bmp_dump_se_ll_destroy(bdsell);
     }
-
-    break;
   }
 }
 
@@ -34,6 +34,8 @@ static const struct _dictionary_line dictionary[] = {
   {"daemonize", cfg_key_daemonize},
   {"aggregate", cfg_key_aggregate},
   {"aggregate_primitives", cfg_key_aggregate_primitives},
+  {"aggregate_distinct", cfg_key_aggregate_distinct},
+  {"aggregate_distinct_precision", cfg_key_aggregate_distinct_precision},
   {"snaplen", cfg_key_snaplen},
   {"aggregate_filter", cfg_key_aggregate_filter},
   {"promisc", cfg_key_promisc},
@@ -87,6 +89,9 @@ static const struct _dictionary_line dictionary[] = {
   {"imt_buckets", cfg_key_imt_buckets},
   {"imt_mem_pools_number", cfg_key_imt_mem_pools_number},
   {"imt_mem_pools_size", cfg_key_imt_mem_pools_size},
+  {"imt_query_threads", cfg_key_imt_query_threads},
+  {"imt_table_layout", cfg_key_imt_table_layout},
+  {"imt_table_file", cfg_key_imt_table_file},
   {"sql_db", cfg_key_sql_db},
   {"sql_table", cfg_key_sql_table},
   {"sql_table_schema", cfg_key_sql_table_schema},
@@ -118,10 +123,17 @@ static const struct _dictionary_line dictionary[] = {
   {"sql_multi_values", cfg_key_sql_multi_values},
   {"sql_locking_style", cfg_key_sql_locking_style},
   {"sql_use_copy", cfg_key_sql_use_copy},
+  {"sql_use_prepared", cfg_key_sql_use_prepared},
+  {"sql_parallel_writers", cfg_key_sql_parallel_writers},
+  {"sql_upsert_batch", cfg_key_sql_upsert_batch},
+  {"sql_wal", cfg_key_sql_wal},
+  {"sql_wal_checkpoint", cfg_key_sql_wal_checkpoint},
   {"sql_num_protos", cfg_key_num_protos},
   {"sql_num_hosts", cfg_key_num_hosts},
   {"print_refresh_time", cfg_key_sql_refresh_time},
   {"print_cache_entries", cfg_key_print_cache_entries},
+  {"print_cache_spill_dir", cfg_key_print_cache_spill_dir},
+  {"print_cache_memory_max", cfg_key_print_cache_memory_max},
   {"print_markers", cfg_key_print_markers},
   {"print_output", cfg_key_print_output},
   {"print_output_file", cfg_key_print_output_file},
@@ -136,24 +148,34 @@ static const struct _dictionary_line dictionary[] = {
   {"print_history", cfg_key_sql_history},
   {"print_history_offset", cfg_key_sql_history_offset},
   {"print_history_roundoff", cfg_key_sql_history_roundoff},
+  {"print_history_rollup", cfg_key_sql_history_rollup},
   {"print_max_writers", cfg_key_dump_max_writers},
   {"print_preprocess", cfg_key_sql_preprocess},
   {"print_preprocess_type", cfg_key_sql_preprocess_type},
   {"print_startup_delay", cfg_key_sql_startup_delay},
+  {"topk_entries", cfg_key_topk_entries},
+  {"topk_summary_entries", cfg_key_topk_summary_entries},
+  {"topk_sketch_width", cfg_key_topk_sketch_width},
+  {"topk_sketch_depth", cfg_key_topk_sketch_depth},
+  {"topk_metric", cfg_key_topk_metric},
   {"mongo_host", cfg_key_sql_host},
   {"mongo_table", cfg_key_sql_table},
   {"mongo_user", cfg_key_sql_user},
   {"mongo_passwd", cfg_key_sql_passwd},
   {"mongo_refresh_time", cfg_key_sql_refresh_time},
   {"mongo_cache_entries", cfg_key_print_cache_entries},
+  {"mongo_cache_spill_dir", cfg_key_print_cache_spill_dir},
+  {"mongo_cache_memory_max", cfg_key_print_cache_memory_max},
   {"mongo_history", cfg_key_sql_history},
   {"mongo_history_offset", cfg_key_sql_history_offset},
   {"mongo_history_roundoff", cfg_key_sql_history_roundoff},
+  {"mongo_history_rollup", cfg_key_sql_history_rollup},
   {"mongo_time_roundoff", cfg_key_sql_history_roundoff},
   {"mongo_trigger_exec", cfg_key_sql_trigger_exec},
   {"mongo_insert_batch", cfg_key_mongo_insert_batch},
   {"mongo_indexes_file", cfg_key_sql_table_schema},
   {"mongo_max_writers", cfg_key_dump_max_writers},
+  {"mongo_parallel_writers", cfg_key_sql_parallel_writers},
   {"mongo_preprocess", cfg_key_sql_preprocess},
   {"mongo_preprocess_type", cfg_key_sql_preprocess_type},
   {"mongo_startup_delay", cfg_key_sql_startup_delay},
@@ -165,6 +187,7 @@ static const struct _dictionary_line dictionary[] = {
   {"amqp_history", cfg_key_sql_history},
   {"amqp_history_offset", cfg_key_sql_history_offset},
   {"amqp_history_roundoff", cfg_key_sql_history_roundoff},
+  {"amqp_history_rollup", cfg_key_sql_history_rollup},
   {"amqp_time_roundoff", cfg_key_sql_history_roundoff},
   {"amqp_host", cfg_key_sql_host},
   {"amqp_user", cfg_key_sql_user},
@@ -176,6 +199,8 @@ static const struct _dictionary_line dictionary[] = {
   {"amqp_persistent_msg", cfg_key_amqp_persistent_msg},
   {"amqp_frame_max", cfg_key_amqp_frame_max},
   {"amqp_cache_entries", cfg_key_print_cache_entries},
+  {"amqp_cache_spill_dir", cfg_key_print_cache_spill_dir},
+  {"amqp_cache_memory_max", cfg_key_print_cache_memory_max},
   {"amqp_max_writers", cfg_key_dump_max_writers},
   {"amqp_preprocess", cfg_key_sql_preprocess},
   {"amqp_preprocess_type", cfg_key_sql_preprocess_type},
@@ -193,6 +218,7 @@ static const struct _dictionary_line dictionary[] = {
   {"kafka_history", cfg_key_sql_history},
   {"kafka_history_offset", cfg_key_sql_history_offset},
   {"kafka_history_roundoff", cfg_key_sql_history_roundoff},
+  {"kafka_history_rollup", cfg_key_sql_history_rollup},
   {"kafka_broker_host", cfg_key_sql_host},
   {"kafka_broker_port", cfg_key_kafka_broker_port},
   {"kafka_topic", cfg_key_sql_table},
@@ -201,6 +227,8 @@ static const struct _dictionary_line dictionary[] = {
   {"kafka_partition_dynamic", cfg_key_kafka_partition_dynamic},
   {"kafka_partition_key", cfg_key_kafka_partition_key},
   {"kafka_cache_entries", cfg_key_print_cache_entries},
+  {"kafka_cache_spill_dir", cfg_key_print_cache_spill_dir},
+  {"kafka_cache_memory_max", cfg_key_print_cache_memory_max},
   {"kafka_max_writers", cfg_key_dump_max_writers},
   {"kafka_preprocess", cfg_key_sql_preprocess},
   {"kafka_preprocess_type", cfg_key_sql_preprocess_type},
@@ -424,6 +452,7 @@ static const struct _dictionary_line dictionary[] = {
   {"bgp_daemon_port", cfg_key_nfacctd_bgp_port},
   {"bgp_daemon_pipe_size", cfg_key_nfacctd_bgp_pipe_size},
   {"bgp_daemon_max_peers", cfg_key_nfacctd_bgp_max_peers},
+  {"bgp_daemon_threads", cfg_key_bgp_daemon_threads},
   {"bgp_daemon_msglog_output", cfg_key_nfacctd_bgp_msglog_output},
   {"bgp_daemon_msglog_file", cfg_key_nfacctd_bgp_msglog_file},
   {"bgp_daemon_msglog_avro_schema_file", cfg_key_nfacctd_bgp_msglog_avro_schema_file},
@@ -476,17 +505,25 @@ static const struct _dictionary_line dictionary[] = {
   {"bgp_follow_default", cfg_key_nfacctd_bgp_follow_default},
   {"bgp_follow_nexthop", cfg_key_nfacctd_bgp_follow_nexthop},
   {"bgp_follow_nexthop_external", cfg_key_nfacctd_bgp_follow_nexthop_external},
+  {"bgp_lookup_cache_entries", cfg_key_bgp_lookup_cache_entries},
   {"bgp_disable_router_id_check", cfg_key_nfacctd_bgp_disable_router_id_check},
   {"bgp_neighbors_file", cfg_key_nfacctd_bgp_neighbors_file},
   {"bgp_table_peer_buckets", cfg_key_nfacctd_bgp_table_peer_buckets},
   {"bgp_table_per_peer_buckets", cfg_key_nfacctd_bgp_table_per_peer_buckets},
   {"bgp_table_attr_hash_buckets", cfg_key_nfacctd_bgp_table_attr_hash_buckets},
   {"bgp_table_per_peer_hash", cfg_key_nfacctd_bgp_table_per_peer_hash},
+  {"bgp_table_lpm_index", cfg_key_bgp_table_lpm_index},
+  {"bgp_table_shared_paths", cfg_key_bgp_table_shared_paths},
+  {"bgp_table_snapshot_file", cfg_key_bgp_table_snapshot_file},
+  {"bgp_table_snapshot_refresh_time", cfg_key_bgp_table_snapshot_refresh_time},
+  {"bgp_table_snapshot_stale_time", cfg_key_bgp_table_snapshot_stale_time},
   {"bgp_table_dump_output", cfg_key_nfacctd_bgp_table_dump_output},
   {"bgp_table_dump_file", cfg_key_nfacctd_bgp_table_dump_file},
   {"bgp_table_dump_latest_file", cfg_key_nfacctd_bgp_table_dump_latest_file},
   {"bgp_table_dump_avro_schema_file", cfg_key_nfacctd_bgp_table_dump_avro_schema_file},
   {"bgp_table_dump_refresh_time", cfg_key_nfacctd_bgp_table_dump_refresh_time},
+  {"bgp_table_dump_checkpoint", cfg_key_bgp_table_dump_checkpoint},
+  {"bgp_table_dump_workers", cfg_key_bgp_table_dump_workers},
   {"bgp_table_dump_amqp_host", cfg_key_nfacctd_bgp_table_dump_amqp_host},
   {"bgp_table_dump_amqp_vhost", cfg_key_nfacctd_bgp_table_dump_amqp_vhost},
   {"bgp_table_dump_amqp_user", cfg_key_nfacctd_bgp_table_dump_amqp_user},
@@ -555,6 +592,7 @@ static const struct _dictionary_line dictionary[] = {
   {"bmp_dump_latest_file", cfg_key_nfacctd_bmp_dump_latest_file},
   {"bmp_dump_avro_schema_file", cfg_key_nfacctd_bmp_dump_avro_schema_file},
   {"bmp_dump_refresh_time", cfg_key_nfacctd_bmp_dump_refresh_time},
+  {"bmp_dump_workers", cfg_key_bmp_dump_workers},
   {"bmp_dump_amqp_host", cfg_key_nfacctd_bmp_dump_amqp_host},
   {"bmp_dump_amqp_vhost", cfg_key_nfacctd_bmp_dump_amqp_vhost},
   {"bmp_dump_amqp_user", cfg_key_nfacctd_bmp_dump_amqp_user},
@@ -609,6 +647,7 @@ static struct plugin_type_entry plugin_types_list[] = {
   {PLUGIN_ID_CORE, 	"core", 	NULL},
   {PLUGIN_ID_MEMORY, 	"memory", 	imt_plugin},
   {PLUGIN_ID_PRINT,	"print",	print_plugin},
+  {PLUGIN_ID_TOPK,	"topk",		topk_plugin},
   {PLUGIN_ID_NFPROBE,	"nfprobe",	nfprobe_plugin},
   {PLUGIN_ID_SFPROBE,	"sfprobe",	sfprobe_plugin},
 #ifdef WITH_MYSQL
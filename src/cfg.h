@@ -79,6 +79,8 @@ struct configuration {
   pm_cfgreg_t what_to_count_2;	/* second registry */
   pm_cfgreg_t nfprobe_what_to_count;
   pm_cfgreg_t nfprobe_what_to_count_2;
+  pm_cfgreg_t distinct_what_to_count;
+  int distinct_precision;
   char *aggregate_primitives;
   struct custom_primitives_ptrs cpptrs;
   char *name;
@@ -133,6 +135,7 @@ struct configuration {
   int sql_history;
   int sql_history_offset;
   int sql_history_howmany; /* internal */
+  char *sql_history_rollup;
   int sql_startup_delay;
   int sql_cache_entries;
   int sql_dont_try_update;
@@ -146,6 +149,11 @@ struct configuration {
   int sql_multi_values;
   char *sql_locking_style;
   int sql_use_copy;
+  int sql_use_prepared;
+  int sql_parallel_writers;
+  int sql_upsert_batch;
+  int sql_wal;
+  int sql_wal_checkpoint;
   char *sql_delimiter;
   int timestamps_rfc3339;
   int timestamps_utc;
@@ -173,6 +181,13 @@ struct configuration {
   char *kafka_avro_schema_registry;
   char *kafka_config_file;
   int print_cache_entries;
+  char *print_cache_spill_dir;
+  u_int64_t print_cache_memory_max;
+  u_int32_t topk_entries;
+  u_int32_t topk_summary_entries;
+  u_int32_t topk_sketch_width;
+  u_int32_t topk_sketch_depth;
+  int topk_metric;
   int print_markers;
   int print_output;
   int print_output_file_append;
@@ -317,6 +332,7 @@ struct configuration {
   int nfacctd_bgp_ipprec;
   char *nfacctd_bgp_allow_file;
   int nfacctd_bgp_max_peers;
+  int bgp_daemon_threads;
   int nfacctd_bgp_aspath_radius;
   char *nfacctd_bgp_stdcomm_pattern;
   char *nfacctd_bgp_extcomm_pattern;
@@ -343,17 +359,25 @@ struct configuration {
   int nfacctd_bgp_follow_default;
   struct prefix nfacctd_bgp_follow_nexthop[FOLLOW_BGP_NH_ENTRIES];
   int nfacctd_bgp_follow_nexthop_external;
+  int bgp_lookup_cache_entries;
   char *nfacctd_bgp_neighbors_file;
   char *nfacctd_bgp_md5_file;
   int bgp_table_peer_buckets;
   int bgp_table_per_peer_buckets;
   int bgp_table_attr_hash_buckets;
   int bgp_table_per_peer_hash;
+  int bgp_table_lpm_index;
+  int bgp_table_shared_paths;
+  char *bgp_table_snapshot_file;
+  int bgp_table_snapshot_refresh_time;
+  int bgp_table_snapshot_stale_time;
   int bgp_table_dump_output;
   char *bgp_table_dump_file;
   char *bgp_table_dump_latest_file;
   char *bgp_table_dump_avro_schema_file;
   int bgp_table_dump_refresh_time;
+  int bgp_table_dump_checkpoint;
+  int bgp_table_dump_workers;
   char *bgp_table_dump_amqp_host;
   char *bgp_table_dump_amqp_vhost;
   char *bgp_table_dump_amqp_user;
@@ -426,6 +450,7 @@ struct configuration {
   char *bmp_dump_latest_file;
   char *bmp_dump_avro_schema_file;
   int bmp_dump_refresh_time;
+  int bmp_dump_workers;
   char *bmp_dump_amqp_host;
   char *bmp_dump_amqp_vhost;
   char *bmp_dump_amqp_user;
@@ -478,6 +503,9 @@ struct configuration {
   int pcap_sf_replay;
   int num_memory_pools;
   int memory_pool_size;
+  int imt_query_threads;
+  int imt_table_layout;
+  char *imt_table_file;
   int buckets;
   int daemon;
   int active_plugins;
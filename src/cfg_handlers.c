@@ -26,6 +26,7 @@
 #include "pmacct-data.h"
 #include "plugin_hooks.h"
 #include "cfg_handlers.h"
+#include "hll.h"
 #include "bgp/bgp.h"
 
 int parse_truefalse(char *value_ptr)
@@ -344,6 +345,89 @@ int cfg_key_aggregate(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+/* distinct counts are kept by the plugins built on top of plugin_common.c */
+static int cfg_distinct_supported(struct plugins_list_entry *list)
+{
+  return (list->type.id == PLUGIN_ID_PRINT || list->type.id == PLUGIN_ID_MONGODB ||
+	  list->type.id == PLUGIN_ID_AMQP || list->type.id == PLUGIN_ID_KAFKA);
+}
+
+int cfg_key_aggregate_distinct(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  char *count_token;
+  pm_cfgreg_t value = 0;
+  int changes = 0;
+
+  trim_all_spaces(value_ptr);
+  lower_string(value_ptr);
+
+  while ((count_token = extract_token(&value_ptr, ','))) {
+    if (!strcmp(count_token, "src_host")) value |= COUNT_SRC_HOST;
+    else if (!strcmp(count_token, "dst_host")) value |= COUNT_DST_HOST;
+    else if (!strcmp(count_token, "src_port")) value |= COUNT_SRC_PORT;
+    else if (!strcmp(count_token, "dst_port")) value |= COUNT_DST_PORT;
+    else if (!strcmp(count_token, "proto")) value |= COUNT_IP_PROTO;
+    else if (!strcmp(count_token, "tos")) value |= COUNT_IP_TOS;
+#if defined (HAVE_L2)
+    else if (!strcmp(count_token, "src_mac")) value |= COUNT_SRC_MAC;
+    else if (!strcmp(count_token, "dst_mac")) value |= COUNT_DST_MAC;
+    else if (!strcmp(count_token, "vlan")) value |= COUNT_VLAN;
+#endif
+    else Log(LOG_WARNING, "WARN: [%s] primitive '%s' not supported by 'aggregate_distinct'. Ignored.\n", filename, count_token);
+  }
+
+  if (!value) return ERR;
+
+  if (!name) {
+    for (; list; list = list->next) {
+      if (cfg_distinct_supported(list)) {
+        list->cfg.distinct_what_to_count = value;
+        changes++;
+      }
+    }
+  }
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        if (cfg_distinct_supported(list)) {
+          list->cfg.distinct_what_to_count = value;
+          changes++;
+        }
+        else Log(LOG_WARNING, "WARN: [%s] 'aggregate_distinct' not supported by plugin '%s'. Ignored.\n", filename, name);
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_aggregate_distinct_precision(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < HLL_PRECISION_MIN || value > HLL_PRECISION_MAX) {
+    Log(LOG_WARNING, "WARN: [%s] 'aggregate_distinct_precision' has to be in the range %d-%d.\n", filename, HLL_PRECISION_MIN, HLL_PRECISION_MAX);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.distinct_precision = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.distinct_precision = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_aggregate_primitives(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -854,6 +938,77 @@ int cfg_key_imt_mem_pools_size(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_imt_query_threads(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'imt_query_threads' has to be >= 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.imt_query_threads = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.imt_query_threads = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_imt_table_layout(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  lower_string(value_ptr);
+  if (!strcmp(value_ptr, "chained")) value = IMT_TABLE_LAYOUT_CHAINED;
+  else if (!strcmp(value_ptr, "open")) value = IMT_TABLE_LAYOUT_OPEN;
+  else {
+    Log(LOG_WARNING, "WARN: [%s] Invalid imt_table_layout value '%s'\n", filename, value_ptr);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.imt_table_layout = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.imt_table_layout = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_imt_table_file(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.imt_table_file = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.imt_table_file = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_sql_db(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -1481,6 +1636,25 @@ int cfg_key_sql_history_roundoff(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_sql_history_rollup(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_history_rollup = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_history_rollup = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_sql_history(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -1670,6 +1844,56 @@ int cfg_key_sql_multi_values(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_sql_parallel_writers(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1 || value >= 100) {
+    Log(LOG_WARNING, "WARN: [%s] invalid 'sql_parallel_writers' value. Allowed values are: 1 <= sql_parallel_writers < 100.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_parallel_writers = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_parallel_writers = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_sql_upsert_batch(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_WARNING, "WARN: [%s] invalid 'sql_upsert_batch' value. Allowed values are: sql_upsert_batch >= 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_upsert_batch = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_upsert_batch = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_mongo_insert_batch(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -2198,6 +2422,75 @@ int cfg_key_sql_use_copy(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_sql_use_prepared(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_use_prepared = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_use_prepared = value;
+	changes++;
+	break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_sql_wal(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_wal = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_wal = value;
+	changes++;
+	break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_sql_wal_checkpoint(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0, value = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1) {
+    Log(LOG_WARNING, "WARN: [%s] invalid 'sql_wal_checkpoint' value. Allowed values are: sql_wal_checkpoint > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.sql_wal_checkpoint = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.sql_wal_checkpoint = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_sql_delimiter(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -2762,6 +3055,179 @@ int cfg_key_print_cache_entries(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_print_cache_spill_dir(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.print_cache_spill_dir = value_ptr;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.print_cache_spill_dir = value_ptr;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_print_cache_memory_max(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  u_int64_t value, changes = 0;
+  char *endptr;
+
+  value = strtoull(value_ptr, &endptr, 10);
+  if (!value) {
+    Log(LOG_WARNING, "WARN: [%s] 'print_cache_memory_max' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.print_cache_memory_max = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.print_cache_memory_max = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_topk_entries(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'topk_entries' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.topk_entries = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.topk_entries = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_topk_summary_entries(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'topk_summary_entries' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.topk_summary_entries = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.topk_summary_entries = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_topk_sketch_width(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0) {
+    Log(LOG_WARNING, "WARN: [%s] 'topk_sketch_width' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.topk_sketch_width = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.topk_sketch_width = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_topk_sketch_depth(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value <= 0 || value > TOPK_SKETCH_DEPTH_MAX) {
+    Log(LOG_WARNING, "WARN: [%s] 'topk_sketch_depth' has to be in the range 1-16.\n", filename);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.topk_sketch_depth = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.topk_sketch_depth = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
+int cfg_key_topk_metric(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  lower_string(value_ptr);
+  if (!strcmp(value_ptr, "bytes")) value = TOPK_METRIC_BYTES;
+  else if (!strcmp(value_ptr, "packets")) value = TOPK_METRIC_PACKETS;
+  else if (!strcmp(value_ptr, "flows")) value = TOPK_METRIC_FLOWS;
+  else {
+    Log(LOG_WARNING, "WARN: [%s] Invalid 'topk_metric' value '%s'\n", filename, value_ptr);
+    return ERR;
+  }
+
+  if (!name) for (; list; list = list->next, changes++) list->cfg.topk_metric = value;
+  else {
+    for (; list; list = list->next) {
+      if (!strcmp(name, list->name)) {
+        list->cfg.topk_metric = value;
+        changes++;
+        break;
+      }
+    }
+  }
+
+  return changes;
+}
+
 int cfg_key_print_markers(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -3683,6 +4149,23 @@ int cfg_key_nfacctd_bgp_max_peers(char *filename, char *name, char *value_ptr)
   return changes;
 }
 
+int cfg_key_bgp_daemon_threads(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if ((value < 0) || (value > BGP_WORKERS_MAX)) {
+    Log(LOG_ERR, "WARN: [%s] 'bgp_daemon_threads' has to be in the range 0-%d.\n", filename, BGP_WORKERS_MAX);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_daemon_threads = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_daemon_threads'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bgp_ip(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -3880,6 +4363,23 @@ int cfg_key_nfacctd_bgp_table_per_peer_buckets(char *filename, char *name, char
   return changes;
 }
 
+int cfg_key_bgp_lookup_cache_entries(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if ((value < 0) || (value > 100000000)) {
+    Log(LOG_ERR, "WARN: [%s] 'bgp_lookup_cache_entries' has to be in the range 0-100000000.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_lookup_cache_entries = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_lookup_cache_entries'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bgp_table_attr_hash_buckets(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -3912,6 +4412,79 @@ int cfg_key_nfacctd_bgp_table_per_peer_hash(char *filename, char *name, char *va
   return changes;
 }
 
+int cfg_key_bgp_table_lpm_index(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_lpm_index = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_lpm_index'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_bgp_table_shared_paths(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = parse_truefalse(value_ptr);
+  if (value < 0) return ERR;
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_shared_paths = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_shared_paths'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_bgp_table_snapshot_file(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int changes = 0;
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_snapshot_file = value_ptr;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_snapshot_file'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_bgp_table_snapshot_refresh_time(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_ERR, "WARN: [%s] 'bgp_table_snapshot_refresh_time' has to be >= 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_snapshot_refresh_time = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_snapshot_refresh_time'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_bgp_table_snapshot_stale_time(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1) {
+    Log(LOG_ERR, "WARN: [%s] 'bgp_table_snapshot_stale_time' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_snapshot_stale_time = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_snapshot_stale_time'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bgp_batch_interval(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -4469,6 +5042,23 @@ int cfg_key_nfacctd_bmp_dump_refresh_time(char *filename, char *name, char *valu
   return changes;
 }
 
+int cfg_key_bmp_dump_workers(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1) {
+    Log(LOG_ERR, "WARN: [%s] 'bmp_dump_workers' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bmp_dump_workers = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bmp_dump_workers'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bmp_dump_amqp_host(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
@@ -6466,6 +7056,40 @@ int cfg_key_nfacctd_bgp_table_dump_refresh_time(char *filename, char *name, char
   return changes;
 }
 
+int cfg_key_bgp_table_dump_checkpoint(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 0) {
+    Log(LOG_ERR, "WARN: [%s] 'bgp_table_dump_checkpoint' has to be >= 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_dump_checkpoint = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_dump_checkpoint'. Globalized.\n", filename);
+
+  return changes;
+}
+
+int cfg_key_bgp_table_dump_workers(char *filename, char *name, char *value_ptr)
+{
+  struct plugins_list_entry *list = plugins_list;
+  int value, changes = 0;
+
+  value = atoi(value_ptr);
+  if (value < 1) {
+    Log(LOG_ERR, "WARN: [%s] 'bgp_table_dump_workers' has to be > 0.\n", filename);
+    return ERR;
+  }
+
+  for (; list; list = list->next, changes++) list->cfg.bgp_table_dump_workers = value;
+  if (name) Log(LOG_WARNING, "WARN: [%s] plugin name not supported for key 'bgp_table_dump_workers'. Globalized.\n", filename);
+
+  return changes;
+}
+
 int cfg_key_nfacctd_bgp_table_dump_amqp_host(char *filename, char *name, char *value_ptr)
 {
   struct plugins_list_entry *list = plugins_list;
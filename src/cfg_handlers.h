@@ -38,6 +38,8 @@ extern int cfg_key_proc_name(char *, char *, char *);
 extern int cfg_key_proc_priority(char *, char *, char *);
 extern int cfg_key_aggregate(char *, char *, char *);
 extern int cfg_key_aggregate_primitives(char *, char *, char *);
+extern int cfg_key_aggregate_distinct(char *, char *, char *);
+extern int cfg_key_aggregate_distinct_precision(char *, char *, char *);
 extern int cfg_key_snaplen(char *, char *, char *);
 extern int cfg_key_aggregate_filter(char *, char *, char *);
 extern int cfg_key_pcap_filter(char *, char *, char *);
@@ -65,6 +67,9 @@ extern int cfg_key_imt_passwd(char *, char *, char *);
 extern int cfg_key_imt_buckets(char *, char *, char *);
 extern int cfg_key_imt_mem_pools_number(char *, char *, char *);
 extern int cfg_key_imt_mem_pools_size(char *, char *, char *);
+extern int cfg_key_imt_query_threads(char *, char *, char *);
+extern int cfg_key_imt_table_layout(char *, char *, char *);
+extern int cfg_key_imt_table_file(char *, char *, char *);
 extern int cfg_key_sql_db(char *, char *, char *);
 extern int cfg_key_sql_table(char *, char *, char *);
 extern int cfg_key_sql_table_schema(char *, char *, char *);
@@ -82,6 +87,7 @@ extern int cfg_key_sql_optimize_clauses(char *, char *, char *);
 extern int cfg_key_sql_history(char *, char *, char *);
 extern int cfg_key_sql_history_offset(char *, char *, char *);
 extern int cfg_key_sql_history_roundoff(char *, char *, char *);
+extern int cfg_key_sql_history_rollup(char *, char *, char *);
 extern int cfg_key_sql_recovery_backup_host(char *, char *, char *);
 extern int cfg_key_sql_trigger_exec(char *, char *, char *);
 extern int cfg_key_sql_trigger_time(char *, char *, char *);
@@ -90,8 +96,13 @@ extern int cfg_key_sql_dont_try_update(char *, char *, char *);
 extern int cfg_key_sql_preprocess(char *, char *, char *);
 extern int cfg_key_sql_preprocess_type(char *, char *, char *);
 extern int cfg_key_sql_multi_values(char *, char *, char *);
+extern int cfg_key_sql_parallel_writers(char *, char *, char *);
+extern int cfg_key_sql_upsert_batch(char *, char *, char *);
 extern int cfg_key_sql_locking_style(char *, char *, char *);
 extern int cfg_key_sql_use_copy(char *, char *, char *);
+extern int cfg_key_sql_use_prepared(char *, char *, char *);
+extern int cfg_key_sql_wal(char *, char *, char *);
+extern int cfg_key_sql_wal_checkpoint(char *, char *, char *);
 extern int cfg_key_sql_delimiter(char *, char *, char *);
 extern int cfg_key_timestamps_rfc3339(char *, char *, char *);
 extern int cfg_key_timestamps_utc(char *, char *, char *);
@@ -132,6 +143,13 @@ extern int cfg_key_networks_no_mask_if_zero(char *, char *, char *);
 extern int cfg_key_networks_cache_entries(char *, char *, char *);
 extern int cfg_key_ports_file(char *, char *, char *);
 extern int cfg_key_print_cache_entries(char *, char *, char *);
+extern int cfg_key_print_cache_spill_dir(char *, char *, char *);
+extern int cfg_key_print_cache_memory_max(char *, char *, char *);
+extern int cfg_key_topk_entries(char *, char *, char *);
+extern int cfg_key_topk_summary_entries(char *, char *, char *);
+extern int cfg_key_topk_sketch_width(char *, char *, char *);
+extern int cfg_key_topk_sketch_depth(char *, char *, char *);
+extern int cfg_key_topk_metric(char *, char *, char *);
 extern int cfg_key_print_markers(char *, char *, char *);
 extern int cfg_key_print_output(char *, char *, char *);
 extern int cfg_key_print_output_file(char *, char *, char *);
@@ -319,6 +337,7 @@ extern int cfg_key_nfacctd_bgp_msglog_kafka_retry(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_msglog_kafka_config_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_msglog_kafka_avro_schema_registry(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_max_peers(char *, char *, char *);
+extern int cfg_key_bgp_daemon_threads(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_ip(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_id(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_as(char *, char *, char *);
@@ -353,13 +372,21 @@ extern int cfg_key_nfacctd_bgp_neighbors_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_md5_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_peer_buckets(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_per_peer_buckets(char *, char *, char *);
+extern int cfg_key_bgp_lookup_cache_entries(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_attr_hash_buckets(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_per_peer_hash(char *, char *, char *);
+extern int cfg_key_bgp_table_lpm_index(char *, char *, char *);
+extern int cfg_key_bgp_table_shared_paths(char *, char *, char *);
+extern int cfg_key_bgp_table_snapshot_file(char *, char *, char *);
+extern int cfg_key_bgp_table_snapshot_refresh_time(char *, char *, char *);
+extern int cfg_key_bgp_table_snapshot_stale_time(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_output(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_latest_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_avro_schema_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_refresh_time(char *, char *, char *);
+extern int cfg_key_bgp_table_dump_checkpoint(char *, char *, char *);
+extern int cfg_key_bgp_table_dump_workers(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_amqp_host(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_amqp_vhost(char *, char *, char *);
 extern int cfg_key_nfacctd_bgp_table_dump_amqp_user(char *, char *, char *);
@@ -431,6 +458,7 @@ extern int cfg_key_nfacctd_bmp_dump_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bmp_dump_avro_schema_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bmp_dump_latest_file(char *, char *, char *);
 extern int cfg_key_nfacctd_bmp_dump_refresh_time(char *, char *, char *);
+extern int cfg_key_bmp_dump_workers(char *, char *, char *);
 extern int cfg_key_nfacctd_bmp_dump_amqp_host(char *, char *, char *);
 extern int cfg_key_nfacctd_bmp_dump_amqp_vhost(char *, char *, char *);
 extern int cfg_key_nfacctd_bmp_dump_amqp_user(char *, char *, char *);
@@ -0,0 +1,256 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "evloop.h"
+
+/* functions */
+int pm_evloop_init(struct pm_evloop *loop)
+{
+  if (!loop) return ERR;
+
+  memset(loop, 0, sizeof(struct pm_evloop));
+  loop->epfd = ERR;
+
+#if defined LINUX
+  loop->epfd = epoll_create1(0);
+  if (loop->epfd < 0) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): epoll_create1() failed (errno: %d).\n", config.name, config.type, errno);
+    return ERR;
+  }
+
+  loop->events = malloc(PM_EVLOOP_EVENTS_MAX * sizeof(struct epoll_event));
+  if (!loop->events) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (pm_evloop_init).\n", config.name, config.type);
+    close(loop->epfd);
+    return ERR;
+  }
+#else
+  FD_ZERO(&loop->bkp_read_descs);
+  loop->max_fd = ERR;
+#endif
+
+  return SUCCESS;
+}
+
+void pm_evloop_destroy(struct pm_evloop *loop)
+{
+  if (!loop) return;
+
+#if defined LINUX
+  if (loop->epfd >= 0) close(loop->epfd);
+  free(loop->events);
+#endif
+  free(loop->fds);
+  free(loop->ready);
+  free(loop->pending);
+
+  memset(loop, 0, sizeof(struct pm_evloop));
+  loop->epfd = ERR;
+}
+
+/* makes room for 'fd' in the per-socket tables */
+static int pm_evloop_grow(struct pm_evloop *loop, int fd)
+{
+  struct pm_evloop_fd *fds;
+  int *ready, *pending, fds_max;
+
+  if (fd < loop->fds_max) return SUCCESS;
+
+  fds_max = (((fd / PM_EVLOOP_FDS_STEP) + 1) * PM_EVLOOP_FDS_STEP);
+
+  fds = realloc(loop->fds, fds_max * sizeof(struct pm_evloop_fd));
+  if (!fds) return ERR;
+  loop->fds = fds;
+  memset(&loop->fds[loop->fds_max], 0, ((fds_max - loop->fds_max) * sizeof(struct pm_evloop_fd)));
+
+  /* pending sockets are carried over and then joined by the new events */
+  ready = realloc(loop->ready, ((fds_max + PM_EVLOOP_EVENTS_MAX) * sizeof(int)));
+  if (!ready) return ERR;
+  loop->ready = ready;
+
+  pending = realloc(loop->pending, (fds_max * sizeof(int)));
+  if (!pending) return ERR;
+  loop->pending = pending;
+
+  loop->fds_max = fds_max;
+
+  return SUCCESS;
+}
+
+int pm_evloop_add(struct pm_evloop *loop, int fd, void *ptr, int edge)
+{
+#if defined LINUX
+  struct epoll_event ev;
+#endif
+
+  if (!loop || fd < 0) return ERR;
+
+  if (pm_evloop_grow(loop, fd) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): realloc() failed (pm_evloop_add).\n", config.name, config.type);
+    return ERR;
+  }
+
+#if defined LINUX
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  if (edge) ev.events |= EPOLLET;
+  ev.data.fd = fd;
+
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): epoll_ctl() failed (fd: %d, errno: %d).\n", config.name, config.type, fd, errno);
+    return ERR;
+  }
+#else
+  if (fd >= FD_SETSIZE) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): socket beyond FD_SETSIZE (fd: %d).\n", config.name, config.type, fd);
+    return ERR;
+  }
+
+  FD_SET(fd, &loop->bkp_read_descs);
+  if (loop->max_fd < fd) loop->max_fd = fd;
+#endif
+
+  loop->fds[fd].ptr = ptr;
+  loop->fds[fd].registered = TRUE;
+
+  return SUCCESS;
+}
+
+/* to be called before the socket is closed */
+void pm_evloop_del(struct pm_evloop *loop, int fd)
+{
+  if (!loop || fd < 0 || fd >= loop->fds_max || !loop->fds[fd].registered) return;
+
+#if defined LINUX
+  epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+#else
+  FD_CLR(fd, &loop->bkp_read_descs);
+  if (fd == loop->max_fd) {
+    for (loop->max_fd--; loop->max_fd >= 0; loop->max_fd--) {
+      if (FD_ISSET(loop->max_fd, &loop->bkp_read_descs)) break;
+    }
+  }
+#endif
+
+  /* any event still queued for it is dropped by pm_evloop_next() */
+  loop->fds[fd].ptr = NULL;
+  loop->fds[fd].registered = FALSE;
+}
+
+static void pm_evloop_queue(struct pm_evloop *loop, int fd)
+{
+  if (fd < 0 || fd >= loop->fds_max || loop->fds[fd].queued) return;
+
+  loop->fds[fd].queued = TRUE;
+  loop->ready[loop->ready_num] = fd;
+  loop->ready_num++;
+}
+
+/*
+   Waits for sockets to turn readable, for up to 'timeout' (NULL: for ever).
+   Returns the number of sockets to be fetched with pm_evloop_next(), 0 on
+   timeout or ERR, ie. if interrupted by a signal.
+*/
+int pm_evloop_wait(struct pm_evloop *loop, struct timeval *timeout)
+{
+  int idx, fd, ret, pending_num;
+
+  /* events not consumed in the previous round are not lost, edges would */
+  for (idx = loop->ready_idx; idx < loop->ready_num; idx++) {
+    fd = loop->ready[idx];
+    loop->fds[fd].queued = FALSE;
+    pm_evloop_again(loop, fd);
+  }
+  loop->ready_num = 0;
+  loop->ready_idx = 0;
+
+  /* sockets left with data to be read go first, and we don't block */
+  for (idx = 0, pending_num = loop->pending_num; idx < pending_num; idx++) {
+    fd = loop->pending[idx];
+    loop->fds[fd].pending = FALSE;
+    if (loop->fds[fd].registered) pm_evloop_queue(loop, fd);
+  }
+  loop->pending_num = 0;
+
+#if defined LINUX
+  {
+    int ms;
+
+    if (loop->ready_num) ms = 0;
+    else if (timeout) ms = ((timeout->tv_sec * 1000) + (timeout->tv_usec / 1000));
+    else ms = -1;
+
+    ret = epoll_wait(loop->epfd, loop->events, PM_EVLOOP_EVENTS_MAX, ms);
+    if (ret < 0) return (loop->ready_num ? loop->ready_num : ERR);
+
+    for (idx = 0; idx < ret; idx++) pm_evloop_queue(loop, loop->events[idx].data.fd);
+  }
+#else
+  {
+    struct timeval zero = {0, 0};
+
+    memcpy(&loop->read_descs, &loop->bkp_read_descs, sizeof(loop->bkp_read_descs));
+
+    ret = select((loop->max_fd + 1), &loop->read_descs, NULL, NULL, (loop->ready_num ? &zero : timeout));
+    if (ret < 0) return (loop->ready_num ? loop->ready_num : ERR);
+
+    for (fd = 0; ret > 0 && fd <= loop->max_fd; fd++) {
+      if (FD_ISSET(fd, &loop->read_descs)) {
+        pm_evloop_queue(loop, fd);
+        ret--;
+      }
+    }
+  }
+#endif
+
+  return loop->ready_num;
+}
+
+/* returns the next readable socket, and its pointer, or ERR once done */
+int pm_evloop_next(struct pm_evloop *loop, void **ptr)
+{
+  int fd;
+
+  while (loop->ready_idx < loop->ready_num) {
+    fd = loop->ready[loop->ready_idx];
+    loop->ready_idx++;
+    loop->fds[fd].queued = FALSE;
+
+    if (loop->fds[fd].registered) {
+      if (ptr) (*ptr) = loop->fds[fd].ptr;
+      return fd;
+    }
+  }
+
+  return ERR;
+}
+
+/* the socket was not read until EAGAIN: serve it again next round */
+void pm_evloop_again(struct pm_evloop *loop, int fd)
+{
+  if (!loop || fd < 0 || fd >= loop->fds_max || !loop->fds[fd].registered || loop->fds[fd].pending) return;
+
+  loop->fds[fd].pending = TRUE;
+  loop->pending[loop->pending_num] = fd;
+  loop->pending_num++;
+}
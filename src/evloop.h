@@ -0,0 +1,84 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+
+#ifndef _EVLOOP_H_
+#define _EVLOOP_H_
+
+#if defined LINUX
+#include <sys/epoll.h>
+#endif
+
+/* defines */
+#define PM_EVLOOP_EVENTS_MAX	256	/* events fetched from the kernel per wait */
+#define PM_EVLOOP_READS_MAX	16	/* reads per socket and round, see pm_evloop_again() */
+#define PM_EVLOOP_FDS_STEP	1024
+
+#define PM_EVLOOP_LEVEL		0
+#define PM_EVLOOP_EDGE		1
+
+/* structs */
+struct pm_evloop_fd {
+  void *ptr;
+  u_int8_t registered;
+  u_int8_t queued;
+  u_int8_t pending;
+};
+
+/*
+   Readiness notification for the sockets of a daemon thread: epoll on
+   Linux, select() elsewhere. A socket is registered along with an opaque
+   pointer, typically its peer, handed back when the socket is found
+   readable. Sockets registered edge-triggered are expected to be read
+   until EAGAIN; as a single busy peer must not hold the loop, a reader
+   can stop after PM_EVLOOP_READS_MAX reads and call pm_evloop_again() to
+   be served again in the next round, after the other sockets.
+*/
+struct pm_evloop {
+  int epfd;
+#if defined LINUX
+  struct epoll_event *events;
+#else
+  fd_set read_descs;
+  fd_set bkp_read_descs;
+  int max_fd;
+#endif
+
+  struct pm_evloop_fd *fds;
+  int fds_max;
+
+  int *ready;
+  int ready_num;
+  int ready_idx;
+
+  int *pending;
+  int pending_num;
+};
+
+/* prototypes */
+extern int pm_evloop_init(struct pm_evloop *);
+extern void pm_evloop_destroy(struct pm_evloop *);
+extern int pm_evloop_add(struct pm_evloop *, int, void *, int);
+extern void pm_evloop_del(struct pm_evloop *, int);
+extern int pm_evloop_wait(struct pm_evloop *, struct timeval *);
+extern int pm_evloop_next(struct pm_evloop *, void **);
+extern void pm_evloop_again(struct pm_evloop *, int);
+#endif /* _EVLOOP_H_ */
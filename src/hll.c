@@ -0,0 +1,100 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+    HyperLogLog cardinality estimator (Flajolet et al., 2007) with 2^p
+    one-byte registers and the linear counting correction for small
+    cardinalities. A 64-bit hash is used, so no large range correction
+    is needed.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "hll.h"
+#include "jhash.h"
+
+/* functions */
+u_int64_t hll_hash(void *key, u_int32_t len)
+{
+  u_int64_t hash;
+
+  /* two independent 32-bit halves */
+  hash = jhash(key, len, JHASH_GOLDEN_RATIO);
+  hash <<= 32;
+  hash |= jhash(key, len, 0x5bd1e995);
+
+  return hash;
+}
+
+void hll_add(u_int8_t *regs, u_int8_t p, u_int64_t hash)
+{
+  u_int32_t idx = (hash >> (64 - p));
+  u_int64_t rest = (hash << p);
+  u_int8_t rank = 1;
+
+  while (rank <= (64 - p) && !(rest & 0x8000000000000000ULL)) {
+    rest <<= 1;
+    rank++;
+  }
+
+  if (rank > regs[idx]) regs[idx] = rank;
+}
+
+void hll_merge(u_int8_t *dst, u_int8_t *src, u_int8_t p)
+{
+  u_int32_t idx, num = HLL_REGISTERS(p);
+
+  for (idx = 0; idx < num; idx++) {
+    if (src[idx] > dst[idx]) dst[idx] = src[idx];
+  }
+}
+
+u_int64_t hll_count(u_int8_t *regs, u_int8_t p)
+{
+  u_int32_t idx, zeros = 0, num = HLL_REGISTERS(p);
+  double alpha, estimate, sum = 0;
+
+  switch (num) {
+  case 16:
+    alpha = 0.673;
+    break;
+  case 32:
+    alpha = 0.697;
+    break;
+  case 64:
+    alpha = 0.709;
+    break;
+  default:
+    alpha = (0.7213 / (1 + (1.079 / num)));
+    break;
+  }
+
+  for (idx = 0; idx < num; idx++) {
+    sum += ldexp(1.0, -regs[idx]);
+    if (!regs[idx]) zeros++;
+  }
+
+  estimate = ((alpha * num * num) / sum);
+
+  if (estimate <= (2.5 * num) && zeros) estimate = (num * log((double) num / zeros));
+
+  return (u_int64_t) (estimate + 0.5);
+}
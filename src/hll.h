@@ -0,0 +1,38 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef HLL_H
+#define HLL_H
+
+/* defines */
+#define HLL_PRECISION_MIN	4
+#define HLL_PRECISION_MAX	16
+#define HLL_PRECISION_DEFAULT	10
+
+#define HLL_REGISTERS(p)	(1U << (p))
+
+/* prototypes */
+extern u_int64_t hll_hash(void *, u_int32_t);
+extern void hll_add(u_int8_t *, u_int8_t, u_int64_t);
+extern void hll_merge(u_int8_t *, u_int8_t *, u_int8_t);
+extern u_int64_t hll_count(u_int8_t *, u_int8_t);
+
+#endif //HLL_H
@@ -27,6 +27,7 @@
 #include "bgp/bgp.h"
 #include "net_aggr.h"
 #include "ports_aggr.h"
+#include "thread_pool.h"
 
 //Global variables
 void (*imt_insert_func)(struct primitives_ptrs *);
@@ -37,6 +38,7 @@ struct acc **lru_elem_ptr;
 int no_more_space;
 struct timeval cycle_stamp;
 struct timeval table_reset_stamp;
+thread_pool_t *imt_query_pool;
 
 /* Functions */
 void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr) 
@@ -50,14 +52,15 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   struct query_header *qh;
   unsigned char *pipebuf, *dataptr;
   char path[] = "/tmp/collect.pipe";
-  short int go_to_clear = FALSE;
+  short int go_to_clear = FALSE, dispatched;
   u_int32_t request, sz;
   struct ch_status *status = ((struct channels_list_entry *)ptr)->status;
   int datasize = ((struct channels_list_entry *)ptr)->datasize;
   pid_t core_pid = ((struct channels_list_entry *)ptr)->core_pid;
   struct extra_primitives extras;
   unsigned char *rgptr;
-  int pollagain = 0;
+  int pollagain = 0, restored = FALSE;
+  u_int32_t extras_len = 0;
   u_int32_t seq = 0;
   int rg_err_count = 0;
   int ret, lock = FALSE, num, sd, sd2;
@@ -150,18 +153,46 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   if (!config.imt_plugin_path) config.imt_plugin_path = path; 
   if (!config.buckets) config.buckets = MAX_HOSTS;
 
-  init_memory_pool_table(config);
-  if (mpd == NULL) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate memory pools table\n", config.name, config.type);
-    exit_gracefully(1);
+  if (config.imt_table_file) {
+    if (extras.off_pkt_lbgp_primitives) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): imt_table_file does not support legacy BGP primitives, ie. as_path or communities. Exiting ..\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    /* extras have to be part of the memory pools in order to persist */
+    config.imt_table_layout = IMT_TABLE_LAYOUT_OPEN;
   }
 
-  current_pool = request_memory_pool(config.buckets*sizeof(struct acc));
-  if (current_pool == NULL) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate first memory pool, try with larger value.\n", config.name, config.type);
-    exit_gracefully(1);
+  if (config.imt_table_layout == IMT_TABLE_LAYOUT_OPEN) {
+    /* given the use of empty_* vars, all fixed-size extras are there */
+    extras_len += IMT_EXTRAS_ALIGN(sizeof(struct pkt_bgp_primitives));
+    extras_len += IMT_EXTRAS_ALIGN(sizeof(struct pkt_nat_primitives));
+    extras_len += IMT_EXTRAS_ALIGN(sizeof(struct pkt_mpls_primitives));
+    extras_len += IMT_EXTRAS_ALIGN(sizeof(struct pkt_tunnel_primitives));
+    extras_len += IMT_EXTRAS_ALIGN(config.cpptrs.len);
+
+    if (config.memory_pool_size < (sizeof(struct acc) + extras_len)) {
+      config.memory_pool_size = MAX(MEMORY_POOL_SIZE, (sizeof(struct acc) + extras_len));
+      Log(LOG_WARNING, "WARN ( %s/%s ): enforcing memory pool's minimum size, %d bytes.\n", config.name, config.type, config.memory_pool_size);
+    }
+  }
+
+  if (config.imt_table_file) restored = imt_table_file_open(&extras);
+
+  if (!restored) {
+    init_memory_pool_table(config);
+    if (mpd == NULL) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate memory pools table\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    current_pool = request_memory_pool(config.buckets*sizeof(struct acc));
+    if (current_pool == NULL) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate first memory pool, try with larger value.\n", config.name, config.type);
+      exit_gracefully(1);
+    }
   }
-  a = current_pool->base_ptr;
+  a = ((struct memory_pool_desc *) mpd)->base_ptr;
 
   lru_elem_ptr = malloc(config.buckets*sizeof(struct acc *));
   if (lru_elem_ptr == NULL) {
@@ -170,10 +201,17 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   }
   else memset(lru_elem_ptr, 0, config.buckets*sizeof(struct acc *));
 
-  current_pool = request_memory_pool(config.memory_pool_size);
-  if (current_pool == NULL) {
-    Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate more memory pools, try with larger value.\n", config.name, config.type);
-    exit_gracefully(1);
+  if (config.imt_table_layout == IMT_TABLE_LAYOUT_OPEN) {
+    imt_index_init(config.buckets, extras_len);
+    if (restored) imt_index_rebuild((struct acc *) a);
+  }
+
+  if (!restored) {
+    current_pool = request_memory_pool(config.memory_pool_size);
+    if (current_pool == NULL) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): unable to allocate more memory pools, try with larger value.\n", config.name, config.type);
+      exit_gracefully(1);
+    }
   }
 
   signal(SIGHUP, reload); /* handles reopening of syslog channel */
@@ -190,12 +228,23 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   memset(&empty_ptun, 0, sizeof(empty_ptun));
   memset(&empty_pvlen, 0, sizeof(empty_pvlen));
 
-  memset(&table_reset_stamp, 0, sizeof(table_reset_stamp));
+  if (restored) memcpy(&table_reset_stamp, &imt_file->table_reset_stamp, sizeof(struct timeval));
+  else memset(&table_reset_stamp, 0, sizeof(table_reset_stamp));
+
+  imt_epoch_init();
+  imt_rcu_publish((struct acc *) a);
 
   /* building a server for interrogations by clients */
   sd = build_query_server(config.imt_plugin_path);
   cLen = sizeof(cAddr);
 
+  imt_query_pool = NULL;
+  if (config.imt_query_threads) {
+    imt_query_pool = allocate_thread_pool(config.imt_query_threads);
+    if (!imt_query_pool) Log(LOG_WARNING, "WARN ( %s/%s ): Unable to allocate query threads. Falling back to fork().\n", config.name, config.type);
+    else Log(LOG_INFO, "INFO ( %s/%s ): serving queries with %d threads\n", config.name, config.type, config.imt_query_threads);
+  }
+
   qh = (struct query_header *) srvbuf;
 
   /* plugin main loop */
@@ -258,6 +307,13 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	continue;
       }
 
+      if (imt_query_check(srvbuf, &num, maxqsize) == ERR) {
+	Log(LOG_WARNING, "WARN ( %s/%s ): request discarded. Unsupported query header (version %u, %d bytes).\n",
+	    config.name, config.type, qh->version, num);
+	close(sd2);
+	continue;
+      }
+
       request = qh->type;
       if (request & WANT_RESET) request ^= WANT_RESET;
       if (request & WANT_LOCK_OP) {
@@ -271,12 +327,16 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	 - operations that may cause inconsistencies (full erasure, counter
 	   reset for individual entries, etc.) are entitled of an exclusive
 	   lock.
+	 - if query threads are configured and one is idle, it serves the
+	   query concurrently with aggregation (see imt_rcu_read_lock());
 	 - if query is matter of just a single short-lived walk through the
 	   table, we avoid fork(): the plugin will serve the request;
          - in all other cases, we fork; the newly created child will serve
 	   queries asyncronously.
       */
 
+      dispatched = FALSE;
+
       if (request & WANT_ERASE) {
 	request ^= WANT_ERASE;
 	if (request) {
@@ -286,6 +346,23 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
 	go_to_clear = TRUE;  
       }
+      else if (!lock && imt_query_pool && num > 0 && pool_has_free_worker(imt_query_pool)) {
+	struct imt_query *query;
+
+	query = malloc(sizeof(struct imt_query) + num);
+	if (query) {
+	  query->sd = sd2;
+	  query->len = num;
+	  query->datasize = datasize;
+	  query->extras = &extras;
+	  query->buf = (unsigned char *) (query + 1);
+	  memcpy(query->buf, srvbuf, num);
+
+	  send_to_pool(imt_query_pool, imt_query_thread, query);
+	  dispatched = TRUE;
+	}
+	else Log(LOG_WARNING, "WARN ( %s/%s ): Unable to serve client query: malloc() failed\n", config.name, config.type);
+      }
       else if (((request == WANT_COUNTER) || (request == WANT_MATCH)) &&
 	(qh->num == 1) && (qh->what_to_count == config.what_to_count)) {
 	if (num > 0) process_query_data(sd2, srvbuf, num, &extras, datasize, FALSE);
@@ -326,7 +403,7 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
           } 
 	}
       }
-      close(sd2);
+      if (!dispatched) close(sd2);
     }
 
     /* clearing stats if requested */
@@ -336,8 +413,11 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
       /* XXX: given the current use of empty_* vars we have always to
          free_extra_allocs() in order to prevent memory leaks */
 
+      imt_rcu_unpublish();
       free_extra_allocs(); 
       clear_memory_pool_table();
+      if (imt_index.entries) imt_index_clear();
+      imt_epoch_erase();
       current_pool = request_memory_pool(config.buckets*sizeof(struct acc));
       if (current_pool == NULL) {
         Log(LOG_ERR, "ERROR ( %s/%s ): Cannot allocate my first memory pool, try with larger value.\n", config.name, config.type);
@@ -350,9 +430,15 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
         Log(LOG_ERR, "ERROR ( %s/%s ): Cannot allocate more memory pools, try with larger value.\n", config.name, config.type);
         exit_gracefully(1);
       }
+      imt_rcu_publish((struct acc *) a);
       go_to_clear = FALSE;
       no_more_space = FALSE;
       memcpy(&table_reset_stamp, &cycle_stamp, sizeof(struct timeval));
+
+      if (imt_file) {
+	memcpy(&imt_file->table_reset_stamp, &table_reset_stamp, sizeof(struct timeval));
+	imt_table_file_sync(MS_ASYNC);
+      }
     }
 
     if (reload_map) {
@@ -423,6 +509,9 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	  else pbgp = &empty_pbgp;
           if (extras.off_pkt_lbgp_primitives)
             plbgp = (struct pkt_legacy_bgp_primitives *) ((u_char *)data + extras.off_pkt_lbgp_primitives);
+          /* legacy BGP primitives live out of the memory pools: with a
+             table file no room is made for them, see above */
+          else if (config.imt_table_file) plbgp = NULL;
           else plbgp = &empty_plbgp;
           if (extras.off_pkt_nat_primitives) 
             pnat = (struct pkt_nat_primitives *) ((u_char *)data + extras.off_pkt_nat_primitives);
@@ -475,10 +564,20 @@ void imt_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   }
 }
 
+void imt_query_thread(struct imt_query *query)
+{
+  process_query_data(query->sd, query->buf, query->len, query->extras, query->datasize, TRUE);
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): Closing connection with client ...\n", config.name, config.type);
+  close(query->sd);
+  free(query);
+}
+
 void exit_now(int signum)
 {
   if (config.imt_plugin_path) unlink(config.imt_plugin_path);
   if (config.pidfile) remove_pid_file(config.pidfile);
+  imt_table_file_sync(MS_SYNC);
   exit_gracefully(0);
 }
 
@@ -544,24 +643,24 @@ void free_extra_allocs()
   for (idx = 0; idx < config.buckets; idx++) {
     if (!following_chain) acc_elem = (struct acc *) elem;
     if (acc_elem->pbgp) {
-      free(acc_elem->pbgp);
+      imt_extras_free(acc_elem->pbgp);
       acc_elem->pbgp = NULL;
     }
     if (acc_elem->clbgp) free_cache_legacy_bgp_primitives(&acc_elem->clbgp);
     if (acc_elem->pnat) {
-      free(acc_elem->pnat);
+      imt_extras_free(acc_elem->pnat);
       acc_elem->pnat = NULL;
     }
     if (acc_elem->pmpls) {
-      free(acc_elem->pmpls);
+      imt_extras_free(acc_elem->pmpls);
       acc_elem->pmpls = NULL;
     }
     if (acc_elem->ptun) {
-      free(acc_elem->ptun);
+      imt_extras_free(acc_elem->ptun);
       acc_elem->ptun = NULL;
     }
     if (acc_elem->pcust) {
-      free(acc_elem->pcust);
+      imt_extras_free(acc_elem->pcust);
       acc_elem->pcust = NULL;
     }
     if (acc_elem->pvlen) {
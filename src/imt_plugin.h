@@ -23,13 +23,54 @@
 #define IMT_PLUGIN_H
 
 #include <sys/poll.h>
+#include <stddef.h>
 
 /* defines */
 #define NUM_MEMORY_POOLS 16
 #define MEMORY_POOL_SIZE 8192
+
+/* persistent table (imt_table_file) */
+#define IMT_TABLE_FILE_MAGIC	0x504d4954	/* "PMIT" */
+#define IMT_TABLE_FILE_VERSION	1
+#define IMT_TABLE_FILE_ALIGN(x)	(((x) + 63) & ~((u_int64_t) 63))
 #define MAX_HOSTS 32771 
 #define MAX_QUERIES 4096
 
+/* query header: clients predating 'version' send only its legacy part,
+   padded to the alignment of the structure */
+#define IMT_QUERY_VERSION	1
+#define IMT_QUERY_HDR_LEGACY_LEN	((offsetof(struct query_header, version) + __alignof__(struct query_header) - 1) & \
+					~(__alignof__(struct query_header) - 1))
+
+/* replies are spooled up to this many bytes by query threads, then sent
+   out of the read-side section (see enQueue_spool_yield()) */
+#define IMT_REPLY_SPOOL_LEN	(4 * LARGEBUFLEN)
+
+/* server-side selection of entries (see imt_select_elem()) */
+#define IMT_QUERY_FILTERS_MAX	4
+
+#define IMT_COUNTER_BYTES	1
+#define IMT_COUNTER_PACKETS	2
+#define IMT_COUNTER_FLOWS	3
+
+#define IMT_FILTER_EQ		1
+#define IMT_FILTER_LT		2
+#define IMT_FILTER_LE		3
+#define IMT_FILTER_GT		4
+#define IMT_FILTER_GE		5
+
+/* streaming replies (see struct imt_chunk_hdr) */
+#define IMT_STREAM_VERSION	1
+#define IMT_STREAM_F_LAST	0x01
+#define IMT_STREAM_F_ZLIB	0x02
+
+/* open addressing index (imt_table_layout: open) */
+#define IMT_INDEX_DELETED	((struct acc *) 1)
+#define IMT_EXTRAS_ALIGN(x)	(((x) + 7) & ~7)
+
+/* readers walk collision chains concurrently with the plugin */
+#define IMT_ACC_NEXT(elem) __atomic_load_n(&(elem)->next, __ATOMIC_ACQUIRE)
+
 /* Structures */
 struct acc {
   struct pkt_primitives primitives;
@@ -40,6 +81,7 @@ struct acc {
   u_int32_t tcp_flags; 
   unsigned int signature;
   u_int8_t reset_flag;
+  u_int64_t epoch;		/* last modification (see struct imt_epoch) */
   struct timeval rstamp;	/* classifiers: reset timestamp */
   struct pkt_bgp_primitives *pbgp;
   struct cache_legacy_bgp_primitives *clbgp;
@@ -65,6 +107,12 @@ struct memory_pool_desc {
   struct memory_pool_desc *next;
 };
 
+struct query_filter {
+  u_int8_t counter;			/* IMT_COUNTER_* */
+  u_int8_t op;				/* IMT_FILTER_*, 0 if unused */
+  pm_counter_t value;
+};
+
 struct query_header {
   int type;				/* type of query */
   pm_cfgreg_t what_to_count;		/* aggregation */
@@ -75,6 +123,27 @@ struct query_header {
   struct extra_primitives extras;	/* offsets for non-standard aggregation primitives structures */
   int datasize;				/* total length of aggregation primitives structures */
   char passwd[12];			/* OBSOLETED: password */
+  u_int16_t version;			/* IMT_QUERY_VERSION, 0 if legacy */
+  u_int16_t hdr_len;			/* sizeof(struct query_header) */
+  u_int8_t topn;			/* sort by counter (IMT_COUNTER_*), 0 if unsorted */
+  u_int32_t limit;			/* max number of entries in reply, 0 if unlimited */
+  u_int32_t offset;			/* number of entries to skip */
+  struct query_filter filter[IMT_QUERY_FILTERS_MAX]; /* counter predicates, all must match */
+  u_int8_t stream;			/* streaming reply version wanted, 0 if legacy */
+  u_int8_t stream_flags;		/* streaming reply options (IMT_STREAM_F_*) */
+  u_int64_t since;			/* WANT_DELTA: entries changed after this epoch; 0 in reply if full */
+  u_int64_t epoch;			/* WANT_DELTA: current epoch, in reply */
+};
+
+/* streaming replies are a sequence of chunks, each made of this header
+   followed by 'len' bytes of payload; elements never span chunks and the
+   last chunk is flagged and carries no payload */
+struct imt_chunk_hdr {
+  u_int8_t version;
+  u_int8_t flags;
+  u_int16_t reserved;
+  u_int32_t len;			/* payload length, network byte order */
+  u_int32_t raw_len;			/* uncompressed payload length, network byte order */
 };
 
 struct query_entry {
@@ -90,11 +159,106 @@ struct query_entry {
   struct pkt_vlen_hdr_primitives *pvlen;	/* variable-length data */
 };
 
+struct imt_rcu {
+  struct acc *table;
+  u_int32_t epoch;
+  u_int32_t readers[2];
+  u_int64_t mark;		/* table epoch (struct imt_epoch) at the last flip */
+  u_int64_t safe;		/* elements hidden up to this table epoch can be reused */
+};
+
+/* with the open layout lookups are served by an open addressing index
+   of the table, resized as it fills up, rather than by walking collision
+   chains; the bucket array and its chains are still maintained as they
+   are what readers walk */
+struct imt_index_entry {
+  u_int32_t signature;
+  struct acc *elem;
+};
+
+struct imt_index {
+  struct imt_index_entry *entries;
+  u_int32_t size;
+  u_int32_t used;
+  u_int32_t deleted;
+  u_int32_t extras_len;		/* fixed-size extras laid out next to each element */
+};
+
+/* every update of an entry advances the epoch of the table and stamps
+   the entry with it, so that pollers can ask for changes since the last
+   epoch they have seen (WANT_DELTA); it lives in shared memory as forked
+   children serve queries too. Only the plugin writes it */
+struct imt_epoch {
+  u_int64_t current;
+  u_int64_t erased;		/* epoch at the last erasure of the table */
+};
+
+/* a persistent table is a file made of this header followed by the
+   memory pool descriptors and the memory pools themselves, bucket array
+   included; pointers are valid as of 'base' and relocated on restore if
+   the file gets mapped elsewhere */
+struct imt_table_file_hdr {
+  u_int32_t magic;
+  u_int32_t version;
+  u_int32_t acc_size;
+  u_int32_t buckets;
+  u_int32_t num_memory_pools;
+  u_int32_t memory_pool_size;
+  u_int32_t cust_len;
+  u_int32_t table_layout;
+  pm_cfgreg_t what_to_count;
+  pm_cfgreg_t what_to_count_2;
+  struct extra_primitives extras;
+  u_int64_t size;
+  u_int64_t used;
+  unsigned char *base;
+  unsigned char *mpd;
+  struct memory_pool_desc *current_pool;
+  struct imt_epoch epoch;
+  struct timeval table_reset_stamp;
+};
+
+struct imt_query {
+  int sd;
+  int len;
+  int datasize;
+  struct extra_primitives *extras;
+  unsigned char *buf;
+};
+
+struct imt_selected {
+  pm_counter_t key;
+  struct acc *elem;
+};
+
+struct imt_selection {
+  struct query_header *q;
+  struct imt_selected *elems;
+  u_int32_t num;
+  u_int32_t size;
+  u_int32_t max;
+  u_int32_t skipped;
+  u_int32_t sent;
+};
+
 struct reply_buffer {
   unsigned char buf[LARGEBUFLEN];
   unsigned char *ptr;
   int len;
   int packed; 
+  u_int8_t stream;
+  u_int8_t stream_flags;
+  int err;
+  unsigned char *zbuf;
+  struct query_header *hdr;	/* reply header, queued before the first element */
+  int hdr_len;
+  int defer;			/* spool the reply, see enQueue_spool_send() */
+  int timeout;			/* msecs a send may wait for the client, 0 if unbounded */
+  unsigned char *spool;
+  size_t spool_len;
+  size_t spool_size;
+  u_int32_t rcu_epoch;		/* read-side section of the walk, see imt_rcu_read_lock() */
+  u_int64_t erased;		/* erasure epoch of the table as of the start of the walk */
 };
 
 struct stripped_class {
@@ -122,21 +286,52 @@ struct imt_custom_primitives {
 
 /* prototypes */
 extern void insert_accounting_structure(struct primitives_ptrs *);
-extern struct acc *search_accounting_structure(struct primitives_ptrs *);
+extern struct acc *search_accounting_structure(struct acc *, struct primitives_ptrs *);
 extern int compare_accounting_structure(struct acc *, struct primitives_ptrs *);
 
 extern void init_memory_pool_table();
 extern void clear_memory_pool_table();
 extern struct memory_pool_desc *request_memory_pool(int);
+extern int imt_table_file_open(struct extra_primitives *);
+extern void imt_table_file_sync(int);
+
+extern void imt_rcu_publish(struct acc *);
+extern void imt_rcu_unpublish();
+extern struct acc *imt_rcu_read_lock(u_int32_t *);
+extern void imt_rcu_read_unlock(u_int32_t);
+extern void imt_rcu_poll();
+
+extern void imt_index_init(u_int32_t, u_int32_t);
+extern void imt_index_rebuild(struct acc *);
+extern void imt_index_clear();
+extern struct acc *imt_index_lookup(u_int32_t, struct primitives_ptrs *);
+extern void imt_index_add(u_int32_t, struct acc *);
+extern void imt_index_del(u_int32_t, struct acc *);
+extern void *imt_extras_alloc(int);
+extern void imt_extras_free(void *);
+extern void *imt_extras_release(void *, int);
+
+extern void imt_epoch_init();
+extern void imt_epoch_erase();
 
 extern void set_reset_flag(struct acc *);
 extern void reset_counters(struct acc *);
 extern int build_query_server(char *);
+extern int imt_query_check(unsigned char *, int *, int);
 extern void process_query_data(int, unsigned char *, int, struct extra_primitives *, int, int);
 extern void mask_elem(struct pkt_primitives *, struct pkt_bgp_primitives *, struct pkt_legacy_bgp_primitives *,
 			struct pkt_nat_primitives *, struct pkt_mpls_primitives *, struct pkt_tunnel_primitives *,
 			struct acc *, u_int64_t, u_int64_t, struct extra_primitives *);
 extern void enQueue_elem(int, struct reply_buffer *, void *, int, int);
+extern void enQueue_flush(int, struct reply_buffer *);
+extern void enQueue_eof(int, struct reply_buffer *);
+extern void enQueue_spool_send(int, struct reply_buffer *);
+extern int enQueue_spool_yield(int, struct reply_buffer *);
+extern void enQueue_acc(int, struct reply_buffer *, struct acc *, struct extra_primitives *, int);
+extern void imt_select_init(struct imt_selection *, struct query_header *);
+extern int imt_select_elem(int, struct reply_buffer *, struct imt_selection *, struct acc *, struct extra_primitives *, int);
+extern void imt_select_flush(int, struct reply_buffer *, struct imt_selection *, struct extra_primitives *, int);
+extern void imt_select_free(struct imt_selection *);
 extern void Accumulate_Counters(struct pkt_data *, struct acc *);
 extern int test_zero_elem(struct acc *);
 
@@ -146,6 +341,7 @@ extern void sum_as_insert(struct primitives_ptrs *);
 #if defined HAVE_L2
 extern void sum_mac_insert(struct primitives_ptrs *);
 #endif
+extern void imt_query_thread(struct imt_query *);
 extern void exit_now(int);
 extern void free_extra_allocs();
 
@@ -158,4 +354,8 @@ extern struct acc **lru_elem_ptr; /* pointer to Last Recently Used (lru) element
 extern int no_more_space;
 extern struct timeval cycle_stamp; /* timestamp for the current cycle */
 extern struct timeval table_reset_stamp; /* global table reset timestamp */
+extern struct imt_rcu imt_rcu;
+extern struct imt_index imt_index;
+extern struct imt_epoch *imt_epoch;
+extern struct imt_table_file_hdr *imt_file;
 #endif //IMT_PLUGIN_H
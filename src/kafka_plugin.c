@@ -565,6 +565,8 @@ void kafka_cache_purge(struct chained_cache *queue[], int index, int safe_action
 			   pvlen, queue[j]->bytes_counter, queue[j]->packet_counter,
 			   queue[j]->flow_counter, queue[j]->tcp_flags, &queue[j]->basetime,
 			   queue[j]->stitch, avro_iface);
+
+      if (config.distinct_what_to_count) add_distinct_count_avro(avro_value, queue[j]->flow_type, P_cache_distinct_count(queue[j]));
       size_t avro_value_size;
 
       add_writer_name_and_pid_avro(avro_value, config.name, writer_pid);
@@ -26,12 +26,30 @@
 /* rules:
    first pool descriptor id is 1 */
 
+/* global variables */
+struct imt_table_file_hdr *imt_file;
+
 /* functions */
+static void *map_memory_pool(size_t size)
+{
+  void *ptr;
+
+  if (!imt_file) return map_shared(0, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+
+  size = IMT_TABLE_FILE_ALIGN(size);
+  if (imt_file->used + size > imt_file->size) return MAP_FAILED;
+
+  ptr = ((u_char *) imt_file) + imt_file->used;
+  imt_file->used += size;
+
+  return ptr;
+}
+
 void init_memory_pool_table()
 {
   if (config.num_memory_pools) {
-    mpd = (unsigned char *) map_shared(0, (config.num_memory_pools+1)*sizeof(struct memory_pool_desc),
-				   PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    mpd = (unsigned char *) map_memory_pool((config.num_memory_pools+1)*sizeof(struct memory_pool_desc));
+    if (imt_file) imt_file->mpd = mpd;
     memset(mpd, 0, (config.num_memory_pools+1)*sizeof(struct memory_pool_desc));
   }
   else {
@@ -82,6 +100,7 @@ struct memory_pool_desc *request_memory_pool(int size)
       memset(new_pool->base_ptr, 0, size);
       new_pool->ptr = new_pool->base_ptr;
       new_pool->space_left = size;
+      if (imt_file) imt_file->current_pool = new_pool;
       return new_pool; 
     }
   }
@@ -117,7 +136,7 @@ struct memory_pool_desc *request_memory_pool(int size)
 
   /* We found a free room in mpd table; now we have
      allocate needed memory */
-  memptr = (unsigned char *) map_shared(0, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+  memptr = (unsigned char *) map_memory_pool(size);
   if (memptr == MAP_FAILED) {
     Log(LOG_WARNING, "WARN ( %s/%s ): memory sold out ! Please, clear in-memory stats !\n", config.name, config.type);
     return NULL;
@@ -129,5 +148,199 @@ struct memory_pool_desc *request_memory_pool(int size)
   new_pool->ptr = memptr;
   new_pool->space_left = size;
   new_pool->len = size;
+  if (imt_file) imt_file->current_pool = new_pool;
   return new_pool;
 }
+
+static u_int64_t imt_table_file_size()
+{
+  u_int64_t size;
+
+  size = IMT_TABLE_FILE_ALIGN(sizeof(struct imt_table_file_hdr));
+  size += IMT_TABLE_FILE_ALIGN((config.num_memory_pools+1)*sizeof(struct memory_pool_desc));
+  size += IMT_TABLE_FILE_ALIGN(config.buckets*sizeof(struct acc));
+  size += (config.num_memory_pools*IMT_TABLE_FILE_ALIGN(config.memory_pool_size));
+
+  return size;
+}
+
+static int imt_table_file_compatible(struct imt_table_file_hdr *hdr, struct extra_primitives *extras, u_int64_t size)
+{
+  if (hdr->magic != IMT_TABLE_FILE_MAGIC || hdr->version != IMT_TABLE_FILE_VERSION) return FALSE;
+  if (hdr->acc_size != sizeof(struct acc) || hdr->size != size) return FALSE;
+  if (hdr->buckets != config.buckets || hdr->num_memory_pools != config.num_memory_pools ||
+      hdr->memory_pool_size != config.memory_pool_size) return FALSE;
+  if (hdr->what_to_count != config.what_to_count || hdr->what_to_count_2 != config.what_to_count_2 ||
+      hdr->cust_len != config.cpptrs.len || hdr->table_layout != config.imt_table_layout) return FALSE;
+  if (memcmp(&hdr->extras, extras, sizeof(struct extra_primitives))) return FALSE;
+
+  return TRUE;
+}
+
+#define IMT_TABLE_FILE_RELOC(ptr, delta) if (ptr) (ptr) = (void *) ((u_char *)(ptr) + (delta))
+
+/* makes pointers stored in the file valid again for where it is mapped */
+static void imt_table_file_relocate(ptrdiff_t delta)
+{
+  struct memory_pool_desc *pool_ptr;
+  struct acc *acc_elem;
+  unsigned int idx;
+
+  IMT_TABLE_FILE_RELOC(imt_file->mpd, delta);
+  IMT_TABLE_FILE_RELOC(imt_file->current_pool, delta);
+
+  pool_ptr = (struct memory_pool_desc *) imt_file->mpd;
+  for (idx = 0; idx <= config.num_memory_pools; idx++, pool_ptr++) {
+    IMT_TABLE_FILE_RELOC(pool_ptr->base_ptr, delta);
+    IMT_TABLE_FILE_RELOC(pool_ptr->ptr, delta);
+    IMT_TABLE_FILE_RELOC(pool_ptr->next, delta);
+  }
+
+  pool_ptr = (struct memory_pool_desc *) imt_file->mpd;
+  for (idx = 0; idx < config.buckets; idx++) {
+    for (acc_elem = ((struct acc *) pool_ptr->base_ptr) + idx; acc_elem; acc_elem = acc_elem->next) {
+      IMT_TABLE_FILE_RELOC(acc_elem->pbgp, delta);
+      IMT_TABLE_FILE_RELOC(acc_elem->pnat, delta);
+      IMT_TABLE_FILE_RELOC(acc_elem->pmpls, delta);
+      IMT_TABLE_FILE_RELOC(acc_elem->ptun, delta);
+      IMT_TABLE_FILE_RELOC(acc_elem->pcust, delta);
+      IMT_TABLE_FILE_RELOC(acc_elem->next, delta);
+    }
+  }
+}
+
+/* pointers are never relocated in the file itself: a crash halfway would
+   leave it neither here nor there. They are relocated in a copy, which
+   replaces the file only once complete and synced */
+static void *imt_table_file_relocate_copy(void *orig, u_int64_t size)
+{
+  char tmp_file[SRVBUFLEN];
+  void *base;
+  int fd;
+
+  snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", config.imt_table_file);
+
+  fd = open(tmp_file, O_RDWR|O_CREAT|O_TRUNC, 0600);
+  if (fd == ERR || ftruncate(fd, size) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to create '%s': %s. Exiting ..\n", config.name, config.type, tmp_file, strerror(errno));
+    exit_gracefully(1);
+  }
+
+  base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (base == MAP_FAILED) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to mmap() '%s': %s. Exiting ..\n", config.name, config.type, tmp_file, strerror(errno));
+    unlink(tmp_file);
+    exit_gracefully(1);
+  }
+
+  memcpy(base, orig, size);
+  munmap(orig, size);
+
+  imt_file = base;
+  imt_table_file_relocate((u_char *) base - imt_file->base);
+  imt_file->base = base;
+
+  if (msync(base, size, MS_SYNC) == ERR || rename(tmp_file, config.imt_table_file) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to replace imt_table_file '%s': %s. Exiting ..\n", config.name, config.type, config.imt_table_file, strerror(errno));
+    unlink(tmp_file);
+    exit_gracefully(1);
+  }
+
+  return base;
+}
+
+/*
+   Backs the memory pools with a file mapped MAP_SHARED. If the file holds
+   a table compatible with the current configuration, it is restored as
+   is and TRUE is returned; otherwise the file is (re)initialized. As new
+   elements are made visible only once complete (see acct.c), the file is
+   consistent at any time and so is a table restored after a crash of the
+   daemon; a crash of the system may lose recent updates to it instead,
+   up to the last imt_table_file_sync().
+*/
+int imt_table_file_open(struct extra_primitives *extras)
+{
+  struct imt_table_file_hdr hdr;
+  struct memory_pool_desc *pool_ptr;
+  struct acc *acc_elem;
+  u_int64_t size = imt_table_file_size();
+  unsigned int idx;
+  int fd, restore = FALSE;
+  void *base;
+
+  fd = open(config.imt_table_file, O_RDWR|O_CREAT, 0600);
+  if (fd == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to open imt_table_file '%s': %s. Exiting ..\n", config.name, config.type, config.imt_table_file, strerror(errno));
+    exit_gracefully(1);
+  }
+
+  if (read(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+    if (imt_table_file_compatible(&hdr, extras, size)) restore = TRUE;
+    else Log(LOG_WARNING, "WARN ( %s/%s ): imt_table_file '%s' does not match the current configuration. Starting afresh.\n", config.name, config.type, config.imt_table_file);
+  }
+
+  if (!restore && (ftruncate(fd, 0) == ERR || ftruncate(fd, size) == ERR)) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to size imt_table_file '%s': %s. Exiting ..\n", config.name, config.type, config.imt_table_file, strerror(errno));
+    exit_gracefully(1);
+  }
+
+  /* mapping the file where it was saves relocating it, see below */
+  base = mmap(restore ? (void *) hdr.base : NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (base == MAP_FAILED) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): Unable to mmap() imt_table_file '%s': %s. Exiting ..\n", config.name, config.type, config.imt_table_file, strerror(errno));
+    exit_gracefully(1);
+  }
+
+  imt_file = base;
+
+  if (!restore) {
+    memset(imt_file, 0, sizeof(struct imt_table_file_hdr));
+    imt_file->magic = IMT_TABLE_FILE_MAGIC;
+    imt_file->version = IMT_TABLE_FILE_VERSION;
+    imt_file->acc_size = sizeof(struct acc);
+    imt_file->buckets = config.buckets;
+    imt_file->num_memory_pools = config.num_memory_pools;
+    imt_file->memory_pool_size = config.memory_pool_size;
+    imt_file->cust_len = config.cpptrs.len;
+    imt_file->table_layout = config.imt_table_layout;
+    imt_file->what_to_count = config.what_to_count;
+    imt_file->what_to_count_2 = config.what_to_count_2;
+    memcpy(&imt_file->extras, extras, sizeof(struct extra_primitives));
+    imt_file->size = size;
+    imt_file->used = IMT_TABLE_FILE_ALIGN(sizeof(struct imt_table_file_hdr));
+    imt_file->base = base;
+
+    return FALSE;
+  }
+
+  if (imt_file->base != base) base = imt_table_file_relocate_copy(base, size);
+
+  mpd = imt_file->mpd;
+  current_pool = imt_file->current_pool;
+
+  /*
+     heap allocations did not survive; none is expected as legacy BGP
+     primitives are refused with imt_table_file and variable-length ones
+     by the IMT plugin altogether, see imt_plugin()
+  */
+  pool_ptr = (struct memory_pool_desc *) mpd;
+  for (idx = 0; idx < config.buckets; idx++) {
+    for (acc_elem = ((struct acc *) pool_ptr->base_ptr) + idx; acc_elem; acc_elem = acc_elem->next) {
+      acc_elem->clbgp = NULL;
+      acc_elem->pvlen = NULL;
+    }
+  }
+
+  Log(LOG_INFO, "INFO ( %s/%s ): Memory table restored from '%s'.\n", config.name, config.type, config.imt_table_file);
+
+  return TRUE;
+}
+
+void imt_table_file_sync(int flags)
+{
+  if (imt_file) msync(imt_file, imt_file->size, flags);
+}
@@ -37,6 +37,7 @@
 
 /* Global variables */
 mongo db_conn;
+struct mongodb_skel mongodb_skel_prims, mongodb_skel_counters;
 
 /* Functions */
 void mongodb_legacy_warning(int pipe_fd, struct configuration *cfgptr, void *ptr) 
@@ -105,7 +106,8 @@ void mongodb_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   else if (config.what_to_count & COUNT_SUM_MAC) insert_func = P_sum_mac_insert;
 #endif
   else insert_func = P_cache_insert;
-  purge_func = MongoDB_cache_purge;
+  if (config.sql_parallel_writers > 1) purge_func = MongoDB_cache_purge_parallel;
+  else purge_func = MongoDB_cache_purge;
 
   memset(&nt, 0, sizeof(nt));
   memset(&nc, 0, sizeof(nc));
@@ -143,6 +145,7 @@ void mongodb_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   mongo_init(&db_conn);
   mongo_set_op_timeout(&db_conn, 1000);
   bson_set_oid_fuzz(&MongoDB_oid_fuzz);
+  MongoDB_skel_init();
 
   /* plugin main loop */
   for(;;) {
@@ -435,7 +438,6 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
       }
 
       bson_init(bson_elem);
-      bson_append_new_oid(bson_elem, "_id" );
 
       data = &queue[j]->primitives;
       if (queue[j]->pbgp) pbgp = queue[j]->pbgp;
@@ -457,9 +459,10 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
       else pvlen = NULL;
   
       if (queue[j]->valid == PRINT_CACHE_FREE) continue;
+
+      /* _id and all fixed-size fields; variable ones follow */
+      MongoDB_skel_append(bson_elem, &mongodb_skel_prims, queue[j], pbgp, pnat, pmpls, ptun);
   
-      if (config.what_to_count & COUNT_TAG) bson_append_long(bson_elem, "tag", data->tag);
-      if (config.what_to_count & COUNT_TAG2) bson_append_long(bson_elem, "tag2", data->tag2);
       if (config.what_to_count_2 & COUNT_LABEL) MongoDB_append_string(bson_elem, "label", pvlen, COUNT_INT_LABEL); 
 
       if (config.what_to_count & COUNT_CLASS) bson_append_string(bson_elem, "class", ((data->class && class[(data->class)-1].id) ? class[(data->class)-1].protocol : "unknown" ));
@@ -484,15 +487,11 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
         bson_append_string(bson_elem, "mac_dst", dst_mac);
       }
   
-      if (config.what_to_count & COUNT_VLAN) bson_append_int(bson_elem, "vlan_id", data->vlan_id);
-      if (config.what_to_count & COUNT_COS) bson_append_int(bson_elem, "cos", data->cos);
       if (config.what_to_count & COUNT_ETHERTYPE) {
         sprintf(misc_str, "%x", data->etype); 
         bson_append_string(bson_elem, "etype", misc_str);
       }
   #endif
-      if (config.what_to_count & (COUNT_SRC_AS|COUNT_SUM_AS)) bson_append_int(bson_elem, "as_src", data->src_as);
-      if (config.what_to_count & COUNT_DST_AS) bson_append_int(bson_elem, "as_dst", data->dst_as);
   
       if (config.what_to_count & COUNT_STD_COMM) {
         vlen_prims_get(pvlen, COUNT_INT_STD_COMM, &str_ptr);
@@ -546,12 +545,8 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
 	MongoDB_append_string(bson_elem, "as_path", pvlen, COUNT_INT_AS_PATH);
       }
   
-      if (config.what_to_count & COUNT_LOCAL_PREF) bson_append_int(bson_elem, "local_pref", pbgp->local_pref);
-      if (config.what_to_count & COUNT_MED) bson_append_int(bson_elem, "med", pbgp->med);
       if (config.what_to_count_2 & COUNT_DST_ROA) bson_append_string(bson_elem, "roa_dst", rpki_roa_print(pbgp->dst_roa));
 
-      if (config.what_to_count & COUNT_PEER_SRC_AS) bson_append_int(bson_elem, "peer_as_src", pbgp->peer_src_as);
-      if (config.what_to_count & COUNT_PEER_DST_AS) bson_append_int(bson_elem, "peer_as_dst", pbgp->peer_dst_as);
   
       if (config.what_to_count & COUNT_PEER_SRC_IP) {
         addr_to_str(ip_address, &pbgp->peer_src_ip);
@@ -614,19 +609,14 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
         MongoDB_append_string(bson_elem, "src_as_path", pvlen, COUNT_INT_SRC_AS_PATH);
       }
 
-      if (config.what_to_count & COUNT_SRC_LOCAL_PREF) bson_append_int(bson_elem, "src_local_pref", pbgp->src_local_pref);
-      if (config.what_to_count & COUNT_SRC_MED) bson_append_int(bson_elem, "src_med", pbgp->src_med);
       if (config.what_to_count_2 & COUNT_SRC_ROA) bson_append_string(bson_elem, "roa_src", rpki_roa_print(pbgp->src_roa));
   
-      if (config.what_to_count & COUNT_IN_IFACE) bson_append_int(bson_elem, "iface_in", data->ifindex_in);
-      if (config.what_to_count & COUNT_OUT_IFACE) bson_append_int(bson_elem, "iface_out", data->ifindex_out);
   
       if (config.what_to_count & COUNT_MPLS_VPN_RD) {
         bgp_rd2str(rd_str, &pbgp->mpls_vpn_rd);
         bson_append_string(bson_elem, "mpls_vpn_rd", rd_str);
       }
 
-      if (config.what_to_count_2 & COUNT_MPLS_PW_ID) bson_append_int(bson_elem, "mpls_pw_id", pbgp->mpls_pw_id);
 
       if (config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST)) {
         addr_to_str(src_host, &data->src_ip);
@@ -648,10 +638,6 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
         bson_append_string(bson_elem, "net_dst", dst_host);
       }
   
-      if (config.what_to_count & COUNT_SRC_NMASK) bson_append_int(bson_elem, "mask_src", data->src_nmask);
-      if (config.what_to_count & COUNT_DST_NMASK) bson_append_int(bson_elem, "mask_dst", data->dst_nmask);
-      if (config.what_to_count & (COUNT_SRC_PORT|COUNT_SUM_PORT)) bson_append_int(bson_elem, "port_src", data->src_port);
-      if (config.what_to_count & COUNT_DST_PORT) bson_append_int(bson_elem, "port_dst", data->dst_port);
 
   #if defined (WITH_GEOIP)
       if (config.what_to_count_2 & COUNT_SRC_HOST_COUNTRY) {
@@ -694,14 +680,6 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
           bson_append_null(bson_elem, "pocode_ip_dst");
       }
 
-      if (config.what_to_count_2 & COUNT_SRC_HOST_COORDS) {
-        bson_append_double(bson_elem, "lat_ip_src", data->src_ip_lat);
-        bson_append_double(bson_elem, "lon_ip_src", data->src_ip_lon);
-      }
-      if (config.what_to_count_2 & COUNT_DST_HOST_COORDS) {
-        bson_append_double(bson_elem, "lat_ip_dst", data->dst_ip_lat);
-        bson_append_double(bson_elem, "lon_ip_dst", data->dst_ip_lon);
-      }
   #endif
 
       if (config.what_to_count & COUNT_TCPFLAGS) {
@@ -715,8 +693,6 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
 	bson_append_string(bson_elem, "ip_proto", ip_proto_print(data->proto, proto, PROTO_NUM_STRLEN));
       }
   
-      if (config.what_to_count & COUNT_IP_TOS) bson_append_int(bson_elem, "tos", data->tos);
-      if (config.what_to_count_2 & COUNT_SAMPLING_RATE) bson_append_int(bson_elem, "sampling_rate", data->sampling_rate);
       if (config.what_to_count_2 & COUNT_SAMPLING_DIRECTION) bson_append_string(bson_elem, "sampling_direction", data->sampling_direction);
   
       if (config.what_to_count_2 & COUNT_POST_NAT_SRC_HOST) {
@@ -727,12 +703,6 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
         addr_to_str(dst_host, &pnat->post_nat_dst_ip);
         bson_append_string(bson_elem, "post_nat_ip_dst", dst_host);
       }
-      if (config.what_to_count_2 & COUNT_POST_NAT_SRC_PORT) bson_append_int(bson_elem, "post_nat_port_src", pnat->post_nat_src_port);
-      if (config.what_to_count_2 & COUNT_POST_NAT_DST_PORT) bson_append_int(bson_elem, "post_nat_port_dst", pnat->post_nat_dst_port);
-      if (config.what_to_count_2 & COUNT_NAT_EVENT) bson_append_int(bson_elem, "nat_event", pnat->nat_event);
-      if (config.what_to_count_2 & COUNT_MPLS_LABEL_TOP) bson_append_int(bson_elem, "mpls_label_top", pmpls->mpls_label_top);
-      if (config.what_to_count_2 & COUNT_MPLS_LABEL_BOTTOM) bson_append_int(bson_elem, "mpls_label_bottom", pmpls->mpls_label_bottom);
-      if (config.what_to_count_2 & COUNT_MPLS_STACK_DEPTH) bson_append_int(bson_elem, "mpls_stack_depth", pmpls->mpls_stack_depth);
 
       if (config.what_to_count_2 & COUNT_TUNNEL_SRC_MAC) {
         etheraddr_string(ptun->tunnel_eth_shost, src_mac);
@@ -756,64 +726,30 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
 	bson_append_string(bson_elem, "tunnel_ip_proto", ip_proto_print(ptun->tunnel_proto, proto, PROTO_NUM_STRLEN));
       }
 
-      if (config.what_to_count_2 & COUNT_TUNNEL_IP_TOS) bson_append_int(bson_elem, "tunnel_tos", ptun->tunnel_tos);
-      if (config.what_to_count_2 & COUNT_TUNNEL_SRC_PORT) bson_append_int(bson_elem, "tunnel_port_src", ptun->tunnel_src_port);
-      if (config.what_to_count_2 & COUNT_TUNNEL_DST_PORT) bson_append_int(bson_elem, "tunnel_port_dst", ptun->tunnel_dst_port);
-      if (config.what_to_count_2 & COUNT_VXLAN) bson_append_int(bson_elem, "vxlan", ptun->tunnel_id);
-  
-      if (config.what_to_count_2 & COUNT_TIMESTAMP_START) {
-	if (config.timestamps_since_epoch) {
-	  char tstamp_str[SRVBUFLEN];
-
-	  compose_timestamp(tstamp_str, SRVBUFLEN, &pnat->timestamp_start, TRUE,
-			    config.timestamps_since_epoch, config.timestamps_rfc3339,
-			    config.timestamps_utc);
-	  bson_append_string(bson_elem, "timestamp_start", tstamp_str);
-	}
-	else {
-          bson_date_t bdate;
   
-	  bdate = 1000*pnat->timestamp_start.tv_sec;
-	  if (pnat->timestamp_start.tv_usec) bdate += (pnat->timestamp_start.tv_usec/1000);
+      if ((config.what_to_count_2 & COUNT_TIMESTAMP_START) && config.timestamps_since_epoch) {
+        char tstamp_str[SRVBUFLEN];
 
-	  bson_append_date(bson_elem, "timestamp_start", bdate);
-	}
+        compose_timestamp(tstamp_str, SRVBUFLEN, &pnat->timestamp_start, TRUE,
+			  config.timestamps_since_epoch, config.timestamps_rfc3339,
+			  config.timestamps_utc);
+        bson_append_string(bson_elem, "timestamp_start", tstamp_str);
       }
-      if (config.what_to_count_2 & COUNT_TIMESTAMP_END) {
-        if (config.timestamps_since_epoch) {
-          char tstamp_str[SRVBUFLEN];
-
-          compose_timestamp(tstamp_str, SRVBUFLEN, &pnat->timestamp_end, TRUE,
-			    config.timestamps_since_epoch, config.timestamps_rfc3339,
-			    config.timestamps_utc);
-          bson_append_string(bson_elem, "timestamp_end", tstamp_str);
-        }
-        else {
-          bson_date_t bdate;
-
-          bdate = 1000*pnat->timestamp_end.tv_sec;
-          if (pnat->timestamp_end.tv_usec) bdate += (pnat->timestamp_end.tv_usec/1000);
+      if ((config.what_to_count_2 & COUNT_TIMESTAMP_END) && config.timestamps_since_epoch) {
+        char tstamp_str[SRVBUFLEN];
 
-          bson_append_date(bson_elem, "timestamp_end", bdate);
-	}
+        compose_timestamp(tstamp_str, SRVBUFLEN, &pnat->timestamp_end, TRUE,
+			  config.timestamps_since_epoch, config.timestamps_rfc3339,
+			  config.timestamps_utc);
+        bson_append_string(bson_elem, "timestamp_end", tstamp_str);
       }
-      if (config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) {
-        if (config.timestamps_since_epoch) {
-          char tstamp_str[SRVBUFLEN];
-
-          compose_timestamp(tstamp_str, SRVBUFLEN, &pnat->timestamp_arrival, TRUE,
-			    config.timestamps_since_epoch, config.timestamps_rfc3339,
-			    config.timestamps_utc);
-          bson_append_string(bson_elem, "timestamp_arrival", tstamp_str);
-        }
-        else {
-          bson_date_t bdate;
+      if ((config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) && config.timestamps_since_epoch) {
+        char tstamp_str[SRVBUFLEN];
 
-          bdate = 1000*pnat->timestamp_arrival.tv_sec;
-          if (pnat->timestamp_arrival.tv_usec) bdate += (pnat->timestamp_arrival.tv_usec/1000);
-
-          bson_append_date(bson_elem, "timestamp_arrival", bdate);
-        }
+        compose_timestamp(tstamp_str, SRVBUFLEN, &pnat->timestamp_arrival, TRUE,
+			  config.timestamps_since_epoch, config.timestamps_rfc3339,
+			  config.timestamps_utc);
+        bson_append_string(bson_elem, "timestamp_arrival", tstamp_str);
       }
 
       if (config.nfacctd_stitching && queue[j]->stitch) {
@@ -843,9 +779,6 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
 	}
       }
 
-      if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SEQNO) bson_append_int(bson_elem, "export_proto_seqno", data->export_proto_seqno);
-      if (config.what_to_count_2 & COUNT_EXPORT_PROTO_VERSION) bson_append_int(bson_elem, "export_proto_version", data->export_proto_version);
-      if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SYSID) bson_append_int(bson_elem, "export_proto_sysid", data->export_proto_sysid);
   
       /* all custom primitives printed here */
       {
@@ -868,22 +801,8 @@ void MongoDB_cache_purge(struct chained_cache *queue[], int index, int safe_acti
         }
       }
   
-      if (config.sql_history) {
-        bson_append_date(bson_elem, "stamp_inserted", (bson_date_t) 1000*queue[j]->basetime.tv_sec);
-        bson_append_date(bson_elem, "stamp_updated", (bson_date_t) 1000*time(NULL));
-      }
-  
-      if (queue[j]->flow_type != NF9_FTYPE_EVENT && queue[j]->flow_type != NF9_FTYPE_OPTION) {
-  #if defined HAVE_64BIT_COUNTERS
-        bson_append_long(bson_elem, "packets", queue[j]->packet_counter);
-        if (config.what_to_count & COUNT_FLOWS) bson_append_long(bson_elem, "flows", queue[j]->flow_counter);
-        bson_append_long(bson_elem, "bytes", queue[j]->bytes_counter);
-  #else
-        bson_append_int(bson_elem, "packets", queue[j]->packet_counter);
-        if (config.what_to_count & COUNT_FLOWS) bson_append_int(bson_elem, "flows", queue[j]->flow_counter);
-        bson_append_int(bson_elem, "bytes", queue[j]->bytes_counter);
-  #endif
-      }
+      if (queue[j]->flow_type != NF9_FTYPE_EVENT && queue[j]->flow_type != NF9_FTYPE_OPTION)
+        MongoDB_skel_append(bson_elem, &mongodb_skel_counters, queue[j], pbgp, pnat, pmpls, ptun);
   
       bson_finish(bson_elem);
       bson_batch[batch_idx] = bson_elem;
@@ -1005,3 +924,361 @@ int MongoDB_oid_fuzz()
 
   return rand();
 }
+
+/*
+   Splits the purge among sql_parallel_writers writers, each with its own
+   connection to MongoDB and a contiguous slice of the queue: documents
+   are only ever inserted, so any split will do. Returns once all writers
+   are done.
+*/
+void MongoDB_cache_purge_parallel(struct chained_cache *queue[], int index, int safe_action)
+{
+  struct timeval start, stop;
+  void (*sigchld_handler)(int);
+  pid_t *writers, cpid;
+  int part, first, num, status, active = 0, writers_num = config.sql_parallel_writers;
+  unsigned long elapsed, slowest = 0;
+
+  if (index < writers_num) writers_num = index;
+  if (writers_num < 2) {
+    MongoDB_cache_purge(queue, index, safe_action);
+    return;
+  }
+
+  writers = malloc(writers_num * sizeof(pid_t));
+  if (!writers) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (MongoDB_cache_purge_parallel). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  /* writers are waited for below, not by the inherited handler */
+  sigchld_handler = signal(SIGCHLD, SIG_DFL);
+  gettimeofday(&start, NULL);
+
+  for (part = 0; part < writers_num; part++) {
+    first = ((u_int64_t) index * part) / writers_num;
+    num = (((u_int64_t) index * (part + 1)) / writers_num) - first;
+
+    switch (writers[part] = fork()) {
+    case 0: /* Child */
+      pm_setproctitle("%s %s %u/%u [%s]", config.type, "Plugin -- Writer", part+1, writers_num, config.name);
+      config.is_forked = TRUE;
+
+      MongoDB_cache_purge(&queue[first], num, TRUE);
+
+      exit_gracefully(0);
+    case -1:
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to fork writer %u/%u: %s. Purging in place.\n", config.name, config.type,
+	  part+1, writers_num, strerror(errno));
+      MongoDB_cache_purge(&queue[first], num, TRUE);
+      break;
+    default: /* Parent */
+      active++;
+      break;
+    }
+  }
+
+  while (active && (cpid = wait(&status)) > 0) {
+    for (part = 0; part < writers_num; part++) {
+      if (writers[part] == cpid) break;
+    }
+    if (part == writers_num) continue;
+
+    active--;
+    gettimeofday(&stop, NULL);
+    elapsed = ((stop.tv_sec - start.tv_sec) * 1000) + ((stop.tv_usec - start.tv_usec) / 1000);
+    if (elapsed > slowest) slowest = elapsed;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+      Log(LOG_WARNING, "WARN ( %s/%s ): Writer %u/%u (PID: %u) failed after %lu ms\n", config.name, config.type,
+	  part+1, writers_num, cpid, elapsed);
+    else
+      Log(LOG_INFO, "INFO ( %s/%s ): Writer %u/%u (PID: %u) done in %lu ms\n", config.name, config.type,
+	  part+1, writers_num, cpid, elapsed);
+  }
+
+  signal(SIGCHLD, sigchld_handler);
+
+  if (slowest > (config.sql_refresh_time * 1000))
+    Log(LOG_WARNING, "WARN ( %s/%s ): Purging cache took %lu ms, longer than mongo_refresh_time. Consider raising mongo_parallel_writers.\n",
+	config.name, config.type, slowest);
+
+  if (config.sql_trigger_exec && !safe_action) P_trigger_exec(config.sql_trigger_exec);
+
+  free(writers);
+}
+
+/*
+   Records are made of the same fields, in the same order, as long as the
+   configuration does not change: fixed-size ones are encoded once here,
+   names and type tags included, so that MongoDB_skel_append() has just to
+   copy them over and patch values in. Fields that may be strings or null
+   depending on the record are still appended one by one.
+*/
+void MongoDB_skel_init()
+{
+  bson skel[1];
+
+  bson_init(skel);
+  MongoDB_skel_add(skel, &mongodb_skel_prims, "_id", BSON_OID, MONGODB_SKEL_OID);
+
+  if (config.what_to_count & COUNT_TAG) MongoDB_skel_add(skel, &mongodb_skel_prims, "tag", BSON_LONG, MONGODB_SKEL_TAG);
+  if (config.what_to_count & COUNT_TAG2) MongoDB_skel_add(skel, &mongodb_skel_prims, "tag2", BSON_LONG, MONGODB_SKEL_TAG2);
+#if defined (HAVE_L2)
+  if (config.what_to_count & COUNT_VLAN) MongoDB_skel_add(skel, &mongodb_skel_prims, "vlan_id", BSON_INT, MONGODB_SKEL_VLAN);
+  if (config.what_to_count & COUNT_COS) MongoDB_skel_add(skel, &mongodb_skel_prims, "cos", BSON_INT, MONGODB_SKEL_COS);
+#endif
+  if (config.what_to_count & (COUNT_SRC_AS|COUNT_SUM_AS)) MongoDB_skel_add(skel, &mongodb_skel_prims, "as_src", BSON_INT, MONGODB_SKEL_SRC_AS);
+  if (config.what_to_count & COUNT_DST_AS) MongoDB_skel_add(skel, &mongodb_skel_prims, "as_dst", BSON_INT, MONGODB_SKEL_DST_AS);
+  if (config.what_to_count & COUNT_LOCAL_PREF) MongoDB_skel_add(skel, &mongodb_skel_prims, "local_pref", BSON_INT, MONGODB_SKEL_LOCAL_PREF);
+  if (config.what_to_count & COUNT_MED) MongoDB_skel_add(skel, &mongodb_skel_prims, "med", BSON_INT, MONGODB_SKEL_MED);
+  if (config.what_to_count & COUNT_PEER_SRC_AS) MongoDB_skel_add(skel, &mongodb_skel_prims, "peer_as_src", BSON_INT, MONGODB_SKEL_PEER_SRC_AS);
+  if (config.what_to_count & COUNT_PEER_DST_AS) MongoDB_skel_add(skel, &mongodb_skel_prims, "peer_as_dst", BSON_INT, MONGODB_SKEL_PEER_DST_AS);
+  if (config.what_to_count & COUNT_SRC_LOCAL_PREF) MongoDB_skel_add(skel, &mongodb_skel_prims, "src_local_pref", BSON_INT, MONGODB_SKEL_SRC_LOCAL_PREF);
+  if (config.what_to_count & COUNT_SRC_MED) MongoDB_skel_add(skel, &mongodb_skel_prims, "src_med", BSON_INT, MONGODB_SKEL_SRC_MED);
+  if (config.what_to_count & COUNT_IN_IFACE) MongoDB_skel_add(skel, &mongodb_skel_prims, "iface_in", BSON_INT, MONGODB_SKEL_IN_IFACE);
+  if (config.what_to_count & COUNT_OUT_IFACE) MongoDB_skel_add(skel, &mongodb_skel_prims, "iface_out", BSON_INT, MONGODB_SKEL_OUT_IFACE);
+  if (config.what_to_count_2 & COUNT_MPLS_PW_ID) MongoDB_skel_add(skel, &mongodb_skel_prims, "mpls_pw_id", BSON_INT, MONGODB_SKEL_MPLS_PW_ID);
+  if (config.what_to_count & COUNT_SRC_NMASK) MongoDB_skel_add(skel, &mongodb_skel_prims, "mask_src", BSON_INT, MONGODB_SKEL_SRC_NMASK);
+  if (config.what_to_count & COUNT_DST_NMASK) MongoDB_skel_add(skel, &mongodb_skel_prims, "mask_dst", BSON_INT, MONGODB_SKEL_DST_NMASK);
+  if (config.what_to_count & (COUNT_SRC_PORT|COUNT_SUM_PORT)) MongoDB_skel_add(skel, &mongodb_skel_prims, "port_src", BSON_INT, MONGODB_SKEL_SRC_PORT);
+  if (config.what_to_count & COUNT_DST_PORT) MongoDB_skel_add(skel, &mongodb_skel_prims, "port_dst", BSON_INT, MONGODB_SKEL_DST_PORT);
+#if defined (WITH_GEOIPV2)
+  if (config.what_to_count_2 & COUNT_SRC_HOST_COORDS) {
+    MongoDB_skel_add(skel, &mongodb_skel_prims, "lat_ip_src", BSON_DOUBLE, MONGODB_SKEL_SRC_LAT);
+    MongoDB_skel_add(skel, &mongodb_skel_prims, "lon_ip_src", BSON_DOUBLE, MONGODB_SKEL_SRC_LON);
+  }
+  if (config.what_to_count_2 & COUNT_DST_HOST_COORDS) {
+    MongoDB_skel_add(skel, &mongodb_skel_prims, "lat_ip_dst", BSON_DOUBLE, MONGODB_SKEL_DST_LAT);
+    MongoDB_skel_add(skel, &mongodb_skel_prims, "lon_ip_dst", BSON_DOUBLE, MONGODB_SKEL_DST_LON);
+  }
+#endif
+  if (config.what_to_count & COUNT_IP_TOS) MongoDB_skel_add(skel, &mongodb_skel_prims, "tos", BSON_INT, MONGODB_SKEL_TOS);
+  if (config.what_to_count_2 & COUNT_SAMPLING_RATE) MongoDB_skel_add(skel, &mongodb_skel_prims, "sampling_rate", BSON_INT, MONGODB_SKEL_SAMPLING_RATE);
+  if (config.what_to_count_2 & COUNT_POST_NAT_SRC_PORT) MongoDB_skel_add(skel, &mongodb_skel_prims, "post_nat_port_src", BSON_INT, MONGODB_SKEL_POST_NAT_SRC_PORT);
+  if (config.what_to_count_2 & COUNT_POST_NAT_DST_PORT) MongoDB_skel_add(skel, &mongodb_skel_prims, "post_nat_port_dst", BSON_INT, MONGODB_SKEL_POST_NAT_DST_PORT);
+  if (config.what_to_count_2 & COUNT_NAT_EVENT) MongoDB_skel_add(skel, &mongodb_skel_prims, "nat_event", BSON_INT, MONGODB_SKEL_NAT_EVENT);
+  if (config.what_to_count_2 & COUNT_MPLS_LABEL_TOP) MongoDB_skel_add(skel, &mongodb_skel_prims, "mpls_label_top", BSON_INT, MONGODB_SKEL_MPLS_LABEL_TOP);
+  if (config.what_to_count_2 & COUNT_MPLS_LABEL_BOTTOM) MongoDB_skel_add(skel, &mongodb_skel_prims, "mpls_label_bottom", BSON_INT, MONGODB_SKEL_MPLS_LABEL_BOTTOM);
+  if (config.what_to_count_2 & COUNT_MPLS_STACK_DEPTH) MongoDB_skel_add(skel, &mongodb_skel_prims, "mpls_stack_depth", BSON_INT, MONGODB_SKEL_MPLS_STACK_DEPTH);
+  if (config.what_to_count_2 & COUNT_TUNNEL_IP_TOS) MongoDB_skel_add(skel, &mongodb_skel_prims, "tunnel_tos", BSON_INT, MONGODB_SKEL_TUNNEL_TOS);
+  if (config.what_to_count_2 & COUNT_TUNNEL_SRC_PORT) MongoDB_skel_add(skel, &mongodb_skel_prims, "tunnel_port_src", BSON_INT, MONGODB_SKEL_TUNNEL_SRC_PORT);
+  if (config.what_to_count_2 & COUNT_TUNNEL_DST_PORT) MongoDB_skel_add(skel, &mongodb_skel_prims, "tunnel_port_dst", BSON_INT, MONGODB_SKEL_TUNNEL_DST_PORT);
+  if (config.what_to_count_2 & COUNT_VXLAN) MongoDB_skel_add(skel, &mongodb_skel_prims, "vxlan", BSON_INT, MONGODB_SKEL_VXLAN);
+
+  if (!config.timestamps_since_epoch) {
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_START) MongoDB_skel_add(skel, &mongodb_skel_prims, "timestamp_start", BSON_DATE, MONGODB_SKEL_TIMESTAMP_START);
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_END) MongoDB_skel_add(skel, &mongodb_skel_prims, "timestamp_end", BSON_DATE, MONGODB_SKEL_TIMESTAMP_END);
+    if (config.what_to_count_2 & COUNT_TIMESTAMP_ARRIVAL) MongoDB_skel_add(skel, &mongodb_skel_prims, "timestamp_arrival", BSON_DATE, MONGODB_SKEL_TIMESTAMP_ARRIVAL);
+  }
+
+  if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SEQNO) MongoDB_skel_add(skel, &mongodb_skel_prims, "export_proto_seqno", BSON_INT, MONGODB_SKEL_EXPORT_PROTO_SEQNO);
+  if (config.what_to_count_2 & COUNT_EXPORT_PROTO_VERSION) MongoDB_skel_add(skel, &mongodb_skel_prims, "export_proto_version", BSON_INT, MONGODB_SKEL_EXPORT_PROTO_VERSION);
+  if (config.what_to_count_2 & COUNT_EXPORT_PROTO_SYSID) MongoDB_skel_add(skel, &mongodb_skel_prims, "export_proto_sysid", BSON_INT, MONGODB_SKEL_EXPORT_PROTO_SYSID);
+
+  if (config.sql_history) {
+    MongoDB_skel_add(skel, &mongodb_skel_prims, "stamp_inserted", BSON_DATE, MONGODB_SKEL_STAMP_INSERTED);
+    MongoDB_skel_add(skel, &mongodb_skel_prims, "stamp_updated", BSON_DATE, MONGODB_SKEL_STAMP_UPDATED);
+  }
+
+  MongoDB_skel_finish(skel, &mongodb_skel_prims);
+
+  /* counters are left out of event and option records */
+  bson_init(skel);
+#if defined HAVE_64BIT_COUNTERS
+  MongoDB_skel_add(skel, &mongodb_skel_counters, "packets", BSON_LONG, MONGODB_SKEL_PACKETS);
+  if (config.what_to_count & COUNT_FLOWS) MongoDB_skel_add(skel, &mongodb_skel_counters, "flows", BSON_LONG, MONGODB_SKEL_FLOWS);
+  if (config.distinct_what_to_count) MongoDB_skel_add(skel, &mongodb_skel_counters, "distinct", BSON_LONG, MONGODB_SKEL_DISTINCT);
+  MongoDB_skel_add(skel, &mongodb_skel_counters, "bytes", BSON_LONG, MONGODB_SKEL_BYTES);
+#else
+  MongoDB_skel_add(skel, &mongodb_skel_counters, "packets", BSON_INT, MONGODB_SKEL_PACKETS);
+  if (config.what_to_count & COUNT_FLOWS) MongoDB_skel_add(skel, &mongodb_skel_counters, "flows", BSON_INT, MONGODB_SKEL_FLOWS);
+  if (config.distinct_what_to_count) MongoDB_skel_add(skel, &mongodb_skel_counters, "distinct", BSON_INT, MONGODB_SKEL_DISTINCT);
+  MongoDB_skel_add(skel, &mongodb_skel_counters, "bytes", BSON_INT, MONGODB_SKEL_BYTES);
+#endif
+  MongoDB_skel_finish(skel, &mongodb_skel_counters);
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): record skeletons: %u fields (%u bytes), %u counters (%u bytes)\n", config.name, config.type,
+	mongodb_skel_prims.num, mongodb_skel_prims.len, mongodb_skel_counters.num, mongodb_skel_counters.len);
+}
+
+void MongoDB_skel_add(bson *skel_bson, struct mongodb_skel *skel, const char *name, u_int8_t type, u_int8_t source)
+{
+  struct mongodb_skel_field *field;
+  bson_oid_t oid;
+
+  if (skel->num == MONGODB_SKEL_FIELDS_MAX) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): too many fields (MongoDB_skel_add). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  field = &skel->fields[skel->num];
+  field->type = type;
+  field->source = source;
+
+  /* the skeleton starts past the document length; the value past the
+     element type and name */
+  field->offset = ((skel_bson->cur - skel_bson->data) - 4) + 1 + (strlen(name) + 1);
+
+  switch (type) {
+  case BSON_OID:
+    memset(&oid, 0, sizeof(oid));
+    bson_append_oid(skel_bson, name, &oid);
+    break;
+  case BSON_LONG:
+    bson_append_long(skel_bson, name, 0);
+    break;
+  case BSON_DATE:
+    bson_append_date(skel_bson, name, 0);
+    break;
+  case BSON_DOUBLE:
+    bson_append_double(skel_bson, name, 0);
+    break;
+  default:
+    bson_append_int(skel_bson, name, 0);
+    break;
+  }
+
+  skel->num++;
+}
+
+void MongoDB_skel_finish(bson *skel_bson, struct mongodb_skel *skel)
+{
+  skel->len = ((skel_bson->cur - skel_bson->data) - 4);
+
+  if (skel->len) {
+    skel->data = malloc(skel->len);
+    if (!skel->data) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (MongoDB_skel_finish). Exiting ..\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    memcpy(skel->data, (skel_bson->data + 4), skel->len);
+  }
+
+  bson_destroy(skel_bson);
+}
+
+static void MongoDB_skel_put32(char *ptr, u_int32_t value)
+{
+  ptr[0] = (value & 0xff);
+  ptr[1] = ((value >> 8) & 0xff);
+  ptr[2] = ((value >> 16) & 0xff);
+  ptr[3] = ((value >> 24) & 0xff);
+}
+
+static void MongoDB_skel_put64(char *ptr, u_int64_t value)
+{
+  MongoDB_skel_put32(ptr, (value & 0xffffffff));
+  MongoDB_skel_put32((ptr + 4), (value >> 32));
+}
+
+static bson_date_t MongoDB_skel_date(struct timeval *tv)
+{
+  bson_date_t bdate = 1000 * (bson_date_t) tv->tv_sec;
+
+  if (tv->tv_usec) bdate += (tv->tv_usec / 1000);
+
+  return bdate;
+}
+
+/* copies a skeleton at the end of a document being built and patches
+   the values of the given cache entry in */
+int MongoDB_skel_append(bson *bson_elem, struct mongodb_skel *skel, struct chained_cache *elem, struct pkt_bgp_primitives *pbgp,
+			struct pkt_nat_primitives *pnat, struct pkt_mpls_primitives *pmpls, struct pkt_tunnel_primitives *ptun)
+{
+  struct pkt_primitives *data = &elem->primitives;
+  struct mongodb_skel_field *field;
+  bson_oid_t oid;
+  double dvalue = 0;
+  u_int64_t value;
+  char *ptr;
+  int num;
+
+  if (!skel->len) return FALSE;
+  if (bson_ensure_space(bson_elem, skel->len) != BSON_OK) return ERR;
+
+  memcpy(bson_elem->cur, skel->data, skel->len);
+
+  for (num = 0; num < skel->num; num++) {
+    field = &skel->fields[num];
+    ptr = (bson_elem->cur + field->offset);
+    value = 0;
+
+    switch (field->source) {
+    case MONGODB_SKEL_OID:
+      bson_oid_gen(&oid);
+      memcpy(ptr, &oid, sizeof(oid));
+      continue;
+    case MONGODB_SKEL_TAG: value = data->tag; break;
+    case MONGODB_SKEL_TAG2: value = data->tag2; break;
+#if defined (HAVE_L2)
+    case MONGODB_SKEL_VLAN: value = data->vlan_id; break;
+    case MONGODB_SKEL_COS: value = data->cos; break;
+#endif
+    case MONGODB_SKEL_SRC_AS: value = data->src_as; break;
+    case MONGODB_SKEL_DST_AS: value = data->dst_as; break;
+    case MONGODB_SKEL_LOCAL_PREF: value = pbgp->local_pref; break;
+    case MONGODB_SKEL_MED: value = pbgp->med; break;
+    case MONGODB_SKEL_PEER_SRC_AS: value = pbgp->peer_src_as; break;
+    case MONGODB_SKEL_PEER_DST_AS: value = pbgp->peer_dst_as; break;
+    case MONGODB_SKEL_SRC_LOCAL_PREF: value = pbgp->src_local_pref; break;
+    case MONGODB_SKEL_SRC_MED: value = pbgp->src_med; break;
+    case MONGODB_SKEL_IN_IFACE: value = data->ifindex_in; break;
+    case MONGODB_SKEL_OUT_IFACE: value = data->ifindex_out; break;
+    case MONGODB_SKEL_MPLS_PW_ID: value = pbgp->mpls_pw_id; break;
+    case MONGODB_SKEL_SRC_NMASK: value = data->src_nmask; break;
+    case MONGODB_SKEL_DST_NMASK: value = data->dst_nmask; break;
+    case MONGODB_SKEL_SRC_PORT: value = data->src_port; break;
+    case MONGODB_SKEL_DST_PORT: value = data->dst_port; break;
+#if defined (WITH_GEOIPV2)
+    case MONGODB_SKEL_SRC_LAT: dvalue = data->src_ip_lat; break;
+    case MONGODB_SKEL_SRC_LON: dvalue = data->src_ip_lon; break;
+    case MONGODB_SKEL_DST_LAT: dvalue = data->dst_ip_lat; break;
+    case MONGODB_SKEL_DST_LON: dvalue = data->dst_ip_lon; break;
+#endif
+    case MONGODB_SKEL_TOS: value = data->tos; break;
+    case MONGODB_SKEL_SAMPLING_RATE: value = data->sampling_rate; break;
+    case MONGODB_SKEL_POST_NAT_SRC_PORT: value = pnat->post_nat_src_port; break;
+    case MONGODB_SKEL_POST_NAT_DST_PORT: value = pnat->post_nat_dst_port; break;
+    case MONGODB_SKEL_NAT_EVENT: value = pnat->nat_event; break;
+    case MONGODB_SKEL_MPLS_LABEL_TOP: value = pmpls->mpls_label_top; break;
+    case MONGODB_SKEL_MPLS_LABEL_BOTTOM: value = pmpls->mpls_label_bottom; break;
+    case MONGODB_SKEL_MPLS_STACK_DEPTH: value = pmpls->mpls_stack_depth; break;
+    case MONGODB_SKEL_TUNNEL_TOS: value = ptun->tunnel_tos; break;
+    case MONGODB_SKEL_TUNNEL_SRC_PORT: value = ptun->tunnel_src_port; break;
+    case MONGODB_SKEL_TUNNEL_DST_PORT: value = ptun->tunnel_dst_port; break;
+    case MONGODB_SKEL_VXLAN: value = ptun->tunnel_id; break;
+    case MONGODB_SKEL_TIMESTAMP_START: value = MongoDB_skel_date(&pnat->timestamp_start); break;
+    case MONGODB_SKEL_TIMESTAMP_END: value = MongoDB_skel_date(&pnat->timestamp_end); break;
+    case MONGODB_SKEL_TIMESTAMP_ARRIVAL: value = MongoDB_skel_date(&pnat->timestamp_arrival); break;
+    case MONGODB_SKEL_EXPORT_PROTO_SEQNO: value = data->export_proto_seqno; break;
+    case MONGODB_SKEL_EXPORT_PROTO_VERSION: value = data->export_proto_version; break;
+    case MONGODB_SKEL_EXPORT_PROTO_SYSID: value = data->export_proto_sysid; break;
+    case MONGODB_SKEL_STAMP_INSERTED: value = (1000 * (bson_date_t) elem->basetime.tv_sec); break;
+    case MONGODB_SKEL_STAMP_UPDATED: value = (1000 * (bson_date_t) time(NULL)); break;
+    case MONGODB_SKEL_PACKETS: value = elem->packet_counter; break;
+    case MONGODB_SKEL_FLOWS: value = elem->flow_counter; break;
+    case MONGODB_SKEL_DISTINCT: value = P_cache_distinct_count(elem); break;
+    case MONGODB_SKEL_BYTES: value = elem->bytes_counter; break;
+    default: break;
+    }
+
+    switch (field->type) {
+    case BSON_INT:
+      MongoDB_skel_put32(ptr, (u_int32_t) value);
+      break;
+    case BSON_DOUBLE:
+      memcpy(&value, &dvalue, sizeof(value));
+      MongoDB_skel_put64(ptr, value);
+      break;
+    default:
+      MongoDB_skel_put64(ptr, value);
+      break;
+    }
+  }
+
+  bson_elem->cur += skel->len;
+
+  return FALSE;
+}
@@ -34,12 +34,84 @@
 
 #define DEFAULT_MONGO_INSERT_BATCH 10000
 
+#define MONGODB_SKEL_FIELDS_MAX			64
+
+/* sources of the fixed-size values patched into record skeletons */
+#define MONGODB_SKEL_OID			0
+#define MONGODB_SKEL_TAG			1
+#define MONGODB_SKEL_TAG2			2
+#define MONGODB_SKEL_VLAN			3
+#define MONGODB_SKEL_COS			4
+#define MONGODB_SKEL_SRC_AS			5
+#define MONGODB_SKEL_DST_AS			6
+#define MONGODB_SKEL_LOCAL_PREF			7
+#define MONGODB_SKEL_MED			8
+#define MONGODB_SKEL_PEER_SRC_AS		9
+#define MONGODB_SKEL_PEER_DST_AS		10
+#define MONGODB_SKEL_SRC_LOCAL_PREF		11
+#define MONGODB_SKEL_SRC_MED			12
+#define MONGODB_SKEL_IN_IFACE			13
+#define MONGODB_SKEL_OUT_IFACE			14
+#define MONGODB_SKEL_MPLS_PW_ID			15
+#define MONGODB_SKEL_SRC_NMASK			16
+#define MONGODB_SKEL_DST_NMASK			17
+#define MONGODB_SKEL_SRC_PORT			18
+#define MONGODB_SKEL_DST_PORT			19
+#define MONGODB_SKEL_SRC_LAT			20
+#define MONGODB_SKEL_SRC_LON			21
+#define MONGODB_SKEL_DST_LAT			22
+#define MONGODB_SKEL_DST_LON			23
+#define MONGODB_SKEL_TOS			24
+#define MONGODB_SKEL_SAMPLING_RATE		25
+#define MONGODB_SKEL_POST_NAT_SRC_PORT		26
+#define MONGODB_SKEL_POST_NAT_DST_PORT		27
+#define MONGODB_SKEL_NAT_EVENT			28
+#define MONGODB_SKEL_MPLS_LABEL_TOP		29
+#define MONGODB_SKEL_MPLS_LABEL_BOTTOM		30
+#define MONGODB_SKEL_MPLS_STACK_DEPTH		31
+#define MONGODB_SKEL_TUNNEL_TOS			32
+#define MONGODB_SKEL_TUNNEL_SRC_PORT		33
+#define MONGODB_SKEL_TUNNEL_DST_PORT		34
+#define MONGODB_SKEL_VXLAN			35
+#define MONGODB_SKEL_TIMESTAMP_START		36
+#define MONGODB_SKEL_TIMESTAMP_END		37
+#define MONGODB_SKEL_TIMESTAMP_ARRIVAL		38
+#define MONGODB_SKEL_EXPORT_PROTO_SEQNO		39
+#define MONGODB_SKEL_EXPORT_PROTO_VERSION	40
+#define MONGODB_SKEL_EXPORT_PROTO_SYSID		41
+#define MONGODB_SKEL_STAMP_INSERTED		42
+#define MONGODB_SKEL_STAMP_UPDATED		43
+#define MONGODB_SKEL_PACKETS			44
+#define MONGODB_SKEL_FLOWS			45
+#define MONGODB_SKEL_DISTINCT			46
+#define MONGODB_SKEL_BYTES			47
+
 /* structures */
+struct mongodb_skel_field {
+  u_int8_t source;
+  u_int8_t type;	/* BSON_INT, BSON_LONG, BSON_DATE, BSON_DOUBLE or BSON_OID */
+  int offset;		/* of the value, from the start of the skeleton */
+};
+
+/* pre-encoded BSON elements, names included, for all the fixed-size
+   fields of a record; only values are patched in for each record */
+struct mongodb_skel {
+  char *data;
+  int len;
+  int num;
+  struct mongodb_skel_field fields[MONGODB_SKEL_FIELDS_MAX];
+};
 
 /* prototypes */
 extern void mongodb_plugin(int, struct configuration *, void *);
 extern void mongodb_legacy_warning(int, struct configuration *, void *);
 extern void MongoDB_cache_purge(struct chained_cache *[], int, int);
+extern void MongoDB_cache_purge_parallel(struct chained_cache *[], int, int);
+extern void MongoDB_skel_init();
+extern void MongoDB_skel_add(bson *, struct mongodb_skel *, const char *, u_int8_t, u_int8_t);
+extern void MongoDB_skel_finish(bson *, struct mongodb_skel *);
+extern int MongoDB_skel_append(bson *, struct mongodb_skel *, struct chained_cache *, struct pkt_bgp_primitives *,
+				struct pkt_nat_primitives *, struct pkt_mpls_primitives *, struct pkt_tunnel_primitives *);
 extern void MongoDB_create_indexes(mongo *, const char *);
 extern int MongoDB_get_database(char *, int, char *);
 extern void MongoDB_append_string(bson *, char *, struct pkt_vlen_hdr_primitives *, pm_cfgreg_t);
@@ -47,6 +119,7 @@ extern int MongoDB_oid_fuzz();
 
 /* global vars */
 extern mongo db_conn;
+extern struct mongodb_skel mongodb_skel_prims, mongodb_skel_counters;
 
 
 #endif //MONGODB_PLUGIN_H
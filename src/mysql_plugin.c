@@ -428,6 +428,21 @@ int MY_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
   else return ret;
 }
 
+static int MY_upsert_exec(struct DBdesc *db, char *query)
+{
+  int ret;
+
+  ret = mysql_query(db->desc, query);
+  if (ret) MY_get_errmsg(db);
+
+  return ret;
+}
+
+int MY_cache_dbop_upsert(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  return sql_cache_dbop_upsert(db, cache_elem, idata, MY_upsert_exec, MY_cache_dbop);
+}
+
 void MY_cache_purge(struct db_cache *queue[], int index, struct insert_data *idata)
 {
   struct db_cache *LastElemCommitted = NULL;
@@ -655,9 +670,21 @@ int MY_compose_static_queries()
     }
   }
 
+  if (config.sql_upsert_batch) MY_compose_upsert_clause();
+
   return primitives;
 }
 
+void MY_compose_upsert_clause()
+{
+  char set_buf[LONGSRVBUFLEN];
+
+  sql_compose_upsert_set(set_buf, sizeof(set_buf), "", "VALUES(", ")");
+  snprintf(upsert_clause, sizeof(upsert_clause), " ON DUPLICATE KEY UPDATE %s", set_buf);
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): upsert clause:%s\n", config.name, config.type, upsert_clause);
+}
+
 void MY_Lock(struct DBdesc *db)
 {
   if (!db->fail) {
@@ -736,7 +763,8 @@ void MY_set_callbacks(struct sqlfunc_cb_registry *cbr)
   cbr->close = MY_DB_Close;
   cbr->lock = MY_Lock;
   cbr->unlock = MY_Unlock;
-  cbr->op = MY_cache_dbop;
+  if (config.sql_upsert_batch) cbr->op = MY_cache_dbop_upsert;
+  else cbr->op = MY_cache_dbop;
   cbr->create_table = MY_create_dyn_table;
   cbr->purge = MY_cache_purge;
   cbr->create_backend = MY_create_backend;
@@ -769,6 +797,8 @@ void MY_init_default_values(struct insert_data *idata)
 
   if (config.sql_backup_host) idata->recover = TRUE;
 
+  sql_upsert_init();
+
   if (config.sql_multi_values) {
     multi_values_buffer = malloc(config.sql_multi_values);
     if (!multi_values_buffer) {
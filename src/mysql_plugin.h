@@ -33,9 +33,11 @@
 /* prototypes */
 void mysql_plugin(int, struct configuration *, void *);
 int MY_cache_dbop(struct DBdesc *, struct db_cache *, struct insert_data *);
+int MY_cache_dbop_upsert(struct DBdesc *, struct db_cache *, struct insert_data *);
 void MY_cache_purge(struct db_cache *[], int, struct insert_data *);
 int MY_evaluate_history(int);
 int MY_compose_static_queries();
+void MY_compose_upsert_clause();
 void MY_Lock(struct DBdesc *);
 void MY_Unlock(struct BE_descs *);
 void MY_DB_Connect(struct DBdesc *, char *);
@@ -600,7 +600,8 @@ void set_net_funcs(struct networks_table *nt)
     count++;
   }
 
-  if (!(config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST))) {
+  /* distinct primitives are cleared by P_distinct_hash() once hashed */
+  if (!((config.what_to_count|config.distinct_what_to_count) & (COUNT_SRC_HOST|COUNT_SUM_HOST))) {
     net_funcs[count] = clear_src_host;
     count++;
   }
@@ -659,7 +660,7 @@ void set_net_funcs(struct networks_table *nt)
     count++;
   }
 
-  if (!(config.what_to_count & (COUNT_DST_HOST|COUNT_SUM_HOST))) {
+  if (!((config.what_to_count|config.distinct_what_to_count) & (COUNT_DST_HOST|COUNT_SUM_HOST))) {
     net_funcs[count] = clear_dst_host;
     count++;
   }
@@ -691,7 +692,7 @@ void set_net_funcs(struct networks_table *nt)
     count++;
   }
 
-  if (!(config.what_to_count & (COUNT_SRC_HOST|COUNT_SUM_HOST))) {
+  if (!((config.what_to_count|config.distinct_what_to_count) & (COUNT_SRC_HOST|COUNT_SUM_HOST))) {
     net_funcs[count] = clear_src_host;
     count++;
   }
@@ -705,7 +706,7 @@ void set_net_funcs(struct networks_table *nt)
     count++;
   }
   
-  if (!(config.what_to_count & (COUNT_DST_HOST|COUNT_SUM_HOST))) {
+  if (!((config.what_to_count|config.distinct_what_to_count) & (COUNT_DST_HOST|COUNT_SUM_HOST))) {
     net_funcs[count] = clear_dst_host;
     count++;
   }
@@ -1200,6 +1200,9 @@ int main(int argc,char **argv, char **envp)
       print_stats = FALSE;
     }
 
+    /* BGP/BMP lookup results are referenced until plugins are fed */
+    bgp_rcu_read_lock();
+
     if (data_plugins) {
       u_int16_t nfv;
 
@@ -1237,6 +1240,8 @@ int main(int argc,char **argv, char **envp)
       process_raw_packet(netflow_packet, ret, &pptrs, &req);
     }
 
+    bgp_rcu_read_unlock();
+
     sigprocmask(SIG_UNBLOCK, &signal_set, NULL);
   }
 }
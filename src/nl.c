@@ -151,6 +151,10 @@ void pcap_cb(u_char *user, const struct pcap_pkthdr *pkthdr, const u_char *buf)
         if (config.nfacctd_isis) {
           isis_srcdst_lookup(&pptrs);
         }
+
+        /* BGP/BMP lookup results are referenced until plugins are fed */
+        bgp_rcu_read_lock();
+
         if (config.nfacctd_bgp) {
           BTA_find_id((struct id_table *)pptrs.bta_table, &pptrs, &pptrs.bta, &pptrs.bta2);
           bgp_srcdst_lookup(&pptrs, FUNC_TYPE_BGP);
@@ -165,6 +169,8 @@ void pcap_cb(u_char *user, const struct pcap_pkthdr *pkthdr, const u_char *buf)
 
 	set_index_pkt_ptrs(&pptrs);
         exec_plugins(&pptrs, &req);
+
+        bgp_rcu_read_unlock();
       }
     }
   }
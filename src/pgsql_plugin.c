@@ -21,6 +21,7 @@
 
 /* includes */
 #include "pmacct.h"
+#include "addr.h"
 #include "pmacct-data.h"
 #include "plugin_hooks.h"
 #include "sql_common.h"
@@ -54,6 +55,11 @@ char pgsql_table_as_v5[] = "acct_as_v5";
 char typed_str[] = "typed"; 
 char unified_str[] = "unified"; 
 
+static struct pg_stmt pg_stmts[PG_STMT_MAX];
+static struct frags pg_text_where[N_PRIMITIVES+2], pg_text_values[N_PRIMITIVES+2];
+static int pg_stmt_ready[BE_TYPE_LOGFILE], pg_stmt_fallback;
+static char pg_stmt_clauses[BE_TYPE_LOGFILE][2*LONGSRVBUFLEN];
+
 /* Functions */
 void pgsql_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr) 
 {
@@ -288,7 +294,7 @@ int PG_cache_dbop_copy(struct DBdesc *db, struct db_cache *cache_elem, struct in
 {
   char *ptr_values, *ptr_where;
   char default_delim[] = ",", delim_buf[SRVBUFLEN];
-  int num=0, have_flows=0;
+  int num=0, have_flows=0, len;
 
   if (config.what_to_count & COUNT_FLOWS) have_flows = TRUE;
 
@@ -303,31 +309,30 @@ int PG_cache_dbop_copy(struct DBdesc *db, struct db_cache *cache_elem, struct in
   memset(where_clause, 0, sizeof(where_clause));
   memset(values_clause, 0, sizeof(values_clause));
 
-  memcpy(&values, &copy_values, sizeof(values));
   while (num < idata->num_primitives) {
     (*where[num].handler)(cache_elem, idata, num, &ptr_values, &ptr_where);
     num++;
   }
 
 #if defined HAVE_64BIT_COUNTERS
-  if (have_flows) snprintf(ptr_values, SPACELEFT(values_clause), "%s%" PRIu64 "%s%" PRIu64 "%s%" PRIu64 "\n", delim_buf, cache_elem->packet_counter,
+  if (have_flows) len = snprintf(ptr_values, SPACELEFT(values_clause), "%s%" PRIu64 "%s%" PRIu64 "%s%" PRIu64 "\n", delim_buf, cache_elem->packet_counter,
 											delim_buf, cache_elem->bytes_counter,
 											delim_buf, cache_elem->flows_counter);
-  else snprintf(ptr_values, SPACELEFT(values_clause), "%s%" PRIu64 "%s%" PRIu64 "\n", delim_buf, cache_elem->packet_counter,
+  else len = snprintf(ptr_values, SPACELEFT(values_clause), "%s%" PRIu64 "%s%" PRIu64 "\n", delim_buf, cache_elem->packet_counter,
 									delim_buf, cache_elem->bytes_counter);
 #else
-  if (have_flows) snprintf(ptr_values, SPACELEFT(values_clause), "%s%lu%s%lu%s%lu\n", delim_buf, cache_elem->packet_counter,
+  if (have_flows) len = snprintf(ptr_values, SPACELEFT(values_clause), "%s%lu%s%lu%s%lu\n", delim_buf, cache_elem->packet_counter,
 											delim_buf, cache_elem->bytes_counter,
 											delim_buf, cache_elem->flows_counter);
-  else snprintf(ptr_values, SPACELEFT(values_clause), "%s%lu%s%lu\n", delim_buf, cache_elem->packet_counter,
+  else len = snprintf(ptr_values, SPACELEFT(values_clause), "%s%lu%s%lu\n", delim_buf, cache_elem->packet_counter,
 									delim_buf, cache_elem->bytes_counter);
 #endif
 
-  strncpy(sql_data, values_clause, SPACELEFT(sql_data));
+  len = MIN((ptr_values - values_clause) + len, (sizeof(values_clause) - 1));
 
-  if (PQputCopyData(db->desc, sql_data, strlen(sql_data)) < 0) { // avoid strlen() 
+  if (PQputCopyData(db->desc, values_clause, len) < 0) {
     db->errmsg = PQerrorMessage(db->desc);
-    Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, sql_data);
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, values_clause);
     if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n", config.name, config.type, db->errmsg);
     sql_db_fail(db);
 
@@ -336,7 +341,7 @@ int PG_cache_dbop_copy(struct DBdesc *db, struct db_cache *cache_elem, struct in
   idata->iqn++;
   idata->een++;
 
-  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n", config.name, config.type, sql_data);
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %s\n", config.name, config.type, values_clause);
 
   return FALSE;
 }
@@ -432,12 +437,177 @@ int PG_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct insert_
   return FALSE;
 }
 
+static int PG_upsert_exec(struct DBdesc *db, char *query)
+{
+  static char errmsg[SRVBUFLEN];
+  PGresult *ret;
+
+  ret = PQexec(db->desc, query);
+  if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
+    /* the message does not outlive the result */
+    strlcpy(errmsg, PQresultErrorMessage(ret), sizeof(errmsg));
+    db->errmsg = errmsg;
+    PQclear(ret);
+    sql_db_fail(db);
+
+    return TRUE;
+  }
+  PQclear(ret);
+
+  return FALSE;
+}
+
+int PG_cache_dbop_upsert(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  return sql_cache_dbop_upsert(db, cache_elem, idata, PG_upsert_exec, PG_cache_dbop);
+}
+
+static int PG_stmt_split_params(char *buf, char *params[])
+{
+  int num = 0;
+
+  for (; *buf; buf++) {
+    if (*buf == PG_STMT_PARAM_SEP) {
+      *buf = '\0';
+      if (num == PG_STMT_PARAMS_MAX) return ERR;
+      params[num] = (buf + 1);
+      num++;
+    }
+  }
+
+  return num;
+}
+
+static int PG_stmt_exec(struct DBdesc *db, struct pg_stmt *stmt, char *text_params[], int text_num, struct db_cache *cache_elem, PGresult **ret)
+{
+  const char *params[PG_STMT_PARAMS_MAX];
+  int lengths[PG_STMT_PARAMS_MAX];
+  u_int64_t packets, bytes, flows;
+  u_int32_t tcp_flags;
+  int idx, text_idx = 0;
+
+  packets = pm_htonll(cache_elem->packet_counter);
+  bytes = pm_htonll(cache_elem->bytes_counter);
+  flows = pm_htonll(cache_elem->flows_counter);
+  tcp_flags = htonl(cache_elem->tcp_flags);
+
+  for (idx = 0; idx < stmt->nparams; idx++) {
+    if (stmt->sources[idx] == PG_PARAM_TEXT) text_idx++;
+  }
+
+  /* ie. a value containing PG_STMT_PARAM_SEP */
+  if (text_idx != text_num) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): EXECUTE %s: expected %d values, got %d.\n", config.name, config.type, stmt->name, text_idx, text_num);
+    sql_db_fail(db);
+
+    return TRUE;
+  }
+
+  for (idx = 0, text_idx = 0; idx < stmt->nparams; idx++) {
+    switch (stmt->sources[idx]) {
+    case PG_PARAM_PACKETS:
+      params[idx] = (char *) &packets;
+      lengths[idx] = sizeof(packets);
+      break;
+    case PG_PARAM_BYTES:
+      params[idx] = (char *) &bytes;
+      lengths[idx] = sizeof(bytes);
+      break;
+    case PG_PARAM_FLOWS:
+      params[idx] = (char *) &flows;
+      lengths[idx] = sizeof(flows);
+      break;
+    case PG_PARAM_TCP_FLAGS:
+      params[idx] = (char *) &tcp_flags;
+      lengths[idx] = sizeof(tcp_flags);
+      break;
+    default:
+      params[idx] = text_params[text_idx];
+      lengths[idx] = 0; /* text, ignored */
+      text_idx++;
+      break;
+    }
+  }
+
+  (*ret) = PQexecPrepared(db->desc, stmt->name, stmt->nparams, params, lengths, stmt->formats, 0);
+  if (PQresultStatus(*ret) != PGRES_COMMAND_OK) {
+    db->errmsg = PQresultErrorMessage(*ret);
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\nEXECUTE %s\n", config.name, config.type, stmt->name);
+    if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+    PQclear(*ret);
+    sql_db_fail(db);
+
+    return TRUE;
+  }
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): EXECUTE %s\n\n", config.name, config.type, stmt->name);
+
+  return FALSE;
+}
+
+/* same as PG_cache_dbop() but executing the statements prepared by
+   PG_prepare_statements(): handlers only emit the values of primitives,
+   see PG_compose_statements(), while counters are passed in binary */
+int PG_cache_dbop_prepared(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  PGresult *ret = NULL;
+  struct pg_stmt *update_stmt, *insert_stmt;
+  char *ptr_values, *ptr_where, *where_params[PG_STMT_PARAMS_MAX], *values_params[PG_STMT_PARAMS_MAX];
+  int num, num_where, num_values, affected = 0;
+
+  if (pg_stmt_fallback) return PG_cache_dbop(db, cache_elem, idata);
+
+  ptr_where = where_clause;
+  ptr_values = values_clause;
+  where_clause[0] = '\0';
+  values_clause[0] = '\0';
+
+  for (num = 0; num < idata->num_primitives; num++)
+    (*where[num].handler)(cache_elem, idata, num, &ptr_values, &ptr_where);
+
+  num_where = PG_stmt_split_params(where_clause, where_params);
+  num_values = PG_stmt_split_params(values_clause, values_params);
+  if (num_where == ERR || num_values == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): too many parameters (PG_cache_dbop_prepared).\n", config.name, config.type);
+    sql_db_fail(db);
+
+    return TRUE;
+  }
+
+  if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION) {
+    update_stmt = &pg_stmts[PG_STMT_UPDATE_EVENT];
+    insert_stmt = &pg_stmts[PG_STMT_INSERT_EVENT];
+  }
+  else {
+    update_stmt = &pg_stmts[PG_STMT_UPDATE];
+    insert_stmt = &pg_stmts[PG_STMT_INSERT];
+  }
+
+  /* UPDATE is not prepared if switched off or if there is nothing to update */
+  if (update_stmt->name[0]) {
+    if (PG_stmt_exec(db, update_stmt, where_params, num_where, cache_elem, &ret)) return TRUE;
+    affected = PG_affected_rows(ret);
+    PQclear(ret);
+  }
+
+  if (!affected) {
+    if (PG_stmt_exec(db, insert_stmt, values_params, num_values, cache_elem, &ret)) return TRUE;
+    PQclear(ret);
+    idata->iqn++;
+  }
+  else idata->uqn++;
+  idata->een++;
+
+  return FALSE;
+}
+
 void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *idata)
 {
   PGresult *ret;
   struct db_cache **reprocess_queries_queue, **bulk_reprocess_queries_queue;
   char orig_insert_clause[LONGSRVBUFLEN], orig_update_clause[LONGSRVBUFLEN], orig_lock_clause[LONGSRVBUFLEN];
   char orig_copy_clause[LONGSRVBUFLEN], tmpbuf[LONGLONGSRVBUFLEN], tmptable[SRVBUFLEN];
+  char orig_upsert_clause[LONGLONGSRVBUFLEN];
   time_t start;
   int j, r, reprocess = 0, stop, go_to_pending, reprocess_idx, bulk_reprocess_idx, saved_index = index;
   struct primitives_ptrs prim_ptrs;
@@ -479,8 +649,10 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
   strlcpy(orig_insert_clause, insert_clause, LONGSRVBUFLEN);
   strlcpy(orig_update_clause, update_clause, LONGSRVBUFLEN);
   strlcpy(orig_lock_clause, lock_clause, LONGSRVBUFLEN);
+  strlcpy(orig_upsert_clause, upsert_clause, LONGLONGSRVBUFLEN);
 
   start:
+  memset(&idata->mv, 0, sizeof(struct multi_values));
   memcpy(queue, sql_pending_queries_queue, pqq_ptr*sizeof(struct db_cache *));
   memset(sql_pending_queries_queue, 0, pqq_ptr*sizeof(struct db_cache *));
   index = pqq_ptr; pqq_ptr = 0;
@@ -499,17 +671,20 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
     strlcpy(insert_clause, orig_insert_clause, LONGSRVBUFLEN);
     strlcpy(update_clause, orig_update_clause, LONGSRVBUFLEN);
     strlcpy(lock_clause, orig_lock_clause, LONGSRVBUFLEN);
+    strlcpy(upsert_clause, orig_upsert_clause, LONGLONGSRVBUFLEN);
 
     handle_dynname_internal_strings_same(copy_clause, LONGSRVBUFLEN, tmpbuf, &prim_ptrs, DYN_STR_SQL_TABLE);
     handle_dynname_internal_strings_same(insert_clause, LONGSRVBUFLEN, tmpbuf, &prim_ptrs, DYN_STR_SQL_TABLE);
     handle_dynname_internal_strings_same(update_clause, LONGSRVBUFLEN, tmpbuf, &prim_ptrs, DYN_STR_SQL_TABLE);
     handle_dynname_internal_strings_same(lock_clause, LONGSRVBUFLEN, tmpbuf, &prim_ptrs, DYN_STR_SQL_TABLE);
+    handle_dynname_internal_strings_same(upsert_clause, LONGLONGSRVBUFLEN, tmpbuf, &prim_ptrs, DYN_STR_SQL_TABLE);
     handle_dynname_internal_strings_same(idata->dyn_table_name, LONGSRVBUFLEN, tmpbuf, &prim_ptrs, DYN_STR_SQL_TABLE);
 
     pm_strftime_same(copy_clause, LONGSRVBUFLEN, tmpbuf, &stamp, config.timestamps_utc);
     pm_strftime_same(insert_clause, LONGSRVBUFLEN, tmpbuf, &stamp, config.timestamps_utc);
     pm_strftime_same(update_clause, LONGSRVBUFLEN, tmpbuf, &stamp, config.timestamps_utc);
     pm_strftime_same(lock_clause, LONGSRVBUFLEN, tmpbuf, &stamp, config.timestamps_utc);
+    pm_strftime_same(upsert_clause, LONGLONGSRVBUFLEN, tmpbuf, &stamp, config.timestamps_utc);
     pm_strftime_same(idata->dyn_table_name, LONGSRVBUFLEN, tmpbuf, &stamp, config.timestamps_utc);
   }
 
@@ -570,6 +745,9 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
     }
   }
 
+  /* batched upserts: wrap-up */
+  if (bulk_reprocess_idx) sql_upsert_wrapup(&bed, bulk_reprocess_queries_queue[bulk_reprocess_idx-1], idata);
+
   /* Finalizing DB transaction */
   if (!p.fail) {
     if (config.sql_use_copy) {
@@ -596,6 +774,8 @@ void PG_cache_purge(struct db_cache *queue[], int index, struct insert_data *ida
         if (bulk_reprocess_queries_queue[j]->valid == SQL_CACHE_COMMITTED) sql_query(&bed, bulk_reprocess_queries_queue[j], idata);
       }
     }
+
+    if (bulk_reprocess_idx) sql_upsert_wrapup(&bed, bulk_reprocess_queries_queue[bulk_reprocess_idx-1], idata);
   }
 
   if (b.connected) {
@@ -791,9 +971,257 @@ int PG_compose_static_queries()
     }
   }
 
+  if (config.sql_use_copy) memcpy(&values, &copy_values, sizeof(values));
+  else if (config.sql_upsert_batch) PG_compose_upsert_clause(primitives);
+  else if (config.sql_use_prepared) PG_compose_statements(primitives);
+
   return primitives;
 }
 
+/*
+   Appends a clause template to a statement, turning each conversion into
+   a $n placeholder. If fmt is supplied, the conversions are also appended
+   to it, each alone after a PG_STMT_PARAM_SEP, so that handlers can emit
+   bare values from it. If sources is supplied, it tells which counter
+   each conversion stands for, to be passed in binary.
+*/
+static int PG_stmt_compose_clause(struct pg_stmt *stmt, const char *tmpl, char *fmt, int fmtlen, const int *sources)
+{
+  char abstime[] = "ABSTIME(", *out = stmt->text + strlen(stmt->text);
+  const char *ptr = tmpl, *spec;
+  int len, spec_len, left, abstime_len = strlen(abstime);
+
+  while (*ptr) {
+    left = (sizeof(stmt->text) - (out - stmt->text));
+    if (left < SHORTSHORTBUFLEN) return ERR;
+
+    if (*ptr != '%') {
+      *out++ = *ptr++;
+      continue;
+    }
+
+    spec = ptr++;
+    while (*ptr && strchr("-+ #0'123456789.hlLqjzt", *ptr)) ptr++;
+    if (!*ptr) return ERR;
+
+    if (*ptr == '%') {
+      *out++ = '%';
+      ptr++;
+      continue;
+    }
+
+    /* function names, ie. MySQL INET_ATON(), can't be parameters */
+    if (*ptr == 's' && *(ptr + 1) == '(') return ERR;
+
+    ptr++;
+    spec_len = (ptr - spec);
+
+    if (stmt->nparams == PG_STMT_PARAMS_MAX) return ERR;
+
+    /* quotes are no longer needed around a parameter */
+    if (out > stmt->text && *(out - 1) == '\'' && *ptr == '\'') {
+      out--;
+      ptr++;
+    }
+
+    stmt->types[stmt->nparams] = 0; /* inferred by the server */
+    stmt->formats[stmt->nparams] = 0;
+    stmt->sources[stmt->nparams] = (sources ? sources[0] : PG_PARAM_TEXT);
+
+    if (sources) {
+      stmt->types[stmt->nparams] = ((sources[0] == PG_PARAM_TCP_FLAGS) ? PG_OID_INT4 : PG_OID_INT8);
+      stmt->formats[stmt->nparams] = 1;
+      sources++;
+    }
+    /* ABSTIME() is gone since PostgreSQL 12; also, its argument type can't be inferred */
+    else if ((out - stmt->text) >= abstime_len && !strncmp((out - abstime_len), abstime, abstime_len)) {
+      out -= abstime_len;
+      out += sprintf(out, "to_timestamp(");
+      stmt->types[stmt->nparams] = PG_OID_INT8;
+    }
+
+    stmt->nparams++;
+    out += sprintf(out, "$%d", stmt->nparams);
+
+    if (fmt) {
+      len = strlen(fmt);
+      if ((len + spec_len + 2) > fmtlen) return ERR;
+      fmt[len] = PG_STMT_PARAM_SEP;
+      memcpy(&fmt[len + 1], spec, spec_len);
+      fmt[len + 1 + spec_len] = '\0';
+    }
+  }
+
+  *out = '\0';
+
+  return FALSE;
+}
+
+static int PG_stmt_compose_set(struct pg_stmt *stmt, struct frags *set_frags)
+{
+  int counters[] = { PG_PARAM_PACKETS, PG_PARAM_BYTES }, flows[] = { PG_PARAM_FLOWS };
+  int tcp_flags[] = { PG_PARAM_TCP_FLAGS };
+  int num, *sources, ret = FALSE;
+
+  for (num = 0; set_frags[num].type && !ret; num++) {
+    switch (set_frags[num].type) {
+    case COUNT_INT_COUNTERS:
+      sources = counters;
+      break;
+    case COUNT_INT_FLOWS:
+      sources = flows;
+      break;
+    case COUNT_INT_TCPFLAGS:
+      sources = tcp_flags;
+      break;
+    default:
+      sources = NULL;
+      break;
+    }
+
+    /* no text parameters are expected in SET clauses */
+    if (!sources && strchr(set_frags[num].string, '%')) return ERR;
+
+    ret = PG_stmt_compose_clause(stmt, set_frags[num].string, NULL, 0, sources);
+  }
+
+  return (ret ? ret : num);
+}
+
+/*
+   Builds the statements to be prepared out of the clause templates. The
+   WHERE and VALUES templates are then replaced by ones making handlers
+   emit just the values to be bound; the original ones are kept aside for
+   PG_prepare_fallback().
+*/
+void PG_compose_statements(int primitives)
+{
+  struct pg_stmt *stmt;
+  int num, num_set, num_set_event, ret = FALSE;
+  int counters[] = { PG_PARAM_PACKETS, PG_PARAM_BYTES, PG_PARAM_FLOWS };
+
+  memset(pg_stmts, 0, sizeof(pg_stmts));
+  memcpy(pg_text_where, where, sizeof(pg_text_where));
+  memcpy(pg_text_values, values, sizeof(pg_text_values));
+
+  for (num = 0; num < primitives && !ret; num++) {
+    where[num].string[0] = '\0';
+    values[num].string[0] = '\0';
+
+    ret = PG_stmt_compose_clause(&pg_stmts[PG_STMT_INSERT], pg_text_values[num].string, values[num].string, sizeof(values[num].string), NULL);
+  }
+
+  if (!ret) {
+    memcpy(&pg_stmts[PG_STMT_INSERT_EVENT], &pg_stmts[PG_STMT_INSERT], sizeof(struct pg_stmt));
+    strncat(pg_stmts[PG_STMT_INSERT_EVENT].text, ")", SPACELEFT(pg_stmts[PG_STMT_INSERT_EVENT].text));
+
+    if (config.what_to_count & COUNT_FLOWS)
+      ret = PG_stmt_compose_clause(&pg_stmts[PG_STMT_INSERT], ", %llu, %llu, %llu)", NULL, 0, counters);
+    else
+      ret = PG_stmt_compose_clause(&pg_stmts[PG_STMT_INSERT], ", %llu, %llu)", NULL, 0, counters);
+  }
+
+  num_set = PG_stmt_compose_set(&pg_stmts[PG_STMT_UPDATE], set);
+  num_set_event = PG_stmt_compose_set(&pg_stmts[PG_STMT_UPDATE_EVENT], set_event);
+  if (num_set == ERR || num_set_event == ERR) ret = ERR;
+
+  for (num = 0; num < primitives && !ret; num++) {
+    ret = PG_stmt_compose_clause(&pg_stmts[PG_STMT_UPDATE], pg_text_where[num].string, where[num].string, sizeof(where[num].string), NULL);
+    if (!ret) ret = PG_stmt_compose_clause(&pg_stmts[PG_STMT_UPDATE_EVENT], pg_text_where[num].string, NULL, 0, NULL);
+  }
+
+  if (ret) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to compose prepared statements. Falling back to plain queries.\n", config.name, config.type);
+    PG_prepare_fallback();
+    return;
+  }
+
+  for (num = 0; num < PG_STMT_MAX; num++) {
+    stmt = &pg_stmts[num];
+
+    if (num == PG_STMT_UPDATE && (config.sql_dont_try_update || !num_set)) continue;
+    if (num == PG_STMT_UPDATE_EVENT && (config.sql_dont_try_update || !num_set_event)) continue;
+
+    snprintf(stmt->name, sizeof(stmt->name), "pmacct_%d", num);
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): statement %s: %s\n", config.name, config.type, stmt->name, stmt->text);
+  }
+}
+
+void PG_compose_upsert_clause(int primitives)
+{
+  char target[LONGSRVBUFLEN], set_buf[LONGSRVBUFLEN], old[SRVBUFLEN];
+
+  if (sql_compose_upsert_target(target, sizeof(target), primitives) <= 0) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): sql_upsert_batch: unable to compose the conflict target. Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  /* existing rows must be qualified: unqualified columns are ambiguous with EXCLUDED */
+  snprintf(old, sizeof(old), "%s.", config.sql_table);
+  sql_compose_upsert_set(set_buf, sizeof(set_buf), old, "EXCLUDED.", "");
+  snprintf(upsert_clause, sizeof(upsert_clause), " ON CONFLICT (%s) DO UPDATE SET %s", target, set_buf);
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): upsert clause:%s\n", config.name, config.type, upsert_clause);
+}
+
+void PG_prepare_fallback()
+{
+  memcpy(where, pg_text_where, sizeof(pg_text_where));
+  memcpy(values, pg_text_values, sizeof(pg_text_values));
+  pg_stmt_fallback = TRUE;
+}
+
+/* called on every new transaction: statements are prepared once per
+   connection, see PG_DB_Connect(), and again only if clauses changed in
+   between, ie. in case of dynamic table names */
+void PG_prepare_statements(struct DBdesc *db)
+{
+  char clauses[2*LONGSRVBUFLEN];
+  PGresult *ret;
+  struct pg_stmt *stmt;
+  int num, len;
+
+  snprintf(clauses, sizeof(clauses), "%s\n%s", insert_clause, update_clause);
+
+  if (pg_stmt_ready[db->type]) {
+    if (!strcmp(clauses, pg_stmt_clauses[db->type])) return;
+
+    ret = PQexec(db->desc, "DEALLOCATE ALL");
+    PQclear(ret);
+    pg_stmt_ready[db->type] = FALSE;
+  }
+
+  for (num = 0; num < PG_STMT_MAX; num++) {
+    stmt = &pg_stmts[num];
+    if (!stmt->name[0]) continue;
+
+    if (num == PG_STMT_INSERT) len = snprintf(sql_data, sizeof(sql_data), "%s%s%s", insert_clause, insert_counters_clause, stmt->text);
+    else if (num == PG_STMT_INSERT_EVENT) len = snprintf(sql_data, sizeof(sql_data), "%s%s%s", insert_clause, insert_nocounters_clause, stmt->text);
+    else len = snprintf(sql_data, sizeof(sql_data), "%s%s", update_clause, stmt->text);
+
+    if (len >= sizeof(sql_data)) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to prepare statements, falling back to plain queries: statement too long\n",
+	  config.name, config.type);
+      PG_prepare_fallback();
+      return;
+    }
+
+    ret = PQprepare(db->desc, stmt->name, sql_data, stmt->nparams, stmt->types);
+    if (PQresultStatus(ret) != PGRES_COMMAND_OK) {
+      Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, sql_data);
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to prepare statements, falling back to plain queries: %s\n",
+	  config.name, config.type, PQresultErrorMessage(ret));
+      PQclear(ret);
+      PG_prepare_fallback();
+      return;
+    }
+    PQclear(ret);
+  }
+
+  strlcpy(pg_stmt_clauses[db->type], clauses, sizeof(pg_stmt_clauses[db->type]));
+  pg_stmt_ready[db->type] = TRUE;
+}
+
 void PG_compose_conn_string(struct DBdesc *db, char *host, int port, char *ca_file)
 {
   char *string;
@@ -822,6 +1250,8 @@ void PG_Lock(struct DBdesc *db)
   PGresult *PGret;
 
   if (!db->fail) {
+    if (config.sql_use_prepared && !pg_stmt_fallback) PG_prepare_statements(db);
+
     PGret = PQexec(db->desc, lock_clause);
     if (PQresultStatus(PGret) != PGRES_COMMAND_OK) {
       db->errmsg = PQresultErrorMessage(PGret);
@@ -857,7 +1287,12 @@ void PG_DB_Connect(struct DBdesc *db, char *host)
       db->errmsg = errmsg;
       sql_db_errmsg(db);
     }
-    else sql_db_ok(db);
+    else {
+      sql_db_ok(db);
+
+      /* prepared statements don't survive the connection */
+      pg_stmt_ready[db->type] = FALSE;
+    }
   }
 }
 
@@ -908,8 +1343,10 @@ void PG_set_callbacks(struct sqlfunc_cb_registry *cbr)
   cbr->close = PG_DB_Close;
   cbr->lock = PG_Lock;
   /* cbr->unlock */ 
-  if (!config.sql_use_copy) cbr->op = PG_cache_dbop;
-  else cbr->op = PG_cache_dbop_copy;
+  if (config.sql_use_copy) cbr->op = PG_cache_dbop_copy;
+  else if (config.sql_upsert_batch) cbr->op = PG_cache_dbop_upsert;
+  else if (config.sql_use_prepared) cbr->op = PG_cache_dbop_prepared;
+  else cbr->op = PG_cache_dbop;
   cbr->create_table = PG_create_dyn_table;
   cbr->purge = PG_cache_purge;
   cbr->create_backend = PG_create_backend;
@@ -994,6 +1431,16 @@ void PG_init_default_values(struct insert_data *idata)
 
   if (config.sql_backup_host) idata->recover = TRUE;
   if (!config.sql_dont_try_update && config.sql_use_copy) config.sql_use_copy = FALSE; 
+  if (config.sql_use_copy && config.sql_use_prepared) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_use_prepared does not apply to COPY (sql_use_copy). Ignored.\n", config.name, config.type);
+    config.sql_use_prepared = FALSE;
+  }
+
+  sql_upsert_init();
+  if (config.sql_upsert_batch && config.sql_use_prepared) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_use_prepared does not apply to upserts (sql_upsert_batch). Ignored.\n", config.name, config.type);
+    config.sql_use_prepared = FALSE;
+  }
 
   if (config.sql_locking_style) idata->locks = sql_select_locking_style(config.sql_locking_style);
 }
@@ -26,15 +26,51 @@
 #define REPROCESS_SPECIFIC	1
 #define REPROCESS_BULK		2
 
+/* prepared statements (sql_use_prepared) */
+#define PG_STMT_INSERT		0
+#define PG_STMT_INSERT_EVENT	1
+#define PG_STMT_UPDATE		2
+#define PG_STMT_UPDATE_EVENT	3
+#define PG_STMT_MAX		4
+
+#define PG_STMT_PARAMS_MAX	(((N_PRIMITIVES+2)*2)+8)
+#define PG_STMT_PARAM_SEP	'\x1f'
+
+#define PG_PARAM_TEXT		0
+#define PG_PARAM_PACKETS	1
+#define PG_PARAM_BYTES		2
+#define PG_PARAM_FLOWS		3
+#define PG_PARAM_TCP_FLAGS	4
+
+/* from catalog/pg_type.h, not meant for client code */
+#define PG_OID_INT8		20
+#define PG_OID_INT4		23
+
 #include "sql_common.h"
 
+/* structures */
+struct pg_stmt {
+  char name[SHORTSHORTBUFLEN];	/* empty if not in use */
+  char text[LONGLONGSRVBUFLEN];	/* past the INSERT or UPDATE clause */
+  int nparams;
+  Oid types[PG_STMT_PARAMS_MAX];
+  int formats[PG_STMT_PARAMS_MAX];
+  int sources[PG_STMT_PARAMS_MAX];
+};
+
 /* prototypes */
 void pgsql_plugin(int, struct configuration *, void *);
 int PG_cache_dbop(struct DBdesc *, struct db_cache *, struct insert_data *);
+int PG_cache_dbop_upsert(struct DBdesc *, struct db_cache *, struct insert_data *);
 int PG_cache_dbop_copy(struct DBdesc *, struct db_cache *, struct insert_data *);
+int PG_cache_dbop_prepared(struct DBdesc *, struct db_cache *, struct insert_data *);
 void PG_cache_purge(struct db_cache *[], int, struct insert_data *);
 int PG_evaluate_history(int);
 int PG_compose_static_queries();
+void PG_compose_statements(int);
+void PG_compose_upsert_clause(int);
+void PG_prepare_statements(struct DBdesc *);
+void PG_prepare_fallback();
 void PG_compose_conn_string(struct DBdesc *, char *, int, char *);
 void PG_Lock(struct DBdesc *);
 void PG_DB_Connect(struct DBdesc *, char *);
@@ -311,6 +311,7 @@ avro_schema_t avro_schema_build_acct_data(u_int64_t wtc, u_int64_t wtc_2)
 
   avro_schema_record_field_append(schema, "packets", optlong_s);
   avro_schema_record_field_append(schema, "flows", optlong_s);
+  if (config.distinct_what_to_count) avro_schema_record_field_append(schema, "distinct", optlong_s);
   avro_schema_record_field_append(schema, "bytes", optlong_s);
 
   avro_schema_decref(optlong_s);
@@ -1066,6 +1067,21 @@ void add_writer_name_and_pid_avro(avro_value_t value, char *name, pid_t writer_p
   pm_avro_check(avro_value_set_string(&field, wid));
 }
 
+void add_distinct_count_avro(avro_value_t value, u_int8_t flow_type, pm_counter_t distinct)
+{
+  avro_value_t field, branch;
+
+  pm_avro_check(avro_value_get_by_name(&value, "distinct", &field, NULL));
+
+  if (flow_type != NF9_FTYPE_EVENT && flow_type != NF9_FTYPE_OPTION) {
+    pm_avro_check(avro_value_set_branch(&field, 1, &branch));
+    pm_avro_check(avro_value_set_long(&branch, distinct));
+  }
+  else {
+    pm_avro_check(avro_value_set_branch(&field, 0, &branch));
+  }
+}
+
 void write_avro_schema_to_file(char *filename, avro_schema_t schema)
 {
   FILE *avro_fp;
@@ -51,6 +51,7 @@ extern avro_schema_t avro_schema_build_acct_init();
 extern avro_schema_t avro_schema_build_acct_close();
 extern void avro_schema_add_writer_id(avro_schema_t);
 extern void add_writer_name_and_pid_avro(avro_value_t, char *, pid_t);
+extern void add_distinct_count_avro(avro_value_t, u_int8_t, pm_counter_t);
 
 extern avro_value_t compose_avro_acct_data(u_int64_t wtc, u_int64_t wtc_2, u_int8_t flow_type,
   struct pkt_primitives *pbase, struct pkt_bgp_primitives *pbgp,
@@ -468,6 +468,11 @@ void compose_json(u_int64_t wtc, u_int64_t wtc_2)
     idx++;
   }
 
+  if (config.distinct_what_to_count) {
+    cjhandler[idx] = compose_json_distinct;
+    idx++;
+  }
+
   cjhandler[idx] = compose_json_counters;
 }
 
@@ -1152,6 +1157,12 @@ void compose_json_flows(json_t *obj, struct chained_cache *cc)
     json_object_set_new_nocheck(obj, "flows", json_integer((json_int_t)cc->flow_counter));
 }
 
+void compose_json_distinct(json_t *obj, struct chained_cache *cc)
+{
+  if (cc->flow_type != NF9_FTYPE_EVENT && cc->flow_type != NF9_FTYPE_OPTION)
+    json_object_set_new_nocheck(obj, "distinct", json_integer((json_int_t)P_cache_distinct_count(cc)));
+}
+
 void compose_json_counters(json_t *obj, struct chained_cache *cc)
 {
   if (cc->flow_type != NF9_FTYPE_EVENT && cc->flow_type != NF9_FTYPE_OPTION) {
@@ -121,6 +121,7 @@ extern void compose_json_export_proto_sysid(json_t *, struct chained_cache *);
 extern void compose_json_custom_primitives(json_t *, struct chained_cache *);
 extern void compose_json_history(json_t *, struct chained_cache *);
 extern void compose_json_flows(json_t *, struct chained_cache *);
+extern void compose_json_distinct(json_t *, struct chained_cache *);
 extern void compose_json_counters(json_t *, struct chained_cache *);
 #endif
 extern void compose_json(u_int64_t, u_int64_t);
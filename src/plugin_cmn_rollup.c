@@ -0,0 +1,257 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "plugin_common.h"
+#include "plugin_cmn_spill.h"
+#include "plugin_cmn_rollup.h"
+#include "pmacct-data.h"
+
+/* global variables */
+struct p_cache_rollup cache_rollup;
+
+/* functions */
+void P_cache_rollup_init()
+{
+  struct p_cache_rollup_level *level;
+  char *list, *sep, *token;
+  int prev_secs, secs;
+
+  memset(&cache_rollup, 0, sizeof(cache_rollup));
+
+  if (!config.sql_history_rollup) return;
+
+  if (!config.sql_history || config.sql_history == COUNT_MONTHLY) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup requires a non-monthly print_history. Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  if (config.print_cache_spill_dir) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup and print_cache_spill_dir are mutual exclusive. Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  if (config.type_id == PLUGIN_ID_TOPK) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup is not supported by the topk plugin. Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  /* levels are written through the same routine as the finest cache:
+     without $hst in the name they would overwrite each other's files */
+  if (config.type_id == PLUGIN_ID_PRINT && config.sql_table && !config.print_output_file_append &&
+      !strstr(config.sql_table, "$hst")) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup requires either '$hst' in print_output_file or print_output_file_append set to true. Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  prev_secs = sql_history_to_secs(config.sql_history, config.sql_history_howmany);
+  list = strdup(config.sql_history_rollup);
+  sep = list;
+
+  while ((token = extract_token(&sep, ','))) {
+    trim_spaces(token);
+
+    if (cache_rollup.levels_num == P_CACHE_ROLLUP_LEVELS_MAX) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup supports up to %u levels. Exiting.\n", config.name, config.type, P_CACHE_ROLLUP_LEVELS_MAX);
+      exit_gracefully(1);
+    }
+
+    level = &cache_rollup.levels[cache_rollup.levels_num];
+    parse_time(config.name, token, &level->history, &level->howmany);
+
+    if (!level->howmany || level->history == COUNT_MONTHLY) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup: invalid or monthly level. Exiting.\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    secs = sql_history_to_secs(level->history, level->howmany);
+    if (secs <= prev_secs || (secs % prev_secs)) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): print_history_rollup: each level must be a multiple of the one preceding it. Exiting.\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    level->timeslot = secs;
+    level->buckets_num = config.print_cache_entries;
+    level->buckets = pm_malloc(level->buckets_num*sizeof(struct chained_cache *));
+    memset(level->buckets, 0, level->buckets_num*sizeof(struct chained_cache *));
+
+    Log(LOG_INFO, "INFO ( %s/%s ): history rollup level %d: %u secs\n", config.name, config.type, cache_rollup.levels_num, secs);
+
+    cache_rollup.levels_num++;
+    prev_secs = secs;
+  }
+
+  free(list);
+
+  /* any bin boundary will do: levels are aligned to it by
+     P_eval_historical_acct() the same way the finest cache is */
+  cache_rollup.reference.tv_sec = roundoff_time(time(NULL), config.sql_history_roundoff);
+  cache_rollup.reference.tv_sec -= config.sql_history_offset;
+}
+
+static u_int32_t P_cache_rollup_hash(struct chained_cache *elem)
+{
+  struct primitives_ptrs prim_ptrs;
+  struct pkt_data dummy_data;
+
+  memset(&prim_ptrs, 0, sizeof(prim_ptrs));
+  prim_ptrs.data = &dummy_data;
+  primptrs_set_all_from_chained_cache(&prim_ptrs, elem);
+
+  return (P_cache_hash(&prim_ptrs) ^ (u_int32_t) elem->basetime.tv_sec);
+}
+
+/* aggregates elem in the bin of level it falls into; elem is left
+   untouched, a deep copy is made if the bin has no such entry yet */
+static void P_cache_rollup_add(struct p_cache_rollup_level *level, struct chained_cache *elem)
+{
+  struct chained_cache lookup, *ptr;
+  u_int32_t bucket;
+
+  memcpy(&lookup, elem, dbc_size);
+  memcpy(&lookup.basetime, &cache_rollup.reference, sizeof(struct timeval));
+  P_eval_historical_acct(&elem->basetime, &lookup.basetime, level->timeslot);
+
+  bucket = (P_cache_rollup_hash(&lookup) % level->buckets_num);
+
+  for (ptr = level->buckets[bucket]; ptr; ptr = ptr->next) {
+    if (!P_cache_cmp(ptr, &lookup)) {
+      P_cache_spill_sum(ptr, elem);
+      return;
+    }
+  }
+
+  ptr = pm_malloc(dbc_size);
+  P_cache_spill_copy(ptr, &lookup);
+  ptr->next = level->buckets[bucket];
+  level->buckets[bucket] = ptr;
+  level->entries_num++;
+}
+
+/* feeds the first level with the entries just committed by the finest
+   cache; to be called right after P_cache_mark_flush() */
+void P_cache_rollup_fold(struct chained_cache *queue[], int index)
+{
+  int j;
+
+  if (!cache_rollup.levels_num) return;
+
+  for (j = 0; j < index; j++) {
+    if (queue[j]->valid == PRINT_CACHE_COMMITTED)
+      P_cache_rollup_add(&cache_rollup.levels[0], queue[j]);
+  }
+}
+
+/* moves bins whose interval is over (all of them if exiting) to the
+   due list of each level, folding them into the next level up. A bin
+   is over once the finest cache has committed past its end. Bins left
+   due by a purge that could not take place are kept, see
+   P_cache_rollup_release() */
+void P_cache_rollup_collect(int exiting)
+{
+  struct p_cache_rollup_level *level;
+  struct chained_cache *elem, **link;
+  struct timeval commit_basetime;
+  int idx, delay = 0;
+  u_int32_t bucket;
+
+  if (!cache_rollup.levels_num) return;
+
+  P_eval_commit_basetime(&commit_basetime, &delay);
+
+  for (idx = 0; idx < cache_rollup.levels_num; idx++) {
+    level = &cache_rollup.levels[idx];
+
+    if (!level->entries_num) continue;
+
+    level->due = realloc(level->due, (level->due_num+level->entries_num)*sizeof(struct chained_cache *));
+    if (!level->due) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): P_cache_rollup_collect() unable to realloc(). Exiting ..\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    for (bucket = 0; bucket < level->buckets_num; bucket++) {
+      for (link = &level->buckets[bucket]; (elem = (*link)); ) {
+        if (exiting || commit_basetime.tv_sec >= (elem->basetime.tv_sec+level->timeslot+delay)) {
+          (*link) = elem->next;
+          elem->next = NULL;
+
+          level->due[level->due_num] = elem;
+          level->due_num++;
+          level->entries_num--;
+
+          if ((idx+1) < cache_rollup.levels_num) P_cache_rollup_add(&cache_rollup.levels[idx+1], elem);
+        }
+        else link = &elem->next;
+      }
+    }
+  }
+}
+
+/* writes due bins out through the plugin purge function; history is
+   swapped to that of each level so that timestamps and $hst in dynamic
+   names reflect it */
+void P_cache_rollup_purge()
+{
+  int idx, history = config.sql_history, howmany = config.sql_history_howmany;
+  time_t finest_timeslot = timeslot;
+  struct p_cache_rollup_level *level;
+
+  for (idx = 0; idx < cache_rollup.levels_num; idx++) {
+    level = &cache_rollup.levels[idx];
+    if (!level->due_num) continue;
+
+    config.sql_history = level->history;
+    config.sql_history_howmany = level->howmany;
+    timeslot = level->timeslot;
+
+    (*purge_func)(level->due, level->due_num, FALSE);
+  }
+
+  config.sql_history = history;
+  config.sql_history_howmany = howmany;
+  timeslot = finest_timeslot;
+}
+
+/* due bins are let go only once a writer was forked to purge them;
+   otherwise they are kept for the next purge */
+void P_cache_rollup_release(pid_t writer)
+{
+  struct p_cache_rollup_level *level;
+  u_int32_t j;
+  int idx;
+
+  if (writer <= 0) return;
+
+  for (idx = 0; idx < cache_rollup.levels_num; idx++) {
+    level = &cache_rollup.levels[idx];
+
+    for (j = 0; j < level->due_num; j++) {
+      P_cache_spill_free_extras(level->due[j]);
+      free(level->due[j]);
+    }
+
+    if (level->due) free(level->due);
+    level->due = NULL;
+    level->due_num = 0;
+  }
+}
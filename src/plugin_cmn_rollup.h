@@ -0,0 +1,60 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef PLUGIN_CMN_ROLLUP_H
+#define PLUGIN_CMN_ROLLUP_H
+
+/* defines */
+#define P_CACHE_ROLLUP_LEVELS_MAX	4
+
+/* structures */
+/* a coarser history level fed by the one below it; entries are deep
+   copies chained per bucket through their next pointer */
+struct p_cache_rollup_level {
+  int history;
+  int howmany;
+  time_t timeslot;
+
+  struct chained_cache **buckets;
+  u_int32_t buckets_num;
+  u_int32_t entries_num;
+
+  struct chained_cache **due;
+  u_int32_t due_num;
+};
+
+struct p_cache_rollup {
+  struct timeval reference;
+  int levels_num;
+  struct p_cache_rollup_level levels[P_CACHE_ROLLUP_LEVELS_MAX];
+};
+
+/* prototypes */
+extern void P_cache_rollup_init();
+extern void P_cache_rollup_fold(struct chained_cache *[], int);
+extern void P_cache_rollup_collect(int);
+extern void P_cache_rollup_purge();
+extern void P_cache_rollup_release(pid_t);
+
+/* global variables */
+extern struct p_cache_rollup cache_rollup;
+
+#endif //PLUGIN_CMN_ROLLUP_H
@@ -0,0 +1,643 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "plugin_common.h"
+#include "plugin_cmn_spill.h"
+#include "hll.h"
+
+/* global variables */
+struct p_cache_spill cache_spill;
+
+/* functions */
+static void P_cache_spill_filename(char *buf, int len, u_int32_t seq)
+{
+  snprintf(buf, len, "%s/pmacct-%s-%s-%u-%u.spill", cache_spill.dir, config.type, config.name, cache_spill.owner, seq);
+}
+
+static int P_cache_spill_qsort_cmp(const void *a, const void *b)
+{
+  return P_cache_cmp(*(struct chained_cache **)a, *(struct chained_cache **)b);
+}
+
+void P_cache_spill_free_extras(struct chained_cache *elem)
+{
+  if (elem->pbgp) free(elem->pbgp);
+  if (elem->pnat) free(elem->pnat);
+  if (elem->pmpls) free(elem->pmpls);
+  if (elem->ptun) free(elem->ptun);
+  if (elem->pcust) free(elem->pcust);
+  if (elem->pvlen) vlen_prims_free(elem->pvlen);
+  if (elem->stitch) free(elem->stitch);
+  if (elem->hll) free(elem->hll);
+
+  memset(elem, 0, dbc_size);
+}
+
+static void *P_cache_spill_dup(void *src, size_t len)
+{
+  void *dst;
+
+  if (!src) return NULL;
+
+  dst = malloc(len);
+  if (!dst) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): P_cache_spill_dup() unable to malloc(). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  memcpy(dst, src, len);
+
+  return dst;
+}
+
+void P_cache_spill_copy(struct chained_cache *dst, struct chained_cache *src)
+{
+  memcpy(dst, src, dbc_size);
+
+  dst->pbgp = P_cache_spill_dup(src->pbgp, PbgpSz);
+  dst->pnat = P_cache_spill_dup(src->pnat, PnatSz);
+  dst->pmpls = P_cache_spill_dup(src->pmpls, PmplsSz);
+  dst->ptun = P_cache_spill_dup(src->ptun, PtunSz);
+  dst->pcust = P_cache_spill_dup(src->pcust, pc_size);
+  if (src->pvlen) dst->pvlen = P_cache_spill_dup(src->pvlen, (PvhdrSz + src->pvlen->tot_len));
+  dst->stitch = P_cache_spill_dup(src->stitch, sizeof(struct pkt_stitching));
+  dst->hll = P_cache_spill_dup(src->hll, HLL_REGISTERS(config.distinct_precision));
+
+  dst->valid = PRINT_CACHE_COMMITTED;
+  dst->prep_valid = FALSE;
+  dst->next = NULL;
+}
+
+void P_cache_spill_sum(struct chained_cache *dst, struct chained_cache *src)
+{
+  dst->bytes_counter += src->bytes_counter;
+  dst->packet_counter += src->packet_counter;
+  dst->flow_counter += src->flow_counter;
+  dst->flow_type = src->flow_type;
+  dst->tcp_flags |= src->tcp_flags;
+
+  if (dst->stitch && src->stitch) {
+    if (timeval_cmp(&src->stitch->timestamp_min, &dst->stitch->timestamp_min) < 0)
+      memcpy(&dst->stitch->timestamp_min, &src->stitch->timestamp_min, sizeof(struct timeval));
+
+    if (timeval_cmp(&src->stitch->timestamp_max, &dst->stitch->timestamp_max) > 0)
+      memcpy(&dst->stitch->timestamp_max, &src->stitch->timestamp_max, sizeof(struct timeval));
+  }
+
+  if (dst->hll && src->hll) hll_merge(dst->hll, src->hll, config.distinct_precision);
+}
+
+static int P_cache_spill_write(FILE *f, struct chained_cache *elem)
+{
+  struct p_cache_spill_rec_hdr hdr;
+  int ret = 0;
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.len = sizeof(hdr) + pp_size;
+  hdr.basetime = elem->basetime;
+  hdr.bytes_counter = elem->bytes_counter;
+  hdr.packet_counter = elem->packet_counter;
+  hdr.flow_counter = elem->flow_counter;
+  hdr.tcp_flags = elem->tcp_flags;
+  hdr.flow_type = elem->flow_type;
+
+  if (elem->pbgp) { hdr.flags |= P_CACHE_SPILL_HAS_BGP; hdr.len += PbgpSz; }
+  if (elem->pnat) { hdr.flags |= P_CACHE_SPILL_HAS_NAT; hdr.len += PnatSz; }
+  if (elem->pmpls) { hdr.flags |= P_CACHE_SPILL_HAS_MPLS; hdr.len += PmplsSz; }
+  if (elem->ptun) { hdr.flags |= P_CACHE_SPILL_HAS_TUN; hdr.len += PtunSz; }
+  if (elem->pcust) { hdr.flags |= P_CACHE_SPILL_HAS_CUST; hdr.len += pc_size; }
+  if (elem->pvlen) {
+    hdr.flags |= P_CACHE_SPILL_HAS_VLEN;
+    hdr.vlen_len = (PvhdrSz + elem->pvlen->tot_len);
+    hdr.len += hdr.vlen_len;
+  }
+  if (elem->stitch) { hdr.flags |= P_CACHE_SPILL_HAS_STITCH; hdr.len += sizeof(struct pkt_stitching); }
+  if (elem->hll) { hdr.flags |= P_CACHE_SPILL_HAS_HLL; hdr.len += HLL_REGISTERS(config.distinct_precision); }
+
+  ret += (fwrite(&hdr, sizeof(hdr), 1, f) != 1);
+  ret += (fwrite(&elem->primitives, pp_size, 1, f) != 1);
+  if (elem->pbgp) ret += (fwrite(elem->pbgp, PbgpSz, 1, f) != 1);
+  if (elem->pnat) ret += (fwrite(elem->pnat, PnatSz, 1, f) != 1);
+  if (elem->pmpls) ret += (fwrite(elem->pmpls, PmplsSz, 1, f) != 1);
+  if (elem->ptun) ret += (fwrite(elem->ptun, PtunSz, 1, f) != 1);
+  if (elem->pcust) ret += (fwrite(elem->pcust, pc_size, 1, f) != 1);
+  if (elem->pvlen) ret += (fwrite(elem->pvlen, hdr.vlen_len, 1, f) != 1);
+  if (elem->stitch) ret += (fwrite(elem->stitch, sizeof(struct pkt_stitching), 1, f) != 1);
+  if (elem->hll) ret += (fwrite(elem->hll, HLL_REGISTERS(config.distinct_precision), 1, f) != 1);
+
+  return (ret ? ERR : SUCCESS);
+}
+
+/* reads the next record of a run into run->cur; extras buffers are
+   allocated on first use and then recycled across records */
+static int P_cache_spill_read(struct p_cache_spill_run *run)
+{
+  struct p_cache_spill_rec_hdr hdr;
+  struct chained_cache *cur = &run->cur;
+  int ret = 0;
+
+  if (run->eof) return ERR;
+
+  if (fread(&hdr, sizeof(hdr), 1, run->f) != 1) goto eof;
+  if (fread(&cur->primitives, pp_size, 1, run->f) != 1) goto corrupt;
+
+  cur->basetime = hdr.basetime;
+  cur->bytes_counter = hdr.bytes_counter;
+  cur->packet_counter = hdr.packet_counter;
+  cur->flow_counter = hdr.flow_counter;
+  cur->tcp_flags = hdr.tcp_flags;
+  cur->flow_type = hdr.flow_type;
+
+  /* release extras the previous record had and this one has not */
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_BGP) && cur->pbgp) { free(cur->pbgp); cur->pbgp = NULL; }
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_NAT) && cur->pnat) { free(cur->pnat); cur->pnat = NULL; }
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_MPLS) && cur->pmpls) { free(cur->pmpls); cur->pmpls = NULL; }
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_TUN) && cur->ptun) { free(cur->ptun); cur->ptun = NULL; }
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_CUST) && cur->pcust) { free(cur->pcust); cur->pcust = NULL; }
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_STITCH) && cur->stitch) { free(cur->stitch); cur->stitch = NULL; }
+  if (!(hdr.flags & P_CACHE_SPILL_HAS_HLL) && cur->hll) { free(cur->hll); cur->hll = NULL; }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_BGP) {
+    if (!cur->pbgp) cur->pbgp = malloc(PbgpSz);
+    if (!cur->pbgp) goto corrupt;
+    ret += (fread(cur->pbgp, PbgpSz, 1, run->f) != 1);
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_NAT) {
+    if (!cur->pnat) cur->pnat = malloc(PnatSz);
+    if (!cur->pnat) goto corrupt;
+    ret += (fread(cur->pnat, PnatSz, 1, run->f) != 1);
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_MPLS) {
+    if (!cur->pmpls) cur->pmpls = malloc(PmplsSz);
+    if (!cur->pmpls) goto corrupt;
+    ret += (fread(cur->pmpls, PmplsSz, 1, run->f) != 1);
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_TUN) {
+    if (!cur->ptun) cur->ptun = malloc(PtunSz);
+    if (!cur->ptun) goto corrupt;
+    ret += (fread(cur->ptun, PtunSz, 1, run->f) != 1);
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_CUST) {
+    if (!cur->pcust) cur->pcust = malloc(pc_size);
+    if (!cur->pcust) goto corrupt;
+    ret += (fread(cur->pcust, pc_size, 1, run->f) != 1);
+  }
+
+  if (cur->pvlen) {
+    vlen_prims_free(cur->pvlen);
+    cur->pvlen = NULL;
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_VLEN) {
+    if (hdr.vlen_len < PvhdrSz) goto corrupt;
+    cur->pvlen = malloc(hdr.vlen_len);
+    if (!cur->pvlen) goto corrupt;
+    ret += (fread(cur->pvlen, hdr.vlen_len, 1, run->f) != 1);
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_STITCH) {
+    if (!cur->stitch) cur->stitch = malloc(sizeof(struct pkt_stitching));
+    if (!cur->stitch) goto corrupt;
+    ret += (fread(cur->stitch, sizeof(struct pkt_stitching), 1, run->f) != 1);
+  }
+
+  if (hdr.flags & P_CACHE_SPILL_HAS_HLL) {
+    if (!cur->hll) cur->hll = malloc(HLL_REGISTERS(config.distinct_precision));
+    if (!cur->hll) goto corrupt;
+    ret += (fread(cur->hll, HLL_REGISTERS(config.distinct_precision), 1, run->f) != 1);
+  }
+
+  if (ret) goto corrupt;
+
+  return SUCCESS;
+
+  corrupt:
+  Log(LOG_WARNING, "WARN ( %s/%s ): P_cache_spill_read(): truncated or corrupt spill record. Skipping rest of run.\n", config.name, config.type);
+
+  eof:
+  run->eof = TRUE;
+
+  return ERR;
+}
+
+void P_cache_spill_init()
+{
+  memset(&cache_spill, 0, sizeof(cache_spill));
+
+  if (!config.print_cache_spill_dir) return;
+
+  if (access(config.print_cache_spill_dir, W_OK|X_OK)) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): print_cache_spill_dir '%s' is not a writable directory: %s. Exiting.\n",
+	config.name, config.type, config.print_cache_spill_dir, strerror(errno));
+    exit_gracefully(1);
+  }
+
+  cache_spill.dir = config.print_cache_spill_dir;
+  cache_spill.owner = getpid();
+  cache_spill.mem_max = config.print_cache_memory_max;
+
+  Log(LOG_INFO, "INFO ( %s/%s ): cache spill enabled: dir=%s memory budget=%" PRIu64 " bytes\n",
+	config.name, config.type, cache_spill.dir, cache_spill.mem_max);
+}
+
+u_int64_t P_cache_spill_entry_size(struct chained_cache *elem)
+{
+  u_int64_t size = dbc_size;
+
+  if (elem->pbgp) size += PbgpSz;
+  if (elem->pnat) size += PnatSz;
+  if (elem->pmpls) size += PmplsSz;
+  if (elem->ptun) size += PtunSz;
+  if (elem->pcust) size += pc_size;
+  if (elem->pvlen) size += (PvhdrSz + elem->pvlen->tot_len);
+  if (elem->stitch) size += sizeof(struct pkt_stitching);
+  if (elem->hll) size += HLL_REGISTERS(config.distinct_precision);
+
+  return size;
+}
+
+/* entry is leaving the cache: takes it off the memory budget */
+void P_cache_spill_unaccount(struct chained_cache *elem)
+{
+  u_int64_t size = P_cache_spill_entry_size(elem);
+
+  if (cache_spill.mem_used > size) cache_spill.mem_used -= size;
+  else cache_spill.mem_used = 0;
+}
+
+int P_cache_spill_is_due()
+{
+  if (cache_spill.dir && cache_spill.mem_max && cache_spill.mem_used > cache_spill.mem_max) return TRUE;
+
+  return FALSE;
+}
+
+/* k-way merges the on-disk runs, and optionally a sorted array of
+   in-memory entries, aggregating equal keys. Each merged entry is handed
+   over to emit() which takes ownership of its extras. Runs are removed
+   once consumed */
+static void P_cache_spill_merge(struct chained_cache **mem, int mem_num,
+				void (*emit)(struct chained_cache *, void *), void *ctx)
+{
+  struct p_cache_spill_run runs[P_CACHE_SPILL_RUNS_MAX];
+  struct chained_cache acc, *min;
+  int j, min_run, mem_idx, have = FALSE;
+
+  memset(runs, 0, sizeof(runs));
+  memset(&acc, 0, sizeof(acc));
+
+  for (j = 0; j < cache_spill.runs_num; j++) {
+    runs[j].f = fopen(cache_spill.runs[j], "r");
+
+    if (!runs[j].f) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to open spill run '%s': %s\n", config.name, config.type, cache_spill.runs[j], strerror(errno));
+      runs[j].eof = TRUE;
+    }
+    else P_cache_spill_read(&runs[j]);
+  }
+
+  for (mem_idx = 0;;) {
+    min = NULL;
+    min_run = ERR;
+
+    for (j = 0; j < cache_spill.runs_num; j++) {
+      if (runs[j].eof) continue;
+
+      if (!min || P_cache_cmp(&runs[j].cur, min) < 0) {
+        min = &runs[j].cur;
+        min_run = j;
+      }
+    }
+
+    if (mem_idx < mem_num && (!min || P_cache_cmp(mem[mem_idx], min) < 0)) {
+      min = mem[mem_idx];
+      min_run = ERR;
+    }
+
+    if (!min) break;
+
+    if (have && !P_cache_cmp(&acc, min)) P_cache_spill_sum(&acc, min);
+    else {
+      if (have) {
+	(*emit)(&acc, ctx);
+	memset(&acc, 0, sizeof(acc));
+      }
+
+      P_cache_spill_copy(&acc, min);
+      have = TRUE;
+    }
+
+    if (min_run == ERR) mem_idx++;
+    else P_cache_spill_read(&runs[min_run]);
+  }
+
+  if (have) (*emit)(&acc, ctx);
+
+  for (j = 0; j < cache_spill.runs_num; j++) {
+    if (runs[j].f) fclose(runs[j].f);
+    P_cache_spill_free_extras(&runs[j].cur);
+    unlink(cache_spill.runs[j]);
+  }
+
+  cache_spill.runs_num = 0;
+}
+
+static void P_cache_spill_emit_run(struct chained_cache *elem, void *ctx)
+{
+  FILE *f = (FILE *) ctx;
+
+  P_cache_spill_write(f, elem);
+  P_cache_spill_free_extras(elem);
+}
+
+/* folds all existing runs into a single one, in constant memory */
+static int P_cache_spill_compact()
+{
+  char filename[SRVBUFLEN];
+  FILE *f;
+
+  P_cache_spill_filename(filename, SRVBUFLEN, cache_spill.seq);
+
+  f = fopen(filename, "w");
+  if (!f) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to open spill file '%s': %s\n", config.name, config.type, filename, strerror(errno));
+    return ERR;
+  }
+
+  Log(LOG_INFO, "INFO ( %s/%s ): Compacting %u spill runs into %s\n", config.name, config.type, cache_spill.runs_num, filename);
+
+  P_cache_spill_merge(NULL, 0, P_cache_spill_emit_run, f);
+
+  strlcpy(cache_spill.runs[0], filename, SRVBUFLEN);
+  cache_spill.runs_num = 1;
+  cache_spill.seq++;
+
+  if (fclose(f)) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to write spill file '%s': %s\n", config.name, config.type, filename, strerror(errno));
+    return ERR;
+  }
+
+  return SUCCESS;
+}
+
+/* sorts in-use and committed cache entries and appends them to a new run
+   file. The caller is expected to flush the cache on success */
+int P_cache_spill(struct chained_cache *queue[], int index)
+{
+  struct chained_cache **sorted;
+  char filename[SRVBUFLEN];
+  FILE *f;
+  int j, num, ret = SUCCESS;
+
+  if (!cache_spill.dir || !index) return ERR;
+
+  if (cache_spill.runs_num == P_CACHE_SPILL_RUNS_MAX) {
+    if (P_cache_spill_compact() == ERR) return ERR;
+  }
+
+  sorted = malloc(index * sizeof(struct chained_cache *));
+  if (!sorted) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): P_cache_spill() unable to malloc() sort buffer.\n", config.name, config.type);
+    return ERR;
+  }
+
+  for (j = 0, num = 0; j < index; j++) {
+    if (queue[j]->valid != PRINT_CACHE_FREE) {
+      sorted[num] = queue[j];
+      num++;
+    }
+  }
+
+  qsort(sorted, num, sizeof(struct chained_cache *), P_cache_spill_qsort_cmp);
+
+  P_cache_spill_filename(filename, SRVBUFLEN, cache_spill.seq);
+
+  f = fopen(filename, "w");
+  if (!f) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to open spill file '%s': %s\n", config.name, config.type, filename, strerror(errno));
+    free(sorted);
+    return ERR;
+  }
+
+  for (j = 0; j < num && ret == SUCCESS; j++) ret = P_cache_spill_write(f, sorted[j]);
+  if (fclose(f)) ret = ERR;
+
+  free(sorted);
+
+  if (ret == ERR) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to write spill file '%s': %s\n", config.name, config.type, filename, strerror(errno));
+    unlink(filename);
+    return ERR;
+  }
+
+  strlcpy(cache_spill.runs[cache_spill.runs_num], filename, SRVBUFLEN);
+  cache_spill.runs_num++;
+  cache_spill.seq++;
+
+  Log(LOG_INFO, "INFO ( %s/%s ): Spilled %u cache entries to %s (run %u)\n", config.name, config.type, num, filename, cache_spill.runs_num);
+
+  return SUCCESS;
+}
+
+struct p_cache_spill_purge_ctx {
+  struct chained_cache *batch;
+  struct chained_cache **batch_queue;
+  int batch_num;
+  int batch_max;
+  FILE *carry;
+  u_int64_t carried;
+  struct timeval commit_basetime;
+  int delay;
+};
+
+static void P_cache_spill_purge_batch(struct p_cache_spill_purge_ctx *pctx, int safe_action)
+{
+  int j;
+
+  for (j = 0; j < pctx->batch_num; j++) pctx->batch_queue[j] = &pctx->batch[j];
+
+  (*purge_func)(pctx->batch_queue, pctx->batch_num, safe_action);
+
+  /* subsequent batches must not truncate what has just been written */
+  config.print_output_file_append = TRUE;
+
+  for (j = 0; j < pctx->batch_num; j++) P_cache_spill_free_extras(&pctx->batch[j]);
+  pctx->batch_num = 0;
+}
+
+static void P_cache_spill_emit_purge(struct chained_cache *elem, void *ctx)
+{
+  struct p_cache_spill_purge_ctx *pctx = (struct p_cache_spill_purge_ctx *) ctx;
+
+  /* not yet due for commit: same test as P_cache_mark_flush() */
+  if (pctx->carry && pctx->commit_basetime.tv_sec < (elem->basetime.tv_sec + pctx->delay)) {
+    if (P_cache_spill_write(pctx->carry, elem) == SUCCESS) pctx->carried++;
+    P_cache_spill_free_extras(elem);
+    return;
+  }
+
+  if (pctx->batch_num == pctx->batch_max) P_cache_spill_purge_batch(pctx, TRUE);
+
+  memcpy(&pctx->batch[pctx->batch_num], elem, dbc_size);
+  pctx->batch_num++;
+}
+
+/* merges the on-disk runs with the committed in-memory entries and hands
+   the result to purge_func in batches of print_cache_entries. Entries not
+   yet due for commit are carried over to a new run which the parent will
+   adopt, see P_cache_spill_rotate(); the run is written under a temporary
+   name and renamed once complete */
+void P_cache_spill_purge(struct chained_cache *queue[], int index, int exiting)
+{
+  struct p_cache_spill_purge_ctx pctx;
+  struct chained_cache **mem;
+  char carry[SRVBUFLEN], carry_tmp[SRVBUFLEN];
+  int j, mem_num;
+
+  memset(&pctx, 0, sizeof(pctx));
+  pctx.batch_max = config.print_cache_entries;
+
+  mem = malloc((index ? index : 1) * sizeof(struct chained_cache *));
+  pctx.batch = calloc(pctx.batch_max, dbc_size);
+  pctx.batch_queue = malloc(pctx.batch_max * sizeof(struct chained_cache *));
+
+  if (!mem || !pctx.batch || !pctx.batch_queue) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): P_cache_spill_purge() unable to malloc() merge buffers. Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  for (j = 0, mem_num = 0; j < index; j++) {
+    if (queue[j]->valid == PRINT_CACHE_COMMITTED) {
+      mem[mem_num] = queue[j];
+      mem_num++;
+    }
+  }
+
+  qsort(mem, mem_num, sizeof(struct chained_cache *), P_cache_spill_qsort_cmp);
+
+  if (!exiting) {
+    P_cache_spill_filename(carry, SRVBUFLEN, cache_spill.seq);
+    if (snprintf(carry_tmp, SRVBUFLEN, "%s.tmp", carry) >= SRVBUFLEN)
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to open spill carry-over: path too long '%s'\n", config.name, config.type, carry);
+    else if (!(pctx.carry = fopen(carry_tmp, "w"))) Log(LOG_WARNING, "WARN ( %s/%s ): Unable to open spill carry-over '%s': %s\n", config.name, config.type, carry_tmp, strerror(errno));
+    P_eval_commit_basetime(&pctx.commit_basetime, &pctx.delay);
+  }
+
+  P_cache_spill_merge(mem, mem_num, P_cache_spill_emit_purge, &pctx);
+  P_cache_spill_purge_batch(&pctx, FALSE);
+
+  if (pctx.carry) {
+    if (fclose(pctx.carry)) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to write spill carry-over '%s': %s\n", config.name, config.type, carry_tmp, strerror(errno));
+      unlink(carry_tmp);
+    }
+    else if (rename(carry_tmp, carry)) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to rename spill carry-over '%s': %s\n", config.name, config.type, carry_tmp, strerror(errno));
+      unlink(carry_tmp);
+    }
+    else if (pctx.carried) Log(LOG_INFO, "INFO ( %s/%s ): Carried over %" PRIu64 " pending entries to %s\n", config.name, config.type, pctx.carried, carry);
+  }
+
+  free(mem);
+  free(pctx.batch);
+  free(pctx.batch_queue);
+}
+
+/* to be called by the parent: adopts the carry-over runs writers have
+   completed. A run missing once its writer is gone was never completed
+   and its entries are lost; one whose writer is still busy is left for
+   a later call */
+void P_cache_spill_adopt()
+{
+  struct p_cache_spill_carry *carry;
+  struct stat st;
+  int j, num, busy;
+
+  for (j = 0, num = 0; j < cache_spill.carry_num; j++) {
+    carry = &cache_spill.carry[j];
+
+    /* checked before stat(): a writer found gone has renamed already */
+    busy = (kill(carry->writer, 0) != -1);
+
+    if (!stat(carry->name, &st)) {
+      if (!st.st_size) {
+        unlink(carry->name);
+        continue;
+      }
+
+      if (cache_spill.runs_num < P_CACHE_SPILL_RUNS_MAX || P_cache_spill_compact() == SUCCESS) {
+        strlcpy(cache_spill.runs[cache_spill.runs_num], carry->name, SRVBUFLEN);
+        cache_spill.runs_num++;
+        continue;
+      }
+    }
+    else if (!busy) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): Spill carry-over '%s' was not completed by writer %u. Pending entries lost.\n",
+	  config.name, config.type, carry->name, carry->writer);
+      continue;
+    }
+
+    if (num != j) memcpy(&cache_spill.carry[num], carry, sizeof(struct p_cache_spill_carry));
+    num++;
+  }
+
+  cache_spill.carry_num = num;
+}
+
+/* to be called by the parent at purge time, before flushing the cache.
+   If a writer was handed the runs over, they now belong to it and the
+   carry-over run it produces is to be adopted in a later interval. If
+   not, committed entries are spilled too and everything is kept for the
+   next purge */
+void P_cache_spill_rotate(pid_t writer, struct chained_cache *queue[], int index)
+{
+  struct p_cache_spill_carry *carry;
+
+  if (!cache_spill.dir) return;
+
+  if (writer <= 0) {
+    if (index) P_cache_spill(queue, index);
+    if (cache_spill.runs_num) Log(LOG_INFO, "INFO ( %s/%s ): Keeping %u spill runs for the next purge\n", config.name, config.type, cache_spill.runs_num);
+
+    return;
+  }
+
+  if (!cache_spill.runs_num) return;
+
+  cache_spill.runs_num = 0;
+
+  if (cache_spill.carry_num < P_CACHE_SPILL_RUNS_MAX) {
+    carry = &cache_spill.carry[cache_spill.carry_num];
+    carry->writer = writer;
+    P_cache_spill_filename(carry->name, SRVBUFLEN, cache_spill.seq);
+    cache_spill.carry_num++;
+  }
+  else Log(LOG_WARNING, "WARN ( %s/%s ): Too many spill carry-overs in progress. Pending entries of writer %u lost.\n",
+	   config.name, config.type, writer);
+
+  cache_spill.seq++;
+}
@@ -0,0 +1,93 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef PLUGIN_CMN_SPILL_H
+#define PLUGIN_CMN_SPILL_H
+
+/* defines */
+#define P_CACHE_SPILL_RUNS_MAX		64
+
+#define P_CACHE_SPILL_HAS_BGP		0x01
+#define P_CACHE_SPILL_HAS_NAT		0x02
+#define P_CACHE_SPILL_HAS_MPLS		0x04
+#define P_CACHE_SPILL_HAS_TUN		0x08
+#define P_CACHE_SPILL_HAS_CUST		0x10
+#define P_CACHE_SPILL_HAS_VLEN		0x20
+#define P_CACHE_SPILL_HAS_STITCH	0x40
+#define P_CACHE_SPILL_HAS_HLL		0x80
+
+/* structures */
+/* on-disk record header; a record is made of this header followed by
+   struct pkt_primitives and, as flagged, the extra primitives in the
+   same order as they appear in struct chained_cache */
+struct p_cache_spill_rec_hdr {
+  u_int32_t len;
+  u_int32_t flags;
+  u_int32_t vlen_len;
+  struct timeval basetime;
+  pm_counter_t bytes_counter;
+  pm_counter_t packet_counter;
+  pm_counter_t flow_counter;
+  u_int32_t tcp_flags;
+  u_int8_t flow_type;
+};
+
+struct p_cache_spill_run {
+  FILE *f;
+  struct chained_cache cur;
+  int eof;
+};
+
+/* carry-over run a writer is producing; adopted once complete */
+struct p_cache_spill_carry {
+  pid_t writer;
+  char name[SRVBUFLEN];
+};
+
+struct p_cache_spill {
+  char *dir;
+  u_int64_t mem_max;
+  u_int64_t mem_used;
+  pid_t owner;
+  u_int32_t seq;
+  int runs_num;
+  char runs[P_CACHE_SPILL_RUNS_MAX][SRVBUFLEN];
+  int carry_num;
+  struct p_cache_spill_carry carry[P_CACHE_SPILL_RUNS_MAX];
+};
+
+/* prototypes */
+extern void P_cache_spill_init();
+extern u_int64_t P_cache_spill_entry_size(struct chained_cache *);
+extern void P_cache_spill_unaccount(struct chained_cache *);
+extern int P_cache_spill_is_due();
+extern int P_cache_spill(struct chained_cache *[], int);
+extern void P_cache_spill_purge(struct chained_cache *[], int, int);
+extern void P_cache_spill_adopt();
+extern void P_cache_spill_rotate(pid_t, struct chained_cache *[], int);
+extern void P_cache_spill_free_extras(struct chained_cache *);
+extern void P_cache_spill_copy(struct chained_cache *, struct chained_cache *);
+extern void P_cache_spill_sum(struct chained_cache *, struct chained_cache *);
+
+/* global variables */
+extern struct p_cache_spill cache_spill;
+
+#endif //PLUGIN_CMN_SPILL_H
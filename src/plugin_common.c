@@ -22,12 +22,15 @@
 /* includes */
 #include "pmacct.h"
 #include "plugin_common.h"
+#include "plugin_cmn_spill.h"
+#include "plugin_cmn_rollup.h"
 #include "addr.h"
 #include "pmacct-data.h"
 #include "plugin_hooks.h"
 #include "ip_flow.h"
 #include "classifier.h"
 #include "crc32.h"
+#include "hll.h"
 #include "preprocess-internal.h"
 
 /* Global variables */
@@ -87,6 +90,7 @@ void P_init_default_values()
   if (!config.sql_refresh_time) config.sql_refresh_time = DEFAULT_PLUGIN_COMMON_REFRESH_TIME;
   if (!config.print_cache_entries) config.print_cache_entries = PRINT_CACHE_ENTRIES;
   if (!config.dump_max_writers) config.dump_max_writers = DEFAULT_PLUGIN_COMMON_WRITERS_NO;
+  if (config.distinct_what_to_count && !config.distinct_precision) config.distinct_precision = HLL_PRECISION_DEFAULT;
 
   dump_writers.list = malloc(config.dump_max_writers * sizeof(pid_t));
   dump_writers_init();
@@ -120,6 +124,9 @@ void P_init_default_values()
   memset(sa.base, 0, sa.size);
   memset(&flushtime, 0, sizeof(flushtime));
 
+  P_cache_spill_init();
+  P_cache_rollup_init();
+
   /* handling purge preprocessor */
   set_preprocess_funcs(config.sql_preprocess, &prep, PREP_DICT_PRINT);
 }
@@ -131,13 +138,99 @@ void P_config_checks()
     goto exit_lane;
   }
 
+  if (config.distinct_what_to_count) {
+    if (config.what_to_count & (COUNT_SUM_HOST|COUNT_SUM_NET|COUNT_SUM_PORT|COUNT_SUM_AS|COUNT_SUM_MAC)) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): aggregate_distinct and sum_* primitives are mutual exclusive. Exiting.\n", config.name, config.type);
+      goto exit_lane;
+    }
+
+    if (config.type_id == PLUGIN_ID_TOPK) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): aggregate_distinct is not supported by the topk plugin. Exiting.\n", config.name, config.type);
+      goto exit_lane;
+    }
+  }
+
   return;
 
 exit_lane:
   exit_gracefully(1);
 }
 
-unsigned int P_cache_modulo(struct primitives_ptrs *prim_ptrs)
+/* hashes the primitives distinct values are counted over (see
+   aggregate_distinct), then clears those not part of the aggregation
+   key: the core fills them in on our behalf */
+u_int64_t P_distinct_hash(struct pkt_primitives *srcdst)
+{
+  u_char buf[SRVBUFLEN], *ptr = buf;
+  pm_cfgreg_t wtc = config.distinct_what_to_count;
+
+#if defined (HAVE_L2)
+  if (wtc & COUNT_SRC_MAC) {
+    memcpy(ptr, srcdst->eth_shost, ETH_ADDR_LEN);
+    ptr += ETH_ADDR_LEN;
+    if (!(config.what_to_count & COUNT_SRC_MAC)) memset(srcdst->eth_shost, 0, ETH_ADDR_LEN);
+  }
+
+  if (wtc & COUNT_DST_MAC) {
+    memcpy(ptr, srcdst->eth_dhost, ETH_ADDR_LEN);
+    ptr += ETH_ADDR_LEN;
+    if (!(config.what_to_count & COUNT_DST_MAC)) memset(srcdst->eth_dhost, 0, ETH_ADDR_LEN);
+  }
+
+  if (wtc & COUNT_VLAN) {
+    memcpy(ptr, &srcdst->vlan_id, sizeof(srcdst->vlan_id));
+    ptr += sizeof(srcdst->vlan_id);
+    if (!(config.what_to_count & COUNT_VLAN)) srcdst->vlan_id = 0;
+  }
+#endif
+
+  if (wtc & COUNT_SRC_HOST) {
+    memcpy(ptr, &srcdst->src_ip, sizeof(struct host_addr));
+    ptr += sizeof(struct host_addr);
+    if (!(config.what_to_count & COUNT_SRC_HOST)) memset(&srcdst->src_ip, 0, sizeof(struct host_addr));
+  }
+
+  if (wtc & COUNT_DST_HOST) {
+    memcpy(ptr, &srcdst->dst_ip, sizeof(struct host_addr));
+    ptr += sizeof(struct host_addr);
+    if (!(config.what_to_count & COUNT_DST_HOST)) memset(&srcdst->dst_ip, 0, sizeof(struct host_addr));
+  }
+
+  if (wtc & COUNT_SRC_PORT) {
+    memcpy(ptr, &srcdst->src_port, sizeof(srcdst->src_port));
+    ptr += sizeof(srcdst->src_port);
+    if (!(config.what_to_count & COUNT_SRC_PORT)) srcdst->src_port = 0;
+  }
+
+  if (wtc & COUNT_DST_PORT) {
+    memcpy(ptr, &srcdst->dst_port, sizeof(srcdst->dst_port));
+    ptr += sizeof(srcdst->dst_port);
+    if (!(config.what_to_count & COUNT_DST_PORT)) srcdst->dst_port = 0;
+  }
+
+  if (wtc & COUNT_IP_PROTO) {
+    memcpy(ptr, &srcdst->proto, sizeof(srcdst->proto));
+    ptr += sizeof(srcdst->proto);
+    if (!(config.what_to_count & COUNT_IP_PROTO)) srcdst->proto = 0;
+  }
+
+  if (wtc & COUNT_IP_TOS) {
+    memcpy(ptr, &srcdst->tos, sizeof(srcdst->tos));
+    ptr += sizeof(srcdst->tos);
+    if (!(config.what_to_count & COUNT_IP_TOS)) srcdst->tos = 0;
+  }
+
+  return hll_hash(buf, (ptr - buf));
+}
+
+pm_counter_t P_cache_distinct_count(struct chained_cache *elem)
+{
+  if (!elem->hll) return 0;
+
+  return hll_count(elem->hll, config.distinct_precision);
+}
+
+unsigned int P_cache_hash(struct primitives_ptrs *prim_ptrs)
 {
   struct pkt_data *pdata = prim_ptrs->data;
   struct pkt_primitives *srcdst = &pdata->primitives;
@@ -157,7 +250,12 @@ unsigned int P_cache_modulo(struct primitives_ptrs *prim_ptrs)
   if (pcust) modulo ^= cache_crc32((unsigned char *)pcust, pc_size);
   if (pvlen) modulo ^= cache_crc32((unsigned char *)pvlen, (PvhdrSz + pvlen->tot_len));
 
-  return modulo %= config.print_cache_entries;
+  return modulo;
+}
+
+unsigned int P_cache_modulo(struct primitives_ptrs *prim_ptrs)
+{
+  return (P_cache_hash(prim_ptrs) % config.print_cache_entries);
 }
 
 struct chained_cache *P_cache_search(struct primitives_ptrs *prim_ptrs)
@@ -226,6 +324,38 @@ struct chained_cache *P_cache_search(struct primitives_ptrs *prim_ptrs)
   return NULL;
 }
 
+/* total order over cache entries; two entries compare equal if and only
+   if P_cache_insert() would aggregate them in the same cache slot */
+int P_cache_cmp(struct chained_cache *a, struct chained_cache *b)
+{
+  int ret;
+
+  if (a->basetime.tv_sec != b->basetime.tv_sec) return (a->basetime.tv_sec < b->basetime.tv_sec ? -1 : 1);
+  if (a->basetime.tv_usec != b->basetime.tv_usec) return (a->basetime.tv_usec < b->basetime.tv_usec ? -1 : 1);
+
+  if ((ret = memcmp(&a->primitives, &b->primitives, pp_size))) return ret;
+
+  if (!a->pbgp != !b->pbgp) return (a->pbgp ? 1 : -1);
+  if (a->pbgp && (ret = memcmp(a->pbgp, b->pbgp, PbgpSz))) return ret;
+
+  if (!a->pnat != !b->pnat) return (a->pnat ? 1 : -1);
+  if (a->pnat && (ret = memcmp(a->pnat, b->pnat, PnatSz))) return ret;
+
+  if (!a->pmpls != !b->pmpls) return (a->pmpls ? 1 : -1);
+  if (a->pmpls && (ret = memcmp(a->pmpls, b->pmpls, PmplsSz))) return ret;
+
+  if (!a->ptun != !b->ptun) return (a->ptun ? 1 : -1);
+  if (a->ptun && (ret = memcmp(a->ptun, b->ptun, PtunSz))) return ret;
+
+  if (!a->pcust != !b->pcust) return (a->pcust ? 1 : -1);
+  if (a->pcust && (ret = memcmp(a->pcust, b->pcust, pc_size))) return ret;
+
+  if (!a->pvlen != !b->pvlen) return (a->pvlen ? 1 : -1);
+  if (a->pvlen && (ret = vlen_prims_cmp(a->pvlen, b->pvlen))) return ret;
+
+  return 0;
+}
+
 void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata)
 {
   struct pkt_data *data = prim_ptrs->data;
@@ -235,9 +365,10 @@ void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata
   struct pkt_tunnel_primitives *ptun = prim_ptrs->ptun;
   u_char *pcust = prim_ptrs->pcust;
   struct pkt_vlen_hdr_primitives *pvlen = prim_ptrs->pvlen;
-  unsigned int modulo = P_cache_modulo(prim_ptrs);
-  struct chained_cache *cache_ptr = &cache[modulo];
   struct pkt_primitives *srcdst = &data->primitives;
+  u_int64_t distinct_hash = 0;
+  unsigned int modulo;
+  struct chained_cache *cache_ptr;
   int res_data, res_bgp, res_nat, res_mpls, res_tun, res_time, res_cust, res_vlen;
 
   /* pro_rating vars */
@@ -248,6 +379,12 @@ void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata
   tot_packets = data->pkt_num;
   tot_flows = data->flo_num;
 
+  /* before hashing: distinct primitives may have to be cleared */
+  if (config.distinct_what_to_count) distinct_hash = P_distinct_hash(srcdst);
+
+  modulo = P_cache_modulo(prim_ptrs);
+  cache_ptr = &cache[modulo];
+
   if (config.sql_history && (*basetime_eval)) {
     memcpy(&ibasetime, &basetime, sizeof(ibasetime));
     (*basetime_eval)(&data->time_start, &ibasetime, timeslot);
@@ -458,9 +595,20 @@ void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata
     }
     else assert(!cache_ptr->stitch);
 
+    if (config.distinct_what_to_count) {
+      if (!cache_ptr->hll) cache_ptr->hll = (u_int8_t *) malloc(HLL_REGISTERS(config.distinct_precision));
+      if (cache_ptr->hll) {
+        memset(cache_ptr->hll, 0, HLL_REGISTERS(config.distinct_precision));
+        hll_add(cache_ptr->hll, config.distinct_precision, distinct_hash);
+      }
+      else goto safe_action;
+    }
+
     cache_ptr->valid = PRINT_CACHE_INUSE;
     cache_ptr->basetime.tv_sec = ibasetime.tv_sec;
     cache_ptr->basetime.tv_usec = ibasetime.tv_usec;
+
+    if (cache_spill.dir) cache_spill.mem_used += P_cache_spill_entry_size(cache_ptr);
   }
   else {
     if (cache_ptr->valid == PRINT_CACHE_INUSE) {
@@ -490,6 +638,8 @@ void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata
 	  }
 	}
       }
+
+      if (cache_ptr->hll) hll_add(cache_ptr->hll, config.distinct_precision, distinct_hash);
     }
     else {
       /* entry invalidated; restarting counters */
@@ -503,11 +653,17 @@ void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata
         cache_ptr->packet_counter += data->cst.pa;
         cache_ptr->flow_counter += data->cst.fa;
       }
+      if (cache_ptr->hll) {
+        memset(cache_ptr->hll, 0, HLL_REGISTERS(config.distinct_precision));
+        hll_add(cache_ptr->hll, config.distinct_precision, distinct_hash);
+      }
       cache_ptr->valid = PRINT_CACHE_INUSE;
       cache_ptr->basetime.tv_sec = ibasetime.tv_sec;
       cache_ptr->basetime.tv_usec = ibasetime.tv_usec;
       queries_queue[qq_ptr] = cache_ptr;
       qq_ptr++;
+
+      if (cache_spill.dir) cache_spill.mem_used += P_cache_spill_entry_size(cache_ptr);
     }
   }
 
@@ -519,18 +675,36 @@ void P_cache_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata
     }
   }
 
+  if (P_cache_spill_is_due()) {
+    if (P_cache_spill(queries_queue, qq_ptr) == SUCCESS) {
+      P_cache_flush(queries_queue, qq_ptr);
+      qq_ptr = FALSE;
+    }
+  }
+
   return;
 
   safe_action:
   {
     pid_t ret;
 
+    /* cache memory is exhausted: if spilling is enabled, move what we
+       have to a run file and carry on within the same interval */
+    if (cache_spill.dir && P_cache_spill(queries_queue, qq_ptr) == SUCCESS) {
+      P_cache_flush(queries_queue, qq_ptr);
+      qq_ptr = FALSE;
+
+      cache_ptr = &cache[modulo];
+      goto start;
+    }
+
     Log(LOG_INFO, "INFO ( %s/%s ): Finished cache entries (ie. print_cache_entries). Purging.\n", config.name, config.type);
 
     if (config.type_id == PLUGIN_ID_PRINT && config.sql_table && !config.print_output_file_append)
       Log(LOG_WARNING, "WARN ( %s/%s ): Make sure print_output_file_append is set to true.\n", config.name, config.type);
 
     if (qq_ptr) P_cache_mark_flush(queries_queue, qq_ptr, FALSE);
+    P_cache_rollup_fold(queries_queue, qq_ptr);
 
     /* Writing out to replenish cache space */
     dump_writers_count();
@@ -592,6 +766,7 @@ void P_cache_insert_pending(struct chained_cache *queue[], int index, struct cha
         if (!cache_ptr) {
           Log(LOG_WARNING, "WARN ( %s/%s ): Finished cache entries. Pending entries will be lost.\n", config.name, config.type);
           Log(LOG_WARNING, "WARN ( %s/%s ): You may want to set a larger print_cache_entries value.\n", config.name, config.type);
+          if (cache_spill.dir) for (; j < index; j++) P_cache_spill_unaccount(&container[j]);
           break;
         }
         else {
@@ -612,6 +787,7 @@ void P_cache_insert_pending(struct chained_cache *queue[], int index, struct cha
     if (cache_ptr->pcust) free(cache_ptr->pcust);
     if (cache_ptr->pvlen) free(cache_ptr->pvlen);
     if (cache_ptr->stitch) free(cache_ptr->stitch);
+    if (cache_ptr->hll) free(cache_ptr->hll);
 
     memcpy(cache_ptr, &container[j], dbc_size); 
 
@@ -622,6 +798,7 @@ void P_cache_insert_pending(struct chained_cache *queue[], int index, struct cha
     container[j].pcust = NULL;
     container[j].pvlen = NULL;
     container[j].stitch = NULL;
+    container[j].hll = NULL;
 
     cache_ptr->valid = PRINT_CACHE_INUSE;
     cache_ptr->next = NULL;
@@ -632,9 +809,12 @@ void P_cache_insert_pending(struct chained_cache *queue[], int index, struct cha
 
 void P_cache_handle_flush_event(struct ports_table *pt)
 {
-  pid_t ret;
+  pid_t ret = ERR;
 
   if (qq_ptr) P_cache_mark_flush(queries_queue, qq_ptr, FALSE);
+  P_cache_rollup_fold(queries_queue, qq_ptr);
+  P_cache_rollup_collect(FALSE);
+  P_cache_spill_adopt();
 
   dump_writers_count();
   if (dump_writers_get_flags() != CHLD_ALERT) {
@@ -643,7 +823,9 @@ void P_cache_handle_flush_event(struct ports_table *pt)
       pm_setproctitle("%s %s [%s]", config.type, "Plugin -- Writer", config.name);
       config.is_forked = TRUE;
 
-      (*purge_func)(queries_queue, qq_ptr, FALSE);
+      if (cache_spill.runs_num) P_cache_spill_purge(queries_queue, qq_ptr, FALSE);
+      else (*purge_func)(queries_queue, qq_ptr, FALSE);
+      P_cache_rollup_purge();
 
       exit_gracefully(0);
     default: /* Parent */
@@ -655,6 +837,8 @@ void P_cache_handle_flush_event(struct ports_table *pt)
   }
   else Log(LOG_WARNING, "WARN ( %s/%s ): Maximum number of writer processes reached (%d).\n", config.name, config.type, dump_writers_get_active());
 
+  P_cache_spill_rotate(ret, queries_queue, qq_ptr);
+  P_cache_rollup_release(ret);
   P_cache_flush(queries_queue, qq_ptr);
 
   gettimeofday(&flushtime, NULL);
@@ -674,22 +858,28 @@ void P_cache_handle_flush_event(struct ports_table *pt)
   }
 }
 
-void P_cache_mark_flush(struct chained_cache *queue[], int index, int exiting)
+void P_eval_commit_basetime(struct timeval *commit_basetime, int *delay)
 {
-  struct timeval commit_basetime;
-  int j, delay = 0;
-
-  memset(&commit_basetime, 0, sizeof(commit_basetime));
+  memset(commit_basetime, 0, sizeof(struct timeval));
+  (*delay) = 0;
 
   /* check-pointing */
-  if (new_basetime.tv_sec) commit_basetime.tv_sec = new_basetime.tv_sec;
-  else commit_basetime.tv_sec = basetime.tv_sec; 
+  if (new_basetime.tv_sec) commit_basetime->tv_sec = new_basetime.tv_sec;
+  else commit_basetime->tv_sec = basetime.tv_sec; 
 
   /* evaluating any delay we may have to introduce */
   if (config.sql_startup_delay) {
-    if (timeslot) delay = config.sql_startup_delay/timeslot;
-    delay = delay*timeslot;
+    if (timeslot) (*delay) = config.sql_startup_delay/timeslot;
+    (*delay) = (*delay)*timeslot;
   }
+}
+
+void P_cache_mark_flush(struct chained_cache *queue[], int index, int exiting)
+{
+  struct timeval commit_basetime;
+  int j, delay = 0;
+
+  P_eval_commit_basetime(&commit_basetime, &delay);
 
   /* mark committed entries as such */
   if (!exiting) {
@@ -721,6 +911,7 @@ void P_cache_mark_flush(struct chained_cache *queue[], int index, int exiting)
       pending_queries_queue[j]->pcust = NULL;
       pending_queries_queue[j]->pvlen = NULL;
       pending_queries_queue[j]->stitch = NULL;
+      pending_queries_queue[j]->hll = NULL;
 
       pending_queries_queue[j]->valid = PRINT_CACHE_FREE;
       pending_queries_queue[j] = &pqq_container[j];
@@ -737,6 +928,9 @@ void P_cache_flush(struct chained_cache *queue[], int index)
   int j;
 
   for (j = 0; j < index; j++) {
+    /* pending entries, moved out by P_cache_mark_flush(), stay accounted */
+    if (cache_spill.dir && queue[j]->valid != PRINT_CACHE_FREE) P_cache_spill_unaccount(queue[j]);
+
     queue[j]->valid = PRINT_CACHE_FREE;
     queue[j]->next = NULL;
   }
@@ -808,9 +1002,20 @@ void P_sum_mac_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *ida
 void P_exit_now(int signum)
 {
   if (qq_ptr) P_cache_mark_flush(queries_queue, qq_ptr, TRUE);
+  P_cache_rollup_fold(queries_queue, qq_ptr);
+  P_cache_rollup_collect(TRUE);
+
+  /* give writers a chance to complete their carry-overs */
+  P_cache_spill_adopt();
+  while (cache_spill.carry_num && wait(NULL) != -1) P_cache_spill_adopt();
+  if (cache_spill.carry_num) Log(LOG_WARNING, "WARN ( %s/%s ): %u spill carry-overs still in progress, left in %s\n", config.name, config.type, cache_spill.carry_num, cache_spill.dir);
 
   dump_writers_count();
-  if (dump_writers_get_flags() != CHLD_ALERT) (*purge_func)(queries_queue, qq_ptr, FALSE);
+  if (dump_writers_get_flags() != CHLD_ALERT) {
+    if (cache_spill.runs_num) P_cache_spill_purge(queries_queue, qq_ptr, TRUE);
+    else (*purge_func)(queries_queue, qq_ptr, FALSE);
+    P_cache_rollup_purge();
+  }
   else Log(LOG_WARNING, "WARN ( %s/%s ): Maximum number of writer processes reached (%d).\n", config.name, config.type, dump_writers_get_active());
 
   if (config.pidfile) remove_pid_file(config.pidfile);
@@ -74,6 +74,7 @@ struct chained_cache {
   u_int8_t prep_valid;
   struct timeval basetime;
   struct pkt_stitching *stitch;
+  u_int8_t *hll;
   struct chained_cache *next;
 };
 #endif
@@ -93,6 +94,9 @@ extern void P_set_signals();
 extern void P_init_default_values();
 extern void P_config_checks();
 extern struct chained_cache *P_cache_attach_new_node(struct chained_cache *);
+extern u_int64_t P_distinct_hash(struct pkt_primitives *);
+extern pm_counter_t P_cache_distinct_count(struct chained_cache *);
+extern unsigned int P_cache_hash(struct primitives_ptrs *);
 extern unsigned int P_cache_modulo(struct primitives_ptrs *);
 extern void P_sum_host_insert(struct primitives_ptrs *, struct insert_data *);
 extern void P_sum_port_insert(struct primitives_ptrs *, struct insert_data *);
@@ -101,8 +105,10 @@ extern void P_sum_as_insert(struct primitives_ptrs *, struct insert_data *);
 extern void P_sum_mac_insert(struct primitives_ptrs *, struct insert_data *);
 #endif
 extern struct chained_cache *P_cache_search(struct primitives_ptrs *);
+extern int P_cache_cmp(struct chained_cache *, struct chained_cache *);
 extern void P_cache_insert(struct primitives_ptrs *, struct insert_data *);
 extern void P_cache_insert_pending(struct chained_cache *[], int, struct chained_cache *);
+extern void P_eval_commit_basetime(struct timeval *, int *);
 extern void P_cache_mark_flush(struct chained_cache *[], int, int);
 extern void P_cache_flush(struct chained_cache *[], int);
 extern void P_cache_handle_flush_event(struct ports_table *);
@@ -574,7 +574,8 @@ struct channels_list_entry *insert_pipe_channel(int plugin_type, struct configur
   while (index < MAX_N_PLUGINS) {
     chptr = &channels_list[index]; 
     if (!chptr->aggregation && !chptr->aggregation_2) { /* found room */
-      chptr->aggregation = cfg->what_to_count;
+      /* distinct primitives are to be filled in by the core too */
+      chptr->aggregation = (cfg->what_to_count | cfg->distinct_what_to_count);
       chptr->aggregation_2 = cfg->what_to_count_2;
       chptr->pipe = pipe; 
       chptr->agg_filter.table = cfg->bpfp_a_table;
@@ -153,6 +153,7 @@ extern void P_zmq_pipe_init(void *, int *, u_int32_t *);
 
 extern void imt_plugin(int, struct configuration *, void *);
 extern void print_plugin(int, struct configuration *, void *);
+extern void topk_plugin(int, struct configuration *, void *);
 extern void nfprobe_plugin(int, struct configuration *, void *);
 extern void sfprobe_plugin(int, struct configuration *, void *);
 extern void tee_plugin(int, struct configuration *, void *);
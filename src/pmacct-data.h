@@ -35,6 +35,7 @@
 #define PLUGIN_ID_MONGODB	9
 #define PLUGIN_ID_AMQP		10
 #define PLUGIN_ID_KAFKA		11
+#define PLUGIN_ID_TOPK		12
 #define PLUGIN_ID_UNKNOWN	255 
 
 /* vars */
@@ -27,7 +27,7 @@
 #define ARGS_PMTELEMETRYD "hVL:u:t:Z:f:dDS:F:o:O:i:"
 #define ARGS_PMBGPD "hVL:l:f:dDS:F:o:O:i:gm:"
 #define ARGS_PMBMPD "hVL:l:f:dDS:F:o:O:i:"
-#define ARGS_PMACCT "hSsc:Cetm:p:P:M:arN:n:lT:O:E:uVUiI0"
+#define ARGS_PMACCT "hSsc:Cetm:p:P:M:arN:n:lT:L:F:D:O:E:uVUiIz0"
 #define N_PRIMITIVES 128
 #define N_FUNCS 10 
 #define MAX_N_PLUGINS 32
@@ -41,6 +41,7 @@
 #define DEFAULT_AVRO_SCHEMA_REFRESH_TIME 60
 #define MAX_AVRO_SCHEMA 16
 #define DEFAULT_IMT_PLUGIN_POLL_TIMEOUT 5
+#define DEFAULT_IMT_REPLY_TIMEOUT 1000 /* msecs */
 #define DEFAULT_SLOTH_SLEEP_TIME 5
 #define UINT32T_THRESHOLD 4290000000UL
 #define UINT64T_THRESHOLD 18446744073709551360ULL
@@ -390,6 +391,7 @@
 #define WANT_LOCK_OP			0x00000100
 #define WANT_CUSTOM_PRIMITIVES_TABLE	0x00000200
 #define WANT_ERASE_LAST_TSTAMP		0x00000400
+#define WANT_DELTA			0x00000800
 
 #define PIPE_TYPE_METADATA	0x00000001
 #define PIPE_TYPE_PAYLOAD	0x00000002
@@ -420,6 +422,14 @@
 #define PRINT_OUTPUT_AVRO_JSON	0x00000020
 #define PRINT_OUTPUT_CUSTOM	0x00000040
 
+#define IMT_TABLE_LAYOUT_CHAINED	0
+#define IMT_TABLE_LAYOUT_OPEN		1
+
+#define TOPK_METRIC_BYTES	0
+#define TOPK_METRIC_PACKETS	1
+#define TOPK_METRIC_FLOWS	2
+#define TOPK_SKETCH_DEPTH_MAX	16
+
 #define DIRECTION_UNKNOWN	0x00000000
 #define DIRECTION_IN		0x00000001
 #define DIRECTION_OUT		0x00000002
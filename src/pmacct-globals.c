@@ -26,8 +26,8 @@ struct utpl_field *(*get_ext_db_ie_by_type)(struct template_cache_entry *, u_int
 char sll_mac[2][ETH_ADDR_LEN];
 struct host_addr mcast_groups[MAX_MCAST_GROUPS];
 int reload_map, reload_map_exec_plugins, reload_geoipv2_file;
-int reload_map_bgp_thread, reload_log_bgp_thread;
-int reload_map_bmp_thread, reload_log_bmp_thread;
+int reload_map_bgp_thread, reload_log_bgp_thread, print_stats_bgp_thread;
+int reload_map_bmp_thread, reload_log_bmp_thread, print_stats_bmp_thread;
 int reload_map_rpki_thread, reload_log_rpki_thread;
 int reload_map_telemetry_thread, reload_log_telemetry_thread;
 int reload_map_pmacctd;
@@ -35,6 +35,7 @@ extern char *strptime(const char *s, const char *format, struct tm *tm);
 
 /* prototypes */
 int Recv(int, unsigned char **);
+int RecvChunk(int, unsigned char **, int *);
 void print_ex_options_error();
 void write_status_header_formatted();
 void write_status_header_csv();
@@ -62,6 +63,7 @@ void pmc_custom_primitive_value_print(char *, int, u_char *, struct imt_custom_p
 void pmc_vlen_prims_get(struct pkt_vlen_hdr_primitives *, pm_cfgreg_t, char **);
 void pmc_printf_csv_label(struct pkt_vlen_hdr_primitives *, pm_cfgreg_t, char *, char *);
 void pmc_lower_string(char *);
+int pmc_parse_filter(char *, struct query_filter *);
 char *pmc_ndpi_get_proto_name(u_int16_t);
 const char *pmc_rpki_roa_print(u_int8_t);
 u_int8_t pmc_rpki_str2roa(char *);
@@ -70,6 +72,7 @@ u_int8_t pmc_rpki_str2roa(char *);
 struct imt_custom_primitives pmc_custom_primitives_registry;
 struct stripped_class *class_table = NULL;
 int want_ipproto_num, ct_idx, ct_num;
+int pmc_hdr_len = sizeof(struct query_header); /* shorter with daemons predating IMT_QUERY_VERSION */
 
 /* functions */
 int CHECK_Q_TYPE(int type)
@@ -97,6 +100,9 @@ void usage_client(char *prog)
   printf("  -a\tDisplay all table fields (even those currently unused)\n");
   printf("  -c\t< src_mac | dst_mac | vlan | cos | src_host | dst_host | src_net | dst_net | src_mask | dst_mask | \n\t src_port | dst_port | tos | proto | src_as | dst_as | sum_mac | sum_host | sum_net | sum_as | \n\t sum_port | in_iface | out_iface | tag | tag2 | flows | class | std_comm | ext_comm | lrg_comm | \n\t med | local_pref | as_path | dst_roa | peer_src_ip | peer_dst_ip | peer_src_as | peer_dst_as | \n\t src_as_path | src_std_comm | src_ext_comm | src_lrg_comm | src_med | src_local_pref | src_roa | \n\t mpls_vpn_rd | mpls_pw_id | etype | sampling_rate | sampling_direction | post_nat_src_host | \n\t post_nat_dst_host | post_nat_src_port | post_nat_dst_port | nat_event | tunnel_src_mac | \n\t tunnel_dst_mac | tunnel_src_host | tunnel_dst_host | tunnel_protocol | tunnel_tos | \n\t tunnel_src_port | tunnel_dst_port | vxlan | timestamp_start | timestamp_end | timestamp_arrival | \n\t mpls_label_top | mpls_label_bottom |  mpls_stack_depth | label | src_host_country | \n\t dst_host_country | export_proto_seqno | export_proto_version | export_proto_sysid | \n\t src_host_pocode | dst_host_pocode | src_host_coords | dst_host_coords > \n\tSelect primitives to match (required by -N and -M)\n");
   printf("  -T\t<bytes | packets | flows>,[<# how many>] \n\tOutput top N statistics (applies to -M and -s)\n");
+  printf("  -L\t<# how many>[,<# offset>] \n\tLimit output to N entries, skipping the first ones (applies to -M and -s)\n");
+  printf("  -F\t<bytes | packets | flows><'=' | '<' | '<=' | '>' | '>='><value>[','...] \n\tOutput only entries whose counters match (applies to -M and -s)\n");
+  printf("  -D\t<epoch> \n\tOutput only entries changed since the given epoch; the current one is reported on stderr (applies to -s)\n");
   printf("  -e\tClear statistics\n");
   printf("  -i\tShow time (in seconds) since statistics were last cleared (ie. pmacct -e)\n");
   printf("  -r\tReset counters (applies to -N and -M)\n");
@@ -108,6 +114,7 @@ void usage_client(char *prog)
   printf("  -O\tSet output < formatted | csv | json | event_formatted | event_csv > (applies to -M and -s)\n");
   printf("  -E\tSet sparator for CSV format\n");
   printf("  -I\tSet timestamps in 'since Epoch' format\n");
+  printf("  -z\tAsk the server to compress replies (applies to -M and -s)\n");
   printf("  -u\tLeave IP protocols in numerical format\n");
   printf("  -0\tAlways set timestamps to UTC (even if the timezone configured on the system is different)\n"); 
   printf("  -V\tPrint version and exit\n");
@@ -683,7 +690,7 @@ int main(int argc,char **argv)
 #endif
   char path[SRVBUFLEN], file[SRVBUFLEN], password[9], rd_str[SRVBUFLEN], tmpbuf[SRVBUFLEN];
   char *as_path, empty_aspath[] = "^$", empty_string[] = "", *bgp_comm;
-  int sd, buflen, unpacked, printed;
+  int sd, stream_sd, buflen, unpacked, printed, largebufsz;
   int counter=0, sep_len=0, is_event;
   char *sep_ptr = NULL, sep[10], default_sep[] = ",", spacing_sep[2];
   struct imt_custom_primitives custom_primitives_input;
@@ -702,7 +709,7 @@ int main(int argc,char **argv)
   int want_output, want_custom_primitives_table;
   int want_erase_last_tstamp, want_tstamp_since_epoch, want_tstamp_utc;
   int which_counter, topN_counter, fetch_from_file, sum_counters, num_counters;
-  int topN_howmany, topN_printed;
+  int topN_howmany, topN_printed, want_limit, want_filter, want_delta;
   int datasize;
   pm_cfgreg_t what_to_count, what_to_count_2, have_wtc;
   u_int32_t tmpnum;
@@ -713,6 +720,8 @@ int main(int argc,char **argv)
   clibuf = malloc(clibufsz);
 
   memset(&q, 0, sizeof(struct query_header));
+  q.version = IMT_QUERY_VERSION;
+  q.hdr_len = sizeof(struct query_header);
   memset(&empty_addr, 0, sizeof(struct pkt_primitives));
   memset(&empty_pbgp, 0, sizeof(struct pkt_bgp_primitives));
   memset(&empty_plbgp, 0, sizeof(struct pkt_legacy_bgp_primitives));
@@ -727,7 +736,7 @@ int main(int argc,char **argv)
   memset(&custom_primitives_input, 0, sizeof(custom_primitives_input));
 
   strcpy(path, "/tmp/collect.pipe");
-  unpacked = 0; printed = 0;
+  unpacked = 0; printed = 0; largebufsz = 0;
   errflag = 0; buflen = 0;
   protocols_number = 0;
   want_stats = FALSE;
@@ -753,6 +762,9 @@ int main(int argc,char **argv)
   have_wtc = FALSE;
   want_output = PRINT_OUTPUT_FORMATTED;
   is_event = FALSE;
+  want_limit = FALSE;
+  want_delta = FALSE;
+  want_filter = FALSE;
   want_tstamp_since_epoch = FALSE;
   want_tstamp_utc = FALSE;
 
@@ -1114,6 +1126,14 @@ int main(int argc,char **argv)
     case 'I':
       want_tstamp_since_epoch = TRUE;
       break;
+    case 'z':
+#if defined WITH_ZLIB
+      q.stream_flags |= IMT_STREAM_F_ZLIB;
+#else
+      printf("ERROR: -z requires zlib support (--enable-zlib)\n  Exiting...\n\n");
+      exit(1);
+#endif
+      break;
     case '0':
       want_tstamp_utc = TRUE;
       break;
@@ -1154,6 +1174,30 @@ int main(int argc,char **argv)
       else if (!strcmp(tmpbuf, "flows")) topN_counter = 3;
       else printf("WARN: -T, ignoring unknown counter type: %s.\n", tmpbuf);
       break;
+    case 'L':
+      strlcpy(tmpbuf, optarg, sizeof(tmpbuf));
+      topN_howmany_ptr = strchr(tmpbuf, ',');
+      if (topN_howmany_ptr) {
+	*topN_howmany_ptr = '\0';
+	topN_howmany_ptr++;
+	q.offset = strtoul(topN_howmany_ptr, &endptr, 10);
+      }
+      q.limit = strtoul(tmpbuf, &endptr, 10);
+      want_limit = TRUE;
+      break;
+    case 'D':
+      q.type |= WANT_DELTA;
+      q.since = strtoull(optarg, &endptr, 10);
+      want_delta = TRUE;
+      break;
+    case 'F':
+      strlcpy(tmpbuf, optarg, sizeof(tmpbuf));
+      if (pmc_parse_filter(tmpbuf, q.filter) == ERR) {
+	printf("ERROR: -F, invalid filter: %s\n  Exiting...\n\n", optarg);
+	exit(1);
+      }
+      want_filter = TRUE;
+      break;
     case 'S':
       sum_counters = TRUE;
       break;
@@ -1232,6 +1276,8 @@ int main(int argc,char **argv)
     memset(&qhdr, 0, sizeof(struct query_header));
     qhdr.type = WANT_CUSTOM_PRIMITIVES_TABLE;
     qhdr.num = 1;
+    qhdr.version = IMT_QUERY_VERSION;
+    qhdr.hdr_len = sizeof(struct query_header);
 
     memcpy(clibuf, &qhdr, sizeof(struct query_header));
     buflen = sizeof(struct query_header);
@@ -1246,7 +1292,15 @@ int main(int argc,char **argv)
     unpacked = Recv(sd, &cpt);
 
     if (unpacked) {
-      memcpy(&pmc_custom_primitives_registry, cpt+sizeof(struct query_header), sizeof(struct imt_custom_primitives));
+      /* older daemons echo the query header in its legacy layout, which
+	 is told apart by the length of the reply (the versioning fields
+	 sit in its padding); they support neither streaming nor any of
+	 the server-side selections */
+      if (unpacked == (IMT_QUERY_HDR_LEGACY_LEN + sizeof(struct imt_custom_primitives)) ||
+	  unpacked == (IMT_QUERY_HDR_LEGACY_LEN + sizeof(struct pkt_data)))
+	pmc_hdr_len = IMT_QUERY_HDR_LEGACY_LEN;
+
+      memcpy(&pmc_custom_primitives_registry, cpt+pmc_hdr_len, sizeof(struct imt_custom_primitives));
   
       if (want_custom_primitives_table) {
         int idx;
@@ -1325,6 +1379,33 @@ int main(int argc,char **argv)
     exit(1);
   }
 
+  if (want_delta && (!want_stats || topN_counter || want_limit || want_filter)) {
+    printf("ERROR: -D option applies only to -s and can't be mixed with -T, -L or -F\n  Exiting...\n\n");
+    usage_client(argv[0]);
+    exit(1);
+  }
+
+  if ((want_limit || want_filter) && (!want_match && !want_stats)) {
+    printf("ERROR: -L and -F options apply only to -M or -s\n  Exiting...\n\n");
+    usage_client(argv[0]);
+    exit(1);
+  }
+
+  if (pmc_hdr_len != sizeof(struct query_header) && (want_delta || want_limit || want_filter || q.stream_flags)) {
+    printf("ERROR: -D, -L, -F and -z options are not supported by the daemon (older release)\n  Exiting...\n\n");
+    exit(1);
+  }
+
+  /* top N entries are selected and sorted by the server; entries are
+     streamed back and printed as they come. Older daemons return the full
+     set in one go and leave sorting to us */
+  if ((want_stats || want_match) && pmc_hdr_len == sizeof(struct query_header)) q.stream = IMT_STREAM_VERSION;
+
+  if (topN_counter) {
+    q.topn = topN_counter;
+    if (topN_howmany && (!q.limit || topN_howmany < q.limit)) q.limit = topN_howmany;
+  }
+
   if (want_counter || want_match) {
     char *ptr = match_string, prefix[] = "file:";
 
@@ -1691,6 +1772,8 @@ int main(int argc,char **argv)
 	    memset(&qhdr, 0, sizeof(struct query_header));
 	    qhdr.type = WANT_CLASS_TABLE;
 	    qhdr.num = 1;
+	    qhdr.version = IMT_QUERY_VERSION;
+	    qhdr.hdr_len = sizeof(struct query_header);
 
 	    memcpy(clibuf, &qhdr, sizeof(struct query_header));
 	    buflen = sizeof(struct query_header);
@@ -1704,7 +1787,7 @@ int main(int argc,char **argv)
 
 	    if (unpacked) {
   	      ct_num = ((struct query_header *)ct)->num;
-  	      elem = ct+sizeof(struct query_header);
+  	      elem = ct+pmc_hdr_len;
   	      class_table = (struct stripped_class *) elem;
   	      ct_idx = 0;
   	      while (ct_idx < ct_num) {
@@ -2087,6 +2170,10 @@ int main(int argc,char **argv)
   /* arranging header and size of buffer to send */
   memcpy(clibuf, &q, sizeof(struct query_header)); 
   buflen = sizeof(struct query_header)+(q.num*sizeof(struct query_entry));
+  if (pmc_hdr_len != sizeof(struct query_header)) {
+    memmove(clibuf+pmc_hdr_len, clibuf+sizeof(struct query_header), q.num*sizeof(struct query_entry));
+    buflen -= (sizeof(struct query_header) - pmc_hdr_len);
+  }
   buflen++;
   clibuf[buflen] = '\x4'; /* EOT */
   buflen++;
@@ -2096,9 +2183,12 @@ int main(int argc,char **argv)
 
   /* reading results */ 
   if (want_stats || want_match) {
-    unpacked = Recv(sd, &largebuf);
+    stream_sd = sd;
+    largebuf = NULL;
+    if (q.stream) unpacked = RecvChunk(stream_sd, &largebuf, &largebufsz);
+    else unpacked = Recv(stream_sd, &largebuf);
  
-    if (!unpacked) {
+    if (unpacked < pmc_hdr_len) {
       printf("ERROR: missing EOF from server (4)\n");
       exit(1);
     }
@@ -2110,6 +2200,8 @@ int main(int argc,char **argv)
     datasize = ((struct query_header *)largebuf)->datasize;
     memcpy(&extras, &((struct query_header *)largebuf)->extras, sizeof(struct extra_primitives));
     if (check_data_sizes((struct query_header *)largebuf, acc_elem)) exit(1);
+    q.since = ((struct query_header *)largebuf)->since;
+    q.epoch = ((struct query_header *)largebuf)->epoch;
 
     /* Before going on with the output, we need to retrieve the class strings
        from the server */
@@ -2120,6 +2212,8 @@ int main(int argc,char **argv)
       memset(&qhdr, 0, sizeof(struct query_header));
       qhdr.type = WANT_CLASS_TABLE;
       qhdr.num = 1;
+      qhdr.version = IMT_QUERY_VERSION;
+      qhdr.hdr_len = sizeof(struct query_header);
 
       memcpy(clibuf, &qhdr, sizeof(struct query_header));
       buflen = sizeof(struct query_header);
@@ -2133,7 +2227,7 @@ int main(int argc,char **argv)
 
       if (unpacked_class) {
         ct_num = ((struct query_header *)ct)->num;
-        elem = ct+sizeof(struct query_header);
+        elem = ct+pmc_hdr_len;
         class_table = (struct stripped_class *) elem;
         while (ct_idx < ct_num) {
 	  class_table[ct_idx].protocol[MAX_PROTOCOL_LEN-1] = '\0';
@@ -2151,16 +2245,19 @@ int main(int argc,char **argv)
     else if (want_output & PRINT_OUTPUT_CSV)
       write_stats_header_csv(what_to_count, what_to_count_2, have_wtc, sep_ptr, is_event);
 
-    elem = largebuf+sizeof(struct query_header);
-    unpacked -= sizeof(struct query_header);
+    elem = largebuf+pmc_hdr_len;
+    unpacked -= pmc_hdr_len;
 
-    acc_elem = (struct pkt_data *) elem;
+    if (!unpacked && q.stream) {
+      unpacked = RecvChunk(stream_sd, &largebuf, &largebufsz);
+      elem = largebuf;
+    }
 
     topN_printed = 0;
-    if (topN_counter) {
+    if (topN_counter && !q.stream) {
       int num = unpacked/datasize;
 
-      client_counters_merge_sort((void *)acc_elem, 0, num, datasize, topN_counter);
+      client_counters_merge_sort((void *)elem, 0, num, datasize, topN_counter);
     }
 
     while (printed < unpacked && (!topN_howmany || topN_printed < topN_howmany)) {
@@ -2866,8 +2963,26 @@ int main(int argc,char **argv)
       }
       elem += datasize;
       printed += datasize;
+
+      /* done with this chunk of the reply, move on to the next one */
+      if (printed >= unpacked && q.stream) {
+        unpacked = RecvChunk(stream_sd, &largebuf, &largebufsz);
+        elem = largebuf;
+        printed = 0;
+      }
+    }
+
+    if (unpacked < 0) {
+      printf("ERROR: missing EOF from server (4)\n");
+      exit(1);
     }
+
     if (want_output & PRINT_OUTPUT_FORMATTED) printf("\nFor a total of: %d entries\n", counter);
+
+    if (want_delta) {
+      if (q.since) fprintf(stderr, "EPOCH: %" PRIu64 "\n", q.epoch);
+      else fprintf(stderr, "EPOCH: %" PRIu64 " (full)\n", q.epoch);
+    }
   }
   else if (want_erase) printf("OK: Clearing stats.\n");
   else if (want_erase_last_tstamp) {
@@ -2876,8 +2991,8 @@ int main(int argc,char **argv)
     gettimeofday(&cycle_stamp, NULL);
     unpacked = Recv(sd, &largebuf);
 
-    if (unpacked == (sizeof(struct query_header) + sizeof(struct timeval))) {
-      memcpy(&table_reset_stamp, (largebuf + sizeof(struct query_header)), sizeof(struct timeval));
+    if (unpacked == (pmc_hdr_len + sizeof(struct timeval))) {
+      memcpy(&table_reset_stamp, (largebuf + pmc_hdr_len), sizeof(struct timeval));
       if (table_reset_stamp.tv_sec) printf("%ld\n", (long)(cycle_stamp.tv_sec - table_reset_stamp.tv_sec));
       else printf("never\n");
     }
@@ -2887,8 +3002,8 @@ int main(int argc,char **argv)
 
     if (unpacked) {
       write_status_header();
-      elem = largebuf+sizeof(struct query_header);
-      unpacked -= sizeof(struct query_header);
+      elem = largebuf+pmc_hdr_len;
+      unpacked -= pmc_hdr_len;
       while (printed < unpacked) {
         bd = (struct bucket_desc *) elem;
         printf("%u\t", bd->num);
@@ -2923,10 +3038,10 @@ int main(int argc,char **argv)
       exit(1);
     }
 
-    base = largebuf+sizeof(struct query_header);
+    base = largebuf+pmc_hdr_len;
     if (check_data_sizes((struct query_header *)largebuf, acc_elem)) exit(1);
     acc_elem = (struct pkt_data *) base;
-    for (printed = sizeof(struct query_header); printed < unpacked; printed += sizeof(struct pkt_data), acc_elem++) {
+    for (printed = pmc_hdr_len; printed < unpacked; printed += sizeof(struct pkt_data), acc_elem++) {
       if (sum_counters) {
 	pcnt += acc_elem->pkt_num;
 	fcnt += acc_elem->flo_num;
@@ -2974,7 +3089,7 @@ int main(int argc,char **argv)
     if (unpacked) {
       write_class_table_header();
       ct_num = ((struct query_header *)ct)->num;
-      elem = ct+sizeof(struct query_header);
+      elem = ct+pmc_hdr_len;
       class_table = (struct stripped_class *) elem;
       while (ct_idx < ct_num) {
         class_table[ct_idx].protocol[MAX_PROTOCOL_LEN-1] = '\0';
@@ -3063,10 +3178,84 @@ int Recv(int sd, unsigned char **buf)
   else return 0;
 }
 
+static int RecvAll(int sd, void *buf, int len)
+{
+  int num, received = 0;
+
+  while (received < len) {
+    num = recv(sd, (unsigned char *)buf + received, len - received, 0);
+    if (num < 0 && errno == EINTR) continue;
+    if (num <= 0) return ERR;
+
+    received += num;
+  }
+
+  return SUCCESS;
+}
+
+/* reads the next chunk of a streaming reply into *buf, growing it up to
+   the size of the largest chunk; returns the length of the payload, 0 on
+   the last chunk and ERR on error */
+int RecvChunk(int sd, unsigned char **buf, int *bufsz)
+{
+  struct imt_chunk_hdr hdr;
+  u_int32_t len, raw_len, size;
+
+  if (RecvAll(sd, &hdr, sizeof(hdr)) == ERR) return ERR;
+
+  if (!hdr.version || hdr.version > IMT_STREAM_VERSION) {
+    printf("ERROR: unsupported reply version from server: %u\n", hdr.version);
+    return ERR;
+  }
+
+  if (hdr.flags & IMT_STREAM_F_LAST) return 0;
+
+  len = ntohl(hdr.len);
+  raw_len = ntohl(hdr.raw_len);
+  if (!len || len > 2*LARGEBUFLEN || raw_len > LARGEBUFLEN) return ERR;
+
+  /* compressed payloads are read past the room for the uncompressed one */
+  size = (hdr.flags & IMT_STREAM_F_ZLIB) ? (raw_len + len) : len;
+  if (size > *bufsz) {
+    *buf = realloc(*buf, size);
+    if (!(*buf)) {
+      printf("ERROR: realloc() out of memory (RecvChunk)\n");
+      exit(1);
+    }
+    *bufsz = size;
+  }
+
+  if (hdr.flags & IMT_STREAM_F_ZLIB) {
+#if defined WITH_ZLIB
+    uLongf dlen = raw_len;
+
+    if (RecvAll(sd, *buf + raw_len, len) == ERR) return ERR;
+    if (uncompress(*buf, &dlen, *buf + raw_len, len) != Z_OK || dlen != raw_len) {
+      printf("ERROR: unable to uncompress reply from server\n");
+      return ERR;
+    }
+#else
+    printf("ERROR: compressed reply from server but zlib support is not compiled in\n");
+    return ERR;
+#endif
+  }
+  else if (RecvAll(sd, *buf, len) == ERR) return ERR;
+
+  return raw_len;
+}
+
 int check_data_sizes(struct query_header *qh, struct pkt_data *acc_elem)
 {
   if (!acc_elem) return FALSE;
 
+  if (pmc_hdr_len == sizeof(struct query_header) &&
+      (qh->version != IMT_QUERY_VERSION || qh->hdr_len != sizeof(struct query_header))) {
+    printf("ERROR: Query protocol mismatch: daemon: %u  client: %u\n", qh->version, IMT_QUERY_VERSION);
+    printf("ERROR: It's very likely that the daemon and the client come from different pmacct releases.\n\n");
+    printf("ERROR: Please fix the issue before trying again.\n");
+    return ERR;
+  }
+
   if (qh->cnt_sz != sizeof(acc_elem->pkt_len)) {
     printf("ERROR: Counter sizes mismatch: daemon: %d  client: %d\n", qh->cnt_sz*8, (int)sizeof(acc_elem->pkt_len)*8);
     printf("ERROR: It's very likely that a 64bit package has been mixed with a 32bit one.\n\n");
@@ -4011,3 +4200,40 @@ u_int8_t pmc_rpki_str2roa(char *roa_str)
 
   return ROA_STATUS_UNKNOWN;
 }
+
+/* parses a comma-separated list of counter predicates, ie.
+   'bytes>=1000,flows<10' */
+int pmc_parse_filter(char *str, struct query_filter *filter)
+{
+  char *token, *ptr;
+  int idx = 0, len;
+
+  memset(filter, 0, IMT_QUERY_FILTERS_MAX * sizeof(struct query_filter));
+  pmc_lower_string(str);
+
+  while (*str) {
+    if (idx == IMT_QUERY_FILTERS_MAX) return ERR;
+    token = pmc_extract_token(&str, ',');
+
+    if (!strncmp(token, "bytes", (len = strlen("bytes")))) filter[idx].counter = IMT_COUNTER_BYTES;
+    else if (!strncmp(token, "packets", (len = strlen("packets")))) filter[idx].counter = IMT_COUNTER_PACKETS;
+    else if (!strncmp(token, "flows", (len = strlen("flows")))) filter[idx].counter = IMT_COUNTER_FLOWS;
+    else return ERR;
+
+    ptr = token + len;
+    if (!strncmp(ptr, ">=", 2)) { filter[idx].op = IMT_FILTER_GE; ptr += 2; }
+    else if (!strncmp(ptr, "<=", 2)) { filter[idx].op = IMT_FILTER_LE; ptr += 2; }
+    else if (*ptr == '>') { filter[idx].op = IMT_FILTER_GT; ptr++; }
+    else if (*ptr == '<') { filter[idx].op = IMT_FILTER_LT; ptr++; }
+    else if (*ptr == '=') { filter[idx].op = IMT_FILTER_EQ; ptr++; }
+    else return ERR;
+
+    if (!isdigit(*ptr)) return ERR;
+    filter[idx].value = strtoull(ptr, NULL, 10);
+    idx++;
+  }
+
+  if (!idx) return ERR;
+
+  return SUCCESS;
+}
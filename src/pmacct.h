@@ -43,7 +43,7 @@
 #include <getopt.h> 
 #endif
 
-#if defined HAVE_MALLOPT
+#if defined HAVE_MALLOPT || defined HAVE_MALLOC_TRIM
 #include <malloc.h>
 #endif
 
@@ -235,6 +235,10 @@ typedef struct {
 #include <avro.h>
 #endif
 
+#if (defined WITH_ZLIB)
+#include <zlib.h>
+#endif
+
 #if (defined WITH_SERDES)
 #if (!defined WITH_AVRO)
 #error "--enable-serdes requires --enable-avro"
@@ -425,8 +429,8 @@ initsetproctitle(int, char**, char**);
 extern char sll_mac[2][ETH_ADDR_LEN];
 extern struct host_addr mcast_groups[MAX_MCAST_GROUPS];
 extern int reload_map, reload_map_exec_plugins, reload_geoipv2_file;
-extern int reload_map_bgp_thread, reload_log_bgp_thread;
-extern int reload_map_bmp_thread, reload_log_bmp_thread;
+extern int reload_map_bgp_thread, reload_log_bgp_thread, print_stats_bgp_thread;
+extern int reload_map_bmp_thread, reload_log_bmp_thread, print_stats_bmp_thread;
 extern int reload_map_rpki_thread, reload_log_rpki_thread;
 extern int reload_map_telemetry_thread, reload_log_telemetry_thread;
 extern int reload_map_pmacctd;
@@ -260,7 +260,7 @@ int main(int argc,char **argv, char **envp)
   sigaction(SIGHUP, &sighandler_action, NULL);
 
   /* logs various statistics via Log() calls */
-  sighandler_action.sa_handler = SIG_IGN;
+  sighandler_action.sa_handler = push_stats;
   sigaction(SIGUSR1, &sighandler_action, NULL);
 
   /* sets to true the reload_maps flag */
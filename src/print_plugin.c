@@ -30,6 +30,7 @@
 #include "plugin_cmn_avro.h"
 #include "plugin_cmn_custom.h"
 #include "print_plugin.h"
+#include "topk_plugin.h"
 #include "ip_flow.h"
 #include "classifier.h"
 #include "crc32.h"
@@ -79,7 +80,7 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   memcpy(&config, cfgptr, sizeof(struct configuration));
   memcpy(&extras, &((struct channels_list_entry *)ptr)->extras, sizeof(struct extra_primitives));
   recollect_pipe_memory(ptr);
-  pm_setproctitle("%s [%s]", "Print Plugin", config.name);
+  pm_setproctitle("%s [%s]", (config.type_id == PLUGIN_ID_TOPK ? "TopK Plugin" : "Print Plugin"), config.name);
 
   P_set_signals();
   P_init_default_values();
@@ -98,6 +99,7 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
 	   (config.print_output & PRINT_OUTPUT_AVRO_JSON)) {
 #ifdef WITH_AVRO
     avro_acct_schema = avro_schema_build_acct_data(config.what_to_count, config.what_to_count_2);
+    if (config.type_id == PLUGIN_ID_TOPK) topk_avro_schema_add(avro_acct_schema);
     if (config.avro_schema_file) write_avro_schema_to_file(config.avro_schema_file, avro_acct_schema);
 #endif
   }
@@ -118,6 +120,8 @@ void print_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
   else insert_func = P_cache_insert;
   purge_func = P_cache_purge;
 
+  if (config.type_id == PLUGIN_ID_TOPK) topk_init();
+
   memset(&nt, 0, sizeof(nt));
   memset(&nc, 0, sizeof(nc));
   memset(&pt, 0, sizeof(pt));
@@ -846,10 +850,12 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
   #if defined HAVE_64BIT_COUNTERS
           fprintf(f, "%-20" PRIu64 "  ", queue[j]->packet_counter);
           if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%-20" PRIu64 "  ", queue[j]->flow_counter);
+          if (config.distinct_what_to_count) fprintf(f, "%-20" PRIu64 "  ", P_cache_distinct_count(queue[j]));
           fprintf(f, "%" PRIu64 "\n", queue[j]->bytes_counter);
   #else
           fprintf(f, "%-10lu  ", queue[j]->packet_counter);
           if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%-10lu  ", queue[j]->flow_counter);
+          if (config.distinct_what_to_count) fprintf(f, "%-10lu  ", P_cache_distinct_count(queue[j]));
           fprintf(f, "%lu\n", queue[j]->bytes_counter);
   #endif
         }
@@ -1216,10 +1222,12 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
   #if defined HAVE_64BIT_COUNTERS
           fprintf(f, "%s%" PRIu64 "", write_sep(sep, &count), queue[j]->packet_counter);
           if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%s%" PRIu64 "", write_sep(sep, &count), queue[j]->flow_counter);
+          if (config.distinct_what_to_count) fprintf(f, "%s%" PRIu64 "", write_sep(sep, &count), P_cache_distinct_count(queue[j]));
           fprintf(f, "%s%" PRIu64 "\n", write_sep(sep, &count), queue[j]->bytes_counter);
   #else
           fprintf(f, "%s%lu", write_sep(sep, &count), queue[j]->packet_counter);
           if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%s%lu", write_sep(sep, &count), queue[j]->flow_counter);
+          if (config.distinct_what_to_count) fprintf(f, "%s%lu", write_sep(sep, &count), P_cache_distinct_count(queue[j]));
           fprintf(f, "%s%lu\n", write_sep(sep, &count), queue[j]->bytes_counter);
   #endif
         }
@@ -1231,6 +1239,7 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
 	int idx;
 
 	for (idx = 0; idx < N_PRIMITIVES && cjhandler[idx]; idx++) cjhandler[idx](json_obj, queue[j]);
+	if (config.type_id == PLUGIN_ID_TOPK) topk_compose_json(json_obj, queue[j]);
         if (json_obj) write_and_free_json(f, json_obj);
 #endif
       }
@@ -1245,6 +1254,10 @@ void P_cache_purge(struct chained_cache *queue[], int index, int safe_action)
 			 pvlen, queue[j]->bytes_counter, queue[j]->packet_counter, queue[j]->flow_counter,
 			 queue[j]->tcp_flags, NULL, queue[j]->stitch, avro_iface);
 
+        if (config.distinct_what_to_count) add_distinct_count_avro(avro_value, queue[j]->flow_type, P_cache_distinct_count(queue[j]));
+
+        if (config.type_id == PLUGIN_ID_TOPK) topk_compose_avro(avro_value, queue[j]);
+
         if (config.sql_table) {
 	  if (config.print_output & PRINT_OUTPUT_AVRO_BIN) {
 	    if (avro_file_writer_append_value(avro_writer, &avro_value)) {
@@ -1449,10 +1462,12 @@ void P_write_stats_header_formatted(FILE *f, int is_event)
 #if defined HAVE_64BIT_COUNTERS
     fprintf(f, "PACKETS               ");
     if (config.what_to_count & COUNT_FLOWS) fprintf(f, "FLOWS                 ");
+    if (config.distinct_what_to_count) fprintf(f, "DISTINCT              ");
     fprintf(f, "BYTES\n");
 #else
     fprintf(f, "PACKETS     ");
     if (config.what_to_count & COUNT_FLOWS) fprintf(f, "FLOWS       ");
+    if (config.distinct_what_to_count) fprintf(f, "DISTINCT    ");
     fprintf(f, "BYTES\n");
 #endif
   }
@@ -1573,6 +1588,7 @@ void P_write_stats_header_csv(FILE *f, int is_event)
   if (!is_event) {
     fprintf(f, "%sPACKETS", write_sep(sep, &count));
     if (config.what_to_count & COUNT_FLOWS) fprintf(f, "%sFLOWS", write_sep(sep, &count));
+    if (config.distinct_what_to_count) fprintf(f, "%sDISTINCT", write_sep(sep, &count));
     fprintf(f, "%sBYTES\n", write_sep(sep, &count));
   }
   else fprintf(f, "\n");
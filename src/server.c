@@ -61,11 +61,43 @@ int build_query_server(char *path_ptr)
 }
 
 
-void process_query_data(int sd, unsigned char *buf, int len, struct extra_primitives *extras, int datasize, int forked)
+/* validates the header of a query of 'len' bytes held in a buffer of
+   'size' bytes; a query is made of the header, optionally 'num' entries
+   and a two bytes trailer, EOT included. Queries from clients predating
+   the versioned header are told apart by their length and upgraded in
+   place: every field they lack is zeroed, version included */
+int imt_query_check(unsigned char *buf, int *len, int size)
 {
-  struct acc *acc_elem = 0;
+  struct query_header *qh = (struct query_header *) buf;
+  int legacy_len = IMT_QUERY_HDR_LEGACY_LEN, gap = sizeof(struct query_header) - IMT_QUERY_HDR_LEGACY_LEN;
+  int entries_len, body_len;
+
+  if (*len < (legacy_len + 2) || qh->num > MAX_QUERIES) return ERR;
+  entries_len = qh->num * sizeof(struct query_entry);
+
+  body_len = *len - legacy_len - 2;
+  if (!body_len || body_len == entries_len) {
+    if ((*len + gap) > size) return ERR;
+
+    memmove(buf + sizeof(struct query_header), buf + legacy_len, *len - legacy_len);
+    memset(buf + offsetof(struct query_header, version), 0, sizeof(struct query_header) - offsetof(struct query_header, version));
+    *len += gap;
+
+    return SUCCESS;
+  }
+
+  body_len = *len - sizeof(struct query_header) - 2;
+  if (body_len && body_len != entries_len) return ERR;
+  if (qh->version != IMT_QUERY_VERSION || qh->hdr_len != sizeof(struct query_header)) return ERR;
+
+  return SUCCESS;
+}
+
+void process_query_data(int sd, unsigned char *buf, int len, struct extra_primitives *extras, int datasize, int concurrent)
+{
+  struct acc *acc_elem = 0, *table;
   struct bucket_desc bd;
-  struct query_header *q, *uq;
+  struct query_header qh, *q, *uq;
   struct query_entry request;
   struct reply_buffer rb;
   unsigned char *elem, *bufptr;
@@ -79,8 +111,9 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
   struct pkt_tunnel_primitives dummy_ptun;
   char *dummy_pcust = NULL, *custbuf = NULL;
   struct pkt_vlen_hdr_primitives dummy_pvlen;
-  char emptybuf[LARGEBUFLEN];
   int reset_counter, offset = PdataSz;
+  struct imt_selection sel;
+  u_int64_t since = 0;
 
   dummy_pcust = malloc(config.cpptrs.len);
   custbuf = malloc(config.cpptrs.len);
@@ -99,20 +132,29 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
   memset(custbuf, 0, config.cpptrs.len); 
   memset(&dummy_pvlen, 0, sizeof(struct pkt_vlen_hdr_primitives));
 
-  memset(emptybuf, 0, LARGEBUFLEN);
+  /* the reply header is built aside and queued along with the first
+     element, see enQueue_hdr(); legacy clients get it in their layout */
+  memcpy(&qh, buf, sizeof(struct query_header));
   memset(&rb, 0, sizeof(struct reply_buffer));
-  memcpy(rb.buf, buf, sizeof(struct query_header));
-  rb.len = LARGEBUFLEN-sizeof(struct query_header);
-  rb.packed = sizeof(struct query_header);
+  rb.defer = !config.is_forked;
+  if (!concurrent) rb.timeout = DEFAULT_IMT_REPLY_TIMEOUT;
+  rb.hdr = &qh;
+  rb.hdr_len = qh.version ? sizeof(struct query_header) : IMT_QUERY_HDR_LEGACY_LEN;
+  rb.len = LARGEBUFLEN-rb.hdr_len;
+  rb.ptr = rb.buf;
 
   /* arranging some pointer */
   uq = (struct query_header *) buf;
-  q = (struct query_header *) rb.buf;
-  rb.ptr = rb.buf+sizeof(struct query_header);
+  q = &qh;
   bufptr = buf+sizeof(struct query_header);
   q->ip_sz = sizeof(acc_elem->primitives.src_ip);
   q->cnt_sz = sizeof(acc_elem->bytes_counter);
   q->datasize = datasize;
+  if (q->stream) {
+    q->stream = MIN(q->stream, IMT_STREAM_VERSION);
+    rb.stream = q->stream;
+    rb.stream_flags = q->stream_flags;
+  }
 
   if (extras->off_pkt_bgp_primitives) {
     q->extras.off_pkt_bgp_primitives = offset;
@@ -158,54 +200,34 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
     else return;
   }
 
-  elem = (unsigned char *) a;
+  table = imt_rcu_read_lock(&rb.rcu_epoch);
+  rb.erased = __atomic_load_n(&imt_epoch->erased, __ATOMIC_RELAXED);
+  elem = (unsigned char *) table;
+  imt_select_init(&sel, q);
 
   reset_counter = q->type & WANT_RESET;
 
   if (q->type & WANT_STATS) {
     q->what_to_count = config.what_to_count; 
     q->what_to_count_2 = config.what_to_count_2; 
-    for (idx = 0; idx < config.buckets; idx++) {
-      if (!following_chain) acc_elem = (struct acc *) elem;
-      if (!test_zero_elem(acc_elem)) {
-	enQueue_elem(sd, &rb, acc_elem, PdataSz, datasize);
-
-        if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
-          enQueue_elem(sd, &rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
-        }
-
-        if (extras->off_pkt_lbgp_primitives) {
-          if (acc_elem->clbgp) {
-            struct pkt_legacy_bgp_primitives tmp_plbgp;
-
-            cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
-            enQueue_elem(sd, &rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
-          }
-        }
-
-        if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
-          enQueue_elem(sd, &rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
-	}
-
-        if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
-          enQueue_elem(sd, &rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
-	}
-
-        if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
-          enQueue_elem(sd, &rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
-	}
 
-        if (extras->off_custom_primitives && acc_elem->pcust) {
-          enQueue_elem(sd, &rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
-        }
+    /* a full reply is returned if changes since the given epoch are not
+       known, ie. the table was erased or the daemon restarted since */
+    if (q->type & WANT_DELTA) {
+      q->epoch = __atomic_load_n(&imt_epoch->current, __ATOMIC_ACQUIRE);
+      if (q->since > __atomic_load_n(&imt_epoch->erased, __ATOMIC_RELAXED) && q->since <= q->epoch) since = q->since;
+      q->since = since;
+    }
 
-        if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
-          enQueue_elem(sd, &rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
-        }
+    for (idx = 0; idx < config.buckets; idx++) {
+      if (!enQueue_spool_yield(sd, &rb)) break;
+      if (!following_chain) acc_elem = (struct acc *) elem;
+      if (!test_zero_elem(acc_elem) && (!since || __atomic_load_n(&acc_elem->epoch, __ATOMIC_RELAXED) > since)) {
+	if (imt_select_elem(sd, &rb, &sel, acc_elem, extras, datasize)) break;
       } 
-      if (acc_elem->next != NULL) {
+      if (IMT_ACC_NEXT(acc_elem) != NULL) {
         Log(LOG_DEBUG, "DEBUG ( %s/%s ): Following chain in reply ...\n", config.name, config.type);
-        acc_elem = acc_elem->next;
+        acc_elem = IMT_ACC_NEXT(acc_elem);
         following_chain = TRUE;
         idx--;
       }
@@ -214,10 +236,12 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
         following_chain = FALSE;
       }
     }
-    if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
+    imt_select_flush(sd, &rb, &sel, extras, datasize);
+    enQueue_flush(sd, &rb); /* send remainder data */
   }
   else if (q->type & WANT_STATUS) {
     for (idx = 0; idx < config.buckets; idx++) {
+      if (!enQueue_spool_yield(sd, &rb)) break;
 
       /* Administrativia */
       following_chain = FALSE;
@@ -226,16 +250,16 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
       acc_elem = (struct acc *) elem;
 
       do {
-        if (following_chain) acc_elem = acc_elem->next;
+        if (following_chain) acc_elem = IMT_ACC_NEXT(acc_elem);
         if (!test_zero_elem(acc_elem)) bd.howmany++;
         bd.num = idx; /* we need to avoid this redundancy */
         following_chain = TRUE;
-      } while (acc_elem->next != NULL);
+      } while (IMT_ACC_NEXT(acc_elem) != NULL);
 
       enQueue_elem(sd, &rb, &bd, sizeof(struct bucket_desc), sizeof(struct bucket_desc));
       elem += sizeof(struct acc);
     }
-    if (rb.packed) send(sd, rb.buf, rb.packed, 0);
+    enQueue_flush(sd, &rb);
   }
   else if (q->type & WANT_MATCH || q->type & WANT_COUNTER) {
     unsigned int j;
@@ -243,6 +267,7 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
     q->what_to_count = config.what_to_count;
     q->what_to_count_2 = config.what_to_count_2;
     for (j = 0; j < uq->num; j++, bufptr += sizeof(struct query_entry)) {
+      if (!enQueue_spool_yield(sd, &rb)) break;
       memcpy(&request, bufptr, sizeof(struct query_entry));
       Log(LOG_DEBUG, "DEBUG ( %s/%s ): Searching into accounting structure ...\n", config.name, config.type); 
       if (request.what_to_count == config.what_to_count && request.what_to_count_2 == config.what_to_count_2) { 
@@ -261,46 +286,14 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 	prim_ptrs.pcust = request.pcust;
 	prim_ptrs.pvlen = request.pvlen;
 
-        acc_elem = search_accounting_structure(&prim_ptrs);
+        acc_elem = search_accounting_structure(table, &prim_ptrs);
         if (acc_elem) { 
 	  if (!test_zero_elem(acc_elem)) {
-	    enQueue_elem(sd, &rb, acc_elem, PdataSz, datasize);
-
-            if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
-              enQueue_elem(sd, &rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
-            }
-
-            if (extras->off_pkt_lbgp_primitives) {
-              if (acc_elem->clbgp) {
-                struct pkt_legacy_bgp_primitives tmp_plbgp;
-
-                cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
-                enQueue_elem(sd, &rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
-              }
-            }
-
-            if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
-              enQueue_elem(sd, &rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
-            }
-
-	    if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
-	      enQueue_elem(sd, &rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
-	    }
-
-            if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
-              enQueue_elem(sd, &rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
-            }
-
-	    if (extras->off_custom_primitives && acc_elem->pcust) {
-	      enQueue_elem(sd, &rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
-	    }
-
-	    if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
-	      enQueue_elem(sd, &rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
-	    }
+	    if (q->type & WANT_MATCH) imt_select_elem(sd, &rb, &sel, acc_elem, extras, datasize);
+	    else enQueue_acc(sd, &rb, acc_elem, extras, datasize);
 
 	    if (reset_counter) {
-	      if (forked) set_reset_flag(acc_elem);
+	      if (concurrent) set_reset_flag(acc_elem);
 	      else reset_counters(acc_elem);
 	    }
 	  }
@@ -367,10 +360,11 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 	struct pkt_tunnel_primitives ubuf;
 	struct pkt_data abuf;
         following_chain = FALSE;
-	elem = (unsigned char *) a;
+	elem = (unsigned char *) table;
 	memset(&abuf, 0, sizeof(abuf));
 
         for (idx = 0; idx < config.buckets; idx++) {
+          if (!enQueue_spool_yield(sd, &rb)) break;
           if (!following_chain) acc_elem = (struct acc *) elem;
 	  if (!test_zero_elem(acc_elem)) {
 	    /* XXX: support for custom and vlen primitives */
@@ -382,43 +376,12 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 		!memcmp(&mbuf, &request.pmpls, sizeof(struct pkt_mpls_primitives)) &&
 		!memcmp(&ubuf, &request.ptun, sizeof(struct pkt_tunnel_primitives))) {
 	      if (q->type & WANT_COUNTER) Accumulate_Counters(&abuf, acc_elem); 
-	      else {
-		enQueue_elem(sd, &rb, acc_elem, PdataSz, datasize); /* q->type == WANT_MATCH */
-
-                if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
-                  enQueue_elem(sd, &rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
-                }
-
-                if (extras->off_pkt_lbgp_primitives) {
-                  if (acc_elem->clbgp) {
-                    struct pkt_legacy_bgp_primitives tmp_plbgp;
-
-                    cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
-                    enQueue_elem(sd, &rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
-                  }
-                }
-
-                if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
-                  enQueue_elem(sd, &rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
-                }
-		if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
-		  enQueue_elem(sd, &rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
-		}
-                if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
-                  enQueue_elem(sd, &rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
-                }
-                if (extras->off_custom_primitives && acc_elem->pcust) {
-                  enQueue_elem(sd, &rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
-                }
-		if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
-		  enQueue_elem(sd, &rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
-		}
-	      }
+	      else imt_select_elem(sd, &rb, &sel, acc_elem, extras, datasize);
 	      if (reset_counter) set_reset_flag(acc_elem);
 	    }
           }
-          if (acc_elem->next) {
-            acc_elem = acc_elem->next;
+          if (IMT_ACC_NEXT(acc_elem)) {
+            acc_elem = IMT_ACC_NEXT(acc_elem);
             following_chain = TRUE;
             idx--;
           }
@@ -430,7 +393,8 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 	if (q->type & WANT_COUNTER) enQueue_elem(sd, &rb, &abuf, PdataSz, PdataSz); /* enqueue accumulated data */
       }
     }
-    if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
+    if (q->type & WANT_MATCH) imt_select_flush(sd, &rb, &sel, extras, datasize);
+    enQueue_flush(sd, &rb); /* send remainder data */
   }
   else if (q->type & WANT_CLASS_TABLE) {
     struct stripped_class dummy;
@@ -447,7 +411,7 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
 
     memset(&dummy, 0, sizeof(dummy));
     enQueue_elem(sd, &rb, &dummy, sizeof(dummy), sizeof(dummy));
-    if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
+    enQueue_flush(sd, &rb); /* send remainder data */
   }
   else if (q->type & WANT_CUSTOM_PRIMITIVES_TABLE) {
     struct imt_custom_primitives custom_primitives_registry;
@@ -471,16 +435,19 @@ void process_query_data(int sd, unsigned char *buf, int len, struct extra_primit
       memset(&dummy, 0, sizeof(dummy));
       enQueue_elem(sd, &rb, &dummy, sizeof(dummy), sizeof(dummy));
     }
-    if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
+    enQueue_flush(sd, &rb); /* send remainder data */
   }
   else if (q->type & WANT_ERASE_LAST_TSTAMP) {
     enQueue_elem(sd, &rb, &table_reset_stamp, sizeof(table_reset_stamp), sizeof(table_reset_stamp));
-    if (rb.packed) send(sd, rb.buf, rb.packed, 0); /* send remainder data */
+    enQueue_flush(sd, &rb); /* send remainder data */
   }
 
-  /* wait a bit due to setnonblocking() then send EOF */
-  usleep(1000);
-  send(sd, emptybuf, LARGEBUFLEN, 0);
+  imt_select_free(&sel);
+  imt_rcu_read_unlock(rb.rcu_epoch);
+
+  enQueue_spool_send(sd, &rb);
+
+  enQueue_eof(sd, &rb);
 
   if (dummy_pcust) free(dummy_pcust);
   if (custbuf) free(custbuf);
@@ -613,23 +580,423 @@ void mask_elem(struct pkt_primitives *d1, struct pkt_bgp_primitives *d2, struct
   }
 }
 
+/* with a timeout, sends don't block and the client is given up on if it
+   doesn't keep up: the plugin itself can't be held by a slow reader */
+static int enQueue_send(int sd, void *buf, int len, int timeout)
+{
+  struct pollfd pfd;
+  int ret, sent = 0;
+
+  while (sent < len) {
+    if (timeout) {
+      pfd.fd = sd;
+      pfd.events = POLLOUT;
+
+      ret = poll(&pfd, 1, timeout);
+      if (ret < 0) {
+        if (errno == EINTR) continue;
+        return ERR;
+      }
+      if (!ret) {
+        errno = ETIMEDOUT;
+        return ERR;
+      }
+    }
+
+    ret = send(sd, (unsigned char *)buf + sent, len - sent, timeout ? MSG_DONTWAIT : 0);
+    if (ret < 0) {
+      if (errno == EINTR || (timeout && errno == EAGAIN)) continue;
+      return ERR;
+    }
+
+    sent += ret;
+  }
+
+  return SUCCESS;
+}
+
+/* the plugin and its query threads share the table: replies are spooled
+   and sent only out of the read-side section, so that a slow client
+   can't hold a grace period up (see imt_rcu_read_lock()); the spool is
+   kept within IMT_REPLY_SPOOL_LEN by enQueue_spool_yield() */
+static int enQueue_out(int sd, struct reply_buffer *rb, void *buf, int len)
+{
+  unsigned char *spool;
+  size_t size;
+
+  if (!rb->defer) return enQueue_send(sd, buf, len, rb->timeout);
+
+  if ((rb->spool_len + len) > rb->spool_size) {
+    for (size = (rb->spool_size ? rb->spool_size : LARGEBUFLEN); size < (rb->spool_len + len); size *= 2);
+
+    spool = realloc(rb->spool, size);
+    if (!spool) return ERR;
+
+    rb->spool = spool;
+    rb->spool_size = size;
+  }
+
+  memcpy(rb->spool + rb->spool_len, buf, len);
+  rb->spool_len += len;
+
+  return SUCCESS;
+}
+
+static void enQueue_spool_out(int sd, struct reply_buffer *rb)
+{
+  if (rb->spool_len && !rb->err && enQueue_send(sd, rb->spool, rb->spool_len, rb->timeout) == ERR) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to send reply to client: %s\n", config.name, config.type, strerror(errno));
+    rb->err = TRUE;
+  }
+
+  rb->spool_len = 0;
+}
+
+/* to be called in between elements of the walk: once the spool is full,
+   the read-side section is left for it to be sent, then entered again.
+   Elements are never unlinked, so the walk can go on from where it was
+   unless the table got erased meanwhile. Returns FALSE once the walk
+   has to stop */
+int enQueue_spool_yield(int sd, struct reply_buffer *rb)
+{
+  if (rb->err) return FALSE;
+  if (!rb->defer || rb->spool_len < IMT_REPLY_SPOOL_LEN) return TRUE;
+
+  imt_rcu_read_unlock(rb->rcu_epoch);
+  enQueue_spool_out(sd, rb);
+  imt_rcu_read_lock(&rb->rcu_epoch);
+
+  if (!rb->err && __atomic_load_n(&imt_epoch->erased, __ATOMIC_RELAXED) != rb->erased) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to send reply to client: table erased meanwhile\n", config.name, config.type);
+    rb->err = TRUE;
+  }
+
+  return !rb->err;
+}
+
+void enQueue_spool_send(int sd, struct reply_buffer *rb)
+{
+  enQueue_spool_out(sd, rb);
+
+  if (rb->spool) free(rb->spool);
+  rb->spool = NULL;
+  rb->spool_len = 0;
+  rb->spool_size = 0;
+  rb->defer = FALSE;
+}
+
+/* a slow reader throttles the walk of the table rather than letting
+   replies pile up in memory: forked children block on the socket, query
+   threads queue chunks to the spool, which is sent out of the read-side
+   section whenever full, see enQueue_spool_yield() */
+static void enQueue_chunk(int sd, struct reply_buffer *rb, unsigned char *payload, int len, u_int8_t flags)
+{
+  struct imt_chunk_hdr hdr;
+  u_int32_t raw_len = len;
+
+  if (rb->err) return;
+
+#if defined WITH_ZLIB
+  if (len && (rb->stream_flags & IMT_STREAM_F_ZLIB)) {
+    uLongf zlen = compressBound(LARGEBUFLEN);
+
+    if (!rb->zbuf) rb->zbuf = malloc(zlen);
+
+    if (rb->zbuf && compress2(rb->zbuf, &zlen, payload, len, Z_BEST_SPEED) == Z_OK && zlen < len) {
+      payload = rb->zbuf;
+      len = zlen;
+      flags |= IMT_STREAM_F_ZLIB;
+    }
+  }
+#endif
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.version = rb->stream;
+  hdr.flags = flags;
+  hdr.len = htonl(len);
+  hdr.raw_len = htonl(raw_len);
+
+  if (enQueue_out(sd, rb, &hdr, sizeof(hdr)) == ERR || (len && enQueue_out(sd, rb, payload, len) == ERR)) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to send reply to client: %s\n", config.name, config.type, strerror(errno));
+    rb->err = TRUE;
+  }
+}
+
+static void enQueue_hdr(struct reply_buffer *rb)
+{
+  memcpy(rb->buf, rb->hdr, rb->hdr_len);
+  rb->ptr = rb->buf+rb->hdr_len;
+  rb->packed = rb->hdr_len;
+  rb->hdr = NULL;
+}
+
+void enQueue_flush(int sd, struct reply_buffer *rb)
+{
+  if (rb->hdr) enQueue_hdr(rb);
+  if (!rb->packed) return;
+
+  if (rb->stream) enQueue_chunk(sd, rb, rb->buf, rb->packed, 0);
+  else if (rb->defer) {
+    if (enQueue_out(sd, rb, rb->buf, rb->packed) == ERR) rb->err = TRUE;
+  }
+  else send(sd, rb->buf, rb->packed, 0);
+
+  rb->len = LARGEBUFLEN;
+  memset(rb->buf, 0, sizeof(rb->buf));
+  rb->packed = 0;
+  rb->ptr = rb->buf;
+}
+
+void enQueue_eof(int sd, struct reply_buffer *rb)
+{
+  if (rb->stream) enQueue_chunk(sd, rb, NULL, 0, IMT_STREAM_F_LAST);
+  else if (!rb->err) {
+    char emptybuf[LARGEBUFLEN];
+
+    memset(emptybuf, 0, LARGEBUFLEN);
+
+    /* wait a bit due to setnonblocking() then send EOF */
+    usleep(1000);
+    enQueue_send(sd, emptybuf, LARGEBUFLEN, rb->timeout);
+  }
+
+  if (rb->zbuf) {
+    free(rb->zbuf);
+    rb->zbuf = NULL;
+  }
+}
+
 void enQueue_elem(int sd, struct reply_buffer *rb, void *elem, int size, int tot_size)
 {
-  if ((rb->packed + tot_size) < rb->len) {
-    memcpy(rb->ptr, elem, size);
-    rb->ptr += size;
-    rb->packed += size; 
-  }
-  else {
-    send(sd, rb->buf, rb->packed, 0);
-    rb->len = LARGEBUFLEN;
-    memset(rb->buf, 0, sizeof(rb->buf));
-    rb->packed = 0;
-    rb->ptr = rb->buf;
-    memcpy(rb->ptr, elem, size);
-    rb->ptr += size;
-    rb->packed += size;
+  if (rb->hdr) enQueue_hdr(rb);
+  if ((rb->packed + tot_size) >= rb->len) enQueue_flush(sd, rb);
+
+  memcpy(rb->ptr, elem, size);
+  rb->ptr += size;
+  rb->packed += size; 
+}
+
+void enQueue_acc(int sd, struct reply_buffer *rb, struct acc *acc_elem, struct extra_primitives *extras, int datasize)
+{
+  enQueue_elem(sd, rb, acc_elem, PdataSz, datasize);
+
+  if (extras->off_pkt_bgp_primitives && acc_elem->pbgp) {
+    enQueue_elem(sd, rb, acc_elem->pbgp, PbgpSz, datasize - extras->off_pkt_bgp_primitives);
+  }
+
+  if (extras->off_pkt_lbgp_primitives) {
+    if (acc_elem->clbgp) {
+      struct pkt_legacy_bgp_primitives tmp_plbgp;
+
+      cache_to_pkt_legacy_bgp_primitives(&tmp_plbgp, acc_elem->clbgp);
+      enQueue_elem(sd, rb, &tmp_plbgp, PlbgpSz, datasize - extras->off_pkt_lbgp_primitives);
+    }
+  }
+
+  if (extras->off_pkt_nat_primitives && acc_elem->pnat) {
+    enQueue_elem(sd, rb, acc_elem->pnat, PnatSz, datasize - extras->off_pkt_nat_primitives);
   }
+
+  if (extras->off_pkt_mpls_primitives && acc_elem->pmpls) {
+    enQueue_elem(sd, rb, acc_elem->pmpls, PmplsSz, datasize - extras->off_pkt_mpls_primitives);
+  }
+
+  if (extras->off_pkt_tun_primitives && acc_elem->ptun) {
+    enQueue_elem(sd, rb, acc_elem->ptun, PtunSz, datasize - extras->off_pkt_tun_primitives);
+  }
+
+  if (extras->off_custom_primitives && acc_elem->pcust) {
+    enQueue_elem(sd, rb, acc_elem->pcust, config.cpptrs.len, datasize - extras->off_custom_primitives);
+  }
+
+  if (extras->off_pkt_vlen_hdr_primitives && acc_elem->pvlen) {
+    enQueue_elem(sd, rb, acc_elem->pvlen, PvhdrSz + acc_elem->pvlen->tot_len, datasize - extras->off_pkt_vlen_hdr_primitives);
+  }
+}
+
+static pm_counter_t imt_select_counter(struct acc *elem, u_int8_t counter)
+{
+  if (counter == IMT_COUNTER_PACKETS) return elem->packet_counter;
+  else if (counter == IMT_COUNTER_FLOWS) return elem->flow_counter;
+  else return elem->bytes_counter;
+}
+
+static int imt_select_filter(struct query_header *q, struct acc *elem)
+{
+  pm_counter_t value;
+  int idx;
+
+  for (idx = 0; idx < IMT_QUERY_FILTERS_MAX && q->filter[idx].op; idx++) {
+    value = imt_select_counter(elem, q->filter[idx].counter);
+
+    switch (q->filter[idx].op) {
+    case IMT_FILTER_EQ:
+      if (!(value == q->filter[idx].value)) return FALSE;
+      break;
+    case IMT_FILTER_LT:
+      if (!(value < q->filter[idx].value)) return FALSE;
+      break;
+    case IMT_FILTER_LE:
+      if (!(value <= q->filter[idx].value)) return FALSE;
+      break;
+    case IMT_FILTER_GT:
+      if (!(value > q->filter[idx].value)) return FALSE;
+      break;
+    case IMT_FILTER_GE:
+      if (!(value >= q->filter[idx].value)) return FALSE;
+      break;
+    default:
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static void imt_select_heap_down(struct imt_selected *heap, u_int32_t num, u_int32_t idx)
+{
+  struct imt_selected tmp;
+  u_int32_t min, left, right;
+
+  for (;;) {
+    min = idx;
+    left = (2 * idx) + 1;
+    right = left + 1;
+
+    if (left < num && heap[left].key < heap[min].key) min = left;
+    if (right < num && heap[right].key < heap[min].key) min = right;
+    if (min == idx) break;
+
+    tmp = heap[idx];
+    heap[idx] = heap[min];
+    heap[min] = tmp;
+    idx = min;
+  }
+}
+
+static void imt_select_heap_up(struct imt_selected *heap, u_int32_t idx)
+{
+  struct imt_selected tmp;
+  u_int32_t parent;
+
+  while (idx) {
+    parent = (idx - 1) / 2;
+    if (heap[parent].key <= heap[idx].key) break;
+
+    tmp = heap[idx];
+    heap[idx] = heap[parent];
+    heap[parent] = tmp;
+    idx = parent;
+  }
+}
+
+static int imt_select_cmp(const void *a, const void *b)
+{
+  const struct imt_selected *sa = a, *sb = b;
+
+  if (sa->key > sb->key) return -1;
+  if (sa->key < sb->key) return 1;
+
+  return 0;
+}
+
+void imt_select_init(struct imt_selection *sel, struct query_header *q)
+{
+  memset(sel, 0, sizeof(struct imt_selection));
+  sel->q = q;
+
+  /* top-N with a limit needs to hold only offset+limit entries */
+  if (q->topn && q->limit) {
+    if (q->offset > (0xffffffffU - q->limit)) sel->max = 0xffffffffU;
+    else sel->max = q->offset + q->limit;
+  }
+}
+
+/* hands an entry of the table over to the selection: it is either
+   queued right away or, for top-N queries, kept aside until the walk is
+   over. Returns TRUE once no more entries are needed */
+int imt_select_elem(int sd, struct reply_buffer *rb, struct imt_selection *sel, struct acc *elem,
+		    struct extra_primitives *extras, int datasize)
+{
+  struct query_header *q = sel->q;
+  pm_counter_t key;
+
+  if (!imt_select_filter(q, elem)) return FALSE;
+
+  if (!q->topn) {
+    if (q->limit && sel->sent >= q->limit) return TRUE;
+
+    if (sel->skipped < q->offset) sel->skipped++;
+    else {
+      enQueue_acc(sd, rb, elem, extras, datasize);
+      sel->sent++;
+    }
+
+    return (q->limit && sel->sent >= q->limit);
+  }
+
+  key = imt_select_counter(elem, q->topn);
+
+  /* bounded: min-heap of the best entries seen so far */
+  if (sel->max && sel->num == sel->max) {
+    if (key > sel->elems[0].key) {
+      sel->elems[0].key = key;
+      sel->elems[0].elem = elem;
+      imt_select_heap_down(sel->elems, sel->num, 0);
+    }
+
+    return FALSE;
+  }
+
+  if (sel->num == sel->size) {
+    struct imt_selected *elems;
+
+    sel->size = sel->size ? (sel->size * 2) : 1024;
+    if (sel->max && sel->size > sel->max) sel->size = sel->max;
+
+    elems = realloc(sel->elems, sel->size * sizeof(struct imt_selected));
+    if (!elems) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): imt_select_elem() unable to realloc(). Exiting ..\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+    sel->elems = elems;
+  }
+
+  sel->elems[sel->num].key = key;
+  sel->elems[sel->num].elem = elem;
+  sel->num++;
+  if (sel->max) imt_select_heap_up(sel->elems, sel->num - 1);
+
+  return FALSE;
+}
+
+/* queues entries kept aside by top-N queries, best first */
+void imt_select_flush(int sd, struct reply_buffer *rb, struct imt_selection *sel,
+		      struct extra_primitives *extras, int datasize)
+{
+  struct query_header *q = sel->q;
+  u_int32_t idx;
+
+  if (!q->topn || !sel->num) return;
+
+  qsort(sel->elems, sel->num, sizeof(struct imt_selected), imt_select_cmp);
+
+  for (idx = q->offset; idx < sel->num; idx++) {
+    if (q->limit && sel->sent >= q->limit) break;
+    if (!enQueue_spool_yield(sd, rb)) break;
+
+    /* the read-side section may have been left meanwhile */
+    if (test_zero_elem(sel->elems[idx].elem)) continue;
+
+    enQueue_acc(sd, rb, sel->elems[idx].elem, extras, datasize);
+    sel->sent++;
+  }
+}
+
+void imt_select_free(struct imt_selection *sel)
+{
+  if (sel->elems) free(sel->elems);
+  memset(sel, 0, sizeof(struct imt_selection));
 }
 
 void Accumulate_Counters(struct pkt_data *abuf, struct acc *elem)
@@ -642,7 +1009,7 @@ void Accumulate_Counters(struct pkt_data *abuf, struct acc *elem)
 
 int test_zero_elem(struct acc *elem)
 {
-  if (elem && elem->flow_type && !elem->reset_flag) return FALSE;
+  if (elem && __atomic_load_n(&elem->flow_type, __ATOMIC_ACQUIRE) && !__atomic_load_n(&elem->reset_flag, __ATOMIC_RELAXED)) return FALSE;
 
 /*
   if (elem) {
@@ -651,7 +1018,7 @@ int test_zero_elem(struct acc *elem)
       else return TRUE;
     }
     else {
-      if (elem->bytes_counter && !elem->reset_flag) return FALSE;
+      if (elem->bytes_counter && !__atomic_load_n(&elem->reset_flag, __ATOMIC_RELAXED)) return FALSE;
       else return TRUE;
     }
   }
@@ -1306,6 +1306,9 @@ int main(int argc,char **argv, char **envp)
 #endif
     }
 
+    /* BGP/BMP lookup results are referenced until plugins are fed */
+    bgp_rcu_read_lock();
+
     if (data_plugins) {
       switch(spp.datagramVersion = getData32(&spp)) {
       case 5:
@@ -1362,6 +1365,8 @@ int main(int argc,char **argv, char **envp)
     else if (tee_plugins) {
       process_SF_raw_packet(&spp, &pptrs, &req, (struct sockaddr *) &client);
     }
+
+    bgp_rcu_read_unlock();
     
     sigprocmask(SIG_UNBLOCK, &signal_set, NULL);
   }
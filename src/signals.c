@@ -116,15 +116,10 @@ void ignore_falling_child()
 void PM_sigint_handler(int signum)
 {
   struct plugins_list_entry *list = plugins_list;
-  char shutdown_msg[] = "pmacct received SIGINT - shutting down";
 
+  /* the BGP thread saves the RIB and closes the sessions itself */
   if (config.acct_type == ACCT_PMBGP || config.nfacctd_bgp == BGP_DAEMON_ONLINE) {
-    int idx;
-
-    for (idx = 0; idx < config.nfacctd_bgp_max_peers; idx++) {
-      if (peers[idx].fd)
-	bgp_peer_close(&peers[idx], FUNC_TYPE_BGP, TRUE, TRUE, BGP_NOTIFY_CEASE, BGP_NOTIFY_CEASE_ADMIN_SHUTDOWN, shutdown_msg);
-    }
+    if (!bgp_daemon_shutdown_request()) return;
   }
 
   if (config.syslog) closelog();
@@ -210,6 +205,10 @@ void push_stats()
     print_stats = TRUE;
   }
 
+  /* RIB slab figures are process-wide, see bgp_slab_stats_log() */
+  if (config.acct_type == ACCT_PMBGP || config.nfacctd_bgp == BGP_DAEMON_ONLINE) print_stats_bgp_thread = TRUE;
+  else if (config.acct_type == ACCT_PMBMP || config.nfacctd_bmp) print_stats_bmp_thread = TRUE;
+
 }
 
 void reload_maps()
@@ -40,6 +40,11 @@ char insert_nocounters_clause[LONGSRVBUFLEN];
 char insert_full_clause[LONGSRVBUFLEN];
 char values_clause[LONGLONGSRVBUFLEN];
 char *multi_values_buffer;
+char upsert_clause[LONGLONGSRVBUFLEN];
+char *upsert_buffer;
+int upsert_buffer_size;
+static u_int32_t *upsert_keys;
+static int upsert_keys_size;
 char where_clause[LONGLONGSRVBUFLEN];
 unsigned char *pipebuf;
 struct db_cache *sql_cache;
@@ -454,18 +459,21 @@ void sql_cache_handle_flush_event(struct insert_data *idata, time_t *refresh_dea
       pm_setproctitle("%s %s [%s]", config.type, "Plugin -- DB Writer", config.name);
       config.is_forked = TRUE;
 
-      if (qq_ptr) {
-        if (dump_writers_get_flags() == CHLD_WARNING) sql_db_fail(&p);
-        if (!strcmp(config.type, "mysql"))
-          (*sqlfunc_cbr.connect)(&p, config.sql_host);
-        else
-          (*sqlfunc_cbr.connect)(&p, NULL);
-      }
+      if (qq_ptr && config.sql_parallel_writers > 1) sql_cache_purge_parallel(idata);
+      else {
+        if (qq_ptr) {
+          if (dump_writers_get_flags() == CHLD_WARNING) sql_db_fail(&p);
+          if (!strcmp(config.type, "mysql"))
+            (*sqlfunc_cbr.connect)(&p, config.sql_host);
+          else
+            (*sqlfunc_cbr.connect)(&p, NULL);
+        }
 
-      /* qq_ptr check inside purge function along with a Log() call */
-      (*sqlfunc_cbr.purge)(sql_queries_queue, qq_ptr, idata);
+        /* qq_ptr check inside purge function along with a Log() call */
+        (*sqlfunc_cbr.purge)(sql_queries_queue, qq_ptr, idata);
 
-      if (qq_ptr) (*sqlfunc_cbr.close)(&bed);
+        if (qq_ptr) (*sqlfunc_cbr.close)(&bed);
+      }
 
       if (config.sql_trigger_exec) {
         if (idata->now > idata->triggertime) sql_trigger_exec(config.sql_trigger_exec);
@@ -503,6 +511,125 @@ void sql_cache_handle_flush_event(struct insert_data *idata, time_t *refresh_dea
   }
 }
 
+/*
+   Purges, over a connection of its own, the entries of the queue falling
+   into the given partition; these are first gathered into 'queue', which
+   may be the queue itself in a writer as it is not needed whole anymore.
+*/
+static void sql_cache_purge_partition(struct db_cache *queue[], int part, struct insert_data *idata)
+{
+  int idx, num;
+
+  for (idx = 0, num = 0; idx < qq_ptr; idx++) {
+    if ((sql_queries_queue[idx]->signature % config.sql_parallel_writers) == part)
+      queue[num++] = sql_queries_queue[idx];
+  }
+
+  if (num) {
+    if (dump_writers_get_flags() == CHLD_WARNING) sql_db_fail(&p);
+    if (!strcmp(config.type, "mysql"))
+      (*sqlfunc_cbr.connect)(&p, config.sql_host);
+    else
+      (*sqlfunc_cbr.connect)(&p, NULL);
+  }
+
+  (*sqlfunc_cbr.purge)(queue, num, idata);
+
+  if (num) (*sqlfunc_cbr.close)(&bed);
+}
+
+/*
+   Called by the DB writer in place of the purge function when
+   sql_parallel_writers is greater than one: the queue is split among as
+   many writers, each with its own connection and transaction. Entries
+   are partitioned by their hash so that a given row is always handled
+   by the same writer. A partition whose writer can't be forked is purged
+   in place. Returns once all writers are done.
+*/
+void sql_cache_purge_parallel(struct insert_data *idata)
+{
+  struct db_cache **part_queue = NULL;
+  struct timeval start, stop;
+  pid_t *writers, cpid;
+  int part, status, active = 0;
+  unsigned long elapsed, slowest = 0;
+
+  writers = malloc(config.sql_parallel_writers * sizeof(pid_t));
+  if (!writers) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (sql_cache_purge_parallel). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  /* writers are waited for below, not by the inherited handler */
+  signal(SIGCHLD, SIG_DFL);
+  gettimeofday(&start, NULL);
+
+  for (part = 0; part < config.sql_parallel_writers; part++) {
+    switch (writers[part] = fork()) {
+    case 0: /* Child */
+      pm_setproctitle("%s %s %u/%u [%s]", config.type, "Plugin -- DB Writer", part+1, config.sql_parallel_writers, config.name);
+
+      sql_cache_purge_partition(sql_queries_queue, part, idata);
+
+      exit_gracefully(0);
+    case -1:
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to fork DB writer %u/%u: %s. Purging in place.\n", config.name, config.type,
+	  part+1, config.sql_parallel_writers, strerror(errno));
+
+      /* the queue is still needed whole by the writers yet to be forked */
+      if (!part_queue) part_queue = malloc(qq_ptr * sizeof(struct db_cache *));
+      if (!part_queue) {
+        Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (sql_cache_purge_parallel). Exiting ..\n", config.name, config.type);
+        exit_gracefully(1);
+      }
+
+      sql_cache_purge_partition(part_queue, part, idata);
+
+      gettimeofday(&stop, NULL);
+      elapsed = ((stop.tv_sec - start.tv_sec) * 1000) + ((stop.tv_usec - start.tv_usec) / 1000);
+      if (elapsed > slowest) slowest = elapsed;
+      break;
+    default: /* Parent */
+      active++;
+      break;
+    }
+  }
+
+  while (active && (cpid = wait(&status)) > 0) {
+    for (part = 0; part < config.sql_parallel_writers; part++) {
+      if (writers[part] == cpid) break;
+    }
+    if (part == config.sql_parallel_writers) continue;
+
+    active--;
+    gettimeofday(&stop, NULL);
+    elapsed = ((stop.tv_sec - start.tv_sec) * 1000) + ((stop.tv_usec - start.tv_usec) / 1000);
+    if (elapsed > slowest) slowest = elapsed;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status))
+      Log(LOG_WARNING, "WARN ( %s/%s ): DB writer %u/%u (PID: %u) failed after %lu ms\n", config.name, config.type,
+	  part+1, config.sql_parallel_writers, cpid, elapsed);
+    else
+      Log(LOG_INFO, "INFO ( %s/%s ): DB writer %u/%u (PID: %u) done in %lu ms\n", config.name, config.type,
+	  part+1, config.sql_parallel_writers, cpid, elapsed);
+  }
+
+  if (slowest > (config.sql_refresh_time * 1000))
+    Log(LOG_WARNING, "WARN ( %s/%s ): Purging cache took %lu ms, longer than sql_refresh_time. Consider raising sql_parallel_writers.\n",
+	config.name, config.type, slowest);
+
+  /* query counters are per writer and are not summed up here */
+  if (config.sql_trigger_exec) {
+    idata->ten = qq_ptr;
+    idata->elap_time = (slowest / 1000);
+    idata->basetime = sql_queries_queue[0]->basetime;
+    SQL_SetENV_child(idata);
+  }
+
+  if (part_queue) free(part_queue);
+  free(writers);
+}
+
 struct db_cache *sql_cache_search(struct primitives_ptrs *prim_ptrs, time_t basetime)
 {
   struct pkt_data *pdata = prim_ptrs->data;
@@ -3026,7 +3153,7 @@ int sql_evaluate_primitives(int primitive)
     }
     strncat(insert_clause, "label", SPACELEFT(insert_clause));
     strncat(values[primitive].string, "\'%s\'", SPACELEFT(values[primitive].string));
-    strncat(where[primitive].string, "label=%\'%s\'", SPACELEFT(where[primitive].string));
+    strncat(where[primitive].string, "label=\'%s\'", SPACELEFT(where[primitive].string));
     values[primitive].type = where[primitive].type = COUNT_INT_LABEL;
     values[primitive].handler = where[primitive].handler = count_label_handler;
     primitive++;
@@ -3524,6 +3651,285 @@ int sql_compose_static_set(int have_flows)
   return set_primitives;
 }
 
+void sql_upsert_init()
+{
+  if (!config.sql_upsert_batch) return;
+
+  if (config.sql_dont_try_update) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_upsert_batch requires sql_dont_try_update set to false. Ignored.\n", config.name, config.type);
+    config.sql_upsert_batch = FALSE;
+    return;
+  }
+
+  if (config.sql_multi_values) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_multi_values does not apply to upserts (sql_upsert_batch). Ignored.\n", config.name, config.type);
+    config.sql_multi_values = FALSE;
+  }
+
+  /* sized for the common case; sql_upsert_append() grows it when needed */
+  upsert_buffer_size = (2 * LONGSRVBUFLEN) + LONGLONGSRVBUFLEN + (MIN(config.sql_upsert_batch, 1024) * SRVBUFLEN);
+  upsert_buffer = malloc(upsert_buffer_size);
+
+  /* hashes of the keys in the batch, see sql_upsert_has_key() */
+  for (upsert_keys_size = 64; upsert_keys_size < (2 * config.sql_upsert_batch); upsert_keys_size *= 2);
+  upsert_keys = calloc(upsert_keys_size, sizeof(u_int32_t));
+
+  if (!upsert_buffer || !upsert_keys) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): malloc() failed (sql_upsert_init). Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+}
+
+static int sql_upsert_where_has_column(int primitives, char *col)
+{
+  char *ptr;
+  int num, len = strlen(col);
+
+  for (num = 0; num < primitives; num++) {
+    for (ptr = strstr(where[num].string, col); ptr; ptr = strstr(ptr + 1, col)) {
+      if (ptr > where[num].string && (isalnum(*(ptr - 1)) || *(ptr - 1) == '_')) continue;
+      if (isalnum(ptr[len]) || ptr[len] == '_') continue;
+
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* the conflict target is made of the INSERT columns the WHERE clause matches
+   on, ie. the key the UPDATE path would look entries up with; stamp_updated
+   and tcp_flags are left out this way */
+int sql_compose_upsert_target(char *buf, int len, int primitives)
+{
+  char columns[LONGSRVBUFLEN], *ptr, *token;
+  int num = 0;
+
+  buf[0] = '\0';
+
+  ptr = strchr(insert_clause, '(');
+  if (!ptr) return ERR;
+  strlcpy(columns, ptr + 1, sizeof(columns));
+
+  for (ptr = columns; (token = strsep(&ptr, ",")); ) {
+    while (*token == ' ') token++;
+    if (!(*token) || !sql_upsert_where_has_column(primitives, token)) continue;
+
+    if (buf[0]) strncat(buf, ", ", len - strlen(buf) - 1);
+    strncat(buf, token, len - strlen(buf) - 1);
+    num++;
+  }
+
+  return num;
+}
+
+/* turns the SET clause into its upsert counterpart: counters are summed to
+   the existing ones, tcp_flags are OR'ed and stamp_updated is taken from the
+   proposed row; 'old' prefixes columns of the existing row, 'new_open' and
+   'new_close' wrap columns of the proposed one */
+void sql_compose_upsert_set(char *buf, int len, char *old, char *new_open, char *new_close)
+{
+  char tmpbuf[SRVBUFLEN];
+  int num;
+
+  buf[0] = '\0';
+
+  for (num = 0; set[num].type; num++) {
+    switch (set[num].type) {
+    case COUNT_INT_COUNTERS:
+      snprintf(tmpbuf, sizeof(tmpbuf), "packets=%spackets+%spackets%s, bytes=%sbytes+%sbytes%s",
+		old, new_open, new_close, old, new_open, new_close);
+      break;
+    case COUNT_INT_FLOWS:
+      snprintf(tmpbuf, sizeof(tmpbuf), "flows=%sflows+%sflows%s", old, new_open, new_close);
+      break;
+    case COUNT_INT_TCPFLAGS:
+      snprintf(tmpbuf, sizeof(tmpbuf), "tcp_flags=%stcp_flags|%stcp_flags%s", old, new_open, new_close);
+      break;
+    case TIMESTAMP:
+      snprintf(tmpbuf, sizeof(tmpbuf), "stamp_updated=%sstamp_updated%s", new_open, new_close);
+      break;
+    default:
+      continue;
+    }
+
+    if (buf[0]) strncat(buf, ", ", len - strlen(buf) - 1);
+    strncat(buf, tmpbuf, len - strlen(buf) - 1);
+  }
+}
+
+void sql_upsert_compose_values(struct db_cache *cache_elem, struct insert_data *idata)
+{
+  char *ptr_values, *ptr_where;
+  int num, have_flows = FALSE;
+
+  if (config.what_to_count & COUNT_FLOWS) have_flows = TRUE;
+
+  ptr_where = where_clause;
+  ptr_values = values_clause;
+  memset(where_clause, 0, sizeof(where_clause));
+  memset(values_clause, 0, sizeof(values_clause));
+
+  for (num = 0; num < idata->num_primitives; num++)
+    (*where[num].handler)(cache_elem, idata, num, &ptr_values, &ptr_where);
+
+#if defined HAVE_64BIT_COUNTERS
+  if (have_flows) snprintf(ptr_values, SPACELEFT(values_clause), ", %" PRIu64 ", %" PRIu64 ", %" PRIu64 ")", cache_elem->packet_counter, cache_elem->bytes_counter, cache_elem->flows_counter);
+  else snprintf(ptr_values, SPACELEFT(values_clause), ", %" PRIu64 ", %" PRIu64 ")", cache_elem->packet_counter, cache_elem->bytes_counter);
+#else
+  if (have_flows) snprintf(ptr_values, SPACELEFT(values_clause), ", %lu, %lu, %lu)", cache_elem->packet_counter, cache_elem->bytes_counter, cache_elem->flows_counter);
+  else snprintf(ptr_values, SPACELEFT(values_clause), ", %lu, %lu)", cache_elem->packet_counter, cache_elem->bytes_counter);
+#endif
+}
+
+/* appends values_clause as a new row of the batch; the INSERT head is written
+   on the first row as the table name may change across batches */
+void sql_upsert_append(struct insert_data *idata)
+{
+  char *row = values_clause + strlen(" VALUES");
+  int row_len = strlen(row), need;
+
+  if (!idata->mv.buffer_elem_num) {
+    idata->mv.buffer_offset = snprintf(upsert_buffer, upsert_buffer_size, "%s%s VALUES", insert_clause, insert_counters_clause);
+    idata->mv.head_buffer_elem = idata->current_queue_elem;
+  }
+
+  need = idata->mv.buffer_offset + row_len + strlen(upsert_clause) + 2;
+  if (need > upsert_buffer_size) {
+    char *new_buffer;
+    int new_size = MAX(need, (upsert_buffer_size * 2));
+
+    new_buffer = realloc(upsert_buffer, new_size);
+    if (!new_buffer) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): realloc() failed (sql_upsert_append). Exiting ..\n", config.name, config.type);
+      exit_gracefully(1);
+    }
+
+    upsert_buffer = new_buffer;
+    upsert_buffer_size = new_size;
+  }
+
+  if (idata->mv.buffer_elem_num) {
+    upsert_buffer[idata->mv.buffer_offset] = ',';
+    idata->mv.buffer_offset++;
+  }
+
+  memcpy(upsert_buffer + idata->mv.buffer_offset, row, row_len + 1);
+  idata->mv.buffer_offset += row_len;
+  idata->mv.buffer_elem_num++;
+}
+
+int sql_upsert_is_due(struct insert_data *idata)
+{
+  if (!idata->mv.buffer_elem_num) return FALSE;
+
+  return (idata->mv.last_queue_elem || idata->mv.buffer_elem_num >= config.sql_upsert_batch);
+}
+
+/* the tail is not accounted in buffer_offset so that a batch failed against
+   the primary can be sent as-is to the backup */
+char *sql_upsert_query(struct insert_data *idata)
+{
+  strlcpy(upsert_buffer + idata->mv.buffer_offset, upsert_clause, upsert_buffer_size - idata->mv.buffer_offset);
+
+  return upsert_buffer;
+}
+
+void sql_upsert_reset(struct insert_data *idata)
+{
+  idata->mv.buffer_elem_num = 0;
+  idata->mv.buffer_offset = 0;
+  idata->mv.head_buffer_elem = 0;
+  memset(upsert_keys, 0, upsert_keys_size * sizeof(u_int32_t));
+}
+
+/* PostgreSQL refuses a batch proposing the same key twice ("ON CONFLICT DO
+   UPDATE command cannot affect row a second time"), ie. entries which only
+   differ in primitives that are not part of the table: the key of the row
+   just composed, as its WHERE clause, is looked up among those in the batch
+   and added if missing. Only hashes are kept: a collision merely sends the
+   batch out earlier */
+static int sql_upsert_has_key(int add)
+{
+  u_int32_t hash = cache_crc32((unsigned char *) where_clause, strlen(where_clause));
+  int idx;
+
+  if (!hash) hash++;
+
+  for (idx = (hash & (upsert_keys_size - 1)); upsert_keys[idx]; idx = ((idx + 1) & (upsert_keys_size - 1))) {
+    if (upsert_keys[idx] == hash) return TRUE;
+  }
+
+  if (add) upsert_keys[idx] = hash;
+
+  return FALSE;
+}
+
+static int sql_upsert_flush(struct DBdesc *db, struct insert_data *idata, db_exec exec)
+{
+  int ret;
+
+  ret = (*exec)(db, sql_upsert_query(idata));
+  if (ret) {
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, upsert_buffer);
+    if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+
+    /* the batch is kept for the backup DB, if any */
+    if (!idata->recover || db->type != BE_TYPE_PRIMARY) sql_upsert_reset(idata);
+
+    return ret;
+  }
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): %d rows upserted.\n", config.name, config.type, idata->mv.buffer_elem_num);
+  idata->iqn++;
+  sql_upsert_reset(idata);
+
+  return FALSE;
+}
+
+/*
+   The op callback of all SQL plugins when sql_upsert_batch is set: rows are
+   batched into upsert_buffer and sent through 'exec', which runs a query and
+   returns non-zero, with db->errmsg set, on failure; 'dbop' is the plain
+   per-entry op, used for entries without counters.
+*/
+int sql_cache_dbop_upsert(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata, db_exec exec, db_op dbop)
+{
+  int ret;
+
+  if (sql_upsert_is_due(idata)) {
+    if ((ret = sql_upsert_flush(db, idata, exec))) return ret;
+  }
+
+  if (idata->mv.last_queue_elem) return FALSE;
+
+  /* event and option entries have no counters: they go the usual way */
+  if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION)
+    return (*dbop)(db, cache_elem, idata);
+
+  sql_upsert_compose_values(cache_elem, idata);
+
+  if (idata->mv.buffer_elem_num && sql_upsert_has_key(FALSE)) {
+    if ((ret = sql_upsert_flush(db, idata, exec))) return ret;
+  }
+
+  sql_upsert_has_key(TRUE);
+  sql_upsert_append(idata);
+  idata->een++;
+
+  return FALSE;
+}
+
+void sql_upsert_wrapup(struct BE_descs *bed, struct db_cache *elem, struct insert_data *idata)
+{
+  if (idata->mv.buffer_elem_num && elem) {
+    idata->mv.last_queue_elem = TRUE;
+    sql_query(bed, elem, idata);
+    idata->qn--; /* increased by sql_query() one time too much */
+    idata->mv.last_queue_elem = FALSE;
+  }
+}
+
 void primptrs_set_all_from_db_cache(struct primitives_ptrs *prim_ptrs, struct db_cache *entry)
 {
   struct pkt_data *data = prim_ptrs->data;
@@ -171,6 +171,7 @@ typedef void (*db_lock)(struct DBdesc *);
 typedef void (*db_unlock)(struct BE_descs *);
 typedef void (*db_create_table)(struct DBdesc *, char *);
 typedef int (*db_op)(struct DBdesc *, struct db_cache *, struct insert_data *); 
+typedef int (*db_exec)(struct DBdesc *, char *);
 typedef void (*sqlcache_purge)(struct db_cache *[], int, struct insert_data *);
 typedef void (*sqlbackend_create)(struct DBdesc *);
 struct sqlfunc_cb_registry {
@@ -329,6 +330,7 @@ extern void sql_cache_modulo(struct primitives_ptrs *, struct insert_data *);
 extern int sql_cache_flush(struct db_cache *[], int, struct insert_data *, int);
 extern void sql_cache_flush_pending(struct db_cache *[], int, struct insert_data *);
 extern void sql_cache_handle_flush_event(struct insert_data *, time_t *, struct ports_table *);
+extern void sql_cache_purge_parallel(struct insert_data *);
 extern void sql_cache_insert(struct primitives_ptrs *, struct insert_data *);
 extern struct db_cache *sql_cache_search(struct primitives_ptrs *, time_t);
 extern int sql_trigger_exec(char *);
@@ -344,6 +346,16 @@ extern void sql_invalidate_shadow_entries(struct db_cache *[], int *);
 extern int sql_select_locking_style(char *);
 extern int sql_compose_static_set(int); 
 extern int sql_compose_static_set_event(); 
+extern void sql_upsert_init();
+extern int sql_compose_upsert_target(char *, int, int);
+extern void sql_compose_upsert_set(char *, int, char *, char *, char *);
+extern void sql_upsert_compose_values(struct db_cache *, struct insert_data *);
+extern void sql_upsert_append(struct insert_data *);
+extern int sql_upsert_is_due(struct insert_data *);
+extern char *sql_upsert_query(struct insert_data *);
+extern void sql_upsert_reset(struct insert_data *);
+extern void sql_upsert_wrapup(struct BE_descs *, struct db_cache *, struct insert_data *);
+extern int sql_cache_dbop_upsert(struct DBdesc *, struct db_cache *, struct insert_data *, db_exec, db_op);
 extern void primptrs_set_all_from_db_cache(struct primitives_ptrs *, struct db_cache *);
 
 extern void sql_sum_host_insert(struct primitives_ptrs *, struct insert_data *);
@@ -369,6 +381,8 @@ extern char insert_nocounters_clause[LONGSRVBUFLEN];
 extern char insert_full_clause[LONGSRVBUFLEN];
 extern char values_clause[LONGLONGSRVBUFLEN];
 extern char *multi_values_buffer;
+extern char upsert_clause[LONGLONGSRVBUFLEN];
+extern char *upsert_buffer;
 extern char where_clause[LONGLONGSRVBUFLEN];
 extern unsigned char *pipebuf;
 extern struct db_cache *sql_cache;
@@ -38,6 +38,11 @@ char sqlite3_table_v7[] = "acct_v7";
 char sqlite3_table_v8[] = "acct_v8";
 char sqlite3_table_bgp[] = "acct_bgp";
 
+static struct sqli_stmt sqli_stmts[SQLI_STMT_MAX];
+static struct frags sqli_text_where[N_PRIMITIVES+2], sqli_text_values[N_PRIMITIVES+2];
+static int sqli_stmt_fallback;
+static int sqli_wal_frames[BE_TYPE_LOGFILE];
+
 /* Functions */
 void sqlite3_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr) 
 {
@@ -408,10 +413,156 @@ int SQLI_cache_dbop(struct DBdesc *db, struct db_cache *cache_elem, struct inser
   return ret;
 }
 
+static int SQLI_upsert_exec(struct DBdesc *db, char *query)
+{
+  int ret;
+
+  ret = sqlite3_exec(db->desc, query, NULL, NULL, NULL);
+  if (ret) SQLI_get_errmsg(db);
+
+  return ret;
+}
+
+int SQLI_cache_dbop_upsert(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  return sql_cache_dbop_upsert(db, cache_elem, idata, SQLI_upsert_exec, SQLI_cache_dbop);
+}
+
+static int SQLI_stmt_split_params(char *buf, char *params[])
+{
+  int num = 0;
+
+  for (; *buf; buf++) {
+    if (*buf == SQLI_STMT_PARAM_SEP) {
+      *buf = '\0';
+      if (num == SQLI_STMT_PARAMS_MAX) return ERR;
+      params[num] = (buf + 1);
+      num++;
+    }
+  }
+
+  return num;
+}
+
+static int SQLI_stmt_exec(struct DBdesc *db, struct sqli_stmt *stmt, char *text_params[], int text_num, struct db_cache *cache_elem)
+{
+  sqlite3_stmt *handle = stmt->handle[db->type];
+  int idx, text_idx = 0, ret = SQLITE_OK;
+
+  for (idx = 0; idx < stmt->nparams; idx++) {
+    if (stmt->sources[idx] == SQLI_PARAM_TEXT || stmt->sources[idx] == SQLI_PARAM_INT) text_idx++;
+  }
+
+  /* ie. a value containing SQLI_STMT_PARAM_SEP */
+  if (text_idx != text_num) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): statement expects %d values, got %d.\n", config.name, config.type, text_idx, text_num);
+    return TRUE;
+  }
+
+  if (!handle) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): statement not prepared.\n", config.name, config.type);
+    return TRUE;
+  }
+
+  sqlite3_reset(handle);
+
+  for (idx = 0, text_idx = 0; idx < stmt->nparams && ret == SQLITE_OK; idx++) {
+    switch (stmt->sources[idx]) {
+    case SQLI_PARAM_PACKETS:
+      ret = sqlite3_bind_int64(handle, (idx + 1), cache_elem->packet_counter);
+      break;
+    case SQLI_PARAM_BYTES:
+      ret = sqlite3_bind_int64(handle, (idx + 1), cache_elem->bytes_counter);
+      break;
+    case SQLI_PARAM_FLOWS:
+      ret = sqlite3_bind_int64(handle, (idx + 1), cache_elem->flows_counter);
+      break;
+    case SQLI_PARAM_TCP_FLAGS:
+      ret = sqlite3_bind_int(handle, (idx + 1), cache_elem->tcp_flags);
+      break;
+    case SQLI_PARAM_INT:
+      ret = sqlite3_bind_int64(handle, (idx + 1), strtoll(text_params[text_idx], NULL, 10));
+      text_idx++;
+      break;
+    default:
+      /* values_clause and where_clause outlive the step */
+      ret = sqlite3_bind_text(handle, (idx + 1), text_params[text_idx], -1, SQLITE_STATIC);
+      text_idx++;
+      break;
+    }
+  }
+
+  if (ret == SQLITE_OK) ret = sqlite3_step(handle);
+
+  if (ret != SQLITE_DONE) {
+    SQLI_get_errmsg(db);
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, sqlite3_sql(handle));
+    if (db->errmsg) Log(LOG_ERR, "ERROR ( %s/%s ): %s\n\n", config.name, config.type, db->errmsg);
+    sqlite3_reset(handle);
+
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* same as SQLI_cache_dbop() but stepping the statements prepared by
+   SQLI_prepare_statements(): handlers only emit the values of primitives,
+   see SQLI_compose_statements(), while counters are bound as integers */
+int SQLI_cache_dbop_prepared(struct DBdesc *db, struct db_cache *cache_elem, struct insert_data *idata)
+{
+  struct sqli_stmt *update_stmt, *insert_stmt;
+  char *ptr_values, *ptr_where, *where_params[SQLI_STMT_PARAMS_MAX], *values_params[SQLI_STMT_PARAMS_MAX];
+  int num, num_where, num_values, affected = 0;
+
+  if (sqli_stmt_fallback) return SQLI_cache_dbop(db, cache_elem, idata);
+
+  ptr_where = where_clause;
+  ptr_values = values_clause;
+  where_clause[0] = '\0';
+  values_clause[0] = '\0';
+
+  for (num = 0; num < idata->num_primitives; num++)
+    (*where[num].handler)(cache_elem, idata, num, &ptr_values, &ptr_where);
+
+  num_where = SQLI_stmt_split_params(where_clause, where_params);
+  num_values = SQLI_stmt_split_params(values_clause, values_params);
+  if (num_where == ERR || num_values == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): too many parameters (SQLI_cache_dbop_prepared).\n", config.name, config.type);
+    return TRUE;
+  }
+
+  if (cache_elem->flow_type == NF9_FTYPE_EVENT || cache_elem->flow_type == NF9_FTYPE_OPTION) {
+    update_stmt = &sqli_stmts[SQLI_STMT_UPDATE_EVENT];
+    insert_stmt = &sqli_stmts[SQLI_STMT_INSERT_EVENT];
+  }
+  else {
+    update_stmt = &sqli_stmts[SQLI_STMT_UPDATE];
+    insert_stmt = &sqli_stmts[SQLI_STMT_INSERT];
+  }
+
+  /* UPDATE is not prepared if switched off or if there is nothing to update */
+  if (update_stmt->in_use) {
+    if (SQLI_stmt_exec(db, update_stmt, where_params, num_where, cache_elem)) return TRUE;
+    affected = sqlite3_changes(db->desc);
+  }
+
+  if (!affected) {
+    if (SQLI_stmt_exec(db, insert_stmt, values_params, num_values, cache_elem)) return TRUE;
+    idata->iqn++;
+  }
+  else idata->uqn++;
+  idata->een++;
+
+  return FALSE;
+}
+
 void SQLI_cache_purge(struct db_cache *queue[], int index, struct insert_data *idata)
 {
   struct db_cache *LastElemCommitted = NULL;
+  struct timeval start_tv, end_tv;
   time_t start;
+  u_int64_t elap_ms;
   int j, stop, go_to_pending, saved_index = index;
   char orig_insert_clause[LONGSRVBUFLEN], orig_update_clause[LONGSRVBUFLEN], orig_lock_clause[LONGSRVBUFLEN];
   char tmpbuf[LONGLONGSRVBUFLEN], tmptable[SRVBUFLEN];
@@ -438,6 +589,7 @@ void SQLI_cache_purge(struct db_cache *queue[], int index, struct insert_data *i
 
   Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - START (PID: %u) ***\n", config.name, config.type, writer_pid);
   start = time(NULL);
+  gettimeofday(&start_tv, NULL);
 
   /* re-using pending queries queue stuff from parent and saving clauses */
   memcpy(sql_pending_queries_queue, queue, index*sizeof(struct db_cache *));
@@ -532,6 +684,11 @@ void SQLI_cache_purge(struct db_cache *queue[], int index, struct insert_data *i
   Log(LOG_INFO, "INFO ( %s/%s ): *** Purging cache - END (PID: %u, QN: %u/%u, ET: %lu) ***\n", 
 		config.name, config.type, writer_pid, idata->qn, saved_index, idata->elap_time); 
 
+  gettimeofday(&end_tv, NULL);
+  elap_ms = ((end_tv.tv_sec - start_tv.tv_sec) * 1000 + (end_tv.tv_usec - start_tv.tv_usec) / 1000);
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): purge throughput: %u rows in %llu ms (%llu rows/s)\n", config.name, config.type,
+	idata->een, (unsigned long long) elap_ms, (unsigned long long) (elap_ms ? (idata->een * 1000ULL / elap_ms) : idata->een));
+
   if (config.sql_trigger_exec) {
     if (queue && queue[0]) idata->basetime = queue[0]->basetime;
     idata->elap_time = time(NULL)-start;
@@ -609,6 +766,10 @@ int SQLI_compose_static_queries()
 
   /* "LOCK ..." stuff */
   if (config.sql_locking_style) Log(LOG_WARNING, "WARN ( %s/%s ): sql_locking_style is not supported. Ignored.\n", config.name, config.type);
+  if (config.sql_parallel_writers > 1) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_parallel_writers is not supported (SQLite serializes writers). Ignored.\n", config.name, config.type);
+    config.sql_parallel_writers = 1;
+  }
   snprintf(lock_clause, sizeof(lock_clause), "BEGIN");
   strncpy(unlock_clause, "COMMIT", sizeof(unlock_clause));
 
@@ -663,12 +824,250 @@ int SQLI_compose_static_queries()
     }
   }
 
+  if (config.sql_upsert_batch) SQLI_compose_upsert_clause(primitives);
+  else if (config.sql_use_prepared) SQLI_compose_statements(primitives);
+
   return primitives;
 }
 
+void SQLI_compose_upsert_clause(int primitives)
+{
+  char target[LONGSRVBUFLEN], set_buf[LONGSRVBUFLEN];
+
+  if (sql_compose_upsert_target(target, sizeof(target), primitives) <= 0) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): sql_upsert_batch: unable to compose the conflict target. Exiting ..\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  sql_compose_upsert_set(set_buf, sizeof(set_buf), "", "excluded.", "");
+  snprintf(upsert_clause, sizeof(upsert_clause), " ON CONFLICT (%s) DO UPDATE SET %s", target, set_buf);
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): upsert clause:%s\n", config.name, config.type, upsert_clause);
+}
+
+/*
+   Appends a clause template to a statement, turning each conversion into
+   a ? placeholder. If fmt is supplied, the conversions are also appended
+   to it, each alone after a SQLI_STMT_PARAM_SEP, so that handlers can emit
+   bare values from it. If sources is supplied, it tells which counter
+   each conversion stands for.
+*/
+static int SQLI_stmt_compose_clause(struct sqli_stmt *stmt, const char *tmpl, char *fmt, int fmtlen, const int *sources)
+{
+  char *out = stmt->text + strlen(stmt->text), conv;
+  const char *ptr = tmpl, *spec;
+  int len, spec_len, left, quoted;
+
+  while (*ptr) {
+    left = (sizeof(stmt->text) - (out - stmt->text));
+    if (left < SHORTSHORTBUFLEN) return ERR;
+
+    if (*ptr != '%') {
+      *out++ = *ptr++;
+      continue;
+    }
+
+    spec = ptr++;
+    while (*ptr && strchr("-+ #0'123456789.hlLqjzt", *ptr)) ptr++;
+    if (!*ptr) return ERR;
+
+    if (*ptr == '%') {
+      *out++ = '%';
+      ptr++;
+      continue;
+    }
+
+    /* function names, ie. MySQL INET_ATON(), can't be parameters */
+    if (*ptr == 's' && *(ptr + 1) == '(') return ERR;
+
+    conv = *ptr;
+    ptr++;
+    spec_len = (ptr - spec);
+
+    if (stmt->nparams == SQLI_STMT_PARAMS_MAX) return ERR;
+
+    /* quotes are no longer needed around a parameter */
+    quoted = FALSE;
+    if (out > stmt->text && *(out - 1) == '\'' && *ptr == '\'') {
+      out--;
+      ptr++;
+      quoted = TRUE;
+    }
+
+    if (sources) {
+      stmt->sources[stmt->nparams] = sources[0];
+      sources++;
+    }
+    /* integers are bound as such unless quoted, ie. meant as strings */
+    else if (!quoted && strchr("diu", conv)) stmt->sources[stmt->nparams] = SQLI_PARAM_INT;
+    else stmt->sources[stmt->nparams] = SQLI_PARAM_TEXT;
+
+    stmt->nparams++;
+    *out++ = '?';
+
+    if (fmt) {
+      len = strlen(fmt);
+      if ((len + spec_len + 2) > fmtlen) return ERR;
+      fmt[len] = SQLI_STMT_PARAM_SEP;
+      memcpy(&fmt[len + 1], spec, spec_len);
+      fmt[len + 1 + spec_len] = '\0';
+    }
+  }
+
+  *out = '\0';
+
+  return FALSE;
+}
+
+static int SQLI_stmt_compose_set(struct sqli_stmt *stmt, struct frags *set_frags)
+{
+  int counters[] = { SQLI_PARAM_PACKETS, SQLI_PARAM_BYTES }, flows[] = { SQLI_PARAM_FLOWS };
+  int tcp_flags[] = { SQLI_PARAM_TCP_FLAGS };
+  int num, *sources, ret = FALSE;
+
+  for (num = 0; set_frags[num].type && !ret; num++) {
+    switch (set_frags[num].type) {
+    case COUNT_INT_COUNTERS:
+      sources = counters;
+      break;
+    case COUNT_INT_FLOWS:
+      sources = flows;
+      break;
+    case COUNT_INT_TCPFLAGS:
+      sources = tcp_flags;
+      break;
+    default:
+      sources = NULL;
+      break;
+    }
+
+    /* no text parameters are expected in SET clauses */
+    if (!sources && strchr(set_frags[num].string, '%') && !strstr(set_frags[num].string, "%%")) return ERR;
+
+    ret = SQLI_stmt_compose_clause(stmt, set_frags[num].string, NULL, 0, sources);
+  }
+
+  return (ret ? ret : num);
+}
+
+/*
+   Builds the statements to be prepared out of the clause templates. The
+   WHERE and VALUES templates are then replaced by ones making handlers
+   emit just the values to be bound; the original ones are kept aside for
+   SQLI_prepare_fallback().
+*/
+void SQLI_compose_statements(int primitives)
+{
+  int num, num_set, num_set_event, ret = FALSE;
+  int counters[] = { SQLI_PARAM_PACKETS, SQLI_PARAM_BYTES, SQLI_PARAM_FLOWS };
+
+  memset(sqli_stmts, 0, sizeof(sqli_stmts));
+  memcpy(sqli_text_where, where, sizeof(sqli_text_where));
+  memcpy(sqli_text_values, values, sizeof(sqli_text_values));
+
+  for (num = 0; num < primitives && !ret; num++) {
+    where[num].string[0] = '\0';
+    values[num].string[0] = '\0';
+
+    ret = SQLI_stmt_compose_clause(&sqli_stmts[SQLI_STMT_INSERT], sqli_text_values[num].string, values[num].string, sizeof(values[num].string), NULL);
+  }
+
+  if (!ret) {
+    memcpy(&sqli_stmts[SQLI_STMT_INSERT_EVENT], &sqli_stmts[SQLI_STMT_INSERT], sizeof(struct sqli_stmt));
+    strncat(sqli_stmts[SQLI_STMT_INSERT_EVENT].text, ")", SPACELEFT(sqli_stmts[SQLI_STMT_INSERT_EVENT].text));
+
+    if (config.what_to_count & COUNT_FLOWS)
+      ret = SQLI_stmt_compose_clause(&sqli_stmts[SQLI_STMT_INSERT], ", %llu, %llu, %llu)", NULL, 0, counters);
+    else
+      ret = SQLI_stmt_compose_clause(&sqli_stmts[SQLI_STMT_INSERT], ", %llu, %llu)", NULL, 0, counters);
+  }
+
+  num_set = SQLI_stmt_compose_set(&sqli_stmts[SQLI_STMT_UPDATE], set);
+  num_set_event = SQLI_stmt_compose_set(&sqli_stmts[SQLI_STMT_UPDATE_EVENT], set_event);
+  if (num_set == ERR || num_set_event == ERR) ret = ERR;
+
+  for (num = 0; num < primitives && !ret; num++) {
+    ret = SQLI_stmt_compose_clause(&sqli_stmts[SQLI_STMT_UPDATE], sqli_text_where[num].string, where[num].string, sizeof(where[num].string), NULL);
+    if (!ret) ret = SQLI_stmt_compose_clause(&sqli_stmts[SQLI_STMT_UPDATE_EVENT], sqli_text_where[num].string, NULL, 0, NULL);
+  }
+
+  if (ret) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to compose prepared statements. Falling back to plain queries.\n", config.name, config.type);
+    SQLI_prepare_fallback();
+    return;
+  }
+
+  for (num = 0; num < SQLI_STMT_MAX; num++) {
+    if (num == SQLI_STMT_UPDATE && (config.sql_dont_try_update || !num_set)) continue;
+    if (num == SQLI_STMT_UPDATE_EVENT && (config.sql_dont_try_update || !num_set_event)) continue;
+
+    sqli_stmts[num].in_use = TRUE;
+    Log(LOG_DEBUG, "DEBUG ( %s/%s ): statement %d: %s\n", config.name, config.type, num, sqli_stmts[num].text);
+  }
+}
+
+void SQLI_prepare_fallback()
+{
+  memcpy(where, sqli_text_where, sizeof(sqli_text_where));
+  memcpy(values, sqli_text_values, sizeof(sqli_text_values));
+  sqli_stmt_fallback = TRUE;
+}
+
+/* called on every new transaction as clauses may change in between, ie.
+   in case of dynamic table names */
+void SQLI_prepare_statements(struct DBdesc *db)
+{
+  char buf[LARGEBUFLEN];
+  struct sqli_stmt *stmt;
+  int num, len;
+
+  SQLI_finalize_statements(db);
+
+  for (num = 0; num < SQLI_STMT_MAX; num++) {
+    stmt = &sqli_stmts[num];
+    if (!stmt->in_use) continue;
+
+    if (num == SQLI_STMT_INSERT) len = snprintf(buf, sizeof(buf), "%s%s%s", insert_clause, insert_counters_clause, stmt->text);
+    else if (num == SQLI_STMT_INSERT_EVENT) len = snprintf(buf, sizeof(buf), "%s%s%s", insert_clause, insert_nocounters_clause, stmt->text);
+    else len = snprintf(buf, sizeof(buf), "%s%s", update_clause, stmt->text);
+
+    if (len >= sizeof(buf)) {
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to prepare statements (statement too long). Falling back to plain queries.\n",
+	  config.name, config.type);
+      SQLI_finalize_statements(db);
+      SQLI_prepare_fallback();
+      return;
+    }
+
+    if (sqlite3_prepare_v2(db->desc, buf, -1, &stmt->handle[db->type], NULL) != SQLITE_OK) {
+      SQLI_get_errmsg(db);
+      Log(LOG_DEBUG, "DEBUG ( %s/%s ): FAILED query follows:\n%s\n", config.name, config.type, buf);
+      Log(LOG_WARNING, "WARN ( %s/%s ): Unable to prepare statements (%s). Falling back to plain queries.\n",
+	  config.name, config.type, db->errmsg);
+      SQLI_finalize_statements(db);
+      SQLI_prepare_fallback();
+      return;
+    }
+  }
+}
+
+void SQLI_finalize_statements(struct DBdesc *db)
+{
+  int num;
+
+  for (num = 0; num < SQLI_STMT_MAX; num++) {
+    if (sqli_stmts[num].handle[db->type]) {
+      sqlite3_finalize(sqli_stmts[num].handle[db->type]);
+      sqli_stmts[num].handle[db->type] = NULL;
+    }
+  }
+}
+
 void SQLI_Lock(struct DBdesc *db)
 {
   if (!db->fail) {
+    if (config.sql_use_prepared && !sqli_stmt_fallback) SQLI_prepare_statements(db);
+
     if (sqlite3_exec(db->desc, lock_clause, NULL, NULL, NULL)) {
       SQLI_get_errmsg(db);
       sql_db_errmsg(db);
@@ -679,8 +1078,15 @@ void SQLI_Lock(struct DBdesc *db)
 
 void SQLI_Unlock(struct BE_descs *bed)
 {
-  if (bed->p->connected) sqlite3_exec(bed->p->desc, unlock_clause, NULL, NULL, NULL);
-  if (bed->b->connected) sqlite3_exec(bed->b->desc, unlock_clause, NULL, NULL, NULL);
+  if (bed->p->connected) {
+    sqlite3_exec(bed->p->desc, unlock_clause, NULL, NULL, NULL);
+    if (config.sql_wal) SQLI_wal_checkpoint(bed->p);
+  }
+
+  if (bed->b->connected) {
+    sqlite3_exec(bed->b->desc, unlock_clause, NULL, NULL, NULL);
+    if (config.sql_wal) SQLI_wal_checkpoint(bed->b);
+  }
 }
 
 void SQLI_DB_Connect(struct DBdesc *db, char *host)
@@ -691,14 +1097,77 @@ void SQLI_DB_Connect(struct DBdesc *db, char *host)
       SQLI_get_errmsg(db);
       sql_db_errmsg(db);
     }
-    else sql_db_ok(db);
+    else {
+      sql_db_ok(db);
+      if (config.sql_wal) SQLI_wal_init(db);
+    }
+  }
+}
+
+static int SQLI_wal_mode_cb(void *is_wal, int ncols, char **cols, char **names)
+{
+  if (ncols && cols[0] && !strcasecmp(cols[0], "wal")) *((int *) is_wal) = TRUE;
+
+  return SQLITE_OK;
+}
+
+static int SQLI_wal_hook(void *frames, sqlite3 *desc, const char *dbname, int num)
+{
+  *((int *) frames) = num;
+
+  return SQLITE_OK;
+}
+
+/* the journal mode sticks to the database file, the rest to the connection;
+   automatic checkpoints are disabled in favour of SQLI_wal_checkpoint() */
+void SQLI_wal_init(struct DBdesc *db)
+{
+  int is_wal = FALSE;
+
+  if (sqlite3_exec(db->desc, "PRAGMA journal_mode=WAL", SQLI_wal_mode_cb, &is_wal, NULL) || !is_wal) {
+    SQLI_get_errmsg(db);
+    Log(LOG_WARNING, "WARN ( %s/%s ): Unable to switch %s to WAL journaling (%s).\n", config.name, config.type, db->filename, db->errmsg);
+    return;
+  }
+
+  if (sqlite3_exec(db->desc, "PRAGMA synchronous=NORMAL; PRAGMA wal_autocheckpoint=0", NULL, NULL, NULL)) {
+    SQLI_get_errmsg(db);
+    sql_db_warnmsg(db);
   }
+
+  sqli_wal_frames[db->type] = 0;
+  sqlite3_wal_hook(db->desc, SQLI_wal_hook, &sqli_wal_frames[db->type]);
+}
+
+/* run past the purge COMMIT so that it does not stretch the transaction;
+   a passive checkpoint never waits on readers */
+void SQLI_wal_checkpoint(struct DBdesc *db)
+{
+  int frames = 0, checkpointed = 0;
+
+  if (sqli_wal_frames[db->type] < config.sql_wal_checkpoint) return;
+
+  if (sqlite3_wal_checkpoint_v2(db->desc, NULL, SQLITE_CHECKPOINT_PASSIVE, &frames, &checkpointed) != SQLITE_OK) {
+    SQLI_get_errmsg(db);
+    sql_db_warnmsg(db);
+    return;
+  }
+
+  Log(LOG_DEBUG, "DEBUG ( %s/%s ): WAL checkpoint: %d/%d frames\n", config.name, config.type, checkpointed, frames);
+  sqli_wal_frames[db->type] = 0;
 }
 
 void SQLI_DB_Close(struct BE_descs *bed)
 {
-  if (bed->p->connected) sqlite3_close(bed->p->desc);
-  if (bed->b->connected) sqlite3_close(bed->b->desc);
+  if (bed->p->connected) {
+    SQLI_finalize_statements(bed->p);
+    sqlite3_close(bed->p->desc);
+  }
+
+  if (bed->b->connected) {
+    SQLI_finalize_statements(bed->b);
+    sqlite3_close(bed->b->desc);
+  }
 }
 
 void SQLI_create_dyn_table(struct DBdesc *db, char *buf)
@@ -731,7 +1200,9 @@ void SQLI_set_callbacks(struct sqlfunc_cb_registry *cbr)
   cbr->close = SQLI_DB_Close;
   cbr->lock = SQLI_Lock;
   cbr->unlock = SQLI_Unlock;
-  cbr->op = SQLI_cache_dbop;
+  if (config.sql_upsert_batch) cbr->op = SQLI_cache_dbop_upsert;
+  else if (config.sql_use_prepared) cbr->op = SQLI_cache_dbop_prepared;
+  else cbr->op = SQLI_cache_dbop;
   cbr->create_table = SQLI_create_dyn_table; 
   cbr->purge = SQLI_cache_purge;
   cbr->create_backend = SQLI_create_backend;
@@ -761,6 +1232,19 @@ void SQLI_init_default_values(struct insert_data *idata)
   
   if (config.sql_backup_host) idata->recover = TRUE;
 
+  sql_upsert_init();
+  if (config.sql_upsert_batch && config.sql_use_prepared) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_use_prepared does not apply to upserts (sql_upsert_batch). Ignored.\n", config.name, config.type);
+    config.sql_use_prepared = FALSE;
+  }
+
+  if (config.sql_use_prepared && config.sql_multi_values) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): sql_multi_values does not apply to prepared statements (sql_use_prepared). Ignored.\n", config.name, config.type);
+    config.sql_multi_values = FALSE;
+  }
+
+  if (!config.sql_wal_checkpoint) config.sql_wal_checkpoint = SQLI_WAL_CHECKPOINT_DEFAULT;
+
   if (config.sql_multi_values) {
     multi_values_buffer = malloc(config.sql_multi_values);
     if (!multi_values_buffer) {
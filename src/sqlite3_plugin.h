@@ -24,15 +24,54 @@
 
 #include "sql_common.h"
 
+/* defines */
+/* prepared statements (sql_use_prepared) */
+#define SQLI_STMT_INSERT	0
+#define SQLI_STMT_INSERT_EVENT	1
+#define SQLI_STMT_UPDATE	2
+#define SQLI_STMT_UPDATE_EVENT	3
+#define SQLI_STMT_MAX		4
+
+#define SQLI_STMT_PARAMS_MAX	(((N_PRIMITIVES+2)*2)+8)
+#define SQLI_STMT_PARAM_SEP	'\x1f'
+
+#define SQLI_PARAM_TEXT		0
+#define SQLI_PARAM_INT		1
+#define SQLI_PARAM_PACKETS	2
+#define SQLI_PARAM_BYTES	3
+#define SQLI_PARAM_FLOWS	4
+#define SQLI_PARAM_TCP_FLAGS	5
+
+/* WAL frames after which a checkpoint is run, same as SQLite default */
+#define SQLI_WAL_CHECKPOINT_DEFAULT	1000
+
+/* structures */
+struct sqli_stmt {
+  int in_use;
+  sqlite3_stmt *handle[BE_TYPE_LOGFILE]; /* per backend */
+  char text[LONGLONGSRVBUFLEN];	/* past the INSERT or UPDATE clause */
+  int nparams;
+  int sources[SQLI_STMT_PARAMS_MAX];
+};
+
 /* prototypes */
 void sqlite3_plugin(int, struct configuration *, void *);
 int SQLI_cache_dbop(struct DBdesc *, struct db_cache *, struct insert_data *);
+int SQLI_cache_dbop_upsert(struct DBdesc *, struct db_cache *, struct insert_data *);
+int SQLI_cache_dbop_prepared(struct DBdesc *, struct db_cache *, struct insert_data *);
 void SQLI_cache_purge(struct db_cache *[], int, struct insert_data *);
 int SQLI_evaluate_history(int);
 int SQLI_compose_static_queries();
+void SQLI_compose_upsert_clause(int);
+void SQLI_compose_statements(int);
+void SQLI_prepare_statements(struct DBdesc *);
+void SQLI_finalize_statements(struct DBdesc *);
+void SQLI_prepare_fallback();
 void SQLI_Lock(struct DBdesc *);
 void SQLI_Unlock(struct BE_descs *);
 void SQLI_DB_Connect(struct DBdesc *, char *);
+void SQLI_wal_init(struct DBdesc *);
+void SQLI_wal_checkpoint(struct DBdesc *);
 void SQLI_DB_Close(struct BE_descs *); 
 void SQLI_create_dyn_table(struct DBdesc *, char *);
 void SQLI_get_errmsg(struct DBdesc *);
@@ -23,6 +23,7 @@
 #include "pmacct.h"
 #include "addr.h"
 #include "thread_pool.h"
+#include "evloop.h"
 #include "bgp/bgp.h"
 #include "telemetry.h"
 #if defined WITH_RABBITMQ
@@ -69,7 +70,7 @@ void telemetry_daemon(void *t_data_void)
   telemetry_peer_cache tpc;
 
   int ret, rc, peers_idx, allowed, yes=1;
-  int peers_idx_rr = 0, max_peers_idx = 0, peers_num = 0;
+  int peers_num = 0;
   int data_decoder = 0, recv_flags = 0;
   u_int16_t port = 0;
   char *srv_proto = NULL;
@@ -84,9 +85,10 @@ void telemetry_daemon(void *t_data_void)
 
   sigset_t signal_set;
 
-  /* select() stuff */
-  fd_set read_descs, bkp_read_descs;
-  int fd, select_fd, bkp_select_fd, recalc_fds, select_num;
+  /* event loop stuff */
+  struct pm_evloop tele_evloop;
+  int fd, select_num, reads;
+  char peek_byte;
 
   /* logdump time management */
   time_t dump_refresh_deadline = {0};
@@ -371,10 +373,13 @@ void telemetry_daemon(void *t_data_void)
   }
 #endif
 
-  /* Preparing for syncronous I/O multiplexing */
-  select_fd = 0;
-  FD_ZERO(&bkp_read_descs);
-  FD_SET(config.telemetry_sock, &bkp_read_descs);
+  /* Preparing for syncronous I/O multiplexing; ZeroMQ has its own poll */
+  if (!config.telemetry_zmq_address) {
+    if (pm_evloop_init(&tele_evloop) == ERR || pm_evloop_add(&tele_evloop, config.telemetry_sock, NULL, PM_EVLOOP_LEVEL) == ERR) {
+      Log(LOG_ERR, "ERROR ( %s/%s ): unable to set up the event loop. Terminating thread.\n", config.name, t_data->log_str);
+      exit_gracefully(1);
+    }
+  }
 
   /* Preparing ACL, if any */
   if (config.telemetry_allow_file) load_allow_file(config.telemetry_allow_file, &allow);
@@ -419,9 +424,6 @@ void telemetry_daemon(void *t_data_void)
     if (config.telemetry_dump_kafka_topic) telemetry_dump_init_kafka_host();
   }
 
-  select_fd = bkp_select_fd = (config.telemetry_sock + 1);
-  recalc_fds = FALSE;
-
   telemetry_link_misc_structs(telemetry_misc_db);
 
   sigemptyset(&signal_set);
@@ -440,27 +442,6 @@ void telemetry_daemon(void *t_data_void)
       sigprocmask(SIG_BLOCK, &signal_set, NULL); 
     }
 
-    if (recalc_fds) {
-      select_fd = config.telemetry_sock;
-      max_peers_idx = -1; /* .. since valid indexes include 0 */
-
-      for (peers_idx = 0, peers_num = 0; peers_idx < config.telemetry_max_peers; peers_idx++) {
-	if (select_fd < telemetry_peers[peers_idx].fd) select_fd = telemetry_peers[peers_idx].fd;
-	if (telemetry_peers[peers_idx].fd > 0) {
-	  max_peers_idx = peers_idx;
-	  peers_num++;
-	}
-      }
-      select_fd++;
-      max_peers_idx++;
-
-      bkp_select_fd = select_fd;
-      recalc_fds = FALSE;
-    }
-    else select_fd = bkp_select_fd;
-
-    memcpy(&read_descs, &bkp_read_descs, sizeof(bkp_read_descs));
-
     if (telemetry_misc_db->dump_backend_methods) {
       int delta;
 
@@ -472,7 +453,7 @@ void telemetry_daemon(void *t_data_void)
     else drt_ptr = NULL;
 
     if (!config.telemetry_zmq_address) {
-      select_num = select(select_fd, &read_descs, NULL, NULL, drt_ptr);
+      select_num = pm_evloop_wait(&tele_evloop, drt_ptr);
       if (select_num < 0) goto select_again;
     }
 #if defined WITH_ZMQ
@@ -518,7 +499,6 @@ void telemetry_daemon(void *t_data_void)
 	      Log(LOG_INFO, "INFO ( %s/%s ): [%s] telemetry peer removed (timeout).\n", config.name, t_data->log_str, peer->addr_str);
 	      telemetry_peer_close(peer, FUNC_TYPE_TELEMETRY);
 	      peers_num--;
-	      recalc_fds = TRUE;
 	    }
 	  }
 	}
@@ -597,23 +577,36 @@ void telemetry_daemon(void *t_data_void)
     */
     if (!select_num) goto select_again;
 
+    next_event:
+    /* ZeroMQ: one message is taken per poll */
+    if (config.telemetry_zmq_address) {
+      if (!select_num) goto select_again;
+
+      fd = config.telemetry_sock;
+      select_num = 0;
+    }
+    else {
+      fd = pm_evloop_next(&tele_evloop, (void **) &peer);
+      if (fd == ERR) goto select_again;
+    }
+
     /* New connection is coming in */
-    if (FD_ISSET(config.telemetry_sock, &read_descs)) {
+    if (fd == config.telemetry_sock) {
       if (config.telemetry_port_tcp) {
         fd = accept(config.telemetry_sock, (struct sockaddr *) &client, &clen);
-        if (fd == ERR) goto read_data;
+        if (fd == ERR) goto next_event;
       }
       else if (config.telemetry_port_udp) {
 	char dummy_local_buf[TRUE];
 
 	ret = recvfrom(config.telemetry_sock, dummy_local_buf, TRUE, MSG_PEEK, (struct sockaddr *) &client, &clen);
-	if (ret <= 0) goto select_again;
+	if (ret <= 0) goto next_event;
 	else fd = config.telemetry_sock;
       }
 #if defined WITH_ZMQ
       else if (config.telemetry_zmq_address) {
 	ret = telemetry_decode_zmq_peer(t_data, &telemetry_zmq_host, zmq_peer_msg, sizeof(zmq_peer_msg), (struct sockaddr *) &client, &clen);
-	if (ret < 0) goto select_again; 
+	if (ret < 0) goto next_event;
 	else fd = config.telemetry_sock;
       }
 #endif
@@ -626,7 +619,7 @@ void telemetry_daemon(void *t_data_void)
 
       if (!allowed) {
         if (config.telemetry_port_tcp) close(fd);
-        goto read_data;
+        goto next_event;
       }
 
       /* XXX: UDP and ZeroMQ cases may be optimized further */
@@ -652,8 +645,6 @@ void telemetry_daemon(void *t_data_void)
 	  if (telemetry_peer_init(peer, FUNC_TYPE_TELEMETRY)) peer = NULL;
 
 	  if (peer) {
-	    recalc_fds = TRUE; // XXX: do we need this for ZeroMQ case?
-
 	    if (config.telemetry_port_udp || config.telemetry_zmq_address) {
 	      tpc.index = peers_idx;
 	      telemetry_peers_timeout[peers_idx].last_msg = t_data->now;
@@ -672,11 +663,10 @@ void telemetry_daemon(void *t_data_void)
         Log(LOG_ERR, "ERROR ( %s/%s ): Insufficient number of telemetry peers has been configured by telemetry_max_peers (%d).\n",
                         config.name, t_data->log_str, config.telemetry_max_peers);
         if (config.telemetry_port_tcp) close(fd);
-        goto read_data;
+        goto next_event;
       }
 
       peer->fd = fd;
-      if (config.telemetry_port_tcp) FD_SET(peer->fd, &bkp_read_descs);
       peer->addr.family = ((struct sockaddr *)&client)->sa_family;
       if (peer->addr.family == AF_INET) {
         peer->addr.address.ipv4.s_addr = ((struct sockaddr_in *)&client)->sin_addr.s_addr;
@@ -694,69 +684,76 @@ void telemetry_daemon(void *t_data_void)
       if (telemetry_misc_db->dump_backend_methods)
         telemetry_dump_init_peer(peer);
 
+      if (config.telemetry_port_tcp && pm_evloop_add(&tele_evloop, peer->fd, peer, PM_EVLOOP_EDGE) == ERR) {
+	telemetry_peer_close(peer, FUNC_TYPE_TELEMETRY);
+	goto next_event;
+      }
+
       peers_num++;
       Log(LOG_INFO, "INFO ( %s/%s ): [%s] telemetry peers usage: %u/%u\n",
 	  config.name, t_data->log_str, peer->addr_str, peers_num, config.telemetry_max_peers);
+
+      /* datagrams and ZeroMQ messages carry data already */
+      if (config.telemetry_port_tcp) goto next_event;
     }
 
     read_data:
 
     /*
-       We have something coming in: let's lookup which peer is that.
-       FvD: To avoid starvation of the "later established" peers, we
-       offset the start of the search in a round-robin style.
+       We have something coming in from a peer. TCP sockets are edge-triggered
+       hence we read until there is nothing left or, to avoid starvation of
+       other peers, PM_EVLOOP_READS_MAX times; in this case the peer is served
+       again in the next round. Datagrams and ZeroMQ messages are taken one
+       per event instead.
     */
-    if (config.telemetry_port_tcp) {
-      for (peer = NULL, peers_idx = 0; peers_idx < max_peers_idx; peers_idx++) {
-        int loc_idx = (peers_idx + peers_idx_rr) % max_peers_idx;
+    for (reads = 0; reads < PM_EVLOOP_READS_MAX; reads++) {
+      recv_flags = 0;
+
+      switch (config.telemetry_decoder_id) {
+      case TELEMETRY_DECODER_JSON:
+        ret = telemetry_recv_json(peer, 0, &recv_flags);
+        data_decoder = TELEMETRY_DATA_DECODER_JSON;
+        break;
+      case TELEMETRY_DECODER_GPB:
+        ret = telemetry_recv_gpb(peer, 0);
+        data_decoder = TELEMETRY_DATA_DECODER_GPB;
+        break;
+      case TELEMETRY_DECODER_CISCO_V0:
+        ret = telemetry_recv_cisco_v0(peer, &recv_flags, &data_decoder);
+        break;
+      case TELEMETRY_DECODER_CISCO_V1:
+        ret = telemetry_recv_cisco_v1(peer, &recv_flags, &data_decoder);
+        break;
+      default:
+        ret = TRUE; recv_flags = ERR;
+        data_decoder = TELEMETRY_DATA_DECODER_UNKNOWN;
+        break;
+      }
 
-        if (telemetry_peers[loc_idx].fd && FD_ISSET(telemetry_peers[loc_idx].fd, &read_descs)) {
-          peer = &telemetry_peers[loc_idx];
-          peers_idx_rr = (peers_idx_rr + 1) % max_peers_idx;
-          break;
+      if (ret <= 0) {
+        Log(LOG_INFO, "INFO ( %s/%s ): [%s] connection reset by peer (%d).\n", config.name, t_data->log_str, peer->addr_str, errno);
+        if (config.telemetry_port_tcp) pm_evloop_del(&tele_evloop, peer->fd);
+        telemetry_peer_close(peer, FUNC_TYPE_TELEMETRY);
+        peers_num--;
+        goto next_event;
+      }
+      else {
+        peer->stats.packets++;
+        if (recv_flags != ERR) {
+          peer->stats.msg_bytes += ret;
+          telemetry_process_data(peer, t_data, data_decoder);
         }
       }
-    }
 
-    if (!peer) goto select_again;
-
-    recv_flags = 0;
-
-    switch (config.telemetry_decoder_id) {
-    case TELEMETRY_DECODER_JSON:
-      ret = telemetry_recv_json(peer, 0, &recv_flags);
-      data_decoder = TELEMETRY_DATA_DECODER_JSON;
-      break;
-    case TELEMETRY_DECODER_GPB:
-      ret = telemetry_recv_gpb(peer, 0);
-      data_decoder = TELEMETRY_DATA_DECODER_GPB;
-      break;
-    case TELEMETRY_DECODER_CISCO_V0:
-      ret = telemetry_recv_cisco_v0(peer, &recv_flags, &data_decoder);
-      break;
-    case TELEMETRY_DECODER_CISCO_V1:
-      ret = telemetry_recv_cisco_v1(peer, &recv_flags, &data_decoder);
-      break;
-    default:
-      ret = TRUE; recv_flags = ERR;
-      data_decoder = TELEMETRY_DATA_DECODER_UNKNOWN;
-      break;
-    }
-
-    if (ret <= 0) {
-      Log(LOG_INFO, "INFO ( %s/%s ): [%s] connection reset by peer (%d).\n", config.name, t_data->log_str, peer->addr_str, errno);
-      FD_CLR(peer->fd, &bkp_read_descs);
-      telemetry_peer_close(peer, FUNC_TYPE_TELEMETRY);
-      peers_num--;
-      recalc_fds = TRUE;
-    }
-    else {
-      peer->stats.packets++;
-      if (recv_flags != ERR) {
-        peer->stats.msg_bytes += ret;
-        telemetry_process_data(peer, t_data, data_decoder);
-      }
+      if (!config.telemetry_port_tcp) goto next_event;
+
+      /* decoders read whole messages: check whether anything is left */
+      if (recv(peer->fd, &peek_byte, 1, (MSG_PEEK | MSG_DONTWAIT)) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	goto next_event;
     }
+
+    pm_evloop_again(&tele_evloop, peer->fd);
+    goto next_event;
   }
 }
 
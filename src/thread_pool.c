@@ -252,3 +252,14 @@ void send_to_pool(thread_pool_t *pool, void *function, void *data)
   pthread_cond_signal(worker->cond);
   pthread_mutex_unlock(worker->mutex);
 }
+
+int pool_has_free_worker(thread_pool_t *pool)
+{
+  int ret;
+
+  pthread_mutex_lock(pool->mutex);
+  ret = (pool->free_list != NULL);
+  pthread_mutex_unlock(pool->mutex);
+
+  return ret;
+}
@@ -65,6 +65,7 @@ typedef struct thread_pool {
 extern thread_pool_t *allocate_thread_pool(int);
 extern void deallocate_thread_pool(thread_pool_t **);
 extern void send_to_pool(thread_pool_t *, void *, void *);
+extern int pool_has_free_worker(thread_pool_t *);
 extern void *thread_runner(void *);
 
 #endif /* _THREAD_POOL_H_ */
@@ -0,0 +1,477 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+/*
+    The topk plugin tracks heavy hitters over each refresh interval in
+    fixed memory: a Space-Saving summary of topk_summary_entries counters
+    holds candidate keys while a Count-Min sketch bounds the estimate of
+    keys which entered the summary by evicting another one. At purge time
+    the topk_entries largest counters are handed to the print plugin
+    output functions along with their error bound.
+*/
+
+/* includes */
+#include "pmacct.h"
+#include "plugin_common.h"
+#include "plugin_cmn_spill.h"
+#include "plugin_cmn_json.h"
+#include "plugin_cmn_avro.h"
+#include "print_plugin.h"
+#include "topk_plugin.h"
+#include "jhash.h"
+
+/* global variables */
+struct topk_sketch topk;
+
+/* functions */
+void topk_plugin(int pipe_fd, struct configuration *cfgptr, void *ptr)
+{
+  int entries = (cfgptr->topk_entries ? cfgptr->topk_entries : DEFAULT_TOPK_ENTRIES);
+
+  /* the chained cache is only used to hand the top-K entries over to
+     the purge function: no need for it to be larger than that */
+  if (!cfgptr->print_cache_entries) cfgptr->print_cache_entries = ((entries / AVERAGE_CHAIN_LEN) + 1);
+
+  print_plugin(pipe_fd, cfgptr, ptr);
+}
+
+static pm_counter_t topk_metric_get(pm_counter_t bytes, pm_counter_t packets, pm_counter_t flows)
+{
+  switch (config.topk_metric) {
+  case TOPK_METRIC_PACKETS:
+    return packets;
+  case TOPK_METRIC_FLOWS:
+    return flows;
+  default:
+    return bytes;
+  }
+}
+
+static void topk_metric_set(struct chained_cache *cc, pm_counter_t value)
+{
+  switch (config.topk_metric) {
+  case TOPK_METRIC_PACKETS:
+    cc->packet_counter = value;
+    break;
+  case TOPK_METRIC_FLOWS:
+    cc->flow_counter = value;
+    break;
+  default:
+    cc->bytes_counter = value;
+    break;
+  }
+}
+
+#if defined (WITH_JANSSON) || defined (WITH_AVRO)
+/* name of the output field carrying the error bound */
+static char *topk_err_name()
+{
+  switch (config.topk_metric) {
+  case TOPK_METRIC_PACKETS:
+    return "packets_err";
+  case TOPK_METRIC_FLOWS:
+    return "flows_err";
+  default:
+    return "bytes_err";
+  }
+}
+#endif
+
+static u_int32_t topk_cms_index(u_int32_t hash, u_int32_t row)
+{
+  u_int32_t hash2 = jhash_1word(hash, row);
+
+  return ((row * topk.width) + (hash2 % topk.width));
+}
+
+static pm_counter_t topk_cms_update(u_int32_t hash, pm_counter_t value)
+{
+  pm_counter_t estimate = 0, *cell;
+  u_int32_t row;
+
+  for (row = 0; row < topk.depth; row++) {
+    cell = &topk.cms[topk_cms_index(hash, row)];
+    (*cell) += value;
+    if (!row || (*cell) < estimate) estimate = (*cell);
+  }
+
+  return estimate;
+}
+
+static pm_counter_t topk_cms_estimate(u_int32_t hash)
+{
+  pm_counter_t estimate = 0, cell;
+  u_int32_t row;
+
+  for (row = 0; row < topk.depth; row++) {
+    cell = topk.cms[topk_cms_index(hash, row)];
+    if (!row || cell < estimate) estimate = cell;
+  }
+
+  return estimate;
+}
+
+static void topk_heap_swap(u_int32_t a, u_int32_t b)
+{
+  struct topk_entry *tmp = topk.heap[a];
+
+  topk.heap[a] = topk.heap[b];
+  topk.heap[b] = tmp;
+  topk.heap[a]->heap_idx = a;
+  topk.heap[b]->heap_idx = b;
+}
+
+static void topk_heap_sift_up(u_int32_t idx)
+{
+  while (idx && topk.heap[(idx - 1) / 2]->count > topk.heap[idx]->count) {
+    topk_heap_swap(idx, ((idx - 1) / 2));
+    idx = ((idx - 1) / 2);
+  }
+}
+
+static void topk_heap_sift_down(u_int32_t idx)
+{
+  u_int32_t min, left, right;
+
+  for (;;) {
+    min = idx;
+    left = ((2 * idx) + 1);
+    right = ((2 * idx) + 2);
+
+    if (left < topk.entries_num && topk.heap[left]->count < topk.heap[min]->count) min = left;
+    if (right < topk.entries_num && topk.heap[right]->count < topk.heap[min]->count) min = right;
+    if (min == idx) break;
+
+    topk_heap_swap(idx, min);
+    idx = min;
+  }
+}
+
+static void topk_bucket_unlink(struct topk_entry *elem)
+{
+  struct topk_entry **ptr = &topk.buckets[elem->hash % topk.buckets_num];
+
+  for (; (*ptr); ptr = &(*ptr)->next) {
+    if ((*ptr) == elem) {
+      (*ptr) = elem->next;
+      break;
+    }
+  }
+
+  elem->next = NULL;
+}
+
+static void topk_bucket_link(struct topk_entry *elem)
+{
+  struct topk_entry **bucket = &topk.buckets[elem->hash % topk.buckets_num];
+
+  elem->next = (*bucket);
+  (*bucket) = elem;
+}
+
+static void topk_reset()
+{
+  u_int32_t idx;
+
+  memset(topk.cms, 0, (topk.width * topk.depth * sizeof(pm_counter_t)));
+  memset(topk.buckets, 0, (topk.buckets_num * sizeof(struct topk_entry *)));
+
+  for (idx = 0; idx < topk.entries_num; idx++) {
+    topk.entries[idx].cc.valid = PRINT_CACHE_FREE;
+    topk.entries[idx].next = NULL;
+  }
+
+  topk.entries_num = 0;
+  topk.total = 0;
+  topk.interval = refresh_deadline;
+}
+
+/* copies the key into a summary slot; extras buffers are allocated on
+   first use and recycled afterwards, variable-length ones excepted */
+static int topk_entry_set_key(struct topk_entry *elem, struct chained_cache *key)
+{
+  struct chained_cache *cc = &elem->cc;
+
+  memcpy(&cc->primitives, &key->primitives, sizeof(struct pkt_primitives));
+  cc->basetime = key->basetime;
+
+  if (key->pbgp) {
+    if (!cc->pbgp) cc->pbgp = (struct pkt_bgp_primitives *) malloc(PbgpSz);
+    if (!cc->pbgp) return ERR;
+    memcpy(cc->pbgp, key->pbgp, PbgpSz);
+  }
+
+  if (key->pnat) {
+    if (!cc->pnat) cc->pnat = (struct pkt_nat_primitives *) malloc(PnatSz);
+    if (!cc->pnat) return ERR;
+    memcpy(cc->pnat, key->pnat, PnatSz);
+  }
+
+  if (key->pmpls) {
+    if (!cc->pmpls) cc->pmpls = (struct pkt_mpls_primitives *) malloc(PmplsSz);
+    if (!cc->pmpls) return ERR;
+    memcpy(cc->pmpls, key->pmpls, PmplsSz);
+  }
+
+  if (key->ptun) {
+    if (!cc->ptun) cc->ptun = (struct pkt_tunnel_primitives *) malloc(PtunSz);
+    if (!cc->ptun) return ERR;
+    memcpy(cc->ptun, key->ptun, PtunSz);
+  }
+
+  if (key->pcust) {
+    if (!cc->pcust) cc->pcust = malloc(config.cpptrs.len);
+    if (!cc->pcust) return ERR;
+    memcpy(cc->pcust, key->pcust, config.cpptrs.len);
+  }
+
+  if (cc->pvlen) {
+    vlen_prims_free(cc->pvlen);
+    cc->pvlen = NULL;
+  }
+
+  if (key->pvlen) {
+    cc->pvlen = (struct pkt_vlen_hdr_primitives *) vlen_prims_copy(key->pvlen);
+    if (!cc->pvlen) return ERR;
+  }
+
+  cc->valid = PRINT_CACHE_INUSE;
+  cc->next = NULL;
+
+  return SUCCESS;
+}
+
+void topk_init()
+{
+  u_int64_t memory;
+
+  if (!config.topk_entries) config.topk_entries = DEFAULT_TOPK_ENTRIES;
+  if (!config.topk_summary_entries) config.topk_summary_entries = (config.topk_entries * DEFAULT_TOPK_SUMMARY_RATIO);
+  if (!config.topk_sketch_width) config.topk_sketch_width = DEFAULT_TOPK_SKETCH_WIDTH;
+  if (!config.topk_sketch_depth) config.topk_sketch_depth = DEFAULT_TOPK_SKETCH_DEPTH;
+
+  if (config.topk_summary_entries < config.topk_entries) {
+    Log(LOG_WARNING, "WARN ( %s/%s ): topk_summary_entries < topk_entries. Raising it to %u.\n", config.name, config.type, config.topk_entries);
+    config.topk_summary_entries = config.topk_entries;
+  }
+
+  if (config.topk_entries > (sa.num + config.print_cache_entries)) {
+    config.topk_entries = (sa.num + config.print_cache_entries);
+    Log(LOG_WARNING, "WARN ( %s/%s ): topk_entries capped to %u by print_cache_entries.\n", config.name, config.type, config.topk_entries);
+  }
+
+  if (config.what_to_count & (COUNT_SUM_HOST|COUNT_SUM_NET|COUNT_SUM_PORT|COUNT_SUM_AS|COUNT_SUM_MAC)) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): sum_* primitives are not supported by the topk plugin. Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  memset(&topk, 0, sizeof(topk));
+  topk.width = config.topk_sketch_width;
+  topk.depth = config.topk_sketch_depth;
+  topk.entries_max = config.topk_summary_entries;
+  topk.buckets_num = ((topk.entries_max * 2) + 1);
+
+  topk.cms = (pm_counter_t *) pm_malloc(topk.width * topk.depth * sizeof(pm_counter_t));
+  topk.entries = (struct topk_entry *) pm_malloc(topk.entries_max * sizeof(struct topk_entry));
+  topk.heap = (struct topk_entry **) pm_malloc(topk.entries_max * sizeof(struct topk_entry *));
+  topk.buckets = (struct topk_entry **) pm_malloc(topk.buckets_num * sizeof(struct topk_entry *));
+
+  memset(topk.entries, 0, (topk.entries_max * sizeof(struct topk_entry)));
+  topk_reset();
+
+  memory = ((topk.width * topk.depth * sizeof(pm_counter_t)) + (topk.entries_max * (sizeof(struct topk_entry) +
+	    sizeof(struct topk_entry *))) + (topk.buckets_num * sizeof(struct topk_entry *)));
+
+  Log(LOG_INFO, "INFO ( %s/%s ): top-K=%u summary entries=%u sketch=%ux%u sketch memory=%" PRIu64 " bytes\n",
+	config.name, config.type, config.topk_entries, topk.entries_max, topk.depth, topk.width, memory);
+
+  insert_func = topk_sketch_insert;
+  purge_func = topk_cache_purge;
+}
+
+void topk_sketch_insert(struct primitives_ptrs *prim_ptrs, struct insert_data *idata)
+{
+  struct pkt_data *data = prim_ptrs->data;
+  struct chained_cache probe;
+  struct topk_entry *elem;
+  pm_counter_t value, estimate;
+  u_int32_t hash;
+
+  /* first insert after a purge event: start a new interval */
+  if (topk.interval != refresh_deadline) topk_reset();
+
+  if (config.sql_history && (*basetime_eval)) {
+    memcpy(&ibasetime, &basetime, sizeof(ibasetime));
+    (*basetime_eval)(&data->time_start, &ibasetime, timeslot);
+  }
+
+  memset(&probe, 0, sizeof(probe));
+  memcpy(&probe.primitives, &data->primitives, sizeof(struct pkt_primitives));
+  probe.pbgp = prim_ptrs->pbgp;
+  probe.pnat = prim_ptrs->pnat;
+  probe.pmpls = prim_ptrs->pmpls;
+  probe.ptun = prim_ptrs->ptun;
+  probe.pcust = prim_ptrs->pcust;
+  probe.pvlen = prim_ptrs->pvlen;
+  if (basetime_cmp) probe.basetime = ibasetime;
+
+  value = topk_metric_get(data->pkt_len, data->pkt_num, data->flo_num);
+  hash = jhash_1word(probe.basetime.tv_sec, P_cache_hash(prim_ptrs));
+
+  estimate = topk_cms_update(hash, value);
+  topk.total += value;
+
+  for (elem = topk.buckets[hash % topk.buckets_num]; elem; elem = elem->next) {
+    if (elem->hash == hash && !P_cache_cmp(&elem->cc, &probe)) break;
+  }
+
+  if (elem) {
+    elem->count += value;
+    elem->cc.bytes_counter += data->pkt_len;
+    elem->cc.packet_counter += data->pkt_num;
+    elem->cc.flow_counter += data->flo_num;
+    elem->cc.flow_type = data->flow_type;
+    elem->cc.tcp_flags |= data->tcp_flags;
+
+    topk_heap_sift_down(elem->heap_idx);
+
+    return;
+  }
+
+  if (topk.entries_num < topk.entries_max) {
+    elem = &topk.entries[topk.entries_num];
+    elem->heap_idx = topk.entries_num;
+    topk.heap[topk.entries_num] = elem;
+    topk.entries_num++;
+
+    elem->count = value;
+    elem->err = 0;
+  }
+  else {
+    /* Space-Saving: the new key takes over the smallest counter, which
+       is an upper bound for its count so far; the Count-Min estimate
+       can only tighten it */
+    elem = topk.heap[0];
+    topk_bucket_unlink(elem);
+
+    elem->count = MIN((elem->count + value), estimate);
+    elem->err = (elem->count - value);
+  }
+
+  if (topk_entry_set_key(elem, &probe) == ERR) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): topk_sketch_insert() unable to malloc(). Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  elem->hash = hash;
+  elem->cc.bytes_counter = data->pkt_len;
+  elem->cc.packet_counter = data->pkt_num;
+  elem->cc.flow_counter = data->flo_num;
+  elem->cc.flow_type = data->flow_type;
+  elem->cc.tcp_flags = data->tcp_flags;
+
+  topk_bucket_link(elem);
+  topk_heap_sift_up(elem->heap_idx);
+  topk_heap_sift_down(elem->heap_idx);
+}
+
+static int topk_entry_cmp(const void *a, const void *b)
+{
+  const struct topk_entry *ea = *(struct topk_entry **)a;
+  const struct topk_entry *eb = *(struct topk_entry **)b;
+
+  if (ea->count == eb->count) return 0;
+
+  return (ea->count > eb->count ? -1 : 1);
+}
+
+/* queue is ignored: entries come from the summary. Counters other than
+   the ranking metric are lower bounds, ie. the traffic seen since the
+   key last entered the summary */
+void topk_cache_purge(struct chained_cache *queue[], int index, int safe_action)
+{
+  struct chained_cache **topk_queue;
+  struct topk_entry **sorted;
+  pm_counter_t estimate, lower;
+  u_int32_t idx, num = 0;
+
+  /* no inserts since the last purge event */
+  if (topk.interval == refresh_deadline) num = topk.entries_num;
+
+  sorted = malloc((num ? num : 1) * sizeof(struct topk_entry *));
+  topk_queue = malloc((num ? num : 1) * sizeof(struct chained_cache *));
+  if (!sorted || !topk_queue) {
+    Log(LOG_ERR, "ERROR ( %s/%s ): topk_cache_purge() unable to malloc(). Exiting.\n", config.name, config.type);
+    exit_gracefully(1);
+  }
+
+  for (idx = 0; idx < num; idx++) {
+    sorted[idx] = &topk.entries[idx];
+
+    estimate = MIN(sorted[idx]->count, topk_cms_estimate(sorted[idx]->hash));
+    lower = (sorted[idx]->count - sorted[idx]->err);
+
+    sorted[idx]->count = estimate;
+    sorted[idx]->err = (estimate > lower ? (estimate - lower) : 0);
+  }
+
+  qsort(sorted, num, sizeof(struct topk_entry *), topk_entry_cmp);
+
+  num = MIN(num, config.topk_entries);
+  for (idx = 0; idx < num; idx++) {
+    topk_metric_set(&sorted[idx]->cc, sorted[idx]->count);
+    sorted[idx]->cc.valid = PRINT_CACHE_COMMITTED;
+    topk_queue[idx] = &sorted[idx]->cc;
+  }
+
+  if (config.debug) Log(LOG_DEBUG, "DEBUG ( %s/%s ): topk_cache_purge(): total=%" PRIu64 " summary=%u\n",
+			config.name, config.type, (u_int64_t) topk.total, topk.entries_num);
+
+  P_cache_purge(topk_queue, num, safe_action);
+
+  free(sorted);
+  free(topk_queue);
+}
+
+#ifdef WITH_JANSSON
+void topk_compose_json(json_t *obj, struct chained_cache *cc)
+{
+  struct topk_entry *elem = (struct topk_entry *) cc;
+
+  json_object_set_new_nocheck(obj, topk_err_name(), json_integer((json_int_t)elem->err));
+}
+#endif
+
+#ifdef WITH_AVRO
+void topk_avro_schema_add(avro_schema_t schema)
+{
+  avro_schema_record_field_append(schema, topk_err_name(), avro_schema_long());
+}
+
+void topk_compose_avro(avro_value_t value, struct chained_cache *cc)
+{
+  struct topk_entry *elem = (struct topk_entry *) cc;
+  avro_value_t field;
+
+  pm_avro_check(avro_value_get_by_name(&value, topk_err_name(), &field, NULL));
+  pm_avro_check(avro_value_set_long(&field, elem->err));
+}
+#endif
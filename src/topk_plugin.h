@@ -0,0 +1,76 @@
+/*
+    pmacct (Promiscuous mode IP Accounting package)
+    pmacct is Copyright (C) 2003-2019 by Paolo Lucente
+*/
+
+/*
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+*/
+
+#ifndef TOPK_PLUGIN_H
+#define TOPK_PLUGIN_H
+
+/* defines */
+#define DEFAULT_TOPK_ENTRIES		100
+#define DEFAULT_TOPK_SUMMARY_RATIO	10
+#define DEFAULT_TOPK_SKETCH_WIDTH	2719
+#define DEFAULT_TOPK_SKETCH_DEPTH	4
+
+/* structures */
+/* Space-Saving counter; cc must stay first as purge functions are
+   handed pointers to it */
+struct topk_entry {
+  struct chained_cache cc;
+  pm_counter_t count;
+  pm_counter_t err;
+  u_int32_t hash;
+  u_int32_t heap_idx;
+  struct topk_entry *next;
+};
+
+struct topk_sketch {
+  pm_counter_t *cms;
+  u_int32_t width;
+  u_int32_t depth;
+  pm_counter_t total;
+
+  struct topk_entry *entries;
+  struct topk_entry **heap;
+  u_int32_t entries_num;
+  u_int32_t entries_max;
+
+  struct topk_entry **buckets;
+  u_int32_t buckets_num;
+
+  time_t interval;
+};
+
+/* prototypes */
+extern void topk_plugin(int, struct configuration *, void *);
+extern void topk_init();
+extern void topk_sketch_insert(struct primitives_ptrs *, struct insert_data *);
+extern void topk_cache_purge(struct chained_cache *[], int, int);
+#ifdef WITH_JANSSON
+extern void topk_compose_json(json_t *, struct chained_cache *);
+#endif
+#ifdef WITH_AVRO
+extern void topk_avro_schema_add(avro_schema_t);
+extern void topk_compose_avro(avro_value_t, struct chained_cache *);
+#endif
+
+/* global variables */
+extern struct topk_sketch topk;
+
+#endif //TOPK_PLUGIN_H